@@ -141,6 +141,18 @@ class TrackDaoTest {
         assertEquals(0.5f, trackDao.getTrackById(id)?.volume)
     }
 
+    @Test
+    fun updateFrozen_togglesFreeze() = runTest {
+        val id = trackDao.insertTrack(track(sortIndex = 0))
+        assertEquals(false, trackDao.getTrackById(id)?.isFrozen)
+
+        trackDao.updateFrozen(id, true)
+        assertEquals(true, trackDao.getTrackById(id)?.isFrozen)
+
+        trackDao.updateFrozen(id, false)
+        assertEquals(false, trackDao.getTrackById(id)?.isFrozen)
+    }
+
     /* ---------- delete ---------- */
 
     @Test
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "common.h"
 #include <atomic>
 #include <cstdint>
 
@@ -15,6 +16,13 @@ namespace nightjar {
  */
 struct AtomicTransport {
 
+    /**
+     * Engine sample rate: the first output stream's native rate. Written
+     * by OboePlaybackStream before its callbacks start, and kept across
+     * reopens, so every frame count in the engine uses this one rate.
+     */
+    std::atomic<int32_t> sampleRate{kDefaultSampleRate};
+
     /** True when playback is active. */
     std::atomic<bool> playing{false};
 
@@ -42,9 +50,6 @@ struct AtomicTransport {
      *  thread wakes up. */
     std::atomic<int64_t> pendingStartPos{0};
 
-    /** Project-level tempo in BPM. Read by the step sequencer on the render thread. */
-    std::atomic<double> bpm{120.0};
-
     /** Returns true if a loop region is active. */
     bool hasLoop() const {
         return loopStartFrames.load(std::memory_order_relaxed) >= 0 &&
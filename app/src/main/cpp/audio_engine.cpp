@@ -5,7 +5,15 @@
 #include "synth_engine.h"
 #include "step_sequencer.h"
 #include "midi_sequencer.h"
+#include "tempo_map.h"
+#include "offline_renderer.h"
+#include "track_freezer.h"
 #include "atomic_transport.h"
+#include "reclaimer.h"
+#include "engine_telemetry.h"
+#include "engine_status.h"
+#include "engine_commands.h"
+#include "resampler.h"
 #include "common.h"
 
 namespace nightjar {
@@ -22,23 +30,34 @@ bool AudioEngine::initialize() {
         return true;
     }
 
-    LOGD("AudioEngine initializing (sampleRate=%d, outputChannels=%d)",
-         kSampleRate, kOutputChannelCount);
+    LOGD("AudioEngine initializing (outputChannels=%d)", kOutputChannelCount);
 
-    recordingStream_ = std::make_unique<OboeRecordingStream>();
+    reclaimer_ = std::make_unique<Reclaimer>();
+    telemetry_ = std::make_unique<EngineTelemetry>();
+    status_ = std::make_unique<EngineStatus>();
     transport_ = std::make_unique<AtomicTransport>();
-    mixer_ = std::make_unique<TrackMixer>();
-    synthEngine_ = std::make_unique<SynthEngine>(*transport_);
-    playbackStream_ = std::make_unique<OboePlaybackStream>(*mixer_, *transport_, synthEngine_.get());
-
-    // Start the output stream — it sits idle (outputting silence) until play()
+    tempo_ = std::make_unique<TempoTrack>(*reclaimer_);
+    recordingStream_ = std::make_unique<OboeRecordingStream>(*telemetry_, *status_, *transport_);
+    mixer_ = std::make_unique<TrackMixer>(*reclaimer_, *transport_);
+    synthEngine_ = std::make_unique<SynthEngine>(*transport_, *tempo_, *reclaimer_, *telemetry_,
+                                                 *status_);
+    playbackStream_ = std::make_unique<OboePlaybackStream>(*mixer_, *transport_, *telemetry_,
+                                                           *status_, synthEngine_.get());
+    offlineRenderer_ = std::make_unique<OfflineRenderer>(*mixer_, synthEngine_.get(), *transport_);
+    trackFreezer_ = std::make_unique<TrackFreezer>(*synthEngine_, *reclaimer_, *transport_,
+                                                   *tempo_);
+
+    // Start the output stream — it outputs silence until play(), and parks
+    // itself once nothing has sounded for a while. Opening it also fixes the engine sample rate, so it must come
+    // before anything is loaded.
     if (!playbackStream_->start()) {
         LOGE("AudioEngine: failed to start playback stream");
         // Non-fatal — playback won't work but recording still can
     }
+    queueMixerCommands_ = playbackStream_->isStreamOpen();
 
     initialized_.store(true, std::memory_order_release);
-    LOGD("AudioEngine initialized successfully");
+    LOGD("AudioEngine initialized successfully (sampleRate=%d)", getSampleRate());
     return true;
 }
 
@@ -51,6 +70,16 @@ void AudioEngine::shutdown() {
         recordingStream_->stop();
     }
 
+    if (offlineRenderer_) {
+        offlineRenderer_->cancel();
+        offlineRenderer_->join();
+    }
+
+    if (trackFreezer_) {
+        trackFreezer_->cancel();
+        trackFreezer_->join();
+    }
+
     if (playbackStream_) {
         playbackStream_->stop();
     }
@@ -59,27 +88,68 @@ void AudioEngine::shutdown() {
         synthEngine_->stop();
     }
 
+    offlineRenderer_.reset();
+    trackFreezer_.reset();
     mixer_.reset();
     synthEngine_.reset();
-    transport_.reset();
     playbackStream_.reset();
     recordingStream_.reset();
+    tempo_.reset();
+    transport_.reset();
+    status_.reset();
+    telemetry_.reset();
+    reclaimer_.reset();
 
     initialized_.store(false, std::memory_order_release);
     LOGD("AudioEngine shut down");
 }
 
+int32_t AudioEngine::getSampleRate() const {
+    if (!transport_) return kDefaultSampleRate;
+    return transport_->sampleRate.load(std::memory_order_relaxed);
+}
+
 // ── Recording API ──────────────────────────────────────────────────────
 
-bool AudioEngine::startRecording(const char* filePath) {
+bool AudioEngine::startRecording(const char* filePath, bool splitTakesAtLoop) {
     if (!initialized_.load(std::memory_order_acquire)) {
         LOGE("AudioEngine: startRecording called but not initialized");
         return false;
     }
     if (!recordingStream_) {
-        recordingStream_ = std::make_unique<OboeRecordingStream>();
+        recordingStream_ = std::make_unique<OboeRecordingStream>(*telemetry_, *status_, *transport_);
+    }
+    wakeOutput();
+    return recordingStream_->start(std::string(filePath), splitTakesAtLoop);
+}
+
+bool AudioEngine::startDuplexRecording(const char* filePath, bool splitTakesAtLoop,
+                                       int64_t startMs) {
+    if (!initialized_.load(std::memory_order_acquire)) {
+        LOGE("AudioEngine: startDuplexRecording called but not initialized");
+        return false;
+    }
+    wakeOutput();
+    if (!playbackStream_ || !playbackStream_->isStreamOpen()) return false;
+    if (!recordingStream_) {
+        recordingStream_ = std::make_unique<OboeRecordingStream>(*telemetry_, *status_, *transport_);
+    }
+    if (!recordingStream_->startDuplex(std::string(filePath), splitTakesAtLoop,
+                                       msToFrames(startMs, getSampleRate()))) {
+        return false;
     }
-    return recordingStream_->start(std::string(filePath));
+    playbackStream_->setDuplexInput(recordingStream_.get());
+    return true;
+}
+
+int64_t AudioEngine::getRecordedStartMs() const {
+    if (!recordingStream_) return -1;
+    int64_t frame = recordingStream_->getRecordedStartFrame();
+    return frame < 0 ? -1 : framesToMs(frame, getSampleRate());
+}
+
+void AudioEngine::setInputMonitoring(bool enabled, float gain) {
+    if (playbackStream_) playbackStream_->setInputMonitoring(enabled ? std::max(gain, 0.0f) : 0.0f);
 }
 
 bool AudioEngine::awaitFirstBuffer(int timeoutMs) {
@@ -95,6 +165,8 @@ void AudioEngine::openWriteGate() {
 
 int64_t AudioEngine::stopRecording() {
     if (!recordingStream_) return -1;
+    // The output callback stops pulling a duplex input before it closes
+    if (playbackStream_) playbackStream_->setDuplexInput(nullptr);
     return recordingStream_->stop();
 }
 
@@ -108,13 +180,27 @@ float AudioEngine::getLatestPeakAmplitude() const {
     return recordingStream_->getLatestPeakAmplitude();
 }
 
+size_t AudioEngine::drainInputEnvelope(EnvelopePoint* out, size_t maxPoints) {
+    if (!recordingStream_) return 0;
+    return recordingStream_->drainEnvelope(out, maxPoints);
+}
+
 int64_t AudioEngine::getRecordedDurationMs() const {
     if (!recordingStream_) return 0;
     return recordingStream_->getRecordedDurationMs();
 }
 
+std::vector<std::string> AudioEngine::getRecordedTakePaths() const {
+    if (!recordingStream_ || recordingStream_->isActive()) return {};
+    return recordingStream_->getTakePaths();
+}
+
 // ── Playback API ───────────────────────────────────────────────────────
 
+bool AudioEngine::prepareTrackFile(const char* filePath) {
+    return prepareTakeFile(std::string(filePath), getSampleRate());
+}
+
 bool AudioEngine::addTrack(int trackId, const char* filePath,
                            int64_t durationMs, int64_t offsetMs,
                            int64_t trimStartMs, int64_t trimEndMs,
@@ -147,7 +233,14 @@ void AudioEngine::removeAllTracks() {
 
 void AudioEngine::play() {
     if (!transport_) return;
+    if (offlineRenderer_ && offlineRenderer_->isRunning()) {
+        // The synth render thread is parked while exporting; playing now
+        // would be WAV-only and fight the export for FluidSynth.
+        LOGW("AudioEngine: play ignored while an export is running");
+        return;
+    }
 
+    wakeOutput();
     int64_t countIn = countInFrames_.exchange(0, std::memory_order_relaxed);
 
     int64_t pos = transport_->posFrames.load(std::memory_order_relaxed);
@@ -161,6 +254,10 @@ void AudioEngine::play() {
 
     int64_t startPos = pos - countIn;  // negative if count-in > 0
 
+    // Usually already cued by seekTo(); this covers play-from-end. The
+    // start position is faulted in before the callback is let loose on it.
+    if (mixer_) mixer_->cueAt(kCueSeek, std::max<int64_t>(pos, 0), true);
+
     transport_->posFrames.store(startPos, std::memory_order_relaxed);
     transport_->pendingStartPos.store(startPos, std::memory_order_release);
     // Defensive: always request a flush before transitioning to playing.
@@ -168,29 +265,37 @@ void AudioEngine::play() {
     // against the start position, all-sounds-off any leftover voices,
     // and re-issues per-channel program changes -- the latter closes a
     // race where the first scheduled noteOn after start could land
-    // before FluidSynth has applied the program from updateMidiTracks,
+    // before FluidSynth has applied the program from stageMidiTracks,
     // making the first pass sound as Acoustic Grand regardless of the
     // selected instrument. Also closes the suspected pause->seek->play
     // silence race where the wasPlaying transition was missed.
     if (synthEngine_) synthEngine_->requestFlush();
     transport_->playing.store(true, std::memory_order_release);
     LOGD("AudioEngine: play (pos=%lldms, countIn=%lldms)",
-         (long long)framesToMs(startPos), (long long)framesToMs(countIn));
+         (long long)framesToMs(startPos, getSampleRate()),
+         (long long)framesToMs(countIn, getSampleRate()));
 }
 
 void AudioEngine::pause() {
     if (!transport_) return;
     transport_->playing.store(false, std::memory_order_release);
     LOGD("AudioEngine: pause (pos=%lldms)",
-         (long long)framesToMs(transport_->posFrames.load(std::memory_order_relaxed)));
+         (long long)framesToMs(transport_->posFrames.load(std::memory_order_relaxed),
+                               getSampleRate()));
 }
 
 void AudioEngine::seekTo(int64_t positionMs) {
     if (!transport_) return;
-    int64_t frames = msToFrames(positionMs);
+    int64_t frames = msToFrames(positionMs, getSampleRate());
     int64_t total = transport_->totalFrames.load(std::memory_order_relaxed);
     frames = std::max((int64_t)0, std::min(frames, total));
+    // While playing, the callback jumps on the store below; make the
+    // target resident first so the jump doesn't page-fault.
+    if (mixer_) mixer_->cueAt(kCueSeek, frames, true);
     transport_->posFrames.store(frames, std::memory_order_relaxed);
+    // The callback publishes the position; a parked stream would leave
+    // the UI at the old one
+    wakeOutput();
 }
 
 bool AudioEngine::isPlaying() const {
@@ -200,30 +305,258 @@ bool AudioEngine::isPlaying() const {
 
 int64_t AudioEngine::getPositionMs() const {
     if (!transport_) return 0;
-    return framesToMs(transport_->posFrames.load(std::memory_order_relaxed));
+    return framesToMs(transport_->posFrames.load(std::memory_order_relaxed), getSampleRate());
 }
 
 int64_t AudioEngine::getTotalDurationMs() const {
     if (!transport_) return 0;
-    return framesToMs(transport_->totalFrames.load(std::memory_order_relaxed));
+    return framesToMs(transport_->totalFrames.load(std::memory_order_relaxed), getSampleRate());
 }
 
-// ── Per-track controls ─────────────────────────────────────────────────
+// ── Command channel ────────────────────────────────────────────────────
+
+int AudioEngine::submitCommands(const uint8_t* data, size_t size) {
+    if (!initialized_.load(std::memory_order_acquire)) return -1;
+    std::lock_guard<std::mutex> lock(commandMutex_);
+
+    CommandBatchReader batch;
+    // A truncated batch is refused whole rather than applied up to the cut
+    if (!batch.open(data, size) || !batch.validate()) return -1;
+
+    std::vector<MixerCommand> mixerCommands;
+    std::vector<SynthCommand> synthCommands;
+    int failed = 0;
+    CommandOp op;
+    CommandReader payload(nullptr, 0);
+    while (batch.next(op, payload)) {
+        if (!applyCommand(op, payload, mixerCommands, synthCommands)) ++failed;
+    }
+
+    if (queueMixerCommands_) {
+        mixer_->post(mixerCommands.data(), mixerCommands.size());
+    } else {
+        mixer_->apply(mixerCommands.data(), mixerCommands.size());
+    }
+    synthEngine_->post(synthCommands.data(), synthCommands.size());
 
-void AudioEngine::setTrackVolume(int trackId, float volume) {
-    if (mixer_) mixer_->setTrackVolume(trackId, volume);
+    if (!batch.complete()) return -1;
+    return failed;
 }
 
-void AudioEngine::setTrackMuted(int trackId, bool muted) {
-    if (mixer_) mixer_->setTrackMuted(trackId, muted);
+/** The clip and event arrays shared by the MIDI commands, borrowed from the batch. */
+struct MidiClipArrays {
+    const int64_t* offsetsMs = nullptr;
+    const int64_t* lengthsMs = nullptr;
+    const int32_t* eventCounts = nullptr;
+    int32_t clipCount = 0;
+    const int64_t* ticks = nullptr;
+    const int32_t* channels = nullptr;
+    const int32_t* notes = nullptr;
+    const int32_t* velocities = nullptr;
+};
+
+/** Read [out] and check it holds [clipCount] clips (-1: any) and all their events. */
+static bool readMidiClipArrays(CommandReader& in, MidiClipArrays& out, int64_t clipCount) {
+    int32_t lengths, eventCounts, ticks, channels, notes, velocities;
+    out.offsetsMs = in.i64s(out.clipCount);
+    out.lengthsMs = in.i64s(lengths);
+    out.eventCounts = in.i32s(eventCounts);
+    out.ticks = in.i64s(ticks);
+    out.channels = in.i32s(channels);
+    out.notes = in.i32s(notes);
+    out.velocities = in.i32s(velocities);
+    if (!in.ok() || lengths != out.clipCount || eventCounts != out.clipCount ||
+        (clipCount >= 0 && out.clipCount != clipCount)) {
+        return false;
+    }
+    int64_t events = 0;
+    for (int32_t c = 0; c < out.clipCount; ++c) {
+        if (out.eventCounts[c] < 0) return false;
+        events += out.eventCounts[c];
+    }
+    return events == ticks && events == channels && events == notes && events == velocities;
+}
+
+/** Sum of [count] non-negative counts, or -1 if one is negative. */
+static int64_t sumCounts(const int32_t* counts, int32_t count) {
+    int64_t total = 0;
+    for (int32_t i = 0; i < count; ++i) {
+        if (counts[i] < 0) return -1;
+        total += counts[i];
+    }
+    return total;
+}
+
+bool AudioEngine::applyCommand(CommandOp op, CommandReader& in,
+                               std::vector<MixerCommand>& mixer,
+                               std::vector<SynthCommand>& synth) {
+    switch (op) {
+        case CommandOp::TrackVolume:
+        case CommandOp::TrackMuted:
+        case CommandOp::TrackPan:
+        case CommandOp::BusVolume:
+        case CommandOp::BusMuted: {
+            MixerCommand command;
+            command.id = in.i32();
+            switch (op) {
+                case CommandOp::TrackVolume:
+                    command.op = MixerCommand::Op::TrackVolume;
+                    command.value = in.f32();
+                    break;
+                case CommandOp::TrackMuted:
+                    command.op = MixerCommand::Op::TrackMuted;
+                    command.value = in.boolean() ? 1.0f : 0.0f;
+                    break;
+                case CommandOp::TrackPan:
+                    command.op = MixerCommand::Op::TrackPan;
+                    command.value = in.f32();
+                    break;
+                case CommandOp::BusVolume:
+                    command.op = MixerCommand::Op::BusVolume;
+                    command.value = in.f32();
+                    break;
+                default:
+                    command.op = MixerCommand::Op::BusMuted;
+                    command.value = in.boolean() ? 1.0f : 0.0f;
+                    break;
+            }
+            if (!in.ok()) return false;
+            mixer.push_back(command);
+            return true;
+        }
+
+        case CommandOp::SetBpm: {
+            double bpm = in.f64();
+            if (!in.ok()) return false;
+            setBpm(bpm);
+            return true;
+        }
+
+        case CommandOp::SetTempoMap: {
+            int32_t count, bpmCount, bpbCount;
+            const int64_t* startTicks = in.i64s(count);
+            const double* bpms = in.f64s(bpmCount);
+            const int32_t* beatsPerBar = in.i32s(bpbCount);
+            if (!in.ok() || bpmCount != count || bpbCount != count) return false;
+            setTempoMap(startTicks, bpms, beatsPerBar, count);
+            return true;
+        }
+
+        case CommandOp::DrumPatternClips: {
+            float volume = in.f32();
+            bool muted = in.boolean();
+            int32_t patterns, totalSteps, beatsPerBar, hitCounts;
+            const int32_t* patternStepsPerBar = in.i32s(patterns);
+            const int32_t* patternTotalSteps = in.i32s(totalSteps);
+            const int32_t* patternBeatsPerBar = in.i32s(beatsPerBar);
+            const int32_t* patternHitCounts = in.i32s(hitCounts);
+            int32_t steps, notes, velocities, clips, offsets;
+            const int32_t* hitStepIndices = in.i32s(steps);
+            const int32_t* hitDrumNotes = in.i32s(notes);
+            const float* hitVelocities = in.f32s(velocities);
+            const int32_t* clipPatterns = in.i32s(clips);
+            const int64_t* clipOffsetsMs = in.i64s(offsets);
+            if (!in.ok() || totalSteps != patterns || beatsPerBar != patterns ||
+                hitCounts != patterns || offsets != clips) {
+                return false;
+            }
+            int64_t hits = sumCounts(patternHitCounts, patterns);
+            if (hits != steps || hits != notes || hits != velocities) return false;
+            stageDrumPatternClips(volume, muted, patternStepsPerBar, patternTotalSteps,
+                                  patternBeatsPerBar, patternHitCounts, patterns,
+                                  hitStepIndices, hitDrumNotes, hitVelocities,
+                                  clipPatterns, clipOffsetsMs, clips);
+            synth.push_back({SynthCommand::Op::CommitDrumPatterns, 0});
+            return true;
+        }
+
+        case CommandOp::DrumSequencerEnabled:
+        case CommandOp::MidiSequencerEnabled: {
+            SynthCommand command;
+            command.op = op == CommandOp::DrumSequencerEnabled
+                ? SynthCommand::Op::DrumSequencerEnabled
+                : SynthCommand::Op::MidiSequencerEnabled;
+            command.value = in.boolean() ? 1 : 0;
+            if (!in.ok()) return false;
+            synth.push_back(command);
+            return true;
+        }
+
+        case CommandOp::MidiTracks: {
+            int32_t tracks, programs, volumes, muted, clipCounts;
+            const int32_t* channels = in.i32s(tracks);
+            const int32_t* trackPrograms = in.i32s(programs);
+            const float* trackVolumes = in.f32s(volumes);
+            const uint8_t* trackMuted = in.u8s(muted);
+            const int32_t* trackClipCounts = in.i32s(clipCounts);
+            if (!in.ok() || programs != tracks || volumes != tracks || muted != tracks ||
+                clipCounts != tracks) {
+                return false;
+            }
+            int64_t clipTotal = sumCounts(trackClipCounts, tracks);
+            MidiClipArrays clips;
+            if (clipTotal < 0 || !readMidiClipArrays(in, clips, clipTotal)) return false;
+            stageMidiTracks(channels, trackPrograms, trackVolumes, trackMuted, tracks,
+                            trackClipCounts, clips.offsetsMs, clips.lengthsMs,
+                            clips.eventCounts, clips.ticks, clips.channels, clips.notes,
+                            clips.velocities);
+            synth.push_back({SynthCommand::Op::CommitMidiTracks, 0});
+            return true;
+        }
+
+        case CommandOp::MidiTrack: {
+            int32_t trackIndex = in.i32();
+            int32_t channel = in.i32();
+            int32_t program = in.i32();
+            float volume = in.f32();
+            bool muted = in.boolean();
+            MidiClipArrays clips;
+            if (!readMidiClipArrays(in, clips, -1)) return false;
+            return updateMidiTrack(trackIndex, channel, program, volume, muted,
+                                   clips.offsetsMs, clips.lengthsMs, clips.eventCounts,
+                                   clips.clipCount, clips.ticks, clips.channels, clips.notes,
+                                   clips.velocities);
+        }
+
+        case CommandOp::MidiTrackRange: {
+            int32_t trackIndex = in.i32();
+            int64_t startMs = in.i64();
+            int64_t endMs = in.i64();
+            MidiClipArrays clips;
+            if (!readMidiClipArrays(in, clips, -1)) return false;
+            return replaceMidiTrackRange(trackIndex, startMs, endMs,
+                                         clips.offsetsMs, clips.lengthsMs, clips.eventCounts,
+                                         clips.clipCount, clips.ticks, clips.channels,
+                                         clips.notes, clips.velocities);
+        }
+    }
+
+    LOGW("AudioEngine: skipping unknown command %u", static_cast<unsigned>(op));
+    return false;
+}
+
+// ── Routing ────────────────────────────────────────────────────────────
+
+void AudioEngine::setTrackBus(int trackId, int32_t busId) {
+    if (mixer_) mixer_->setTrackBus(trackId, busId);
+}
+
+bool AudioEngine::addBus(int32_t busId) {
+    return mixer_ && mixer_->addBus(busId);
+}
+
+void AudioEngine::removeBus(int32_t busId) {
+    if (mixer_) mixer_->removeBus(busId);
 }
 
 // ── Loop ───────────────────────────────────────────────────────────────
 
 void AudioEngine::setLoopRegion(int64_t startMs, int64_t endMs) {
     if (!transport_) return;
-    transport_->loopStartFrames.store(msToFrames(startMs), std::memory_order_relaxed);
-    transport_->loopEndFrames.store(msToFrames(endMs), std::memory_order_relaxed);
+    int32_t rate = getSampleRate();
+    transport_->loopStartFrames.store(msToFrames(startMs, rate), std::memory_order_relaxed);
+    transport_->loopEndFrames.store(msToFrames(endMs, rate), std::memory_order_relaxed);
+    if (mixer_) mixer_->cueAt(kCueLoopStart, msToFrames(startMs, rate));
     LOGD("AudioEngine: setLoopRegion %lld-%lldms", (long long)startMs, (long long)endMs);
 }
 
@@ -231,6 +564,7 @@ void AudioEngine::clearLoopRegion() {
     if (!transport_) return;
     transport_->loopStartFrames.store(-1, std::memory_order_relaxed);
     transport_->loopEndFrames.store(-1, std::memory_order_relaxed);
+    if (mixer_) mixer_->cueAt(kCueLoopStart, -1);
     LOGD("AudioEngine: clearLoopRegion");
 }
 
@@ -238,6 +572,7 @@ void AudioEngine::clearLoopRegion() {
 
 void AudioEngine::setRecording(bool active) {
     if (transport_) {
+        if (active) wakeOutput();
         transport_->recording.store(active, std::memory_order_relaxed);
     }
 }
@@ -251,9 +586,9 @@ int64_t AudioEngine::getLoopResetCount() const {
 
 // ── Synth API ──────────────────────────────────────────────────────────
 
-bool AudioEngine::loadSoundFont(const char* path) {
+bool AudioEngine::loadSoundFont(const char* path, bool lazySamples) {
     if (!synthEngine_) return false;
-    bool ok = synthEngine_->loadSoundFont(std::string(path));
+    bool ok = synthEngine_->loadSoundFont(std::string(path), lazySamples);
     if (ok) {
         synthEngine_->start();
         LOGD("AudioEngine: SoundFont loaded, synth render thread started");
@@ -262,6 +597,7 @@ bool AudioEngine::loadSoundFont(const char* path) {
 }
 
 void AudioEngine::synthNoteOn(int channel, int note, int velocity) {
+    wakeOutput();
     if (synthEngine_) synthEngine_->noteOn(channel, note, velocity);
 }
 
@@ -274,6 +610,8 @@ void AudioEngine::synthProgramChange(int channel, int program) {
 }
 
 void AudioEngine::synthRequestPreviewFlush() {
+    // Ahead of a preview note: start a parked stream as early as possible
+    wakeOutput();
     if (synthEngine_) synthEngine_->requestPreviewFlush();
 }
 
@@ -281,6 +619,22 @@ void AudioEngine::setSynthVolume(float volume) {
     if (synthEngine_) synthEngine_->setVolume(volume);
 }
 
+void AudioEngine::setSynthLatencyProfile(int profile) {
+    if (!synthEngine_) return;
+    synthEngine_->setLatencyProfile(profile == static_cast<int>(SynthLatencyProfile::LiveInput)
+                                        ? SynthLatencyProfile::LiveInput
+                                        : SynthLatencyProfile::Play);
+}
+
+int AudioEngine::getSynthQualityTier() const {
+    if (!synthEngine_) return static_cast<int>(SynthQualityTier::Full);
+    return static_cast<int>(synthEngine_->getQualityTier());
+}
+
+float AudioEngine::getSynthRenderLoad() const {
+    return synthEngine_ ? synthEngine_->getRenderLoad() : 0.0f;
+}
+
 void AudioEngine::synthAllSoundsOff() {
     if (synthEngine_) synthEngine_->allSoundsOff();
 }
@@ -306,128 +660,175 @@ void AudioEngine::updateDrumPattern(int stepsPerBar, int bars, int64_t offsetMs,
     }
 
     // Convert clip offsets from ms to frames
+    int32_t rate = getSampleRate();
     std::vector<int64_t> clipOffsetFrames;
     if (clipOffsetsMs != nullptr && clipCount > 0) {
         clipOffsetFrames.reserve(clipCount);
         for (int i = 0; i < clipCount; ++i) {
-            clipOffsetFrames.push_back(msToFrames(clipOffsetsMs[i]));
+            clipOffsetFrames.push_back(msToFrames(clipOffsetsMs[i], rate));
         }
     }
 
     synthEngine_->updateDrumPattern(
-        stepsPerBar, bars, msToFrames(offsetMs), volume, muted, hits, clipOffsetFrames,
+        stepsPerBar, bars, msToFrames(offsetMs, rate), volume, muted, hits, clipOffsetFrames,
         beatsPerBar);
 
     // Recompute total frames to include drum pattern end
-    if (transport_) {
-        double bpm = transport_->bpm.load(std::memory_order_relaxed);
-        int64_t drumEnd = synthEngine_->getSequencerMaxEndFrame(bpm);
-        drumEndFrames_.store(drumEnd, std::memory_order_relaxed);
-        recomputeTotalFrames();
-    }
+    drumEndFrames_.store(synthEngine_->getSequencerMaxEndFrame(), std::memory_order_relaxed);
+    recomputeTotalFrames();
 }
 
-void AudioEngine::updateDrumPatternClips(float volume, bool muted,
-                                          const int* clipStepsPerBar, const int* clipTotalSteps,
-                                          const int* clipBeatsPerBar, const int64_t* clipOffsetsMs,
-                                          const int* clipHitCounts, int clipCount,
-                                          const int* hitStepIndices, const int* hitDrumNotes,
-                                          const float* hitVelocities) {
+void AudioEngine::stageDrumPatternClips(float volume, bool muted,
+                                        const int* patternStepsPerBar,
+                                        const int* patternTotalSteps,
+                                        const int* patternBeatsPerBar,
+                                        const int* patternHitCounts, int patternCount,
+                                        const int* hitStepIndices, const int* hitDrumNotes,
+                                        const float* hitVelocities,
+                                        const int* clipPatterns, const int64_t* clipOffsetsMs,
+                                        int clipCount) {
     if (!synthEngine_) return;
 
-    std::vector<StepSequencer::ClipSlot> clips;
-    clips.reserve(clipCount);
+    std::vector<StepSequencer::PatternData> patterns(patternCount);
     int hitOffset = 0;
 
-    for (int c = 0; c < clipCount; ++c) {
-        StepSequencer::ClipSlot slot;
-        slot.stepsPerBar = clipStepsPerBar[c];
-        slot.totalSteps = clipTotalSteps[c];
-        slot.beatsPerBar = clipBeatsPerBar[c] > 0 ? clipBeatsPerBar[c] : 4;
-        slot.offsetFrames = msToFrames(clipOffsetsMs[c]);
-
-        int hc = clipHitCounts[c];
-        slot.hits.reserve(hc);
+    for (int p = 0; p < patternCount; ++p) {
+        auto& pattern = patterns[p];
+        pattern.stepsPerBar = patternStepsPerBar[p];
+        pattern.totalSteps = patternTotalSteps[p];
+        pattern.beatsPerBar = patternBeatsPerBar[p] > 0 ? patternBeatsPerBar[p] : 4;
+
+        int hc = patternHitCounts[p];
+        pattern.hits.reserve(hc);
         for (int h = 0; h < hc; ++h) {
             int idx = hitOffset + h;
-            slot.hits.push_back({
+            pattern.hits.push_back({
                 hitStepIndices[idx],
                 hitDrumNotes[idx],
                 static_cast<int>(hitVelocities[idx] * 127.0f)
             });
         }
         hitOffset += hc;
+    }
 
-        clips.push_back(std::move(slot));
+    std::vector<StepSequencer::ClipPlacement> clips(clipCount);
+    for (int c = 0; c < clipCount; ++c) {
+        clips[c].pattern = clipPatterns[c];
+        clips[c].offsetFrames = msToFrames(clipOffsetsMs[c], getSampleRate());
     }
 
-    synthEngine_->updateDrumPatternClips(volume, muted, clips);
+    synthEngine_->stageDrumPatternClips(volume, muted, patterns, clips);
 
-    if (transport_) {
-        double bpm = transport_->bpm.load(std::memory_order_relaxed);
-        int64_t drumEnd = synthEngine_->getSequencerMaxEndFrame(bpm);
-        drumEndFrames_.store(drumEnd, std::memory_order_relaxed);
-        recomputeTotalFrames();
-    }
+    drumEndFrames_.store(synthEngine_->getSequencerMaxEndFrame(), std::memory_order_relaxed);
+    recomputeTotalFrames();
 }
 
+// ── Tempo map ───────────────────────────────────────────────────────
+
 void AudioEngine::setBpm(double bpm) {
-    if (transport_) {
-        transport_->bpm.store(bpm, std::memory_order_relaxed);
-        LOGD("AudioEngine: setBpm %.1f", bpm);
-
-        // BPM change affects drum pattern duration -- recompute
-        if (synthEngine_) {
-            int64_t drumEnd = synthEngine_->getSequencerMaxEndFrame(bpm);
-            drumEndFrames_.store(drumEnd, std::memory_order_relaxed);
-            recomputeTotalFrames();
-        }
+    if (!tempo_) return;
+    tempo_->setBpm(bpm);
+    LOGD("AudioEngine: setBpm %.1f", bpm);
+    onTempoChanged();
+}
+
+void AudioEngine::setTempoMap(const int64_t* startTicks, const double* bpms,
+                              const int* beatsPerBar, int count) {
+    if (!tempo_) return;
+    std::vector<TempoSegment> segments(count);
+    for (int i = 0; i < count; ++i) {
+        segments[i] = {startTicks[i], bpms[i], beatsPerBar[i]};
     }
+    tempo_->setSegments(std::move(segments));
+    onTempoChanged();
 }
 
-void AudioEngine::setDrumSequencerEnabled(bool enabled) {
-    if (synthEngine_) synthEngine_->setSequencerEnabled(enabled);
+void AudioEngine::onTempoChanged() {
+    // Drum and MIDI content is in musical time: its end moves with the tempo
+    if (!synthEngine_) return;
+    drumEndFrames_.store(synthEngine_->getSequencerMaxEndFrame(), std::memory_order_relaxed);
+    midiEndFrames_.store(synthEngine_->getMidiMaxEndFrame(), std::memory_order_relaxed);
+    recomputeTotalFrames();
 }
 
 // ── MIDI sequencer API ─────────────────────────────────────────────
 
-void AudioEngine::updateMidiTracks(const int* channels, const int* programs,
-                                    const float* volumes, const bool* muted, int trackCount,
-                                    const int* trackEventCounts,
-                                    const int64_t* eventFrames, const int* eventChannels,
-                                    const int* eventNotes, const int* eventVelocities,
-                                    int totalEventCount) {
+/** Reconstruct a MidiEvent array from the JNI parallel arrays. */
+static std::vector<MidiEvent> buildMidiEvents(const int64_t* ticks, const int* channels,
+                                              const int* notes, const int* velocities,
+                                              int count) {
+    std::vector<MidiEvent> events;
+    events.reserve(count);
+    for (int e = 0; e < count; ++e) {
+        MidiEvent me;
+        me.tick = ticks[e];
+        me.channel = channels[e];
+        me.note = notes[e];
+        me.velocity = velocities[e];
+        events.push_back(me);
+    }
+    return events;
+}
+
+/**
+ * Reconstruct [clipCount] MidiClipData from the JNI parallel arrays,
+ * consuming their events from the event arrays at [eventOffset].
+ */
+static std::vector<MidiClipData> buildMidiClips(const int64_t* clipOffsetsMs,
+                                                const int64_t* clipLengthsMs,
+                                                const int* clipEventCounts, int clipCount,
+                                                const int64_t* eventTicks,
+                                                const int* eventChannels,
+                                                const int* eventNotes,
+                                                const int* eventVelocities,
+                                                int& eventOffset, int32_t sampleRate) {
+    std::vector<MidiClipData> clips(clipCount);
+    for (int c = 0; c < clipCount; ++c) {
+        clips[c].offsetFrames = msToFrames(clipOffsetsMs[c], sampleRate);
+        clips[c].lengthFrames = msToFrames(clipLengthsMs[c], sampleRate);
+        int eventCount = clipEventCounts[c];
+        clips[c].events = buildMidiEvents(eventTicks + eventOffset, eventChannels + eventOffset,
+                                          eventNotes + eventOffset,
+                                          eventVelocities + eventOffset, eventCount);
+        eventOffset += eventCount;
+    }
+    return clips;
+}
+
+void AudioEngine::stageMidiTracks(const int* channels, const int* programs,
+                                  const float* volumes, const uint8_t* muted, int trackCount,
+                                  const int* trackClipCounts,
+                                  const int64_t* clipOffsetsMs, const int64_t* clipLengthsMs,
+                                  const int* clipEventCounts,
+                                  const int64_t* eventTicks, const int* eventChannels,
+                                  const int* eventNotes, const int* eventVelocities) {
     if (!synthEngine_) return;
 
     // Reconstruct MidiTrackData from flat arrays
     std::vector<MidiTrackData> tracks;
     tracks.reserve(trackCount);
 
+    int32_t rate = getSampleRate();
+    int clipOffset = 0;
     int eventOffset = 0;
     for (int t = 0; t < trackCount; ++t) {
         MidiTrackData td;
         td.channel = channels[t];
         td.program = programs[t];
         td.volume = volumes[t];
-        td.muted = muted[t];
-
-        int eventCount = trackEventCounts[t];
-        td.events.reserve(eventCount);
-        for (int e = 0; e < eventCount; ++e) {
-            int idx = eventOffset + e;
-            MidiEvent me;
-            me.framePos = eventFrames[idx];
-            me.channel = eventChannels[idx];
-            me.note = eventNotes[idx];
-            me.velocity = eventVelocities[idx];
-            td.events.push_back(me);
-        }
-        eventOffset += eventCount;
+        td.muted = muted[t] != 0;
+
+        int clipCount = trackClipCounts[t];
+        td.clips = buildMidiClips(clipOffsetsMs + clipOffset, clipLengthsMs + clipOffset,
+                                  clipEventCounts + clipOffset, clipCount,
+                                  eventTicks, eventChannels, eventNotes, eventVelocities,
+                                  eventOffset, rate);
+        clipOffset += clipCount;
 
         tracks.push_back(std::move(td));
     }
 
-    synthEngine_->updateMidiTracks(tracks);
+    synthEngine_->stageMidiTracks(std::move(tracks));
 
     // Update MIDI end frames for timeline length
     int64_t midiEnd = synthEngine_->getMidiMaxEndFrame();
@@ -435,24 +836,66 @@ void AudioEngine::updateMidiTracks(const int* channels, const int* programs,
     recomputeTotalFrames();
 }
 
-void AudioEngine::setMidiSequencerEnabled(bool enabled) {
-    if (synthEngine_) synthEngine_->setMidiSequencerEnabled(enabled);
+bool AudioEngine::updateMidiTrack(int trackIndex, int channel, int program, float volume,
+                                  bool muted,
+                                  const int64_t* clipOffsetsMs, const int64_t* clipLengthsMs,
+                                  const int* clipEventCounts, int clipCount,
+                                  const int64_t* eventTicks, const int* eventChannels,
+                                  const int* eventNotes, const int* eventVelocities) {
+    if (!synthEngine_) return false;
+
+    MidiTrackData td;
+    td.channel = channel;
+    td.program = program;
+    td.volume = volume;
+    td.muted = muted;
+    int eventOffset = 0;
+    td.clips = buildMidiClips(clipOffsetsMs, clipLengthsMs, clipEventCounts, clipCount,
+                              eventTicks, eventChannels, eventNotes, eventVelocities,
+                              eventOffset, getSampleRate());
+
+    if (!synthEngine_->replaceMidiTrack(trackIndex, std::move(td))) return false;
+
+    midiEndFrames_.store(synthEngine_->getMidiMaxEndFrame(), std::memory_order_relaxed);
+    recomputeTotalFrames();
+    return true;
+}
+
+bool AudioEngine::replaceMidiTrackRange(int trackIndex, int64_t startMs, int64_t endMs,
+                                        const int64_t* clipOffsetsMs,
+                                        const int64_t* clipLengthsMs,
+                                        const int* clipEventCounts, int clipCount,
+                                        const int64_t* eventTicks, const int* eventChannels,
+                                        const int* eventNotes, const int* eventVelocities) {
+    if (!synthEngine_) return false;
+
+    int32_t rate = getSampleRate();
+    int eventOffset = 0;
+    std::vector<MidiClipData> clips = buildMidiClips(
+        clipOffsetsMs, clipLengthsMs, clipEventCounts, clipCount,
+        eventTicks, eventChannels, eventNotes, eventVelocities, eventOffset, rate);
+    if (!synthEngine_->replaceMidiTrackRange(trackIndex, msToFrames(startMs, rate),
+                                             msToFrames(endMs, rate), clips)) {
+        return false;
+    }
+
+    midiEndFrames_.store(synthEngine_->getMidiMaxEndFrame(), std::memory_order_relaxed);
+    recomputeTotalFrames();
+    return true;
 }
 
 // ── Count-in API ────────────────────────────────────────────────────
 
 void AudioEngine::setCountIn(int bars, int beatsPerBar) {
-    if (!transport_ || bars <= 0 || beatsPerBar <= 0) {
-        countInFrames_.store(0, std::memory_order_relaxed);
-        return;
-    }
-    double bpm = transport_->bpm.load(std::memory_order_relaxed);
-    if (bpm <= 0.0) {
+    if (!tempo_ || bars <= 0 || beatsPerBar <= 0) {
         countInFrames_.store(0, std::memory_order_relaxed);
         return;
     }
-    double framesPerBeat = (60.0 / bpm) * static_cast<double>(kSampleRate);
-    auto frames = static_cast<int64_t>(bars * beatsPerBar * framesPerBeat);
+    // Count-in beats run back from 0 at the opening tempo, landing on the
+    // same frames the metronome clicks them on.
+    auto countInTicks = static_cast<double>(
+        static_cast<int64_t>(bars) * beatsPerBar * kTicksPerBeat);
+    int64_t frames = -tempo_->snapshot().frameAtTick(-countInTicks, getSampleRate());
     countInFrames_.store(frames, std::memory_order_relaxed);
     LOGD("AudioEngine: setCountIn bars=%d bpb=%d -> %lld frames", bars, beatsPerBar,
          (long long)frames);
@@ -469,7 +912,8 @@ void AudioEngine::setMetronomeVolume(float volume) {
 }
 
 void AudioEngine::setMetronomeBeatsPerBar(int beatsPerBar) {
-    if (synthEngine_) synthEngine_->setMetronomeBeatsPerBar(beatsPerBar);
+    // The bar length lives in the tempo map, with the beat it applies to
+    if (tempo_) tempo_->setBeatsPerBar(beatsPerBar);
 }
 
 int64_t AudioEngine::getLastMetronomeBeatFrame() const {
@@ -489,8 +933,104 @@ int64_t AudioEngine::getInputLatencyMs() const {
     return recordingStream_->getInputLatencyMs();
 }
 
+// ── Offline export (mixdown) ─────────────────────────────────────────
+
+bool AudioEngine::startExport(const char* filePath, bool includeMetronome) {
+    if (!offlineRenderer_) return false;
+    pause();
+    return offlineRenderer_->start(std::string(filePath), includeMetronome);
+}
+
+void AudioEngine::cancelExport() {
+    if (offlineRenderer_) offlineRenderer_->cancel();
+}
+
+int AudioEngine::getExportState() const {
+    if (!offlineRenderer_) return static_cast<int>(OfflineRenderState::Idle);
+    return static_cast<int>(offlineRenderer_->getState());
+}
+
+float AudioEngine::getExportProgress() const {
+    if (!offlineRenderer_) return 0.0f;
+    return offlineRenderer_->getProgress();
+}
+
+// ── Track freeze ─────────────────────────────────────────────────────
+
+bool AudioEngine::startMidiFreeze(const char* filePath, int channel, int program, float volume,
+                                  const int64_t* eventTicks, const int* eventChannels,
+                                  const int* eventNotes, const int* eventVelocities,
+                                  int eventCount, int64_t lengthMs) {
+    if (!trackFreezer_) return false;
+
+    MidiTrackData td;
+    td.channel = channel;
+    td.program = program;
+    td.volume = volume;
+    MidiClipData clip;
+    clip.lengthFrames = msToFrames(lengthMs, getSampleRate());
+    clip.events = buildMidiEvents(eventTicks, eventChannels, eventNotes, eventVelocities,
+                                  eventCount);
+    td.clips.push_back(std::move(clip));
+    return trackFreezer_->startMidi(std::string(filePath), std::move(td));
+}
+
+bool AudioEngine::startDrumFreeze(const char* filePath, float volume,
+                                  int stepsPerBar, int totalSteps, int beatsPerBar,
+                                  const int* hitStepIndices, const int* hitDrumNotes,
+                                  const float* hitVelocities, int hitCount) {
+    if (!trackFreezer_) return false;
+
+    StepSequencer::ClipSlot clip;
+    clip.stepsPerBar = stepsPerBar;
+    clip.totalSteps = totalSteps;
+    clip.beatsPerBar = beatsPerBar > 0 ? beatsPerBar : 4;
+    clip.hits.reserve(hitCount);
+    for (int h = 0; h < hitCount; ++h) {
+        clip.hits.push_back({
+            hitStepIndices[h],
+            hitDrumNotes[h],
+            static_cast<int>(hitVelocities[h] * 127.0f)
+        });
+    }
+    return trackFreezer_->startDrums(std::string(filePath), volume, std::move(clip));
+}
+
+void AudioEngine::cancelFreeze() {
+    if (trackFreezer_) trackFreezer_->cancel();
+}
+
+int AudioEngine::getFreezeState() const {
+    if (!trackFreezer_) return static_cast<int>(OfflineRenderState::Idle);
+    return static_cast<int>(trackFreezer_->getState());
+}
+
+float AudioEngine::getFreezeProgress() const {
+    if (!trackFreezer_) return 0.0f;
+    return trackFreezer_->getProgress();
+}
+
+// ── Telemetry ────────────────────────────────────────────────────────
+
+int32_t AudioEngine::getTelemetry(int64_t* out, int32_t count) const {
+    if (!telemetry_ || !out || count <= 0) return 0;
+    int64_t fields[kTelFieldCount];
+    telemetry_->snapshot(fields);
+    int32_t n = std::min(count, static_cast<int32_t>(kTelFieldCount));
+    std::copy(fields, fields + n, out);
+    return n;
+}
+
+void AudioEngine::resetTelemetry() {
+    if (telemetry_) telemetry_->reset();
+}
+
 // ── Internal helpers ────────────────────────────────────────────────
 
+void AudioEngine::wakeOutput() {
+    if (playbackStream_) playbackStream_->wake();
+}
+
 void AudioEngine::recomputeTotalFrames() {
     if (!transport_) return;
     int64_t mixerFrames = mixer_ ? mixer_->computeTotalFrames() : 0;
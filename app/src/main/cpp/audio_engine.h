@@ -3,6 +3,9 @@
 #include "common.h"
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace nightjar {
 
@@ -10,7 +13,18 @@ class OboeRecordingStream;
 class OboePlaybackStream;
 class TrackMixer;
 class SynthEngine;
+class OfflineRenderer;
+class TrackFreezer;
+class Reclaimer;
+class TempoTrack;
+class CommandReader;
 struct AtomicTransport;
+struct EnvelopePoint;
+struct EngineTelemetry;
+class EngineStatus;
+struct MixerCommand;
+struct SynthCommand;
+enum class CommandOp : uint16_t;
 
 /**
  * Top-level audio engine managing Oboe input (recording) and output (playback) streams.
@@ -31,16 +45,44 @@ public:
         return initialized_.load(std::memory_order_acquire);
     }
 
+    /**
+     * Engine sample rate: the output device's native rate, fixed when
+     * initialize() opens the output stream. Every frame count crossing
+     * the API (MIDI events, metronome beats) is in this rate.
+     */
+    int32_t getSampleRate() const;
+
     // ── Recording API ───────────────────────────────────────────────────
-    bool startRecording(const char* filePath);
+    bool startRecording(const char* filePath, bool splitTakesAtLoop);
+    /** Record full duplex, stamped against the output: the take starts
+     *  at the first input heard at or after [startMs] of the timeline,
+     *  with no write gate or latency compensation. False if the output
+     *  stream isn't open; use startRecording() then. */
+    bool startDuplexRecording(const char* filePath, bool splitTakesAtLoop, int64_t startMs);
+    /** Timeline ms the current or last duplex take starts at; -1 until
+     *  its first sample, and for callback recordings. */
+    int64_t getRecordedStartMs() const;
+    /** Hear the duplex input through the output mix at [gain]. */
+    void setInputMonitoring(bool enabled, float gain);
     bool awaitFirstBuffer(int timeoutMs);
     void openWriteGate();
     int64_t stopRecording();
     bool isRecordingActive() const;
     float getLatestPeakAmplitude() const;
+    /** Move up to [maxPoints] new live-input envelope points into [out];
+     *  returns how many. See OboeRecordingStream::drainEnvelope(). */
+    size_t drainInputEnvelope(EnvelopePoint* out, size_t maxPoints);
     int64_t getRecordedDurationMs() const;
+    /** Take files of the last recording (just the original path unless
+     *  it was split at loop boundaries). Valid after stopRecording(). */
+    std::vector<std::string> getRecordedTakePaths() const;
 
     // ── Playback API ────────────────────────────────────────────────────
+    /** Convert the take at [filePath] to the engine rate if it was
+     *  recorded at another (prepareTakeFile()), so addTrack() only has to
+     *  open it. Blocking and slow for such a take: call on a worker
+     *  thread, before addTrack(). */
+    bool prepareTrackFile(const char* filePath);
     bool addTrack(int trackId, const char* filePath,
                   int64_t durationMs, int64_t offsetMs,
                   int64_t trimStartMs, int64_t trimEndMs,
@@ -54,9 +96,23 @@ public:
     int64_t getPositionMs() const;
     int64_t getTotalDurationMs() const;
 
-    // ── Per-track controls ──────────────────────────────────────────────
-    void setTrackVolume(int trackId, float volume);
-    void setTrackMuted(int trackId, bool muted);
+    // ── Command channel ─────────────────────────────────────────────────
+    /**
+     * Apply a batch in the engine command format (engine_commands.h),
+     * decoded in place from [data]. Track and bus controls and the
+     * sequencer switches are queued for the audio callback and the synth
+     * render thread, which each apply the batch's share on one block or
+     * chunk boundary; drum, MIDI and tempo edits publish new snapshots
+     * that the render thread picks up at its next chunk. Calls are
+     * serialized. Returns how many commands failed or were not
+     * recognized, or -1 if the batch itself is malformed.
+     */
+    int submitCommands(const uint8_t* data, size_t size);
+
+    // ── Routing ─────────────────────────────────────────────────────────
+    void setTrackBus(int trackId, int32_t busId);
+    bool addBus(int32_t busId);
+    void removeBus(int32_t busId);
 
     // ── Loop ────────────────────────────────────────────────────────────
     void setLoopRegion(int64_t startMs, int64_t endMs);
@@ -69,13 +125,19 @@ public:
     int64_t getLoopResetCount() const;
 
     // ── Synth API ─────────────────────────────────────────────────────
-    bool loadSoundFont(const char* path);
+    bool loadSoundFont(const char* path, bool lazySamples);
     void synthNoteOn(int channel, int note, int velocity);
     void synthNoteOff(int channel, int note);
     void synthProgramChange(int channel, int program);
     void synthRequestPreviewFlush();
     void setSynthVolume(float volume);
     void synthAllSoundsOff();
+    /** SynthLatencyProfile as int (0 play, 1 live input). */
+    void setSynthLatencyProfile(int profile);
+    /** SynthQualityTier as int; Full (0) while no synth is loaded. */
+    int getSynthQualityTier() const;
+    /** Smoothed synth render load, fraction of the real-time budget. */
+    float getSynthRenderLoad() const;
 
     // ── Drum sequencer API ──────────────────────────────────────────
     void updateDrumPattern(int stepsPerBar, int bars, int64_t offsetMs,
@@ -87,26 +149,57 @@ public:
                            int beatsPerBar = 4);
 
     /**
-     * Per-clip drum pattern update. Each clip has its own grid dimensions and hits.
-     * Flat arrays: per-clip metadata + concatenated hit arrays.
+     * Per-clip drum pattern update. Each distinct pattern is sent once with
+     * its grid dimensions and hits; clips name a pattern by index.
+     * Flat arrays: per-pattern metadata + concatenated hit arrays, then
+     * per-clip pattern index and offset. Only builds the snapshot: it
+     * plays once a SynthCommand::Op::CommitDrumPatterns is applied.
      */
-    void updateDrumPatternClips(float volume, bool muted,
-                                const int* clipStepsPerBar, const int* clipTotalSteps,
-                                const int* clipBeatsPerBar, const int64_t* clipOffsetsMs,
-                                const int* clipHitCounts, int clipCount,
-                                const int* hitStepIndices, const int* hitDrumNotes,
-                                const float* hitVelocities);
+    void stageDrumPatternClips(float volume, bool muted,
+                               const int* patternStepsPerBar, const int* patternTotalSteps,
+                               const int* patternBeatsPerBar, const int* patternHitCounts,
+                               int patternCount,
+                               const int* hitStepIndices, const int* hitDrumNotes,
+                               const float* hitVelocities,
+                               const int* clipPatterns, const int64_t* clipOffsetsMs,
+                               int clipCount);
+
+    // ── Tempo map ─────────────────────────────────────────────────
+    /** Single tempo for the whole song (the project BPM). */
     void setBpm(double bpm);
-    void setDrumSequencerEnabled(bool enabled);
+    /**
+     * Replace the tempo map with [count] segments, each starting at
+     * startTicks[i] (kTicksPerBeat per beat) with bpms[i] and
+     * beatsPerBar[i]. Re-times drums, MIDI and the metronome in place.
+     */
+    void setTempoMap(const int64_t* startTicks, const double* bpms, const int* beatsPerBar,
+                     int count);
 
     // ── MIDI sequencer API ─────────────────────────────────────────
-    void updateMidiTracks(const int* channels, const int* programs,
-                          const float* volumes, const bool* muted, int trackCount,
-                          const int* trackEventCounts,
-                          const int64_t* eventFrames, const int* eventChannels,
-                          const int* eventNotes, const int* eventVelocities,
-                          int totalEventCount);
-    void setMidiSequencerEnabled(bool enabled);
+    /**
+     * Flat arrays: per-track metadata and clip counts, per-clip offset,
+     * length and event count, then the concatenated events with their
+     * positions in ticks from the clip start. Only builds the snapshot:
+     * it plays once a SynthCommand::Op::CommitMidiTracks is applied.
+     */
+    void stageMidiTracks(const int* channels, const int* programs,
+                         const float* volumes, const uint8_t* muted, int trackCount,
+                         const int* trackClipCounts,
+                         const int64_t* clipOffsetsMs, const int64_t* clipLengthsMs,
+                         const int* clipEventCounts,
+                         const int64_t* eventTicks, const int* eventChannels,
+                         const int* eventNotes, const int* eventVelocities);
+    bool updateMidiTrack(int trackIndex, int channel, int program, float volume, bool muted,
+                         const int64_t* clipOffsetsMs, const int64_t* clipLengthsMs,
+                         const int* clipEventCounts, int clipCount,
+                         const int64_t* eventTicks, const int* eventChannels,
+                         const int* eventNotes, const int* eventVelocities);
+    /** Replace the clips of one track that start in [startMs, endMs). */
+    bool replaceMidiTrackRange(int trackIndex, int64_t startMs, int64_t endMs,
+                               const int64_t* clipOffsetsMs, const int64_t* clipLengthsMs,
+                               const int* clipEventCounts, int clipCount,
+                               const int64_t* eventTicks, const int* eventChannels,
+                               const int* eventNotes, const int* eventVelocities);
 
     // ── Count-in API ──────────────────────────────────────────────
     /** Set count-in duration. Next play() will start from -countInFrames. */
@@ -122,19 +215,94 @@ public:
     int64_t getOutputLatencyMs() const;
     int64_t getInputLatencyMs() const;
 
+    // ── Offline export (mixdown) ─────────────────────────────────────
+    /** Start a faster-than-realtime mixdown of the whole timeline to a
+     *  stereo WAV at [filePath]. Pauses playback first. */
+    bool startExport(const char* filePath, bool includeMetronome);
+    void cancelExport();
+    /** OfflineRenderState as int (0 idle, 1 running, 2 done, 3 failed, 4 cancelled). */
+    int getExportState() const;
+    float getExportProgress() const;
+
+    // ── Track freeze ──────────────────────────────────────────────────
+    /** Render one MIDI clip (events relative to the clip start, in
+     *  ticks) to a stereo WAV at [filePath] for a frozen track. Runs
+     *  alongside playback. */
+    bool startMidiFreeze(const char* filePath, int channel, int program, float volume,
+                         const int64_t* eventTicks, const int* eventChannels,
+                         const int* eventNotes, const int* eventVelocities,
+                         int eventCount, int64_t lengthMs);
+    /** As startMidiFreeze() for one drum clip at the current tempo. */
+    bool startDrumFreeze(const char* filePath, float volume,
+                         int stepsPerBar, int totalSteps, int beatsPerBar,
+                         const int* hitStepIndices, const int* hitDrumNotes,
+                         const float* hitVelocities, int hitCount);
+    void cancelFreeze();
+    /** OfflineRenderState as int, as getExportState(). */
+    int getFreezeState() const;
+    float getFreezeProgress() const;
+
+    // ── Telemetry ───────────────────────────────────────────────────────
+    /**
+     * Copy the real-time counters into [out] (TelemetryField layout, see
+     * engine_telemetry.h). Copies min(count, kTelFieldCount) entries and
+     * returns how many; 0 before initialize().
+     */
+    int32_t getTelemetry(int64_t* out, int32_t count) const;
+    /** Zero the counters to start a new aggregation window. */
+    void resetTelemetry();
+
+    // ── Status block ────────────────────────────────────────────────────
+    /**
+     * The block the real-time threads publish transport, metronome and
+     * meter status into (see engine_status.h), for mapping into Kotlin.
+     * Valid until shutdown(); nullptr before initialize().
+     */
+    EngineStatus* getStatus() { return status_.get(); }
+
 private:
+    /**
+     * Apply one command from a batch. Queued control changes are
+     * collected into [mixer] and [synth] and posted once the batch is
+     * decoded. Returns false if the command failed or is malformed.
+     */
+    bool applyCommand(CommandOp op, CommandReader& in, std::vector<MixerCommand>& mixer,
+                      std::vector<SynthCommand>& synth);
+
+    /** Restart a parked output stream ahead of something that needs it. */
+    void wakeOutput();
+
     /** Recompute totalFrames from max(mixer tracks, drum patterns, MIDI). */
     void recomputeTotalFrames();
 
+    /** Re-measure the drum and MIDI ends after a tempo change. */
+    void onTempoChanged();
+
     std::atomic<bool> initialized_{false};
+    /** Serializes submitCommands(): the command queues have one producer. */
+    std::mutex commandMutex_;
+    /** Mixer controls go through the callback's queue once the output
+     *  stream runs; without one they are applied directly. */
+    bool queueMixerCommands_ = false;
     std::atomic<int64_t> countInFrames_{0};
     std::atomic<int64_t> drumEndFrames_{0};
     std::atomic<int64_t> midiEndFrames_{0};
+    /** Frees retired mixer/sequencer snapshots. Created first and
+     *  destroyed last so every publisher can drain into it. */
+    std::unique_ptr<Reclaimer> reclaimer_;
+    /** Shared by every real-time component; same lifetime as reclaimer_. */
+    std::unique_ptr<EngineTelemetry> telemetry_;
+    /** Published by the real-time threads, read by Kotlin; same lifetime. */
+    std::unique_ptr<EngineStatus> status_;
+    /** Tempo map of the drum, MIDI and metronome sequencers. */
+    std::unique_ptr<TempoTrack> tempo_;
     std::unique_ptr<OboeRecordingStream> recordingStream_;
     std::unique_ptr<TrackMixer> mixer_;
     std::unique_ptr<SynthEngine> synthEngine_;
     std::unique_ptr<AtomicTransport> transport_;
     std::unique_ptr<OboePlaybackStream> playbackStream_;
+    std::unique_ptr<OfflineRenderer> offlineRenderer_;
+    std::unique_ptr<TrackFreezer> trackFreezer_;
 };
 
 }  // namespace nightjar
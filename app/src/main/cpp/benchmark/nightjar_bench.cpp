@@ -0,0 +1,499 @@
+/**
+ * Host micro-benchmarks for the Nightjar native engine.
+ *
+ * Each benchmark drives one real-time hot path with synthetic data the
+ * way the engine does on device (same chunk sizes, same call pattern) and
+ * reports the best-of-N time per output frame. Numbers are only
+ * comparable on the same machine; the point is catching regressions
+ * between two builds, not predicting phone performance.
+ *
+ * Usage: nightjar-bench [--filter NAME] [--reps N] [--tracks N]
+ *                       [--seconds S] [--soundfont PATH] [--partitions N]
+ */
+
+#include "common.h"
+#include "compressed_audio.h"
+#include "midi_sequencer.h"
+#include "reclaimer.h"
+#include "resampler.h"
+#include "spsc_ring_buffer.h"
+#include "step_sequencer.h"
+#include "synth_engine.h"
+#include "track_mixer.h"
+#include "wav_writer.h"
+
+#ifdef NIGHTJAR_BENCH_HAVE_FLUIDSYNTH
+#include "synth_partitions.h"
+#include <fluidsynth.h>
+#endif
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nightjar;
+
+namespace {
+
+// Output burst used by the mixer benchmark; a typical AAudio burst.
+constexpr int32_t kBenchBurstFrames = 192;
+
+struct Options {
+    std::string filter;
+    int reps = 5;
+    int tracks = 32;
+    int seconds = 30;
+    std::string soundFont;
+    int partitions = 0;  // 0 = SynthPartitions::defaultCount()
+};
+
+/** Written to at the end of every run so the optimizer keeps the work. */
+double gSink = 0.0;
+
+double nowNs() {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * Run [body] [reps] times (after one warm-up) and print the fastest run
+ * normalised by [frames]. [body] returns a checksum folded into gSink.
+ */
+void report(const Options& opt, const char* name, const char* unit, int64_t frames,
+            const std::function<double()>& body) {
+    if (!opt.filter.empty() && std::string(name).find(opt.filter) == std::string::npos) return;
+
+    gSink += body();
+    double best = 1e300;
+    for (int r = 0; r < opt.reps; ++r) {
+        double start = nowNs();
+        gSink += body();
+        best = std::min(best, nowNs() - start);
+    }
+    std::printf("%-28s %10.2f ns/%s   (%lld %ss, best of %d)\n",
+                name, best / static_cast<double>(frames), unit,
+                static_cast<long long>(frames), unit, opt.reps);
+}
+
+// ── TrackMixer::renderFrames ─────────────────────────────────────────────
+
+/** Write a mono 16-bit WAV of [frames] sine samples. */
+bool writeSyntheticWav(const std::string& path, int64_t frames, double freq) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    writePcmWavHeader(f, kDefaultSampleRate, kChannelCount);
+    std::vector<int16_t> block(4096);
+    double phase = 0.0;
+    double step = 2.0 * M_PI * freq / kDefaultSampleRate;
+    for (int64_t done = 0; done < frames;) {
+        auto n = static_cast<size_t>(std::min<int64_t>(block.size(), frames - done));
+        for (size_t i = 0; i < n; ++i) {
+            block[i] = static_cast<int16_t>(std::sin(phase) * 12000.0);
+            phase += step;
+        }
+        std::fwrite(block.data(), sizeof(int16_t), n, f);
+        done += static_cast<int64_t>(n);
+    }
+    patchPcmWavHeader(f, frames * kBytesPerSample);
+    std::fclose(f);
+    return true;
+}
+
+void benchMixer(const Options& opt, Reclaimer& reclaimer) {
+    char dirTemplate[] = "/tmp/nightjar-bench-XXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        LOGE("bench: mkdtemp failed");
+        return;
+    }
+    std::string dir = dirTemplate;
+
+    // Tracks are staggered by half a second so the active set changes
+    // across the timeline, like a real arrangement.
+    AtomicTransport transport;
+    TrackMixer mixer(reclaimer, transport);
+    int64_t trackMs = static_cast<int64_t>(opt.seconds) * 1000;
+    std::vector<std::string> paths;
+    for (int t = 0; t < opt.tracks; ++t) {
+        std::string path = dir + "/track" + std::to_string(t) + ".wav";
+        if (!writeSyntheticWav(path, msToFrames(trackMs, kDefaultSampleRate), 110.0 + 20.0 * t)) {
+            LOGE("bench: failed to write %s", path.c_str());
+            return;
+        }
+        paths.push_back(path);
+        mixer.addTrack(t, path, trackMs, t * 500LL, 0, 0, 0.5f, false);
+    }
+
+    int64_t total = mixer.computeTotalFrames();
+    std::vector<float> out(kBenchBurstFrames * kOutputChannelCount);
+
+    report(opt, "mixer.renderFrames", "frame", total, [&] {
+        double sum = 0.0;
+        for (int64_t pos = 0; pos < total; pos += kBenchBurstFrames) {
+            mixer.renderFrames(out.data(), kBenchBurstFrames, pos);
+            sum += out[0];
+        }
+        return sum;
+    });
+
+    // Random seeks defeat the render cursor and exercise the index lookup.
+    std::mt19937 rng(1234);
+    std::vector<int64_t> seeks(static_cast<size_t>(total / kBenchBurstFrames));
+    for (auto& s : seeks) s = std::uniform_int_distribution<int64_t>(0, total - 1)(rng);
+
+    report(opt, "mixer.renderFrames.seek", "frame",
+           static_cast<int64_t>(seeks.size()) * kBenchBurstFrames, [&] {
+        double sum = 0.0;
+        for (int64_t pos : seeks) {
+            mixer.renderFrames(out.data(), kBenchBurstFrames, pos);
+            sum += out[0];
+        }
+        return sum;
+    });
+
+    // Panned tracks, half of them summed through a group bus.
+    mixer.addBus(1);
+    mixer.setBusVolume(1, 0.8f);
+    for (int t = 0; t < opt.tracks; ++t) {
+        mixer.setTrackPan(t, t % 2 == 0 ? -0.5f : 0.5f);
+        if (t % 2 == 1) mixer.setTrackBus(t, 1);
+    }
+
+    report(opt, "mixer.renderFrames.bus", "frame", total, [&] {
+        double sum = 0.0;
+        for (int64_t pos = 0; pos < total; pos += kBenchBurstFrames) {
+            mixer.renderFrames(out.data(), kBenchBurstFrames, pos);
+            sum += out[0];
+        }
+        return sum;
+    });
+
+    mixer.removeAllTracks();
+    mixer.removeBus(1);
+    for (const auto& p : paths) unlink(p.c_str());
+    rmdir(dir.c_str());
+}
+
+// ── StepSequencer::tick ──────────────────────────────────────────────────
+
+void benchStepSequencer(const Options& opt, Reclaimer& reclaimer) {
+    constexpr double kBpm = 120.0;
+    const TempoMap tempo({{0, kBpm, 4}});
+    constexpr int kClips = 256;
+    constexpr int kStepsPerBar = 16;
+    constexpr int kBars = 4;
+
+    // Four bars of 16ths with kick/snare/hats/percussion on every step,
+    // with overlapping clips so several are active at once.
+    double framesPerStep = kDefaultSampleRate * 60.0 / (kBpm * kStepsPerBar / 4.0);
+    auto clipFrames = static_cast<int64_t>(framesPerStep * kStepsPerBar * kBars);
+
+    std::vector<StepSequencer::ClipSlot> clips(kClips);
+    for (int c = 0; c < kClips; ++c) {
+        auto& clip = clips[c];
+        clip.stepsPerBar = kStepsPerBar;
+        clip.totalSteps = kStepsPerBar * kBars;
+        clip.offsetFrames = c * clipFrames / 4;
+        for (int s = 0; s < clip.totalSteps; ++s) {
+            for (int note : {36, 38, 42, 46}) clip.hits.push_back({s, note, 100});
+        }
+    }
+
+    StepSequencer sequencer(reclaimer);
+    sequencer.updatePattern(1.0f, false, clips);
+    int64_t total = clips.back().offsetFrames + clipFrames;
+
+    report(opt, "step.tick", "frame", total, [&] {
+        sequencer.reset();
+        double sum = 0.0;
+        for (int64_t pos = 0; pos < total; pos += kSynthRenderChunkFrames) {
+            sum += static_cast<double>(sequencer.tick(pos, kSynthRenderChunkFrames, tempo, kDefaultSampleRate).size());
+        }
+        return sum;
+    });
+}
+
+// ── MidiSequencer::tick ──────────────────────────────────────────────────
+
+void benchMidiSequencer(const Options& opt, Reclaimer& reclaimer) {
+    constexpr int kTracks = 16;
+    constexpr int kClipsPerTrack = 312;
+    constexpr int kNotesPerClip = 64;
+    const TempoMap tempo;  // 120 BPM
+
+    // Dense 32nd-note lines: one noteOn/noteOff pair every ~31ms per
+    // track, cut into back-to-back two-bar clips.
+    constexpr int64_t kNoteTicks = kTicksPerBeat / 8;
+    const int64_t clipFrames = tempo.frameAtTick(
+        static_cast<double>(kNoteTicks * kNotesPerClip), kDefaultSampleRate);
+    std::vector<MidiTrackData> tracks(kTracks);
+    for (int t = 0; t < kTracks; ++t) {
+        auto& track = tracks[t];
+        track.channel = t;
+        track.clips.resize(kClipsPerTrack);
+        for (int c = 0; c < kClipsPerTrack; ++c) {
+            auto& clip = track.clips[c];
+            clip.offsetFrames = c * clipFrames + t * 37;
+            clip.lengthFrames = clipFrames;
+            clip.events.reserve(kNotesPerClip * 2);
+            for (int n = 0; n < kNotesPerClip; ++n) {
+                int64_t on = n * kNoteTicks;
+                int note = 40 + (n * 7 + t) % 40;
+                clip.events.push_back({on, t, note, 90});
+                clip.events.push_back({on + kNoteTicks - 4, t, note, 0});
+            }
+        }
+    }
+    int64_t total = kClipsPerTrack * clipFrames;
+
+    MidiSequencer sequencer(reclaimer);
+    sequencer.updateTracks(std::move(tracks));
+
+    report(opt, "midi.tick", "frame", total, [&] {
+        sequencer.resetToPosition(0, tempo, kDefaultSampleRate);
+        double sum = 0.0;
+        for (int64_t pos = 0; pos < total; pos += kSynthRenderChunkFrames) {
+            sum += static_cast<double>(
+                sequencer.tick(pos, kSynthRenderChunkFrames, tempo, kDefaultSampleRate).size());
+        }
+        return sum;
+    });
+}
+
+// ── SpscRingBuffer throughput ────────────────────────────────────────────
+
+void benchRingBuffer(const Options& opt) {
+    constexpr int64_t kSamples = 1 << 25;
+    // Producer writes render chunks, consumer reads callback bursts, as
+    // between the synth render thread and the audio callback.
+    constexpr size_t kWriteChunk = kSynthRenderChunkFrames * kOutputChannelCount;
+    constexpr size_t kReadChunk = kBenchBurstFrames * kOutputChannelCount;
+
+    auto ring = std::make_unique<SpscRingBuffer<kSynthRingBufferCapacity>>();
+
+    report(opt, "spsc.transfer", "sample", kSamples, [&] {
+        ring->reset();
+        std::thread producer([&] {
+            float chunk[kWriteChunk];
+            for (size_t i = 0; i < kWriteChunk; ++i) chunk[i] = static_cast<float>(i);
+            int64_t sent = 0;
+            while (sent < kSamples) {
+                size_t n = ring->write(chunk, std::min<int64_t>(kWriteChunk, kSamples - sent));
+                if (n == 0) std::this_thread::yield();
+                sent += static_cast<int64_t>(n);
+            }
+        });
+        float burst[kReadChunk];
+        int64_t received = 0;
+        double sum = 0.0;
+        while (received < kSamples) {
+            size_t n = ring->read(burst, kReadChunk);
+            if (n == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            sum += burst[0];
+            received += static_cast<int64_t>(n);
+        }
+        producer.join();
+        return sum;
+    });
+}
+
+// ── Compressed take codec ────────────────────────────────────────────────
+
+void benchCodec(const Options& opt) {
+    // A tone over a low noise floor, roughly what a quiet vocal take
+    // looks like to the predictor.
+    int64_t frames = msToFrames(static_cast<int64_t>(opt.seconds) * 1000, kDefaultSampleRate);
+    std::vector<int16_t> pcm(static_cast<size_t>(frames));
+    std::mt19937 rng(99);
+    std::uniform_int_distribution<int> noise(-48, 48);
+    double step = 2.0 * M_PI * 220.0 / kDefaultSampleRate;
+    for (int64_t i = 0; i < frames; ++i) {
+        pcm[static_cast<size_t>(i)] = static_cast<int16_t>(
+            std::sin(static_cast<double>(i) * step) * 8000.0 + noise(rng));
+    }
+
+    char path[] = "/tmp/nightjar-bench-XXXXXX.njca";
+    int fd = mkstemps(path, 5);
+    if (fd < 0) {
+        LOGE("bench: mkstemps failed");
+        return;
+    }
+    close(fd);
+    if (!encodeCompressedAudio(pcm.data(), frames, kDefaultSampleRate, path)) {
+        unlink(path);
+        return;
+    }
+
+    report(opt, "njca.encode", "frame", frames, [&] {
+        return encodeCompressedAudio(pcm.data(), frames, kDefaultSampleRate, path) ? 1.0 : 0.0;
+    });
+
+    CompressedAudioFile file;
+    if (!file.open(path)) {
+        unlink(path);
+        return;
+    }
+    std::vector<int16_t> block(kCompressedBlockFrames);
+    report(opt, "njca.decodeBlock", "frame", frames, [&] {
+        double sum = 0.0;
+        for (int64_t b = 0; b < file.blockCount(); ++b) {
+            sum += file.decodeBlock(b, block.data());
+        }
+        return sum;
+    });
+
+    const char* ratioName = "njca.size/pcm";
+    struct stat st{};
+    if (stat(path, &st) == 0 &&
+        (opt.filter.empty() || std::string(ratioName).find(opt.filter) != std::string::npos)) {
+        std::printf("%-28s %10.1f %%\n", ratioName,
+                    100.0 * static_cast<double>(st.st_size) /
+                    static_cast<double>(frames * kBytesPerSample));
+    }
+    file.close();
+    unlink(path);
+}
+
+// ── Take resampling ──────────────────────────────────────────────────────
+
+void benchResampler(const Options& opt) {
+    int64_t frames = msToFrames(static_cast<int64_t>(opt.seconds) * 1000, kDefaultSampleRate);
+    std::vector<int16_t> pcm(static_cast<size_t>(frames));
+    double step = 2.0 * M_PI * 440.0 / kDefaultSampleRate;
+    for (int64_t i = 0; i < frames; ++i) {
+        pcm[static_cast<size_t>(i)] = static_cast<int16_t>(
+            std::sin(static_cast<double>(i) * step) * 12000.0);
+    }
+
+    // The conversion every pre-existing take needs on a 48kHz device.
+    PolyphaseResampler resampler(kDefaultSampleRate, 48000);
+    int64_t outFrames = resampler.outputFrames(frames);
+    std::vector<int16_t> out(static_cast<size_t>(outFrames));
+    report(opt, "resample.44k1to48k", "frame", outFrames, [&] {
+        resampler.process(pcm.data(), frames, 0, static_cast<int32_t>(outFrames), out.data());
+        return static_cast<double>(out[static_cast<size_t>(outFrames / 2)]);
+    });
+}
+
+// ── SynthPartitions::render ──────────────────────────────────────────────
+
+#ifdef NIGHTJAR_BENCH_HAVE_FLUIDSYNTH
+void benchSynth(const Options& opt) {
+    if (opt.soundFont.empty()) {
+        std::printf("%-28s skipped (pass --soundfont PATH)\n", "synth.render");
+        return;
+    }
+
+    // Same settings as SynthEngine::loadSoundFont().
+    fluid_settings_t* settings = new_fluid_settings();
+    fluid_settings_setnum(settings, "synth.sample-rate", static_cast<double>(kDefaultSampleRate));
+    fluid_settings_setint(settings, "synth.audio-channels", 1);
+    fluid_settings_setint(settings, "synth.midi-channels", kSynthInstanceChannels);
+    fluid_settings_setint(settings, "synth.polyphony", 64);
+    fluid_settings_setint(settings, "synth.reverb.active", 1);
+    fluid_settings_setint(settings, "synth.chorus.active", 0);
+
+    SynthPartitions partitions;
+    int32_t count = opt.partitions > 0 ? opt.partitions : SynthPartitions::defaultCount();
+    if (!partitions.create(settings, opt.soundFont, count)) {
+        LOGE("bench: failed to load %s", opt.soundFont.c_str());
+        delete_fluid_settings(settings);
+        return;
+    }
+
+    // Dense chunks: 32 events per 256 frames spread over 16 channels on
+    // every partition, each noteOn released a chunk later so polyphony stays bounded.
+    constexpr int kEventsPerChunk = 32;
+    int64_t total = static_cast<int64_t>(opt.seconds) * kDefaultSampleRate;
+    int64_t chunks = total / kSynthRenderChunkFrames;
+    std::vector<NoteEvent> events;
+    events.reserve(kEventsPerChunk * 2);
+    float out[kSynthRenderChunkFrames * kOutputChannelCount];
+
+    char name[48];
+    std::snprintf(name, sizeof(name), "synth.render.p%d", partitions.count());
+    report(opt, name, "frame", chunks * kSynthRenderChunkFrames, [&] {
+        partitions.allSoundsOff();
+        double sum = 0.0;
+        for (int64_t c = 0; c < chunks; ++c) {
+            events.clear();
+            for (int e = 0; e < kEventsPerChunk / 2; ++e) {
+                int channel = SynthPartitions::physicalChannel(e % partitions.count(), e % 16);
+                int note = 48 + static_cast<int>((c * 5 + e * 3) % 36);
+                int prevNote = 48 + static_cast<int>(((c - 1) * 5 + e * 3) % 36);
+                int32_t offset = e * (kSynthRenderChunkFrames / (kEventsPerChunk / 2));
+                if (c > 0) events.push_back({channel, prevNote, 0, offset});
+                events.push_back({channel, note, 100, offset});
+            }
+            if (!partitions.render(out, kSynthRenderChunkFrames, events)) break;
+            sum += out[0];
+        }
+        return sum;
+    });
+
+    partitions.destroy();
+    delete_fluid_settings(settings);
+}
+#endif
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (arg == "--filter" && (v = value())) {
+            opt.filter = v;
+        } else if (arg == "--reps" && (v = value())) {
+            opt.reps = std::max(1, std::atoi(v));
+        } else if (arg == "--tracks" && (v = value())) {
+            opt.tracks = std::max(1, std::atoi(v));
+        } else if (arg == "--seconds" && (v = value())) {
+            opt.seconds = std::max(1, std::atoi(v));
+        } else if (arg == "--soundfont" && (v = value())) {
+            opt.soundFont = v;
+        } else if (arg == "--partitions" && (v = value())) {
+            opt.partitions = std::clamp(std::atoi(v), 1, kMaxSynthPartitions);
+        } else {
+            std::fprintf(stderr,
+                         "usage: %s [--filter NAME] [--reps N] [--tracks N] [--seconds S]\n"
+                         "       [--soundfont PATH] [--partitions N]\n",
+                         argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 2;
+
+    Reclaimer reclaimer;
+    benchMixer(opt, reclaimer);
+    benchStepSequencer(opt, reclaimer);
+    benchMidiSequencer(opt, reclaimer);
+    benchRingBuffer(opt);
+    benchCodec(opt);
+    benchResampler(opt);
+#ifdef NIGHTJAR_BENCH_HAVE_FLUIDSYNTH
+    benchSynth(opt);
+#endif
+
+    std::fflush(stdout);
+    std::fprintf(stderr, "(checksum %g)\n", gSink);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "common.h"
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace nightjar {
+
+/**
+ * Lock-free single-producer single-consumer queue of fixed-size
+ * records, the engine's control counterpart to SpscRingBuffer: commands
+ * into the real-time threads, and envelope points out of the capture
+ * callback.
+ *
+ * The producer (a UI-side edit, serialized by its owner) pushes a
+ * whole batch at once; the consumer (the audio callback or the synth
+ * render thread) drains everything queued at one point in its cycle,
+ * so the batch takes effect on a single block or chunk boundary.
+ * Records are trivially copyable and stored inline: no allocations, no
+ * mutexes, no syscalls on either side. Capacity must be a power of 2.
+ */
+template <typename T, size_t N>
+class CommandRing {
+    static_assert((N & (N - 1)) == 0, "N must be a power of 2");
+    static_assert(std::is_trivially_copyable<T>::value, "commands are copied as raw records");
+
+public:
+    /**
+     * Producer: queue [count] commands, all or none. Returns false if
+     * they don't fit; nothing is queued then.
+     */
+    bool push(const T* commands, size_t count) {
+        size_t w = writePos_.load(std::memory_order_relaxed);
+        size_t r = readPos_.load(std::memory_order_acquire);
+        if (count > N - (w - r)) return false;
+        for (size_t i = 0; i < count; ++i) {
+            buffer_[(w + i) & (N - 1)] = commands[i];
+        }
+        // One release for the batch: the consumer sees all of it or none.
+        writePos_.store(w + count, std::memory_order_release);
+        return true;
+    }
+
+    /** Consumer: call [apply] on up to [maxCount] queued records, oldest first. */
+    template <typename F>
+    size_t drain(F&& apply, size_t maxCount = N) {
+        size_t r = readPos_.load(std::memory_order_relaxed);
+        size_t w = writePos_.load(std::memory_order_acquire);
+        if (w - r > maxCount) w = r + maxCount;
+        for (size_t i = r; i != w; ++i) {
+            apply(buffer_[i & (N - 1)]);
+        }
+        readPos_.store(w, std::memory_order_release);
+        return w - r;
+    }
+
+    /** Consumer: the oldest queued record, left queued; null if none. */
+    const T* front() const {
+        size_t r = readPos_.load(std::memory_order_relaxed);
+        if (r == writePos_.load(std::memory_order_acquire)) return nullptr;
+        return &buffer_[r & (N - 1)];
+    }
+
+    /** Consumer: drop the record front() returned. */
+    void pop() {
+        readPos_.store(readPos_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** Drop everything. Only call when neither side is active. */
+    void clear() {
+        writePos_.store(0, std::memory_order_relaxed);
+        readPos_.store(0, std::memory_order_relaxed);
+    }
+
+    /** True if nothing is queued. Either side. */
+    bool empty() const {
+        return writePos_.load(std::memory_order_acquire) ==
+               readPos_.load(std::memory_order_acquire);
+    }
+
+private:
+    T buffer_[N] = {};
+    alignas(kCacheLine) std::atomic<size_t> writePos_{0};  // producer line
+    alignas(kCacheLine) std::atomic<size_t> readPos_{0};   // consumer line
+};
+
+}  // namespace nightjar
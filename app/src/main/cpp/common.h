@@ -1,29 +1,57 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <android/log.h>
 
 #define LOG_TAG "NightjarAudio"
+
+#if defined(__ANDROID__)
+#include <android/log.h>
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 #define LOGW(...) __android_log_print(ANDROID_LOG_WARN,  LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+// Host builds (benchmark/): warnings and errors go to stderr; debug
+// logging is compiled out unless NIGHTJAR_HOST_DEBUG_LOG is defined so
+// it doesn't distort timings.
+#include <cstdio>
+#define NIGHTJAR_HOST_LOG(level, ...) \
+    (std::fprintf(stderr, "%s " LOG_TAG ": ", level), \
+     std::fprintf(stderr, __VA_ARGS__), std::fputc('\n', stderr))
+#if defined(NIGHTJAR_HOST_DEBUG_LOG)
+#define LOGD(...) NIGHTJAR_HOST_LOG("D", __VA_ARGS__)
+#else
+// Unevaluated, but still type-checks the format arguments.
+#define LOGD(...) ((void)sizeof(std::fprintf(stderr, __VA_ARGS__)))
+#endif
+#define LOGW(...) NIGHTJAR_HOST_LOG("W", __VA_ARGS__)
+#define LOGE(...) NIGHTJAR_HOST_LOG("E", __VA_ARGS__)
+#endif
 
 namespace nightjar {
 
-constexpr int32_t kSampleRate = 44100;
+// The engine runs at whatever rate the output stream opens with (see
+// AtomicTransport::sampleRate). This is only the fallback when no stream
+// could be opened, and the rate every take was recorded at before the
+// engine followed the device.
+constexpr int32_t kDefaultSampleRate = 44100;
 constexpr int32_t kChannelCount = 1;         // mono recording
-constexpr int32_t kOutputChannelCount = 2;   // stereo output (mono tracks panned center)
+constexpr int32_t kOutputChannelCount = 2;   // stereo output (mono tracks panned)
 constexpr int32_t kBitsPerSample = 16;
 constexpr int32_t kBytesPerSample = kBitsPerSample / 8;
 
-/** Convert milliseconds to sample frames at kSampleRate. */
-inline int64_t msToFrames(int64_t ms) {
-    return (ms * kSampleRate) / 1000;
+// Indices written by different threads are padded apart to this, so a
+// producer's stores don't keep invalidating the consumer's line.
+constexpr size_t kCacheLine = 64;
+
+/** Convert milliseconds to sample frames at [sampleRate]. */
+inline int64_t msToFrames(int64_t ms, int32_t sampleRate) {
+    return (ms * sampleRate) / 1000;
 }
 
-/** Convert sample frames to milliseconds at kSampleRate. */
-inline int64_t framesToMs(int64_t frames) {
-    return (frames * 1000) / kSampleRate;
+/** Convert sample frames to milliseconds at [sampleRate]. */
+inline int64_t framesToMs(int64_t frames, int32_t sampleRate) {
+    return (frames * 1000) / sampleRate;
 }
 
 }  // namespace nightjar
@@ -0,0 +1,455 @@
+#include "compressed_audio.h"
+#include "wav_track_source.h"
+#include "wav_writer.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace nightjar {
+
+namespace {
+
+constexpr char kCompressedMagic[4] = {'N', 'J', 'C', 'A'};
+constexpr uint32_t kCompressedVersion = 1;
+
+struct CompressedFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t sampleRate;
+    uint16_t channelCount;
+    uint16_t bitsPerSample;
+    uint32_t blockFrames;
+    uint32_t reserved;
+    int64_t totalFrames;
+    int64_t blockCount;
+};
+
+// First byte of every block: the predictor order, kConstantBlock for a
+// block that repeats one sample, or kVerbatimBlock for raw samples when
+// coding would not make the block smaller.
+constexpr uint8_t kMaxPredictorOrder = 3;
+constexpr uint8_t kConstantBlock = 0x80;
+constexpr uint8_t kVerbatimBlock = 0x81;
+constexpr uint32_t kMaxRiceParameter = 20;
+// A residual whose Rice quotient reaches this many zero bits is stored
+// raw (32 bits) after them instead.
+constexpr uint32_t kRiceEscape = 24;
+
+inline int32_t predict(int32_t order, const int32_t* x) {
+    switch (order) {
+        case 1: return x[-1];
+        case 2: return 2 * x[-1] - x[-2];
+        case 3: return 3 * x[-1] - 3 * x[-2] + x[-3];
+        default: return 0;
+    }
+}
+
+inline uint32_t zigzag(int32_t v) {
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+inline int32_t unzigzag(uint32_t u) {
+    return static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void write(uint32_t value, uint32_t bits) {
+        for (uint32_t i = bits; i-- > 0;) {
+            acc_ = static_cast<uint8_t>((acc_ << 1) | ((value >> i) & 1));
+            if (++fill_ == 8) flushByte();
+        }
+    }
+
+    void writeZeros(uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) {
+            acc_ = static_cast<uint8_t>(acc_ << 1);
+            if (++fill_ == 8) flushByte();
+        }
+    }
+
+    /** Pad the last byte with zeros. */
+    void finish() {
+        if (fill_ > 0) {
+            acc_ = static_cast<uint8_t>(acc_ << (8 - fill_));
+            flushByte();
+        }
+    }
+
+private:
+    void flushByte() {
+        out_.push_back(acc_);
+        acc_ = 0;
+        fill_ = 0;
+    }
+
+    std::vector<uint8_t>& out_;
+    uint8_t acc_ = 0;
+    uint32_t fill_ = 0;
+};
+
+/** MSB-first reader over one block; reads past the end yield zeros. */
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : begin_(data), p_(data), end_(data + size) {}
+
+    uint32_t read(uint32_t bits) {
+        if (bits == 0) return 0;
+        refill();
+        auto v = static_cast<uint32_t>(buf_ >> (64 - bits));
+        buf_ <<= bits;
+        avail_ -= bits;
+        return v;
+    }
+
+    /** Decode one Rice-coded, zigzagged residual. */
+    int32_t readRice(uint32_t k) {
+        refill();
+        uint32_t zeros = buf_ ? static_cast<uint32_t>(__builtin_clzll(buf_)) : 64;
+        if (zeros >= kRiceEscape) {
+            consume(kRiceEscape);
+            uint32_t hi = read(16);
+            return unzigzag((hi << 16) | read(16));
+        }
+        consume(zeros + 1);
+        return unzigzag((zeros << k) | read(k));
+    }
+
+    /** True if more bits were consumed than the block holds. */
+    bool overrun() const {
+        auto fed = static_cast<uint64_t>(p_ - begin_) + padBytes_;
+        return fed * 8 - avail_ > static_cast<uint64_t>(end_ - begin_) * 8;
+    }
+
+private:
+    void refill() {
+        while (avail_ <= 56) {
+            uint64_t byte = 0;
+            if (p_ < end_) {
+                byte = *p_++;
+            } else {
+                ++padBytes_;
+            }
+            buf_ |= byte << (56 - avail_);
+            avail_ += 8;
+        }
+    }
+
+    void consume(uint32_t bits) {
+        buf_ <<= bits;
+        avail_ -= bits;
+    }
+
+    const uint8_t* begin_;
+    const uint8_t* p_;
+    const uint8_t* end_;
+    uint64_t buf_ = 0;
+    uint32_t avail_ = 0;
+    uint64_t padBytes_ = 0;
+};
+
+void encodeBlock(const int16_t* pcm, int32_t n, std::vector<uint8_t>& out) {
+    int32_t x[kCompressedBlockFrames];
+    bool constant = true;
+    for (int32_t i = 0; i < n; ++i) {
+        x[i] = pcm[i];
+        constant = constant && x[i] == x[0];
+    }
+
+    if (constant) {
+        out.push_back(kConstantBlock);
+        auto v = static_cast<uint16_t>(pcm[0]);
+        out.push_back(static_cast<uint8_t>(v & 0xFF));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+        return;
+    }
+
+    // Pick the fixed predictor with the smallest residual energy.
+    int32_t maxOrder = std::min<int32_t>(kMaxPredictorOrder, n - 1);
+    uint64_t bestSum = UINT64_MAX;
+    int32_t order = 0;
+    for (int32_t o = 0; o <= maxOrder; ++o) {
+        uint64_t sum = 0;
+        for (int32_t i = o; i < n; ++i) sum += zigzag(x[i] - predict(o, x + i));
+        if (sum < bestSum) {
+            bestSum = sum;
+            order = o;
+        }
+    }
+
+    // Rice parameter from the mean residual magnitude.
+    uint64_t mean = bestSum / static_cast<uint64_t>(std::max(1, n - order));
+    uint32_t k = 0;
+    while (k < kMaxRiceParameter && (uint64_t{2} << k) <= mean) ++k;
+
+    size_t blockStart = out.size();
+    out.push_back(static_cast<uint8_t>(order));
+    out.push_back(static_cast<uint8_t>(k));
+    for (int32_t i = 0; i < order; ++i) {
+        auto v = static_cast<uint16_t>(pcm[i]);
+        out.push_back(static_cast<uint8_t>(v & 0xFF));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+    }
+
+    BitWriter bits(out);
+    for (int32_t i = order; i < n; ++i) {
+        uint32_t u = zigzag(x[i] - predict(order, x + i));
+        uint32_t q = u >> k;
+        if (q >= kRiceEscape) {
+            bits.writeZeros(kRiceEscape);
+            bits.write(u, 32);
+        } else {
+            bits.writeZeros(q);
+            bits.write(1, 1);
+            bits.write(u & ((1u << k) - 1), k);
+        }
+    }
+    bits.finish();
+
+    if (out.size() - blockStart > 1 + static_cast<size_t>(n) * sizeof(int16_t)) {
+        out.resize(blockStart);
+        out.push_back(kVerbatimBlock);
+        for (int32_t i = 0; i < n; ++i) {
+            auto v = static_cast<uint16_t>(pcm[i]);
+            out.push_back(static_cast<uint8_t>(v & 0xFF));
+            out.push_back(static_cast<uint8_t>(v >> 8));
+        }
+    }
+}
+
+}  // namespace
+
+// ── Encoder ────────────────────────────────────────────────────────────
+
+bool encodeCompressedAudio(const int16_t* pcm, int64_t frameCount, int32_t sampleRate,
+                           const std::string& outPath) {
+    if (!pcm && frameCount > 0) return false;
+
+    int64_t blockCount = (frameCount + kCompressedBlockFrames - 1) / kCompressedBlockFrames;
+    std::vector<uint64_t> offsets(static_cast<size_t>(blockCount) + 1);
+    std::vector<uint8_t> data;
+    data.reserve(static_cast<size_t>(frameCount));
+
+    uint64_t base = sizeof(CompressedFileHeader) + offsets.size() * sizeof(uint64_t);
+    for (int64_t b = 0; b < blockCount; ++b) {
+        offsets[static_cast<size_t>(b)] = base + data.size();
+        int64_t start = b * kCompressedBlockFrames;
+        auto n = static_cast<int32_t>(std::min<int64_t>(kCompressedBlockFrames, frameCount - start));
+        encodeBlock(pcm + start, n, data);
+    }
+    offsets.back() = base + data.size();
+
+    CompressedFileHeader fh{};
+    std::memcpy(fh.magic, kCompressedMagic, sizeof(kCompressedMagic));
+    fh.version = kCompressedVersion;
+    fh.sampleRate = static_cast<uint32_t>(sampleRate);
+    fh.channelCount = static_cast<uint16_t>(kChannelCount);
+    fh.bitsPerSample = static_cast<uint16_t>(kBitsPerSample);
+    fh.blockFrames = static_cast<uint32_t>(kCompressedBlockFrames);
+    fh.totalFrames = frameCount;
+    fh.blockCount = blockCount;
+
+    std::string tmpPath = outPath + ".tmp" +
+        std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        LOGE("CompressedAudio: failed to create %s", tmpPath.c_str());
+        return false;
+    }
+    bool ok = fwrite(&fh, sizeof(fh), 1, f) == 1 &&
+              fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), f) == offsets.size() &&
+              (data.empty() || fwrite(data.data(), 1, data.size(), f) == data.size());
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), outPath.c_str()) != 0) {
+        LOGE("CompressedAudio: failed to write %s", outPath.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    LOGD("CompressedAudio: wrote %s (%lld frames, %llu bytes, %.1f%% of PCM)",
+         outPath.c_str(), (long long)frameCount, (unsigned long long)offsets.back(),
+         frameCount > 0 ? 100.0 * static_cast<double>(offsets.back()) /
+                          static_cast<double>(frameCount * kBytesPerSample) : 0.0);
+    return true;
+}
+
+bool compressWavFile(const std::string& wavPath, const std::string& outPath) {
+    WavTrackSource source;
+    if (!source.open(wavPath) || source.channelCount() != kChannelCount) return false;
+    return encodeCompressedAudio(source.pcmData(), source.totalFrames(), source.sampleRate(),
+                                 outPath);
+}
+
+bool expandCompressedAudio(const std::string& path, const std::string& outPath) {
+    CompressedAudioFile source;
+    if (!source.open(path)) return false;
+
+    std::string tmpPath = outPath + ".tmp" +
+        std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        LOGE("CompressedAudio: failed to create %s", tmpPath.c_str());
+        return false;
+    }
+    writePcmWavHeader(f, source.sampleRate(), kChannelCount);
+
+    std::vector<int16_t> block(kCompressedBlockFrames);
+    bool ok = true;
+    for (int64_t b = 0; ok && b < source.blockCount(); ++b) {
+        int32_t n = source.decodeBlock(b, block.data());
+        ok = n == source.blockFrames(b) &&
+             fwrite(block.data(), sizeof(int16_t), static_cast<size_t>(n), f) ==
+                 static_cast<size_t>(n);
+    }
+    if (ok) patchPcmWavHeader(f, source.totalFrames() * kBytesPerSample);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), outPath.c_str()) != 0) {
+        LOGE("CompressedAudio: failed to expand %s", path.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ── Decoder ────────────────────────────────────────────────────────────
+
+CompressedAudioFile::~CompressedAudioFile() {
+    close();
+}
+
+bool CompressedAudioFile::sniff(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char magic[4] = {};
+    bool match = ::read(fd, magic, sizeof(magic)) == static_cast<ssize_t>(sizeof(magic)) &&
+                 std::memcmp(magic, kCompressedMagic, sizeof(magic)) == 0;
+    ::close(fd);
+    return match;
+}
+
+bool CompressedAudioFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("CompressedAudio: failed to open %s", path.c_str());
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CompressedFileHeader)) {
+        LOGE("CompressedAudio: file too small or stat failed: %s", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    auto size = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        LOGE("CompressedAudio: mmap failed for %s", path.c_str());
+        return false;
+    }
+
+    const auto* fh = static_cast<const CompressedFileHeader*>(mapped);
+    int64_t expectedBlocks = (fh->totalFrames + kCompressedBlockFrames - 1) / kCompressedBlockFrames;
+    size_t tableEnd = sizeof(CompressedFileHeader) +
+                      (static_cast<size_t>(std::max<int64_t>(fh->blockCount, 0)) + 1) * sizeof(uint64_t);
+    bool valid = std::memcmp(fh->magic, kCompressedMagic, sizeof(kCompressedMagic)) == 0 &&
+                 fh->version == kCompressedVersion &&
+                 fh->channelCount == kChannelCount &&
+                 fh->bitsPerSample == kBitsPerSample &&
+                 fh->blockFrames == static_cast<uint32_t>(kCompressedBlockFrames) &&
+                 fh->sampleRate > 0 &&
+                 fh->totalFrames >= 0 && fh->blockCount == expectedBlocks &&
+                 tableEnd <= size;
+
+    const auto* offsets = reinterpret_cast<const uint64_t*>(
+        static_cast<const uint8_t*>(mapped) + sizeof(CompressedFileHeader));
+    for (int64_t b = 0; valid && b < fh->blockCount; ++b) {
+        valid = offsets[b] >= tableEnd && offsets[b] < offsets[b + 1] && offsets[b + 1] <= size;
+    }
+    if (!valid) {
+        LOGE("CompressedAudio: not a valid compressed take: %s", path.c_str());
+        munmap(mapped, size);
+        return false;
+    }
+
+    mapped_ = mapped;
+    mappedSize_ = size;
+    blockOffsets_ = offsets;
+    totalFrames_ = fh->totalFrames;
+    blockCount_ = fh->blockCount;
+    sampleRate_ = static_cast<int32_t>(fh->sampleRate);
+    LOGD("CompressedAudio: opened %s (frames=%lld, blocks=%lld, bytes=%zu, rate=%d)",
+         path.c_str(), (long long)totalFrames_, (long long)blockCount_, size, sampleRate_);
+    return true;
+}
+
+void CompressedAudioFile::close() {
+    if (mapped_) munmap(mapped_, mappedSize_);
+    mapped_ = nullptr;
+    mappedSize_ = 0;
+    blockOffsets_ = nullptr;
+    totalFrames_ = 0;
+    blockCount_ = 0;
+    sampleRate_ = kDefaultSampleRate;
+}
+
+int32_t CompressedAudioFile::blockFrames(int64_t index) const {
+    if (index < 0 || index >= blockCount_) return 0;
+    return static_cast<int32_t>(std::min<int64_t>(
+        kCompressedBlockFrames, totalFrames_ - index * kCompressedBlockFrames));
+}
+
+int32_t CompressedAudioFile::decodeBlock(int64_t index, int16_t* out) const {
+    int32_t n = blockFrames(index);
+    if (n == 0) return 0;
+
+    const auto* base = static_cast<const uint8_t*>(mapped_);
+    const uint8_t* p = base + blockOffsets_[index];
+    auto size = static_cast<size_t>(blockOffsets_[index + 1] - blockOffsets_[index]);
+
+    auto readInt16 = [](const uint8_t* b) {
+        return static_cast<int16_t>(static_cast<uint16_t>(b[0] | (b[1] << 8)));
+    };
+
+    if (p[0] == kConstantBlock) {
+        if (size < 3) return 0;
+        std::fill(out, out + n, readInt16(p + 1));
+        return n;
+    }
+    if (p[0] == kVerbatimBlock) {
+        if (size < 1 + static_cast<size_t>(n) * sizeof(int16_t)) return 0;
+        for (int32_t i = 0; i < n; ++i) out[i] = readInt16(p + 1 + i * 2);
+        return n;
+    }
+
+    int32_t order = p[0];
+    uint32_t k = p[1];
+    size_t headerBytes = 2 + static_cast<size_t>(order) * sizeof(int16_t);
+    if (order > kMaxPredictorOrder || order >= n || k > kMaxRiceParameter || size < headerBytes) {
+        return 0;
+    }
+
+    int32_t x[kCompressedBlockFrames];
+    for (int32_t i = 0; i < order; ++i) x[i] = readInt16(p + 2 + i * 2);
+
+    BitReader bits(p + headerBytes, size - headerBytes);
+    for (int32_t i = order; i < n; ++i) {
+        x[i] = bits.readRice(k) + predict(order, x + i);
+    }
+    if (bits.overrun()) return 0;
+
+    for (int32_t i = 0; i < n; ++i) out[i] = static_cast<int16_t>(x[i]);
+    return n;
+}
+
+}  // namespace nightjar
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "common.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace nightjar {
+
+/**
+ * Nightjar compressed audio (`.njca`): lossless, block-compressed 16-bit
+ * mono PCM with a seek table.
+ *
+ * Each block of kCompressedBlockFrames samples is coded on its own with
+ * the best of the fixed polynomial predictors (orders 0-3, as in FLAC)
+ * and Rice-coded residuals, so any block can be decoded without touching
+ * its neighbours. Silent or constant blocks collapse to a single sample,
+ * and blocks that don't compress (noise) are stored verbatim, so a file
+ * is never meaningfully larger than its WAV. How far a take shrinks
+ * depends mostly on its noise floor; quiet passages and the gaps
+ * between phrases cost very little.
+ *
+ * Layout (native endianness; the file never leaves the device):
+ *   CompressedFileHeader
+ *   uint64_t blockOffsets[blockCount + 1]   // byte offsets, last = EOF
+ *   block data
+ */
+static constexpr int32_t kCompressedBlockFrames = 4096;
+
+/**
+ * Encode [frameCount] mono samples at [sampleRate] to [outPath] (via a
+ * temp file + rename, so readers never see a partial file). Returns true
+ * on success.
+ */
+bool encodeCompressedAudio(const int16_t* pcm, int64_t frameCount, int32_t sampleRate,
+                           const std::string& outPath);
+
+/** Encode the 16-bit mono WAV at [wavPath] to [outPath]. */
+bool compressWavFile(const std::string& wavPath, const std::string& outPath);
+
+/**
+ * Decode the `.njca` at [path] back to a 16-bit mono WAV at [outPath]
+ * (via a temp file + rename), for handing a take to another app.
+ */
+bool expandCompressedAudio(const std::string& path, const std::string& outPath);
+
+/**
+ * Read-only, memory-mapped `.njca` file.
+ *
+ * decodeBlock() only reads the mapping, so any number of threads may
+ * decode from one file at once. Decoding allocates nothing but is not
+ * meant for the audio callback; CompressedTrackSource runs it on the
+ * prefetch thread.
+ */
+class CompressedAudioFile {
+public:
+    CompressedAudioFile() = default;
+    ~CompressedAudioFile();
+
+    CompressedAudioFile(const CompressedAudioFile&) = delete;
+    CompressedAudioFile& operator=(const CompressedAudioFile&) = delete;
+
+    /** Map and validate [path]. */
+    bool open(const std::string& path);
+
+    void close();
+
+    bool isOpen() const { return mapped_ != nullptr; }
+
+    int64_t totalFrames() const { return totalFrames_; }
+    int64_t blockCount() const { return blockCount_; }
+    int32_t sampleRate() const { return sampleRate_; }
+
+    /** Samples in block [index]; only the last block may be short. */
+    int32_t blockFrames(int64_t index) const;
+
+    /**
+     * Decode block [index] into [out] (room for kCompressedBlockFrames).
+     * Returns the number of samples written, or 0 if the block is out of
+     * range or malformed.
+     */
+    int32_t decodeBlock(int64_t index, int16_t* out) const;
+
+    /** True if [path] starts with the `.njca` magic. */
+    static bool sniff(const std::string& path);
+
+private:
+    void* mapped_ = nullptr;
+    size_t mappedSize_ = 0;
+    const uint64_t* blockOffsets_ = nullptr;
+    int64_t totalFrames_ = 0;
+    int64_t blockCount_ = 0;
+    int32_t sampleRate_ = kDefaultSampleRate;
+};
+
+}  // namespace nightjar
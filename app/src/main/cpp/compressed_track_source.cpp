@@ -0,0 +1,171 @@
+#include "compressed_track_source.h"
+#include "common.h"
+#include "mix_kernels.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace nightjar {
+
+CompressedTrackSource::CompressedTrackSource() {
+    for (auto& at : cueAt_) at.store(-1, std::memory_order_relaxed);
+}
+
+CompressedTrackSource::~CompressedTrackSource() = default;
+
+bool CompressedTrackSource::open(const std::string& filePath) {
+    if (!file_.open(filePath)) return false;
+    ring_ = std::make_unique<CacheBlock[]>(kStreamBlocks);
+    cueBlocks_ = std::make_unique<CacheBlock[]>(kCueCount * kCueBlocks);
+    offlineBlock_ = std::make_unique<int16_t[]>(kCompressedBlockFrames);
+    offlineIndex_ = -1;
+    return true;
+}
+
+// ── Audio callback side ────────────────────────────────────────────────
+
+bool CompressedTrackSource::copyFrom(const CacheBlock& block, int64_t index, int32_t at,
+                                     int32_t count, float* output) const {
+    if (block.tag.load(std::memory_order_acquire) != index) return false;
+    convertInt16ToFloat(block.samples + at, output, count);
+    // Seqlock read side: the block must still hold [index] after the copy.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return block.tag.load(std::memory_order_relaxed) == index;
+}
+
+int64_t CompressedTrackSource::readFrames(float* output, int64_t frameOffset, int64_t numFrames) {
+    int64_t total = totalFrames();
+    if (!ring_ || frameOffset < 0 || frameOffset >= total) return 0;
+    int64_t toRead = std::min(numFrames, total - frameOffset);
+
+    // Moving into a new block slides the ring forward.
+    int64_t first = frameOffset / kCompressedBlockFrames;
+    if (head_.load(std::memory_order_relaxed) != first) {
+        head_.store(first, std::memory_order_release);
+        requestPrefetch();
+    }
+
+    for (int64_t done = 0; done < toRead;) {
+        int64_t pos = frameOffset + done;
+        int64_t index = pos / kCompressedBlockFrames;
+        auto at = static_cast<int32_t>(pos % kCompressedBlockFrames);
+        auto count = static_cast<int32_t>(std::min<int64_t>(kCompressedBlockFrames - at, toRead - done));
+        float* dst = output + done;
+
+        bool hit = copyFrom(ring_[index % kStreamBlocks], index, at, count, dst);
+        for (int32_t c = 0; !hit && c < kCueCount; ++c) {
+            int64_t cueFirst = cueAt_[c].load(std::memory_order_acquire);
+            if (cueFirst >= 0 && index >= cueFirst && index < cueFirst + kCueBlocks) {
+                hit = copyFrom(cueBlocks_[c * kCueBlocks + (index - cueFirst)], index, at, count, dst);
+            }
+        }
+        if (!hit) {
+            std::memset(dst, 0, static_cast<size_t>(count) * sizeof(float));
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            requestPrefetch();
+        }
+        done += count;
+    }
+    return toRead;
+}
+
+// ── UI / offline side ──────────────────────────────────────────────────
+
+void CompressedTrackSource::cue(TrackCue cue, int64_t frame) {
+    if (cue < 0 || cue >= kCueCount) return;
+    int64_t index = -1;
+    if (frame >= 0 && frame < totalFrames()) index = frame / kCompressedBlockFrames;
+    if (cueAt_[cue].exchange(index, std::memory_order_acq_rel) != index && index >= 0) {
+        requestPrefetch();
+    }
+}
+
+void CompressedTrackSource::prepare(TrackCue cue) {
+    if (cue < 0 || cue >= kCueCount || !cueBlocks_) return;
+    auto deadline = std::chrono::steady_clock::now() + kPrepareTimeout;
+    for (;;) {
+        int64_t cueFirst = cueAt_[cue].load(std::memory_order_acquire);
+        if (cueFirst < 0) return;
+        bool ready = true;
+        for (int32_t j = 0; j < kCueBlocks && cueFirst + j < file_.blockCount(); ++j) {
+            const CacheBlock& block = cueBlocks_[cue * kCueBlocks + j];
+            if (block.tag.load(std::memory_order_acquire) != cueFirst + j) ready = false;
+        }
+        if (ready || std::chrono::steady_clock::now() >= deadline) return;
+        requestPrefetch();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int64_t CompressedTrackSource::readFramesOffline(float* output, int64_t frameOffset,
+                                                 int64_t numFrames) {
+    int64_t total = totalFrames();
+    if (!offlineBlock_ || frameOffset < 0 || frameOffset >= total) return 0;
+    int64_t toRead = std::min(numFrames, total - frameOffset);
+
+    for (int64_t done = 0; done < toRead;) {
+        int64_t pos = frameOffset + done;
+        int64_t index = pos / kCompressedBlockFrames;
+        auto at = static_cast<int32_t>(pos % kCompressedBlockFrames);
+        auto count = static_cast<int32_t>(std::min<int64_t>(kCompressedBlockFrames - at, toRead - done));
+
+        if (index != offlineIndex_) {
+            offlineFrames_ = file_.decodeBlock(index, offlineBlock_.get());
+            offlineIndex_ = index;
+        }
+        if (at + count <= offlineFrames_) {
+            convertInt16ToFloat(offlineBlock_.get() + at, output + done, count);
+        } else {
+            std::memset(output + done, 0, static_cast<size_t>(count) * sizeof(float));
+        }
+        done += count;
+    }
+    return toRead;
+}
+
+// ── Prefetch thread side ───────────────────────────────────────────────
+
+void CompressedTrackSource::fill(CacheBlock& block, int64_t index) {
+    // Seqlock write side: retract the tag before touching the samples.
+    block.tag.store(-1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if (file_.decodeBlock(index, block.samples) == 0) {
+        // Serve a corrupt block as silence instead of retrying it forever.
+        LOGE("CompressedTrackSource: block %lld failed to decode", (long long)index);
+        std::memset(block.samples, 0, sizeof(block.samples));
+    }
+    block.tag.store(index, std::memory_order_release);
+}
+
+bool CompressedTrackSource::service(int32_t budget) {
+    if (!ring_) return false;
+    int64_t blocks = file_.blockCount();
+    int32_t decoded = 0;
+
+    for (int32_t c = 0; c < kCueCount; ++c) {
+        int64_t cueFirst = cueAt_[c].load(std::memory_order_acquire);
+        if (cueFirst < 0) continue;
+        for (int32_t j = 0; j < kCueBlocks && cueFirst + j < blocks; ++j) {
+            CacheBlock& block = cueBlocks_[c * kCueBlocks + j];
+            if (block.tag.load(std::memory_order_relaxed) == cueFirst + j) continue;
+            if (decoded == budget) return true;
+            fill(block, cueFirst + j);
+            ++decoded;
+        }
+    }
+
+    // Nearest blocks first, so after a jump the callback is covered
+    // again as soon as possible.
+    int64_t head = head_.load(std::memory_order_acquire);
+    for (int64_t index = head; index < head + kStreamBlocks && index < blocks; ++index) {
+        if (head_.load(std::memory_order_relaxed) != head) return true;
+        CacheBlock& block = ring_[index % kStreamBlocks];
+        if (block.tag.load(std::memory_order_relaxed) == index) continue;
+        if (decoded == budget) return true;
+        fill(block, index);
+        ++decoded;
+    }
+    return false;
+}
+
+}  // namespace nightjar
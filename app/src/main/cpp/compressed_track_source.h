@@ -0,0 +1,94 @@
+#pragma once
+
+#include "compressed_audio.h"
+#include "track_source.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace nightjar {
+
+/**
+ * Playback source for a `.njca` take, decoded ahead of the playhead.
+ *
+ * A ring of kStreamBlocks decoded blocks follows the block the audio
+ * callback last read (the head); the TrackPrefetcher thread keeps it
+ * filled. Each TrackCue additionally pins kCueBlocks blocks, so a track
+ * starting, a loop wrap or a seek finds its first ~180ms decoded while
+ * the ring catches up behind it.
+ *
+ * Every cache block carries the index of the block it holds. The writer
+ * clears the tag, fills the samples and publishes the tag again; the
+ * callback copies the samples and re-checks the tag afterwards, so a
+ * block that was being replaced mid-copy reads as a miss (silence)
+ * rather than as torn audio.
+ *
+ * Decoded samples stay 16-bit like the WAV mapping, and are converted in
+ * readFrames() with the same kernel.
+ */
+class CompressedTrackSource : public TrackSource {
+public:
+    /** Decoded lookahead: 16 blocks, ~1.5s at 44.1kHz. */
+    static constexpr int32_t kStreamBlocks = 16;
+    /** Blocks pinned per cue. */
+    static constexpr int32_t kCueBlocks = 2;
+    /** Longest prepare() will hold up the caller. */
+    static constexpr auto kPrepareTimeout = std::chrono::milliseconds(100);
+
+    CompressedTrackSource();
+    ~CompressedTrackSource() override;
+
+    bool open(const std::string& filePath);
+
+    bool isOpen() const override { return file_.isOpen(); }
+    int64_t totalFrames() const override { return file_.totalFrames(); }
+    int32_t sampleRate() const { return file_.sampleRate(); }
+
+    int64_t readFrames(float* output, int64_t frameOffset, int64_t numFrames) override;
+    int64_t readFramesOffline(float* output, int64_t frameOffset, int64_t numFrames) override;
+    void cue(TrackCue cue, int64_t frame) override;
+
+    /**
+     * Wait (bounded by kPrepareTimeout) for the prefetch thread to decode
+     * the cue's blocks; the thread stays their only writer.
+     */
+    void prepare(TrackCue cue) override;
+
+    /**
+     * Decode up to [budget] missing blocks (cues first, then the ring in
+     * playback order).
+     */
+    bool service(int32_t budget) override;
+
+    int64_t takeMissCount() override {
+        return misses_.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct CacheBlock {
+        std::atomic<int64_t> tag{-1};   // block index held, -1 while writing
+        int16_t samples[kCompressedBlockFrames];
+    };
+
+    /** Decode [index] into [block] unless it already holds it. */
+    void fill(CacheBlock& block, int64_t index);
+
+    /** Copy [count] frames of block [index] from [at], or false on a miss. */
+    bool copyFrom(const CacheBlock& block, int64_t index, int32_t at, int32_t count,
+                  float* output) const;
+
+    CompressedAudioFile file_;
+    std::unique_ptr<CacheBlock[]> ring_;
+    std::unique_ptr<CacheBlock[]> cueBlocks_;
+    std::array<std::atomic<int64_t>, kCueCount> cueAt_;   // first block per cue, -1 = unset
+    std::atomic<int64_t> head_{0};       // block the callback last read
+    std::atomic<int64_t> misses_{0};
+
+    // Offline renderer's one-block decode memo (its thread only).
+    std::unique_ptr<int16_t[]> offlineBlock_;
+    int64_t offlineIndex_ = -1;
+    int32_t offlineFrames_ = 0;
+};
+
+}  // namespace nightjar
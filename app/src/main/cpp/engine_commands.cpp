@@ -0,0 +1,146 @@
+#include "engine_commands.h"
+#include "common.h"
+#include <cstring>
+
+namespace nightjar {
+
+static size_t alignUp(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+template <typename T>
+static T load(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+// ── CommandReader ──────────────────────────────────────────────────────
+
+const uint8_t* CommandReader::take(size_t bytes, size_t align) {
+    if (!ok_) return nullptr;
+    size_t start = alignUp(pos_, align);
+    if (start > size_ || bytes > size_ - start) {
+        ok_ = false;
+        return nullptr;
+    }
+    pos_ = start + bytes;
+    return data_ + start;
+}
+
+int32_t CommandReader::i32() {
+    const uint8_t* p = take(sizeof(int32_t), sizeof(int32_t));
+    return p ? load<int32_t>(p) : 0;
+}
+
+float CommandReader::f32() {
+    const uint8_t* p = take(sizeof(float), sizeof(float));
+    return p ? load<float>(p) : 0.0f;
+}
+
+int64_t CommandReader::i64() {
+    const uint8_t* p = take(sizeof(int64_t), sizeof(int64_t));
+    return p ? load<int64_t>(p) : 0;
+}
+
+double CommandReader::f64() {
+    const uint8_t* p = take(sizeof(double), sizeof(double));
+    return p ? load<double>(p) : 0.0;
+}
+
+template <typename T>
+const T* CommandReader::array(int32_t& count) {
+    count = 0;
+    const uint8_t* header = take(8, 8);
+    if (!header) return nullptr;
+    int32_t n = load<int32_t>(header);
+    if (n < 0) {
+        ok_ = false;
+        return nullptr;
+    }
+    const uint8_t* elements = take(static_cast<size_t>(n) * sizeof(T), 8);
+    if (!elements) return nullptr;
+    count = n;
+    // Aligned by construction (8-aligned buffer, 8-aligned array start)
+    return n > 0 ? reinterpret_cast<const T*>(elements) : nullptr;
+}
+
+// The element types the header's array readers use.
+template const int32_t* CommandReader::array<int32_t>(int32_t&);
+template const float* CommandReader::array<float>(int32_t&);
+template const int64_t* CommandReader::array<int64_t>(int32_t&);
+template const double* CommandReader::array<double>(int32_t&);
+template const uint8_t* CommandReader::array<uint8_t>(int32_t&);
+
+// ── CommandBatchReader ─────────────────────────────────────────────────
+
+bool CommandBatchReader::open(const uint8_t* data, size_t size) {
+    data_ = data;
+    size_ = size;
+    pos_ = kCommandHeaderBytes;
+    count_ = 0;
+    index_ = 0;
+
+    if (!data || size < kCommandHeaderBytes) {
+        LOGE("CommandBatch: %zu bytes is too short for a batch", size);
+        return false;
+    }
+    if (reinterpret_cast<uintptr_t>(data) % 8 != 0) {
+        LOGE("CommandBatch: buffer is not 8-byte aligned");
+        return false;
+    }
+    uint32_t magic = load<uint32_t>(data);
+    uint16_t version = load<uint16_t>(data + 4);
+    uint32_t byteLength = load<uint32_t>(data + 8);
+    if (magic != kCommandMagic || version != kCommandFormatVersion) {
+        LOGE("CommandBatch: unsupported batch (magic=0x%08x, version=%u, expected %u)",
+             magic, static_cast<unsigned>(version), static_cast<unsigned>(kCommandFormatVersion));
+        return false;
+    }
+    if (byteLength < kCommandHeaderBytes || byteLength > size) {
+        LOGE("CommandBatch: length %u does not fit the %zu-byte buffer", byteLength, size);
+        return false;
+    }
+    size_ = byteLength;
+    count_ = load<uint16_t>(data + 6);
+    return true;
+}
+
+bool CommandBatchReader::recordAt(size_t pos, int32_t index, uint32_t& payloadBytes) const {
+    // The record header first: nothing of it is read unless it is all there
+    if (pos > size_ || size_ - pos < kCommandRecordHeaderBytes) {
+        LOGE("CommandBatch: truncated at command %d of %d", index, count_);
+        return false;
+    }
+    payloadBytes = load<uint32_t>(data_ + pos + 4);
+    size_t payloadStart = pos + kCommandRecordHeaderBytes;
+    if (payloadBytes % 8 != 0 || payloadBytes > size_ - payloadStart) {
+        LOGE("CommandBatch: command %d has a bad payload size (%u)", index, payloadBytes);
+        return false;
+    }
+    return true;
+}
+
+bool CommandBatchReader::validate() const {
+    size_t pos = pos_;
+    for (int32_t index = index_; index < count_; ++index) {
+        uint32_t payloadBytes = 0;
+        if (!recordAt(pos, index, payloadBytes)) return false;
+        pos += kCommandRecordHeaderBytes + payloadBytes;
+    }
+    return true;
+}
+
+bool CommandBatchReader::next(CommandOp& op, CommandReader& payload) {
+    if (index_ >= count_) return false;
+    uint32_t payloadBytes = 0;
+    if (!recordAt(pos_, index_, payloadBytes)) return false;
+    size_t payloadStart = pos_ + kCommandRecordHeaderBytes;
+    op = static_cast<CommandOp>(load<uint16_t>(data_ + pos_));
+    payload = CommandReader(data_ + payloadStart, payloadBytes);
+    pos_ = payloadStart + payloadBytes;
+    ++index_;
+    return true;
+}
+
+}  // namespace nightjar
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nightjar {
+
+/**
+ * Binary format of the engine command channel.
+ *
+ * Kotlin (EngineCommandBuffer) writes a batch of commands into a direct
+ * ByteBuffer and hands it over with one JNI call; the engine decodes it
+ * in place, so bulk edits cross JNI without per-array copies. All
+ * values are in native byte order.
+ *
+ *   batch   := header command*
+ *   header  := u32 magic, u16 version, u16 commandCount, u32 byteLength, u32 reserved
+ *   command := u16 op, u16 reserved, u32 payloadBytes, payload (padded to 8)
+ *   array   := i32 count, i32 reserved, count elements (padded to 8)
+ *
+ * Scalars in a payload are 4 bytes (i32, f32; booleans as i32) or 8
+ * (i64, f64); 8-byte values start on an 8-byte boundary. Arrays start 8
+ * byte aligned, so the decoder hands out pointers straight into the
+ * buffer. Boolean arrays are one byte per element, read as uint8_t:
+ * any nonzero byte is true.
+ *
+ * The version is bumped whenever the payload of an existing op changes;
+ * new ops may be added without a bump, and an unknown op is skipped.
+ */
+static constexpr uint32_t kCommandMagic = 0x42434A4E;  // "NJCB"
+static constexpr uint16_t kCommandFormatVersion = 1;
+static constexpr size_t kCommandHeaderBytes = 16;
+static constexpr size_t kCommandRecordHeaderBytes = 8;
+
+/** Command opcodes. Values are part of the format; never renumber. */
+enum class CommandOp : uint16_t {
+    // Mixer controls, applied by the audio callback at a block boundary.
+    TrackVolume = 1,   // i32 trackId, f32 volume
+    TrackMuted = 2,    // i32 trackId, i32 muted
+    TrackPan = 3,      // i32 trackId, f32 pan
+    BusVolume = 4,     // i32 busId, f32 volume
+    BusMuted = 5,      // i32 busId, i32 muted
+
+    // Tempo map
+    SetBpm = 16,       // f64 bpm
+    SetTempoMap = 17,  // i64[] startTicks, f64[] bpms, i32[] beatsPerBar
+
+    // Drum sequencer
+    DrumPatternClips = 32,  // f32 volume, i32 muted, i32[] patternStepsPerBar,
+                            // i32[] patternTotalSteps, i32[] patternBeatsPerBar,
+                            // i32[] patternHitCounts, i32[] hitStepIndices,
+                            // i32[] hitDrumNotes, f32[] hitVelocities,
+                            // i32[] clipPatterns, i64[] clipOffsetsMs
+    DrumSequencerEnabled = 33,  // i32 enabled
+
+    // MIDI sequencer
+    MidiTracks = 48,   // i32[] channels, i32[] programs, f32[] volumes, u8[] muted,
+                       // i32[] trackClipCounts, i64[] clipOffsetsMs, i64[] clipLengthsMs,
+                       // i32[] clipEventCounts, i64[] eventTicks, i32[] eventChannels,
+                       // i32[] eventNotes, i32[] eventVelocities
+    MidiTrack = 49,    // i32 trackIndex, i32 channel, i32 program, f32 volume, i32 muted,
+                       // then the clip and event arrays of MidiTracks
+    MidiSequencerEnabled = 50,  // i32 enabled
+    MidiTrackRange = 51,  // i32 trackIndex, i64 startMs, i64 endMs,
+                          // then the clip and event arrays of MidiTracks
+};
+
+/**
+ * Bounds-checked cursor over one command's payload. A read past the end
+ * or an array whose size doesn't add up fails and leaves the reader
+ * failed; callers check ok() once after reading every field.
+ */
+class CommandReader {
+public:
+    CommandReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    int32_t i32();
+    float f32();
+    bool boolean() { return i32() != 0; }
+    int64_t i64();
+    double f64();
+
+    /**
+     * Borrow an array of [count] elements from the buffer. The pointer
+     * is valid for as long as the batch. Empty arrays give nullptr.
+     */
+    const int32_t* i32s(int32_t& count) { return array<int32_t>(count); }
+    const float* f32s(int32_t& count) { return array<float>(count); }
+    const int64_t* i64s(int32_t& count) { return array<int64_t>(count); }
+    const double* f64s(int32_t& count) { return array<double>(count); }
+    /** A boolean array: one byte per element, nonzero = true. Compare
+     *  with 0 rather than reading the bytes as bool. */
+    const uint8_t* u8s(int32_t& count) { return array<uint8_t>(count); }
+
+    bool ok() const { return ok_; }
+
+private:
+    /** Reserve [bytes] at an [align]-aligned offset; nullptr on overrun. */
+    const uint8_t* take(size_t bytes, size_t align);
+
+    template <typename T>
+    const T* array(int32_t& count);
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+/**
+ * Walks the commands of a batch. open() validates the header against
+ * the format version; next() yields each command's op and payload
+ * until the batch is exhausted or a record is malformed.
+ */
+class CommandBatchReader {
+public:
+    /** Returns false (and logs) if [data] is not a batch this engine reads. */
+    bool open(const uint8_t* data, size_t size);
+
+    /**
+     * Walk every record header of the opened batch without consuming it.
+     * False (and logs) if a record runs past the batch or the batch ends
+     * before the announced count, so a truncated batch can be refused
+     * before any of it is applied.
+     */
+    bool validate() const;
+
+    /** Advance to the next command. Returns false at the end. */
+    bool next(CommandOp& op, CommandReader& payload);
+
+    /** Number of commands the header announces. */
+    int32_t commandCount() const { return count_; }
+
+    /** False if the batch ended early on a malformed record. */
+    bool complete() const { return index_ == count_; }
+
+private:
+    /** Payload size of the record at [pos]; false if the record doesn't fit. */
+    bool recordAt(size_t pos, int32_t index, uint32_t& payloadBytes) const;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+    int32_t count_ = 0;
+    int32_t index_ = 0;
+};
+
+}  // namespace nightjar
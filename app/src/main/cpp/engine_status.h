@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace nightjar {
+
+/**
+ * Word layout of EngineStatus, in 64-bit words. Mirrored by the Kotlin
+ * EngineStatusReader -- append only within a section, never reorder.
+ *
+ * Each section has a single writer thread, its own sequence word and
+ * its own cache line, so the writers never contend with each other.
+ */
+enum StatusWord : int32_t {
+    // Transport: the playback callback, once per block
+    kStatTransportSeq = 0,
+    kStatPlaying,             // 0 or 1
+    kStatRecording,           // overdub active, 0 or 1
+    kStatPositionFrames,      // timeline frame the block started at
+    kStatTotalFrames,
+    kStatLoopResetCount,
+    kStatPresentNanos,        // CLOCK_MONOTONIC time that frame reaches the output
+    kStatSampleRate,
+
+    // Synth: the render thread, once per chunk
+    kStatSynthSeq = 8,
+    kStatMetronomeBeatFrame,  // -1 before the first beat
+
+    // Input: the recording callback, once per block
+    kStatInputSeq = 16,
+    kStatInputPeak,           // double, 0-1
+    kStatRecordedFrames,      // frames captured since the write gate opened
+
+    kStatWordCount = 24
+};
+
+/**
+ * Status the UI polls every frame, published by the real-time threads
+ * into a block of plain memory that Kotlin maps as a direct ByteBuffer.
+ * Reading it costs no JNI transitions at all.
+ *
+ * Each section is a seqlock: the writer makes its sequence word odd,
+ * stores the fields, then makes it even again. A reader copies the
+ * section between two reads of the sequence and retries if they differ
+ * or are odd, so the fields of one section always come from the same
+ * block. Sections are independent of each other. Writers never wait
+ * and never allocate.
+ *
+ * The block is owned by AudioEngine and lives from initialize() to
+ * shutdown(); Kotlin drops its buffer before shutting the engine down.
+ */
+class EngineStatus {
+public:
+    static_assert(std::atomic<int64_t>::is_always_lock_free,
+                  "the block is read as plain memory from Kotlin");
+    static_assert(sizeof(std::atomic<int64_t>) == sizeof(int64_t),
+                  "one atomic per 64-bit word");
+
+    EngineStatus() {
+        for (auto& word : words_) word.store(0, std::memory_order_relaxed);
+        words_[kStatMetronomeBeatFrame].store(-1, std::memory_order_relaxed);
+    }
+
+    EngineStatus(const EngineStatus&) = delete;
+    EngineStatus& operator=(const EngineStatus&) = delete;
+
+    /**
+     * One update of the section headed by [sequence]. The section is
+     * marked in progress on construction and published on destruction,
+     * so a writer scopes one Writer around its stores.
+     */
+    class Writer {
+    public:
+        Writer(EngineStatus& status, StatusWord sequence)
+            : words_(status.words_), sequence_(sequence),
+              seq_(words_[sequence].load(std::memory_order_relaxed)) {
+            words_[sequence_].store(seq_ + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        ~Writer() { words_[sequence_].store(seq_ + 2, std::memory_order_release); }
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        void set(StatusWord word, int64_t value) {
+            words_[word].store(value, std::memory_order_relaxed);
+        }
+
+        void set(StatusWord word, double value) {
+            int64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            set(word, bits);
+        }
+
+    private:
+        std::atomic<int64_t>* words_;
+        StatusWord sequence_;
+        int64_t seq_;
+    };
+
+    /** Base of the block, for NewDirectByteBuffer. */
+    void* data() { return words_; }
+    static constexpr size_t sizeBytes() { return sizeof(int64_t) * kStatWordCount; }
+
+private:
+    alignas(64) std::atomic<int64_t> words_[kStatWordCount];
+};
+
+}  // namespace nightjar
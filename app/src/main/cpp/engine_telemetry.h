@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace nightjar {
+
+/**
+ * Flat index layout of EngineTelemetry::snapshot(). Mirrored by the
+ * Kotlin EngineTelemetry parser -- append only, never reorder.
+ */
+enum TelemetryField : int32_t {
+    kTelCallbackCount = 0,
+    kTelCallbackTotalNanos,
+    kTelCallbackMaxNanos,
+    kTelCallbackPeriodNanos,        // buffer period of the most recent callback
+    kTelCallbackHistogram,          // kCallbackHistogramBuckets entries
+    kTelXRunCount = kTelCallbackHistogram + 8,
+    kTelSynthReads,
+    kTelSynthUnderruns,             // callbacks that got no synth audio at all
+    kTelSynthShortReads,            // callbacks that got some, but not all
+    kTelSynthMissingFrames,
+    kTelRenderChunks,
+    kTelRenderTotalNanos,
+    kTelRenderMaxNanos,
+    kTelSynthRingFillFrames,        // fill level seen before the last render
+    kTelSynthRingLowWaterFrames,
+    kTelRecordRingHighWaterSamples,
+    kTelRecordDroppedSamples,
+    kTelSynthAlignCorrections,      // times synth audio was re-aligned to the timeline
+    kTelSynthAlignDroppedFrames,    // synth frames skipped because they ran late
+    kTelSynthAlignPaddedFrames,     // silence mixed because synth audio ran early
+    kTelFieldCount
+};
+
+/**
+ * Lock-free counters for the real-time paths, readable from any thread.
+ *
+ * Every writer is a single real-time or worker thread and every update is
+ * a relaxed atomic op, so instrumentation never blocks or allocates.
+ * Readers get a best-effort snapshot: fields are individually consistent
+ * but may be a callback apart from each other, which is fine for overlays
+ * and aggregated device stats.
+ *
+ * The callback histogram counts callbacks by how much of their buffer
+ * period they took, in quarter-period buckets: [0, 0.25), [0.25, 0.5),
+ * ..., [1.5, 1.75), [1.75, inf). Anything at or above 1.0 has eaten into
+ * the next buffer's deadline.
+ */
+struct EngineTelemetry {
+    static constexpr int32_t kCallbackHistogramBuckets = 8;
+    static_assert(kTelXRunCount == kTelCallbackHistogram + kCallbackHistogramBuckets,
+                  "histogram size must match TelemetryField layout");
+
+    // Playback callback (audio thread)
+    std::atomic<uint64_t> callbackCount{0};
+    std::atomic<uint64_t> callbackTotalNanos{0};
+    std::atomic<uint64_t> callbackMaxNanos{0};
+    std::atomic<uint64_t> callbackPeriodNanos{0};
+    std::atomic<uint64_t> callbackHistogram[kCallbackHistogramBuckets] = {};
+    std::atomic<uint64_t> xrunCount{0};
+
+    // Synth ring consumer (audio thread)
+    std::atomic<uint64_t> synthReads{0};
+    std::atomic<uint64_t> synthUnderruns{0};
+    std::atomic<uint64_t> synthShortReads{0};
+    std::atomic<uint64_t> synthMissingFrames{0};
+    std::atomic<uint64_t> synthAlignCorrections{0};
+    std::atomic<uint64_t> synthAlignDroppedFrames{0};
+    std::atomic<uint64_t> synthAlignPaddedFrames{0};
+
+    // Synth render thread
+    std::atomic<uint64_t> renderChunks{0};
+    std::atomic<uint64_t> renderTotalNanos{0};
+    std::atomic<uint64_t> renderMaxNanos{0};
+    std::atomic<uint64_t> synthRingFillFrames{0};
+    std::atomic<uint64_t> synthRingLowWaterFrames{UINT64_MAX};
+
+    // Recording ring (input callback produces, WavWriter consumes)
+    std::atomic<uint64_t> recordRingHighWaterSamples{0};
+    std::atomic<uint64_t> recordDroppedSamples{0};
+
+    /** Monotonic clock for duration measurements (vDSO, RT-safe). */
+    static uint64_t nowNanos() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static void raiseMax(std::atomic<uint64_t>& field, uint64_t value) {
+        uint64_t prev = field.load(std::memory_order_relaxed);
+        while (value > prev &&
+               !field.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+    }
+
+    static void lowerMin(std::atomic<uint64_t>& field, uint64_t value) {
+        uint64_t prev = field.load(std::memory_order_relaxed);
+        while (value < prev &&
+               !field.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+    }
+
+    /** One playback callback took [nanos] against a [periodNanos] budget. */
+    void recordCallback(uint64_t nanos, uint64_t periodNanos) {
+        callbackCount.fetch_add(1, std::memory_order_relaxed);
+        callbackTotalNanos.fetch_add(nanos, std::memory_order_relaxed);
+        callbackPeriodNanos.store(periodNanos, std::memory_order_relaxed);
+        raiseMax(callbackMaxNanos, nanos);
+
+        uint64_t bucket = periodNanos > 0 ? (nanos * 4) / periodNanos
+                                          : kCallbackHistogramBuckets - 1;
+        if (bucket >= kCallbackHistogramBuckets) bucket = kCallbackHistogramBuckets - 1;
+        callbackHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** The audio callback asked the synth ring for [wanted] frames, got [got]. */
+    void recordSynthRead(int32_t wanted, int32_t got) {
+        synthReads.fetch_add(1, std::memory_order_relaxed);
+        if (got >= wanted) return;
+        if (got == 0) {
+            synthUnderruns.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            synthShortReads.fetch_add(1, std::memory_order_relaxed);
+        }
+        synthMissingFrames.fetch_add(static_cast<uint64_t>(wanted - got),
+                                     std::memory_order_relaxed);
+    }
+
+    /** The audio callback skipped [dropped] late synth frames or mixed
+     *  [padded] frames of silence ahead of early ones to stay aligned. */
+    void recordSynthAlignment(int32_t dropped, int32_t padded) {
+        synthAlignCorrections.fetch_add(1, std::memory_order_relaxed);
+        synthAlignDroppedFrames.fetch_add(static_cast<uint64_t>(dropped),
+                                          std::memory_order_relaxed);
+        synthAlignPaddedFrames.fetch_add(static_cast<uint64_t>(padded),
+                                         std::memory_order_relaxed);
+    }
+
+    /** One render chunk took [nanos] with [fillFrames] already queued. */
+    void recordRenderChunk(uint64_t nanos, uint64_t fillFrames) {
+        renderChunks.fetch_add(1, std::memory_order_relaxed);
+        renderTotalNanos.fetch_add(nanos, std::memory_order_relaxed);
+        raiseMax(renderMaxNanos, nanos);
+        synthRingFillFrames.store(fillFrames, std::memory_order_relaxed);
+        lowerMin(synthRingLowWaterFrames, fillFrames);
+    }
+
+    /** Copy every field into [out] using the TelemetryField layout. */
+    void snapshot(int64_t (&out)[kTelFieldCount]) const {
+        auto get = [](const std::atomic<uint64_t>& f) {
+            return static_cast<int64_t>(f.load(std::memory_order_relaxed));
+        };
+        out[kTelCallbackCount] = get(callbackCount);
+        out[kTelCallbackTotalNanos] = get(callbackTotalNanos);
+        out[kTelCallbackMaxNanos] = get(callbackMaxNanos);
+        out[kTelCallbackPeriodNanos] = get(callbackPeriodNanos);
+        for (int32_t i = 0; i < kCallbackHistogramBuckets; ++i) {
+            out[kTelCallbackHistogram + i] = get(callbackHistogram[i]);
+        }
+        out[kTelXRunCount] = get(xrunCount);
+        out[kTelSynthReads] = get(synthReads);
+        out[kTelSynthUnderruns] = get(synthUnderruns);
+        out[kTelSynthShortReads] = get(synthShortReads);
+        out[kTelSynthMissingFrames] = get(synthMissingFrames);
+        out[kTelRenderChunks] = get(renderChunks);
+        out[kTelRenderTotalNanos] = get(renderTotalNanos);
+        out[kTelRenderMaxNanos] = get(renderMaxNanos);
+        out[kTelSynthRingFillFrames] = get(synthRingFillFrames);
+        uint64_t low = synthRingLowWaterFrames.load(std::memory_order_relaxed);
+        out[kTelSynthRingLowWaterFrames] = low == UINT64_MAX ? -1 : static_cast<int64_t>(low);
+        out[kTelRecordRingHighWaterSamples] = get(recordRingHighWaterSamples);
+        out[kTelRecordDroppedSamples] = get(recordDroppedSamples);
+        out[kTelSynthAlignCorrections] = get(synthAlignCorrections);
+        out[kTelSynthAlignDroppedFrames] = get(synthAlignDroppedFrames);
+        out[kTelSynthAlignPaddedFrames] = get(synthAlignPaddedFrames);
+    }
+
+    /** Zero all counters (start a new aggregation window). Races with
+     *  concurrent writers only lose the updates in flight. */
+    void reset() {
+        auto zero = [](std::atomic<uint64_t>& f) { f.store(0, std::memory_order_relaxed); };
+        zero(callbackCount);
+        zero(callbackTotalNanos);
+        zero(callbackMaxNanos);
+        zero(callbackPeriodNanos);
+        for (auto& bucket : callbackHistogram) zero(bucket);
+        zero(xrunCount);
+        zero(synthReads);
+        zero(synthUnderruns);
+        zero(synthShortReads);
+        zero(synthMissingFrames);
+        zero(renderChunks);
+        zero(renderTotalNanos);
+        zero(renderMaxNanos);
+        zero(synthRingFillFrames);
+        synthRingLowWaterFrames.store(UINT64_MAX, std::memory_order_relaxed);
+        zero(recordRingHighWaterSamples);
+        zero(recordDroppedSamples);
+        zero(synthAlignCorrections);
+        zero(synthAlignDroppedFrames);
+        zero(synthAlignPaddedFrames);
+    }
+};
+
+}  // namespace nightjar
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace nightjar {
+
+/**
+ * One-consumer wakeup signal that is safe to raise from the audio callback.
+ *
+ * notify() bumps a sequence counter and only enters the kernel
+ * (FUTEX_WAKE) when the consumer is actually parked in waitFor(). A
+ * consumer that is busy -- e.g. the synth render thread catching up on
+ * an underflowing ring -- costs the notifier a single atomic add.
+ *
+ * waitFor() parks until the next notify() or the timeout. Spurious
+ * wakeups are possible; callers re-check their condition in a loop.
+ *
+ * Non-Linux builds (host tools) fall back to a condition variable.
+ */
+class EventSignal {
+public:
+    /** Wake the waiter, if any. Real-time safe on Linux/Android. */
+    void notify() {
+        seq_.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) == 0) return;
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq_),
+                FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+#endif
+    }
+
+    /** Block for up to [timeout] or until notify(). */
+    void waitFor(std::chrono::microseconds timeout) {
+        waitFor(prepareWait(), timeout);
+    }
+
+    /**
+     * Token for a two-phase wait: take the token, check the condition,
+     * then waitFor(token, ...). A notify() landing between the check and
+     * the wait makes the wait return immediately instead of being lost.
+     */
+    uint32_t prepareWait() const {
+        return seq_.load(std::memory_order_seq_cst);
+    }
+
+    /** Block until notify() has been called since [seen] was taken, or [timeout]. */
+    void waitFor(uint32_t seen, std::chrono::microseconds timeout) {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+#if defined(__linux__)
+        // FUTEX_WAIT returns immediately if seq_ moved since [seen], so a
+        // notify() racing with this call is never lost.
+        auto us = timeout.count();
+        timespec ts{};
+        ts.tv_sec = static_cast<time_t>(us / 1000000);
+        ts.tv_nsec = static_cast<long>((us % 1000000) * 1000);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq_),
+                FUTEX_WAIT_PRIVATE, seen, &ts, nullptr, 0);
+#else
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, timeout, [&] {
+            return seq_.load(std::memory_order_seq_cst) != seen;
+        });
+#endif
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+private:
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "futex word must be a plain 32-bit integer");
+
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<uint32_t> waiters_{0};
+#if !defined(__linux__)
+    std::mutex mutex_;
+    std::condition_variable cv_;
+#endif
+};
+
+}  // namespace nightjar
@@ -1,5 +1,12 @@
 #include <jni.h>
 #include "audio_engine.h"
+#include "compressed_audio.h"
+#include "engine_status.h"
+#include "engine_telemetry.h"
+#include "oboe_recording_stream.h"
+#include "peak_cache.h"
+#include "thread_policy.h"
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -41,18 +48,49 @@ Java_com_example_nightjar_audio_OboeAudioEngine_nativeIsInitialized(JNIEnv* /* e
     return (sEngine && sEngine->isInitialized()) ? JNI_TRUE : JNI_FALSE;
 }
 
+JNIEXPORT jint JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetSampleRate(JNIEnv* /* env */, jobject /* thiz */) {
+    if (!sEngine) return nightjar::kDefaultSampleRate;
+    return sEngine->getSampleRate();
+}
+
 // ── Recording ──────────────────────────────────────────────────────────
 
 JNIEXPORT jboolean JNICALL
 Java_com_example_nightjar_audio_OboeAudioEngine_nativeStartRecording(
-        JNIEnv* env, jobject /* thiz */, jstring filePath) {
+        JNIEnv* env, jobject /* thiz */, jstring filePath, jboolean splitTakesAtLoop) {
     if (!sEngine) return JNI_FALSE;
     const char* path = env->GetStringUTFChars(filePath, nullptr);
-    bool ok = sEngine->startRecording(path);
+    bool ok = sEngine->startRecording(path, splitTakesAtLoop == JNI_TRUE);
     env->ReleaseStringUTFChars(filePath, path);
     return ok ? JNI_TRUE : JNI_FALSE;
 }
 
+JNIEXPORT jboolean JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeStartDuplexRecording(
+        JNIEnv* env, jobject /* thiz */, jstring filePath, jboolean splitTakesAtLoop,
+        jlong startMs) {
+    if (!sEngine) return JNI_FALSE;
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    bool ok = sEngine->startDuplexRecording(path, splitTakesAtLoop == JNI_TRUE,
+                                            static_cast<int64_t>(startMs));
+    env->ReleaseStringUTFChars(filePath, path);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetRecordedStartMs(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (!sEngine) return -1;
+    return static_cast<jlong>(sEngine->getRecordedStartMs());
+}
+
+JNIEXPORT void JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetInputMonitoring(
+        JNIEnv* /* env */, jobject /* thiz */, jboolean enabled, jfloat gain) {
+    if (sEngine) sEngine->setInputMonitoring(enabled == JNI_TRUE, static_cast<float>(gain));
+}
+
 JNIEXPORT jboolean JNICALL
 Java_com_example_nightjar_audio_OboeAudioEngine_nativeAwaitFirstBuffer(
         JNIEnv* /* env */, jobject /* thiz */, jint timeoutMs) {
@@ -79,11 +117,29 @@ Java_com_example_nightjar_audio_OboeAudioEngine_nativeIsRecordingActive(
     return (sEngine && sEngine->isRecordingActive()) ? JNI_TRUE : JNI_FALSE;
 }
 
-JNIEXPORT jfloat JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetLatestPeakAmplitude(
-        JNIEnv* /* env */, jobject /* thiz */) {
-    if (!sEngine) return 0.0f;
-    return static_cast<jfloat>(sEngine->getLatestPeakAmplitude());
+/**
+ * Drain new live-input envelope points into [out] as interleaved
+ * min/max/rms triples. Returns the number of points written, at most
+ * out.length / 3; the caller drains again while the array comes back full.
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeDrainInputEnvelope(
+        JNIEnv* env, jobject /* thiz */, jfloatArray out) {
+    static_assert(sizeof(nightjar::EnvelopePoint) == 3 * sizeof(jfloat),
+                  "points are copied out as packed float triples");
+    if (!sEngine) return 0;
+    const size_t capacity = static_cast<size_t>(env->GetArrayLength(out)) / 3;
+    nightjar::EnvelopePoint points[256];
+    size_t total = 0;
+    while (total < capacity) {
+        size_t n = sEngine->drainInputEnvelope(
+                points, std::min(capacity - total, std::size(points)));
+        if (n == 0) break;
+        env->SetFloatArrayRegion(out, static_cast<jsize>(total * 3), static_cast<jsize>(n * 3),
+                                 reinterpret_cast<const jfloat*>(points));
+        total += n;
+    }
+    return static_cast<jint>(total);
 }
 
 JNIEXPORT jlong JNICALL
@@ -93,8 +149,36 @@ Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetRecordedDurationMs(
     return static_cast<jlong>(sEngine->getRecordedDurationMs());
 }
 
+JNIEXPORT jobjectArray JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetRecordedTakePaths(
+        JNIEnv* env, jobject /* thiz */) {
+    std::vector<std::string> paths;
+    if (sEngine) paths = sEngine->getRecordedTakePaths();
+
+    jclass stringClass = env->FindClass("java/lang/String");
+    jobjectArray result = env->NewObjectArray(static_cast<jsize>(paths.size()),
+                                              stringClass, nullptr);
+    if (!result) return nullptr;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        jstring path = env->NewStringUTF(paths[i].c_str());
+        env->SetObjectArrayElement(result, static_cast<jsize>(i), path);
+        env->DeleteLocalRef(path);
+    }
+    return result;
+}
+
 // ── Playback ───────────────────────────────────────────────────────────
 
+JNIEXPORT jboolean JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativePrepareTrackFile(
+        JNIEnv* env, jobject /* thiz */, jstring filePath) {
+    if (!sEngine || !filePath) return JNI_FALSE;
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    bool ok = sEngine->prepareTrackFile(path);
+    env->ReleaseStringUTFChars(filePath, path);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
 JNIEXPORT jboolean JNICALL
 Java_com_example_nightjar_audio_OboeAudioEngine_nativeAddTrack(
         JNIEnv* env, jobject /* thiz */, jint trackId, jstring filePath,
@@ -141,36 +225,46 @@ Java_com_example_nightjar_audio_OboeAudioEngine_nativeSeekTo(
     if (sEngine) sEngine->seekTo(static_cast<int64_t>(positionMs));
 }
 
-JNIEXPORT jboolean JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeIsPlaying(
-        JNIEnv* /* env */, jobject /* thiz */) {
-    return (sEngine && sEngine->isPlaying()) ? JNI_TRUE : JNI_FALSE;
+JNIEXPORT void JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetTrackBus(
+        JNIEnv* /* env */, jobject /* thiz */, jint trackId, jint busId) {
+    if (sEngine) sEngine->setTrackBus(static_cast<int>(trackId), static_cast<int32_t>(busId));
 }
 
-JNIEXPORT jlong JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetPositionMs(
-        JNIEnv* /* env */, jobject /* thiz */) {
-    if (!sEngine) return 0;
-    return static_cast<jlong>(sEngine->getPositionMs());
-}
+// ── Command channel ──────────────────────────────────────────────────────
 
-JNIEXPORT jlong JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetTotalDurationMs(
-        JNIEnv* /* env */, jobject /* thiz */) {
-    if (!sEngine) return 0;
-    return static_cast<jlong>(sEngine->getTotalDurationMs());
+/**
+ * Hand a batch written by EngineCommandBuffer to the engine. The buffer
+ * is direct, so the engine decodes it in place without copying; it is
+ * only borrowed for the duration of the call.
+ * Returns the number of rejected commands, or -1 if the batch is invalid.
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSubmitCommands(
+        JNIEnv* env, jobject /* thiz */, jobject buffer, jint length) {
+    if (!sEngine) return -1;
+    auto* data = static_cast<const uint8_t*>(env->GetDirectBufferAddress(buffer));
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (data == nullptr || length < 0 || static_cast<jlong>(length) > capacity) {
+        LOGE("nativeSubmitCommands: not a direct buffer or bad length (%d)", static_cast<int>(length));
+        return -1;
+    }
+    return static_cast<jint>(sEngine->submitCommands(data, static_cast<size_t>(length)));
 }
 
-JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetTrackVolume(
-        JNIEnv* /* env */, jobject /* thiz */, jint trackId, jfloat volume) {
-    if (sEngine) sEngine->setTrackVolume(static_cast<int>(trackId), static_cast<float>(volume));
+// ── Buses ────────────────────────────────────────────────────────────────
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeAddBus(
+        JNIEnv* /* env */, jobject /* thiz */, jint busId) {
+    if (!sEngine) return JNI_FALSE;
+    return sEngine->addBus(static_cast<int32_t>(busId)) ? JNI_TRUE : JNI_FALSE;
 }
 
 JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetTrackMuted(
-        JNIEnv* /* env */, jobject /* thiz */, jint trackId, jboolean muted) {
-    if (sEngine) sEngine->setTrackMuted(static_cast<int>(trackId), static_cast<bool>(muted));
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeRemoveBus(
+        JNIEnv* /* env */, jobject /* thiz */, jint busId) {
+    if (sEngine) sEngine->removeBus(static_cast<int32_t>(busId));
 }
 
 JNIEXPORT void JNICALL
@@ -191,15 +285,6 @@ Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetRecording(
     if (sEngine) sEngine->setRecording(static_cast<bool>(active));
 }
 
-// ── Loop reset tracking ─────────────────────────────────────────────────
-
-JNIEXPORT jlong JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetLoopResetCount(
-        JNIEnv* /* env */, jobject /* thiz */) {
-    if (!sEngine) return 0;
-    return static_cast<jlong>(sEngine->getLoopResetCount());
-}
-
 // ── Hardware latency measurement ────────────────────────────────────────
 
 JNIEXPORT jlong JNICALL
@@ -220,10 +305,10 @@ Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetInputLatencyMs(
 
 JNIEXPORT jboolean JNICALL
 Java_com_example_nightjar_audio_OboeAudioEngine_nativeLoadSoundFont(
-        JNIEnv* env, jobject /* thiz */, jstring path) {
+        JNIEnv* env, jobject /* thiz */, jstring path, jboolean lazySamples) {
     if (!sEngine) return JNI_FALSE;
     const char* cPath = env->GetStringUTFChars(path, nullptr);
-    bool ok = sEngine->loadSoundFont(cPath);
+    bool ok = sEngine->loadSoundFont(cPath, lazySamples == JNI_TRUE);
     env->ReleaseStringUTFChars(path, cPath);
     return ok ? JNI_TRUE : JNI_FALSE;
 }
@@ -258,6 +343,26 @@ Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetSynthVolume(
     if (sEngine) sEngine->setSynthVolume(static_cast<float>(volume));
 }
 
+JNIEXPORT void JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetSynthLatencyProfile(
+        JNIEnv* /* env */, jobject /* thiz */, jint profile) {
+    if (sEngine) sEngine->setSynthLatencyProfile(static_cast<int>(profile));
+}
+
+JNIEXPORT jint JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetSynthQualityTier(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (!sEngine) return 0;
+    return static_cast<jint>(sEngine->getSynthQualityTier());
+}
+
+JNIEXPORT jfloat JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetSynthRenderLoad(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (!sEngine) return 0.0f;
+    return static_cast<jfloat>(sEngine->getSynthRenderLoad());
+}
+
 JNIEXPORT void JNICALL
 Java_com_example_nightjar_audio_OboeAudioEngine_nativeSynthAllSoundsOff(
         JNIEnv* /* env */, jobject /* thiz */) {
@@ -307,157 +412,258 @@ Java_com_example_nightjar_audio_OboeAudioEngine_nativeUpdateDrumPattern(
     }
 }
 
-JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeUpdateDrumPatternClips(
-        JNIEnv* env, jobject /* thiz */,
-        jfloat volume, jboolean muted,
-        jintArray clipStepsPerBarArr, jintArray clipTotalStepsArr,
-        jintArray clipBeatsPerBarArr, jlongArray clipOffsetsMsArr,
-        jintArray clipHitCountsArr,
-        jintArray hitStepIndicesArr, jintArray hitDrumNotesArr,
-        jfloatArray hitVelocitiesArr) {
-    if (!sEngine) return;
-
-    jint clipCount = env->GetArrayLength(clipStepsPerBarArr);
-    jint* clipStepsPerBar = env->GetIntArrayElements(clipStepsPerBarArr, nullptr);
-    jint* clipTotalSteps = env->GetIntArrayElements(clipTotalStepsArr, nullptr);
-    jint* clipBeatsPerBar = env->GetIntArrayElements(clipBeatsPerBarArr, nullptr);
-    jlong* clipOffsetsMs = env->GetLongArrayElements(clipOffsetsMsArr, nullptr);
-    jint* clipHitCounts = env->GetIntArrayElements(clipHitCountsArr, nullptr);
+// ── Count-in API ─────────────────────────────────────────────────────
 
-    jint* hitStepIndices = env->GetIntArrayElements(hitStepIndicesArr, nullptr);
-    jint* hitDrumNotes = env->GetIntArrayElements(hitDrumNotesArr, nullptr);
-    jfloat* hitVelocities = env->GetFloatArrayElements(hitVelocitiesArr, nullptr);
+JNIEXPORT void JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetCountIn(
+        JNIEnv* /* env */, jobject /* thiz */, jint bars, jint beatsPerBar) {
+    if (sEngine) sEngine->setCountIn(static_cast<int>(bars), static_cast<int>(beatsPerBar));
+}
 
-    sEngine->updateDrumPatternClips(
-        static_cast<float>(volume), static_cast<bool>(muted),
-        static_cast<const int*>(clipStepsPerBar),
-        static_cast<const int*>(clipTotalSteps),
-        static_cast<const int*>(clipBeatsPerBar),
-        reinterpret_cast<const int64_t*>(clipOffsetsMs),
-        static_cast<const int*>(clipHitCounts),
-        static_cast<int>(clipCount),
-        static_cast<const int*>(hitStepIndices),
-        static_cast<const int*>(hitDrumNotes),
-        static_cast<const float*>(hitVelocities));
+// ── Metronome API ────────────────────────────────────────────────────
 
-    env->ReleaseIntArrayElements(clipStepsPerBarArr, clipStepsPerBar, JNI_ABORT);
-    env->ReleaseIntArrayElements(clipTotalStepsArr, clipTotalSteps, JNI_ABORT);
-    env->ReleaseIntArrayElements(clipBeatsPerBarArr, clipBeatsPerBar, JNI_ABORT);
-    env->ReleaseLongArrayElements(clipOffsetsMsArr, clipOffsetsMs, JNI_ABORT);
-    env->ReleaseIntArrayElements(clipHitCountsArr, clipHitCounts, JNI_ABORT);
-    env->ReleaseIntArrayElements(hitStepIndicesArr, hitStepIndices, JNI_ABORT);
-    env->ReleaseIntArrayElements(hitDrumNotesArr, hitDrumNotes, JNI_ABORT);
-    env->ReleaseFloatArrayElements(hitVelocitiesArr, hitVelocities, JNI_ABORT);
+JNIEXPORT void JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetMetronomeEnabled(
+        JNIEnv* /* env */, jobject /* thiz */, jboolean enabled) {
+    if (sEngine) sEngine->setMetronomeEnabled(static_cast<bool>(enabled));
 }
 
 JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetBpm(
-        JNIEnv* /* env */, jobject /* thiz */, jdouble bpm) {
-    if (sEngine) sEngine->setBpm(static_cast<double>(bpm));
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetMetronomeVolume(
+        JNIEnv* /* env */, jobject /* thiz */, jfloat volume) {
+    if (sEngine) sEngine->setMetronomeVolume(static_cast<float>(volume));
 }
 
 JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetDrumSequencerEnabled(
-        JNIEnv* /* env */, jobject /* thiz */, jboolean enabled) {
-    if (sEngine) sEngine->setDrumSequencerEnabled(static_cast<bool>(enabled));
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetMetronomeBeatsPerBar(
+        JNIEnv* /* env */, jobject /* thiz */, jint beatsPerBar) {
+    if (sEngine) sEngine->setMetronomeBeatsPerBar(static_cast<int>(beatsPerBar));
 }
 
-// ── MIDI Sequencer API ──────────────────────────────────────────────────
+// ── Offline export ───────────────────────────────────────────────────
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeStartExport(
+        JNIEnv* env, jobject /* thiz */, jstring filePath, jboolean includeMetronome) {
+    if (!sEngine) return JNI_FALSE;
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    bool ok = sEngine->startExport(path, static_cast<bool>(includeMetronome));
+    env->ReleaseStringUTFChars(filePath, path);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
 
 JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeUpdateMidiTracks(
-        JNIEnv* env, jobject /* thiz */,
-        jintArray channelsArr, jintArray programsArr,
-        jfloatArray volumesArr, jbooleanArray mutedArr,
-        jintArray trackEventCountsArr,
-        jlongArray eventFramesArr, jintArray eventChannelsArr,
-        jintArray eventNotesArr, jintArray eventVelocitiesArr) {
-    if (!sEngine) return;
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeCancelExport(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (sEngine) sEngine->cancelExport();
+}
 
-    jint trackCount = env->GetArrayLength(channelsArr);
-    jint* channels = env->GetIntArrayElements(channelsArr, nullptr);
-    jint* programs = env->GetIntArrayElements(programsArr, nullptr);
-    jfloat* volumes = env->GetFloatArrayElements(volumesArr, nullptr);
-    jboolean* mutedRaw = env->GetBooleanArrayElements(mutedArr, nullptr);
-    jint* trackEventCounts = env->GetIntArrayElements(trackEventCountsArr, nullptr);
-
-    // Convert jboolean array to bool array (can't use vector<bool> — it's a bit-packed
-    // specialization without .data()). Use a plain bool array instead.
-    std::vector<uint8_t> mutedBuf(trackCount);
-    for (int i = 0; i < trackCount; ++i) {
-        mutedBuf[i] = mutedRaw[i] != JNI_FALSE ? 1 : 0;
-    }
+JNIEXPORT jint JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetExportState(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (!sEngine) return 0;
+    return static_cast<jint>(sEngine->getExportState());
+}
 
-    jint totalEvents = env->GetArrayLength(eventFramesArr);
-    jlong* eventFrames = env->GetLongArrayElements(eventFramesArr, nullptr);
+JNIEXPORT jfloat JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetExportProgress(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (!sEngine) return 0.0f;
+    return static_cast<jfloat>(sEngine->getExportProgress());
+}
+
+// ── Track freeze ─────────────────────────────────────────────────────
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeStartMidiFreeze(
+        JNIEnv* env, jobject /* thiz */, jstring filePath,
+        jint channel, jint program, jfloat volume,
+        jlongArray eventTicksArr, jintArray eventChannelsArr,
+        jintArray eventNotesArr, jintArray eventVelocitiesArr, jlong lengthMs) {
+    if (!sEngine) return JNI_FALSE;
+
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    jint eventCount = env->GetArrayLength(eventTicksArr);
+    jlong* eventTicks = env->GetLongArrayElements(eventTicksArr, nullptr);
     jint* eventChannels = env->GetIntArrayElements(eventChannelsArr, nullptr);
     jint* eventNotes = env->GetIntArrayElements(eventNotesArr, nullptr);
     jint* eventVelocities = env->GetIntArrayElements(eventVelocitiesArr, nullptr);
 
-    sEngine->updateMidiTracks(
-        static_cast<const int*>(channels),
-        static_cast<const int*>(programs),
-        static_cast<const float*>(volumes),
-        reinterpret_cast<const bool*>(mutedBuf.data()),
-        static_cast<int>(trackCount),
-        static_cast<const int*>(trackEventCounts),
-        reinterpret_cast<const int64_t*>(eventFrames),
+    bool ok = sEngine->startMidiFreeze(
+        path, static_cast<int>(channel), static_cast<int>(program),
+        static_cast<float>(volume),
+        reinterpret_cast<const int64_t*>(eventTicks),
         static_cast<const int*>(eventChannels),
         static_cast<const int*>(eventNotes),
         static_cast<const int*>(eventVelocities),
-        static_cast<int>(totalEvents));
-
-    env->ReleaseIntArrayElements(channelsArr, channels, JNI_ABORT);
-    env->ReleaseIntArrayElements(programsArr, programs, JNI_ABORT);
-    env->ReleaseFloatArrayElements(volumesArr, volumes, JNI_ABORT);
-    env->ReleaseBooleanArrayElements(mutedArr, mutedRaw, JNI_ABORT);
-    env->ReleaseIntArrayElements(trackEventCountsArr, trackEventCounts, JNI_ABORT);
-    env->ReleaseLongArrayElements(eventFramesArr, eventFrames, JNI_ABORT);
+        static_cast<int>(eventCount), static_cast<int64_t>(lengthMs));
+
+    env->ReleaseLongArrayElements(eventTicksArr, eventTicks, JNI_ABORT);
     env->ReleaseIntArrayElements(eventChannelsArr, eventChannels, JNI_ABORT);
     env->ReleaseIntArrayElements(eventNotesArr, eventNotes, JNI_ABORT);
     env->ReleaseIntArrayElements(eventVelocitiesArr, eventVelocities, JNI_ABORT);
+    env->ReleaseStringUTFChars(filePath, path);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeStartDrumFreeze(
+        JNIEnv* env, jobject /* thiz */, jstring filePath, jfloat volume,
+        jint stepsPerBar, jint totalSteps, jint beatsPerBar,
+        jintArray hitStepIndicesArr, jintArray hitDrumNotesArr,
+        jfloatArray hitVelocitiesArr) {
+    if (!sEngine) return JNI_FALSE;
+
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    jint hitCount = env->GetArrayLength(hitStepIndicesArr);
+    jint* hitStepIndices = env->GetIntArrayElements(hitStepIndicesArr, nullptr);
+    jint* hitDrumNotes = env->GetIntArrayElements(hitDrumNotesArr, nullptr);
+    jfloat* hitVelocities = env->GetFloatArrayElements(hitVelocitiesArr, nullptr);
+
+    bool ok = sEngine->startDrumFreeze(
+        path, static_cast<float>(volume), static_cast<int>(stepsPerBar),
+        static_cast<int>(totalSteps), static_cast<int>(beatsPerBar),
+        static_cast<const int*>(hitStepIndices),
+        static_cast<const int*>(hitDrumNotes),
+        static_cast<const float*>(hitVelocities),
+        static_cast<int>(hitCount));
+
+    env->ReleaseIntArrayElements(hitStepIndicesArr, hitStepIndices, JNI_ABORT);
+    env->ReleaseIntArrayElements(hitDrumNotesArr, hitDrumNotes, JNI_ABORT);
+    env->ReleaseFloatArrayElements(hitVelocitiesArr, hitVelocities, JNI_ABORT);
+    env->ReleaseStringUTFChars(filePath, path);
+    return ok ? JNI_TRUE : JNI_FALSE;
 }
 
 JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetMidiSequencerEnabled(
-        JNIEnv* /* env */, jobject /* thiz */, jboolean enabled) {
-    if (sEngine) sEngine->setMidiSequencerEnabled(static_cast<bool>(enabled));
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeCancelFreeze(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (sEngine) sEngine->cancelFreeze();
 }
 
-// ── Count-in API ─────────────────────────────────────────────────────
+JNIEXPORT jint JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetFreezeState(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (!sEngine) return 0;
+    return static_cast<jint>(sEngine->getFreezeState());
+}
 
-JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetCountIn(
-        JNIEnv* /* env */, jobject /* thiz */, jint bars, jint beatsPerBar) {
-    if (sEngine) sEngine->setCountIn(static_cast<int>(bars), static_cast<int>(beatsPerBar));
+JNIEXPORT jfloat JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetFreezeProgress(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (!sEngine) return 0.0f;
+    return static_cast<jfloat>(sEngine->getFreezeProgress());
 }
 
-// ── Metronome API ────────────────────────────────────────────────────
+// ── Telemetry ───────────────────────────────────────────────────────────
 
-JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetMetronomeEnabled(
-        JNIEnv* /* env */, jobject /* thiz */, jboolean enabled) {
-    if (sEngine) sEngine->setMetronomeEnabled(static_cast<bool>(enabled));
+/**
+ * Fill the caller's LongArray with the TelemetryField counters in one
+ * call. The array is reused across polls so overlays don't allocate.
+ * Returns the number of entries written.
+ */
+JNIEXPORT jint JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetTelemetry(
+        JNIEnv* env, jobject /* thiz */, jlongArray outArr) {
+    if (!sEngine || !outArr) return 0;
+    int64_t fields[nightjar::kTelFieldCount];
+    jint capacity = env->GetArrayLength(outArr);
+    int32_t n = sEngine->getTelemetry(fields, std::min<int32_t>(capacity, nightjar::kTelFieldCount));
+    if (n > 0) {
+        env->SetLongArrayRegion(outArr, 0, n, reinterpret_cast<const jlong*>(fields));
+    }
+    return static_cast<jint>(n);
 }
 
 JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetMetronomeVolume(
-        JNIEnv* /* env */, jobject /* thiz */, jfloat volume) {
-    if (sEngine) sEngine->setMetronomeVolume(static_cast<float>(volume));
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeResetTelemetry(
+        JNIEnv* /* env */, jobject /* thiz */) {
+    if (sEngine) sEngine->resetTelemetry();
 }
 
+// ── Thread policy ───────────────────────────────────────────────────────
+
+/**
+ * Replace the scheduling settings of the engine's own threads (see
+ * ThreadPolicy). Process-wide and usable before nativeInit(); running
+ * synth threads pick the change up before their next chunk.
+ */
 JNIEXPORT void JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetMetronomeBeatsPerBar(
-        JNIEnv* /* env */, jobject /* thiz */, jint beatsPerBar) {
-    if (sEngine) sEngine->setMetronomeBeatsPerBar(static_cast<int>(beatsPerBar));
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeSetThreadPolicy(
+        JNIEnv* /* env */, jobject /* thiz */, jboolean realtimePriority,
+        jboolean performanceCores, jboolean performanceHint, jint hintTargetPercent) {
+    nightjar::ThreadPolicySettings settings;
+    settings.realtimePriority = realtimePriority == JNI_TRUE;
+    settings.performanceCores = performanceCores == JNI_TRUE;
+    settings.performanceHint = performanceHint == JNI_TRUE;
+    settings.hintTargetPercent = static_cast<int32_t>(hintTargetPercent);
+    nightjar::ThreadPolicy::setSettings(settings);
 }
 
-JNIEXPORT jlong JNICALL
-Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetLastMetronomeBeatFrame(
-        JNIEnv* /* env */, jobject /* thiz */) {
-    if (!sEngine) return -1;
-    return static_cast<jlong>(sEngine->getLastMetronomeBeatFrame());
+// ── Status block ────────────────────────────────────────────────────────
+
+/**
+ * Map the engine's status block (engine_status.h) as a direct ByteBuffer.
+ * Kotlin reads it without any further JNI calls; the buffer must not be
+ * touched after nativeShutdown(). Returns null before nativeInit().
+ */
+JNIEXPORT jobject JNICALL
+Java_com_example_nightjar_audio_OboeAudioEngine_nativeGetStatusBuffer(
+        JNIEnv* env, jobject /* thiz */) {
+    if (!sEngine || !sEngine->getStatus()) return nullptr;
+    return env->NewDirectByteBuffer(sEngine->getStatus()->data(),
+                                    static_cast<jlong>(nightjar::EngineStatus::sizeBytes()));
+}
+
+// ── Waveform peak cache ─────────────────────────────────────────────────
+// Static: reads the `.peaks` sidecar and does not need the engine.
+
+JNIEXPORT jfloatArray JNICALL
+Java_com_example_nightjar_audio_PeakCache_nativeReadBars(
+        JNIEnv* env, jobject /* thiz */, jstring takePath,
+        jlong startFrame, jlong endFrame, jint bars) {
+    if (!takePath || bars <= 0) return nullptr;
+    const char* path = env->GetStringUTFChars(takePath, nullptr);
+    nightjar::PeakCacheReader reader;
+    bool opened = reader.openForTake(path);
+    env->ReleaseStringUTFChars(takePath, path);
+    if (!opened) return nullptr;
+
+    std::vector<float> peaks(static_cast<size_t>(bars));
+    if (!reader.readBars(startFrame, endFrame, bars, peaks.data())) return nullptr;
+
+    jfloatArray result = env->NewFloatArray(bars);
+    if (result) env->SetFloatArrayRegion(result, 0, bars, peaks.data());
+    return result;
+}
+
+// ── Take compression ────────────────────────────────────────────────────
+// Static: converts files between WAV and `.njca` without the engine.
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_nightjar_audio_TakeCodec_nativeCompress(
+        JNIEnv* env, jobject /* thiz */, jstring wavPath, jstring outPath) {
+    if (!wavPath || !outPath) return JNI_FALSE;
+    const char* in = env->GetStringUTFChars(wavPath, nullptr);
+    const char* out = env->GetStringUTFChars(outPath, nullptr);
+    bool ok = nightjar::compressWavFile(in, out);
+    // Keep the waveform: the PCM is the same, so the WAV's peaks still hold
+    if (ok) nightjar::PeakCacheReader::adoptSidecar(in, out);
+    env->ReleaseStringUTFChars(outPath, out);
+    env->ReleaseStringUTFChars(wavPath, in);
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_example_nightjar_audio_TakeCodec_nativeExpand(
+        JNIEnv* env, jobject /* thiz */, jstring takePath, jstring outPath) {
+    if (!takePath || !outPath) return JNI_FALSE;
+    const char* in = env->GetStringUTFChars(takePath, nullptr);
+    const char* out = env->GetStringUTFChars(outPath, nullptr);
+    bool ok = nightjar::expandCompressedAudio(in, out);
+    env->ReleaseStringUTFChars(outPath, out);
+    env->ReleaseStringUTFChars(takePath, in);
+    return ok ? JNI_TRUE : JNI_FALSE;
 }
 
 }  // extern "C"
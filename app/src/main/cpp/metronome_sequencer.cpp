@@ -22,35 +22,36 @@ void MetronomeSequencer::resetToPosition(int64_t pos) {
 }
 
 const std::vector<NoteEvent>& MetronomeSequencer::tick(
-        int64_t renderPos, int32_t chunkFrames, double bpm) {
+        int64_t renderPos, int32_t chunkFrames, const TempoMap& tempo, int32_t sampleRate,
+        bool ignoreEnabled) {
     pendingEvents_.clear();
 
-    if (!enabled_.load(std::memory_order_acquire) || bpm <= 0.0) {
+    if (!ignoreEnabled && !enabled_.load(std::memory_order_acquire)) {
         return pendingEvents_;
     }
 
     float volume = volume_.load(std::memory_order_relaxed);
-    int beatsPerBar = beatsPerBar_.load(std::memory_order_relaxed);
-    if (beatsPerBar <= 0) beatsPerBar = 4;
-
-    double framesPerBeat = (60.0 / bpm) * static_cast<double>(kSampleRate);
-    if (framesPerBeat <= 0.0) return pendingEvents_;
 
     // Check all beats that fall within [renderPos, renderPos + chunkFrames)
     int64_t chunkEnd = renderPos + chunkFrames;
+    const auto ticksPerBeat = static_cast<double>(kTicksPerBeat);
 
     // First beat index in this chunk (ceiling)
     auto firstBeat = static_cast<int64_t>(
-        std::ceil(static_cast<double>(renderPos) / framesPerBeat));
+        std::ceil(tempo.tickAtFrame(renderPos, sampleRate) / ticksPerBeat));
     // Last possible beat in this chunk (floor, exclusive end)
     auto lastBeat = static_cast<int64_t>(
-        std::floor(static_cast<double>(chunkEnd - 1) / framesPerBeat));
+        std::floor(tempo.tickAtFrame(chunkEnd - 1, sampleRate) / ticksPerBeat));
 
-    for (int64_t beatIdx = firstBeat; beatIdx <= lastBeat; ++beatIdx) {
+    // One beat of slack on each side: a beat exactly on a chunk edge can
+    // round either way through frame -> tick -> frame, so the frame test
+    // below has the final say.
+    for (int64_t beatIdx = firstBeat - 1; beatIdx <= lastBeat + 1; ++beatIdx) {
         // Skip if we already triggered this beat
         if (beatIdx == lastBeatIndex_) continue;
 
-        auto beatFrame = static_cast<int64_t>(beatIdx * framesPerBeat);
+        const int64_t beatTick = beatIdx * kTicksPerBeat;
+        int64_t beatFrame = tempo.frameAtTick(static_cast<double>(beatTick), sampleRate);
         if (beatFrame < renderPos || beatFrame >= chunkEnd) continue;
 
         int32_t offset = static_cast<int32_t>(
@@ -58,10 +59,14 @@ const std::vector<NoteEvent>& MetronomeSequencer::tick(
                        static_cast<int64_t>(0),
                        static_cast<int64_t>(chunkFrames - 1)));
 
-        // Determine if this is beat 1 (accent) or a normal beat.
-        // C++ remainder can be negative for negative beatIdx, so normalize.
-        int beatInBar = static_cast<int>(beatIdx % beatsPerBar);
-        if (beatInBar < 0) beatInBar += beatsPerBar;
+        // Determine if this is beat 1 (accent) or a normal beat, counting
+        // bars from the start of the beat's tempo segment. Count-in beats
+        // are negative, so floor the division and normalize the remainder.
+        const TempoSegment& segment = tempo.segmentAtTick(static_cast<double>(beatTick));
+        auto beatInSegment = static_cast<int64_t>(std::floor(
+            static_cast<double>(beatTick - segment.startTick) / ticksPerBeat));
+        int beatInBar = static_cast<int>(beatInSegment % segment.beatsPerBar);
+        if (beatInBar < 0) beatInBar += segment.beatsPerBar;
         int note = (beatInBar == 0) ? kAccentNote : kNormalNote;
 
         int vel = static_cast<int>(volume * 100.0f);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "step_sequencer.h"  // for NoteEvent
+#include "tempo_map.h"
 #include <atomic>
 #include <cstdint>
 #include <vector>
@@ -10,8 +11,9 @@ namespace nightjar {
 /**
  * Metronome that fires GM percussion events on beat boundaries.
  *
- * Simple beat math -- no pattern data, no double-buffering needed.
- * Config is all atomics, safe for lock-free reads from the render thread.
+ * Beats and bars come from the tempo map -- no pattern data, no
+ * double-buffering needed. Config is all atomics, safe for lock-free
+ * reads from the render thread.
  *
  * Beat 1 (accent): GM note 76 (Hi Wood Block)
  * Other beats:     GM note 37 (Side Stick)
@@ -26,9 +28,16 @@ public:
 
     /**
      * Advance the metronome and return note events for this chunk.
-     * Called from the render thread -- reads only atomics.
+     * Called from the render thread -- reads only atomics and [tempo].
+     *
+     * @param tempo Map giving the beat positions and each bar's length.
+     * @param sampleRate Engine rate the beat length is measured in.
+     * @param ignoreEnabled Tick even when the metronome is switched off
+     *        (offline export with the click explicitly requested).
      */
-    const std::vector<NoteEvent>& tick(int64_t renderPos, int32_t chunkFrames, double bpm);
+    const std::vector<NoteEvent>& tick(int64_t renderPos, int32_t chunkFrames,
+                                       const TempoMap& tempo, int32_t sampleRate,
+                                       bool ignoreEnabled = false);
 
     /** Reset internal tracking state. Call on flush/stop. */
     void reset();
@@ -44,15 +53,12 @@ public:
     void setVolume(float volume) { volume_.store(volume, std::memory_order_relaxed); }
     float getVolume() const { return volume_.load(std::memory_order_relaxed); }
 
-    void setBeatsPerBar(int beats) { beatsPerBar_.store(beats, std::memory_order_relaxed); }
-
     /** Frame of the last beat event fired. Polled by UI for LED pulse. */
     int64_t getLastBeatFrame() const { return lastBeatFrame_.load(std::memory_order_relaxed); }
 
 private:
     std::atomic<bool> enabled_{false};
     std::atomic<float> volume_{0.7f};
-    std::atomic<int> beatsPerBar_{4};
 
     // Beat tracking (render thread only, int64 to support negative count-in indices)
     int64_t lastBeatIndex_ = -1;
@@ -4,53 +4,243 @@
 
 namespace nightjar {
 
-MidiSequencer::MidiSequencer() = default;
+// Render-side cursor arrays are reserved up front so a swap with a
+// typical track and clip count never allocates on the render thread.
+// Bigger snapshots carry buffers of their own (Snapshot::scratch).
+static constexpr size_t kReservedMidiTracks = 64;
+static constexpr size_t kReservedMidiClips = 1024;
 
-void MidiSequencer::updateTracks(const std::vector<MidiTrackData>& tracks) {
+MidiSequencer::MidiSequencer(Reclaimer& reclaimer) : snapshot_(reclaimer) {
+    cursors_.reserve(kReservedMidiClips);
+    nextCursors_.reserve(kReservedMidiClips);
+    cursorBases_.reserve(kReservedMidiTracks);
+    cursorVersions_.reserve(kReservedMidiTracks);
+    firstOpenClip_.reserve(kReservedMidiTracks);
+}
+
+void MidiSequencer::updateTracks(std::vector<MidiTrackData> tracks) {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    size_t trackCount = tracks.size();
+    publish(withTracks(std::move(tracks)));
+    LOGD("MidiSequencer: updated %zu tracks (gen=%llu)",
+         trackCount, (unsigned long long)generationCounter_);
+}
+
+void MidiSequencer::stageTracks(std::vector<MidiTrackData> tracks) {
     std::lock_guard<std::mutex> lock(editMutex_);
+    size_t trackCount = tracks.size();
+    auto next = withTracks(std::move(tracks));
+    stamp(*next);
+    snapshot_.stage(std::move(next));
+    LOGD("MidiSequencer: staged %zu tracks (gen=%llu)",
+         trackCount, (unsigned long long)generationCounter_);
+}
 
+std::unique_ptr<MidiSequencer::Snapshot> MidiSequencer::withTracks(
+        std::vector<MidiTrackData> tracks) {
     // Detect tracks that just became muted -- need all-notes-off on their channels
-    Snapshot* active = active_.load(std::memory_order_acquire);
-    uint16_t silenceMask = 0;
-    for (size_t i = 0; i < tracks.size() && i < active->tracks.size(); ++i) {
-        if (tracks[i].muted && !active->tracks[i].muted) {
-            silenceMask |= static_cast<uint16_t>(1 << tracks[i].channel);
-        }
+    const Snapshot* current = snapshot_.current();
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        const MidiTrackData* previous =
+            i < current->tracks.size() ? current->tracks[i].get() : nullptr;
+        silenceIfNewlyMuted(tracks[i], previous);
     }
-    if (silenceMask) {
-        silenceChannelMask_.fetch_or(silenceMask, std::memory_order_release);
+
+    // Every track gets a fresh version, so the render thread re-seeks
+    // all cursors on its next tick().
+    auto next = std::make_unique<Snapshot>();
+    next->tracks.reserve(tracks.size());
+    next->trackVersions.reserve(tracks.size());
+    for (auto& track : tracks) {
+        track.clips = sortedClips(std::move(track.clips));
+        next->tracks.push_back(std::make_shared<const MidiTrackData>(std::move(track)));
+        next->trackVersions.push_back(++versionCounter_);
     }
+    return next;
+}
 
-    // Write to the inactive snapshot
-    Snapshot* inactive = (active == &snapshotA_) ? &snapshotB_ : &snapshotA_;
+bool MidiSequencer::replaceTrack(size_t trackIndex, MidiTrackData track) {
+    std::lock_guard<std::mutex> lock(editMutex_);
 
-    inactive->tracks = tracks;
-    inactive->nextEventIndex.resize(tracks.size(), 0);
-    // Reset cursors -- the render thread will re-align them against the
-    // current render frame on its next tick() via the generation check.
-    for (size_t i = 0; i < tracks.size(); ++i) {
-        inactive->nextEventIndex[i] = 0;
+    const Snapshot* current = snapshot_.current();
+    if (trackIndex >= current->tracks.size()) {
+        LOGE("MidiSequencer: replaceTrack index %zu out of range (%zu tracks)",
+             trackIndex, current->tracks.size());
+        return false;
     }
-    // Bump generation so the render thread notices the swap and calls
-    // resetToPosition(renderPos) before iterating events.
-    inactive->generation = ++generationCounter_;
+    silenceIfNewlyMuted(track, current->tracks[trackIndex].get());
 
-    // Atomic swap
-    active_.store(inactive, std::memory_order_release);
-    LOGD("MidiSequencer: updated %zu tracks (gen=%llu)",
-         tracks.size(), (unsigned long long)inactive->generation);
+    track.clips = sortedClips(std::move(track.clips));
+    size_t clipCount = track.clips.size();
+    publish(withTrack(trackIndex, std::make_shared<const MidiTrackData>(std::move(track))));
+    LOGD("MidiSequencer: replaced track %zu, %zu clips (gen=%llu)",
+         trackIndex, clipCount, (unsigned long long)generationCounter_);
+    return true;
+}
+
+bool MidiSequencer::replaceTrackRange(size_t trackIndex, int64_t startFrame, int64_t endFrame,
+                                      const std::vector<MidiClipData>& clips) {
+    std::lock_guard<std::mutex> lock(editMutex_);
+
+    const Snapshot* current = snapshot_.current();
+    if (trackIndex >= current->tracks.size()) {
+        LOGE("MidiSequencer: replaceTrackRange index %zu out of range (%zu tracks)",
+             trackIndex, current->tracks.size());
+        return false;
+    }
+
+    // Keep the old clips starting outside the range, add the new ones
+    // starting inside it.
+    auto inRange = [&](const MidiClipData& clip) {
+        return clip.offsetFrames >= startFrame && clip.offsetFrames < endFrame;
+    };
+    const MidiTrackData& old = *current->tracks[trackIndex];
+    auto patched = std::make_shared<MidiTrackData>();
+    patched->channel = old.channel;
+    patched->program = old.program;
+    patched->volume = old.volume;
+    patched->muted = old.muted;
+    std::vector<MidiClipData> merged;
+    merged.reserve(old.clips.size() + clips.size());
+    for (const auto& clip : old.clips) {
+        if (!inRange(clip)) merged.push_back(clip);
+    }
+    for (const auto& clip : clips) {
+        if (inRange(clip)) merged.push_back(clip);
+    }
+    patched->clips = sortedClips(std::move(merged));
+
+    publish(withTrack(trackIndex, std::move(patched)));
+    LOGD("MidiSequencer: patched track %zu [%lld, %lld) (gen=%llu)",
+         trackIndex, (long long)startFrame, (long long)endFrame,
+         (unsigned long long)generationCounter_);
+    return true;
+}
+
+std::unique_ptr<MidiSequencer::Snapshot> MidiSequencer::withTrack(
+        size_t trackIndex, std::shared_ptr<const MidiTrackData> track) {
+    // Share every other track's data with the current snapshot.
+    const Snapshot* current = snapshot_.current();
+    auto next = std::make_unique<Snapshot>();
+    next->tracks = current->tracks;
+    next->trackVersions = current->trackVersions;
+    next->tracks[trackIndex] = std::move(track);
+    next->trackVersions[trackIndex] = ++versionCounter_;
+    return next;
+}
+
+void MidiSequencer::stamp(Snapshot& next) {
+    // Bump generation so the render thread notices the swap and
+    // re-aligns the cursors of changed tracks before iterating events.
+    indexClips(next);
+    next.generation = ++generationCounter_;
+
+    // Past the reserve, the render thread takes its buffers from here
+    size_t tracks = next.tracks.size();
+    if (next.clipCount > kReservedMidiClips) next.scratch.clips.reserve(next.clipCount);
+    if (tracks > kReservedMidiTracks) {
+        next.scratch.bases.reserve(tracks);
+        next.scratch.versions.reserve(tracks);
+        next.scratch.firstOpen.reserve(tracks);
+    }
 }
 
-const std::vector<NoteEvent>& MidiSequencer::tick(int64_t renderPos, int32_t chunkFrames) {
+void MidiSequencer::publish(std::unique_ptr<Snapshot> next) {
+    stamp(*next);
+    snapshot_.publish(std::move(next));
+}
+
+void MidiSequencer::silenceIfNewlyMuted(const MidiTrackData& track,
+                                        const MidiTrackData* previous) {
+    if (track.muted && previous && !previous->muted &&
+        track.channel >= 0 && track.channel < kMaxLogicalChannels) {
+        silenceChannels_[track.channel / 64].fetch_or(uint64_t{1} << (track.channel % 64),
+                                                      std::memory_order_release);
+    }
+}
+
+void MidiSequencer::indexClips(Snapshot& snap) {
+    snap.clipBase.resize(snap.tracks.size());
+    snap.clipCount = 0;
+    for (size_t t = 0; t < snap.tracks.size(); ++t) {
+        snap.clipBase[t] = snap.clipCount;
+        snap.clipCount += snap.tracks[t]->clips.size();
+    }
+}
+
+std::vector<MidiClipData> MidiSequencer::sortedClips(std::vector<MidiClipData> clips) {
+    std::stable_sort(clips.begin(), clips.end(),
+                     [](const MidiClipData& a, const MidiClipData& b) {
+                         return a.offsetFrames < b.offsetFrames;
+                     });
+    return clips;
+}
+
+int64_t MidiSequencer::eventFrame(const MidiClipData& clip, const MidiEvent& e,
+                                  const TempoMap& tempo, int32_t sampleRate) {
+    int64_t frame = tempo.frameAfter(clip.offsetFrames, static_cast<double>(e.tick), sampleRate);
+    if (clip.lengthFrames > 0) {
+        frame = std::min(frame, clip.offsetFrames + clip.lengthFrames);
+    }
+    return frame;
+}
+
+size_t MidiSequencer::lowerBound(const MidiClipData& clip, int64_t posFrames,
+                                 const TempoMap& tempo, int32_t sampleRate) {
+    // Binary search: find first event at or after posFrames. Frames
+    // grow with ticks (the clip-end cut only flattens them), so the
+    // resolved events are still sorted.
+    const auto& events = clip.events;
+    size_t lo = 0, hi = events.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (eventFrame(clip, events[mid], tempo, sampleRate) < posFrames) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void MidiSequencer::seekTrack(const MidiTrackData& track, size_t* cursors, int64_t posFrames,
+                              const TempoMap& tempo, int32_t sampleRate) {
+    for (size_t c = 0; c < track.clips.size(); ++c) {
+        cursors[c] = lowerBound(track.clips[c], posFrames, tempo, sampleRate);
+    }
+}
+
+void MidiSequencer::seekAll(const Snapshot& snap, int64_t posFrames, const TempoMap& tempo,
+                            int32_t sampleRate) {
+    size_t tracks = snap.tracks.size();
+    fit(cursors_, snap.scratch.clips, snap.clipCount);
+    fit(cursorBases_, snap.scratch.bases, tracks);
+    fit(cursorVersions_, snap.scratch.versions, tracks);
+    fit(firstOpenClip_, snap.scratch.firstOpen, tracks);
+    cursors_.resize(snap.clipCount);
+    cursorBases_.assign(snap.clipBase.begin(), snap.clipBase.end());
+    cursorVersions_.assign(snap.trackVersions.begin(), snap.trackVersions.end());
+    for (size_t t = 0; t < snap.tracks.size(); ++t) {
+        seekTrack(*snap.tracks[t], cursors_.data() + snap.clipBase[t], posFrames,
+                  tempo, sampleRate);
+    }
+    firstOpenClip_.assign(snap.tracks.size(), 0);
+    lastSeenGeneration_ = snap.generation;
+    lastSeenTempo_ = tempo.generation();
+}
+
+const std::vector<NoteEvent>& MidiSequencer::tick(int64_t renderPos, int32_t chunkFrames,
+                                                  const TempoMap& tempo, int32_t sampleRate) {
     pendingEvents_.clear();
 
     // Emit all-notes-off for channels that were just muted (note = -1 sentinel)
-    uint16_t silenceMask = silenceChannelMask_.exchange(0, std::memory_order_acq_rel);
-    if (silenceMask) {
-        for (int ch = 0; ch < 16; ++ch) {
-            if (silenceMask & (1 << ch)) {
+    for (int word = 0; word < kSilenceWords; ++word) {
+        if (silenceChannels_[word].load(std::memory_order_relaxed) == 0) continue;
+        uint64_t silenceMask = silenceChannels_[word].exchange(0, std::memory_order_acq_rel);
+        for (int bit = 0; bit < 64; ++bit) {
+            if (silenceMask & (uint64_t{1} << bit)) {
                 NoteEvent ne;
-                ne.channel = ch;
+                ne.channel = word * 64 + bit;
                 ne.note = -1;       // sentinel: all notes off on this channel
                 ne.velocity = 0;
                 ne.frameOffset = 0; // fire immediately at chunk start
@@ -59,63 +249,92 @@ const std::vector<NoteEvent>& MidiSequencer::tick(int64_t renderPos, int32_t chu
         }
     }
 
-    Snapshot* snap = active_.load(std::memory_order_acquire);
+    SnapshotPublisher<Snapshot>::ReadGuard snap(snapshot_, kRenderReader);
 
-    // Detect a snapshot swap (a mid-playback edit) and realign per-track
-    // cursors to the current render frame. Without this the new
-    // snapshot's cursor=0 would point at events long behind the playhead
-    // and the framePos >= renderPos guard below would silently consume
-    // them all without firing anything.
-    if (snap->generation != lastSeenGeneration_) {
+    // Detect a snapshot swap (a mid-playback edit) and realign the
+    // cursors of changed tracks to the current render frame. Without
+    // this the cursor would point into the replaced event array and the
+    // frame >= renderPos guard below would silently consume events
+    // behind the playhead without firing anything. Tracks whose version
+    // is unchanged keep their cursors as-is. A new tempo map moves
+    // every event, so it realigns everything.
+    if (tempo.generation() != lastSeenTempo_ ||
+        (snap->generation != lastSeenGeneration_ &&
+         cursorVersions_.size() != snap->tracks.size())) {
+        seekAll(*snap, renderPos, tempo, sampleRate);
+    } else if (snap->generation != lastSeenGeneration_) {
+        // The old cursors and bases are read below, so only the
+        // rebuilt ones take the snapshot's scratch
+        fit(nextCursors_, snap->scratch.clips, snap->clipCount);
+        nextCursors_.resize(snap->clipCount);
         for (size_t t = 0; t < snap->tracks.size(); ++t) {
-            const auto& events = snap->tracks[t].events;
-            if (events.empty()) {
-                snap->nextEventIndex[t] = 0;
-                continue;
-            }
-            size_t lo = 0, hi = events.size();
-            while (lo < hi) {
-                size_t mid = lo + (hi - lo) / 2;
-                if (events[mid].framePos < renderPos) {
-                    lo = mid + 1;
-                } else {
-                    hi = mid;
-                }
+            const MidiTrackData& track = *snap->tracks[t];
+            size_t* next = nextCursors_.data() + snap->clipBase[t];
+            if (cursorVersions_[t] == snap->trackVersions[t]) {
+                std::copy_n(cursors_.begin() + static_cast<ptrdiff_t>(cursorBases_[t]),
+                            track.clips.size(), next);
+            } else {
+                seekTrack(track, next, renderPos, tempo, sampleRate);
+                cursorVersions_[t] = snap->trackVersions[t];
             }
-            snap->nextEventIndex[t] = lo;
         }
+        cursors_.swap(nextCursors_);
+        fit(cursorBases_, snap->scratch.bases, snap->tracks.size());
+        fit(firstOpenClip_, snap->scratch.firstOpen, snap->tracks.size());
+        cursorBases_.assign(snap->clipBase.begin(), snap->clipBase.end());
+        firstOpenClip_.assign(snap->tracks.size(), 0);
         lastSeenGeneration_ = snap->generation;
     }
 
     int64_t chunkEnd = renderPos + chunkFrames;
 
     for (size_t t = 0; t < snap->tracks.size(); ++t) {
-        const MidiTrackData& track = snap->tracks[t];
-        if (track.muted || track.events.empty()) continue;
+        const MidiTrackData& track = *snap->tracks[t];
+        if (track.muted) continue;
 
-        size_t& idx = snap->nextEventIndex[t];
-        const auto& events = track.events;
+        const size_t* clipCursors = cursors_.data() + snap->clipBase[t];
+        size_t& firstOpen = firstOpenClip_[t];
+        while (firstOpen < track.clips.size() &&
+               clipCursors[firstOpen] >= track.clips[firstOpen].events.size()) {
+            ++firstOpen;
+        }
 
-        // Fire all events whose framePos falls within [renderPos, chunkEnd)
-        while (idx < events.size() && events[idx].framePos < chunkEnd) {
-            const MidiEvent& e = events[idx];
-            if (e.framePos >= renderPos) {
-                NoteEvent ne;
-                ne.channel = e.channel;
-                ne.note = e.note;
-                // Scale noteOn velocity by track volume
-                if (e.velocity > 0) {
-                    ne.velocity = std::max(1, static_cast<int>(e.velocity * track.volume));
-                } else {
-                    ne.velocity = 0;
+        for (size_t c = firstOpen; c < track.clips.size(); ++c) {
+            const MidiClipData& clip = track.clips[c];
+            // Clip hasn't started yet (nor has any later one)
+            if (clip.offsetFrames >= chunkEnd) break;
+
+            size_t& idx = cursors_[snap->clipBase[t] + c];
+            const auto& events = clip.events;
+            const int64_t clipEnd = clip.lengthFrames > 0
+                ? clip.offsetFrames + clip.lengthFrames
+                : INT64_MAX;
+
+            // Fire all events whose frame falls within [renderPos, chunkEnd)
+            while (idx < events.size()) {
+                const MidiEvent& e = events[idx];
+                int64_t frame = eventFrame(clip, e, tempo, sampleRate);
+                if (frame >= chunkEnd) break;
+                // Notes starting at or past the clip end are cut; their
+                // noteOffs, pinned to the end, are harmless.
+                if (frame >= renderPos && !(e.velocity > 0 && frame >= clipEnd)) {
+                    NoteEvent ne;
+                    ne.channel = e.channel;
+                    ne.note = e.note;
+                    // Scale noteOn velocity by track volume
+                    if (e.velocity > 0) {
+                        ne.velocity = std::max(1, static_cast<int>(e.velocity * track.volume));
+                    } else {
+                        ne.velocity = 0;
+                    }
+                    ne.frameOffset = static_cast<int32_t>(
+                        std::clamp(frame - renderPos,
+                                   static_cast<int64_t>(0),
+                                   static_cast<int64_t>(chunkFrames - 1)));
+                    pendingEvents_.push_back(ne);
                 }
-                ne.frameOffset = static_cast<int32_t>(
-                    std::clamp(e.framePos - renderPos,
-                               static_cast<int64_t>(0),
-                               static_cast<int64_t>(chunkFrames - 1)));
-                pendingEvents_.push_back(ne);
+                ++idx;
             }
-            ++idx;
         }
     }
 
@@ -123,53 +342,36 @@ const std::vector<NoteEvent>& MidiSequencer::tick(int64_t renderPos, int32_t chu
 }
 
 void MidiSequencer::reset() {
-    Snapshot* snap = active_.load(std::memory_order_acquire);
-    for (size_t i = 0; i < snap->nextEventIndex.size(); ++i) {
-        snap->nextEventIndex[i] = 0;
-    }
+    SnapshotPublisher<Snapshot>::ReadGuard snap(snapshot_, kRenderReader);
+    cursors_.assign(snap->clipCount, 0);
+    cursorBases_.assign(snap->clipBase.begin(), snap->clipBase.end());
+    cursorVersions_.assign(snap->trackVersions.begin(), snap->trackVersions.end());
+    firstOpenClip_.assign(snap->tracks.size(), 0);
+    lastSeenGeneration_ = snap->generation;
 }
 
-void MidiSequencer::resetToPosition(int64_t posFrames) {
-    Snapshot* snap = active_.load(std::memory_order_acquire);
-
-    for (size_t t = 0; t < snap->tracks.size(); ++t) {
-        const auto& events = snap->tracks[t].events;
-        if (events.empty()) {
-            snap->nextEventIndex[t] = 0;
-            continue;
-        }
-
-        // Binary search: find first event at or after posFrames
-        size_t lo = 0, hi = events.size();
-        while (lo < hi) {
-            size_t mid = lo + (hi - lo) / 2;
-            if (events[mid].framePos < posFrames) {
-                lo = mid + 1;
-            } else {
-                hi = mid;
-            }
-        }
-        snap->nextEventIndex[t] = lo;
-    }
+void MidiSequencer::resetToPosition(int64_t posFrames, const TempoMap& tempo,
+                                    int32_t sampleRate) {
+    SnapshotPublisher<Snapshot>::ReadGuard snap(snapshot_, kRenderReader);
+    seekAll(*snap, posFrames, tempo, sampleRate);
 }
 
-void MidiSequencer::forEachProgramAssignment(
-        const std::function<void(int, int)>& fn) const {
-    const Snapshot* snap = active_.load(std::memory_order_acquire);
-    for (const auto& track : snap->tracks) {
-        if (track.muted) continue;
-        fn(track.channel, track.program);
-    }
+int MidiSequencer::trackChannel(size_t trackIndex) const {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    const Snapshot* current = snapshot_.current();
+    return trackIndex < current->tracks.size() ? current->tracks[trackIndex]->channel : -1;
 }
 
-int64_t MidiSequencer::getMaxEndFrame() const {
-    const Snapshot* snap = active_.load(std::memory_order_acquire);
+int64_t MidiSequencer::getMaxEndFrame(const TempoMap& tempo, int32_t sampleRate) const {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    const Snapshot* snap = snapshot_.current();
     int64_t maxFrame = 0;
 
     for (const auto& track : snap->tracks) {
-        if (!track.events.empty()) {
+        for (const auto& clip : track->clips) {
+            if (clip.events.empty()) continue;
             // Last event's frame position (noteOff marks the true end)
-            int64_t endFrame = track.events.back().framePos;
+            int64_t endFrame = eventFrame(clip, clip.events.back(), tempo, sampleRate);
             maxFrame = std::max(maxFrame, endFrame);
         }
     }
@@ -1,58 +1,109 @@
 #pragma once
 
 #include "step_sequencer.h"  // for NoteEvent
+#include "snapshot_publisher.h"
+#include "tempo_map.h"
 #include <atomic>
 #include <cstdint>
-#include <functional>
+#include <memory>
 #include <mutex>
 #include <vector>
 
 namespace nightjar {
 
+// Logical MIDI channels: one per instrument track, plus the drum and
+// preview channels. SynthChannelMap lays them onto the synth's channels.
+static constexpr int kMaxLogicalChannels = 256;
+
 /**
- * A single MIDI event at a specific frame position.
- * Pre-generated by Kotlin as paired noteOn/noteOff events sorted by frame.
+ * A single MIDI event, [tick] ticks (kTicksPerBeat per beat) after the
+ * start of its clip. Pre-generated by Kotlin as paired noteOn/noteOff
+ * events sorted by tick.
  */
 struct MidiEvent {
-    int64_t framePos;   // absolute timeline frame position
-    int channel;        // MIDI channel (0-15)
+    int64_t tick;       // clip-relative position in ticks
+    int channel;        // logical channel, its track's
     int note;           // MIDI note number (0-127)
     int velocity;       // > 0 = noteOn, 0 = noteOff
 };
 
 /**
- * All MIDI events and metadata for a single instrument track.
+ * One clip of a MIDI track. The clip itself is placed in frames -- it
+ * stays put on the timeline when the tempo changes -- while its notes
+ * are in ticks and follow the tempo map.
+ */
+struct MidiClipData {
+    int64_t offsetFrames = 0;   // clip start on the timeline
+    /** Clip length; notes starting at or past it are dropped and notes
+     *  still sounding there end on it. <= 0 = unbounded. */
+    int64_t lengthFrames = 0;
+    std::vector<MidiEvent> events;   // sorted by tick
+};
+
+/**
+ * All MIDI clips and metadata for a single instrument track.
  */
 struct MidiTrackData {
-    int channel = 0;        // MIDI channel for this track
+    int channel = 0;        // logical channel (< kMaxLogicalChannels)
     int program = 0;        // GM program number (0-127)
     float volume = 1.0f;    // Track volume multiplier
     bool muted = false;
-    std::vector<MidiEvent> events;   // sorted by framePos
+    std::vector<MidiClipData> clips;   // kept sorted by offsetFrames
 };
 
 /**
  * Sequencer that plays variable-length MIDI note events across multiple
  * instrument channels. Events are pre-generated as noteOn/noteOff pairs
- * sorted by frame position.
+ * sorted by tick within each clip, and resolved to frames through the
+ * tempo map as they come due, so a tempo change needs no re-upload.
  *
- * Uses the same double-buffered, lock-free-read architecture as StepSequencer:
- * UI writes to the inactive buffer under a mutex, then atomically swaps.
- * The render thread reads lock-free from the active buffer.
+ * Uses the same RCU-published, lock-free-read architecture as StepSequencer:
+ * UI builds a new snapshot under a mutex and publishes it. The render
+ * thread reads lock-free through a hazard slot; replaced snapshots are
+ * freed on the Reclaimer thread.
  *
  * tick() is called from SynthEngine's render thread between render chunks.
  * It returns NoteEvent structs (same type as StepSequencer) for the caller
  * to fire into FluidSynth.
+ *
+ * Track data is held by shared_ptr so a snapshot swap only copies
+ * pointers. replaceTrack() / replaceTrackRange() rebuild a single
+ * track's clips and leave every other track's data -- and its
+ * render-side cursors -- untouched.
  */
 class MidiSequencer {
 public:
-    MidiSequencer();
+    explicit MidiSequencer(Reclaimer& reclaimer);
 
     /**
      * Replace all MIDI track data. Called from UI thread (JNI).
-     * Mutex-protected, writes to inactive buffer, then swaps.
+     * Mutex-protected, builds a new snapshot, then publishes it.
+     */
+    void updateTracks(std::vector<MidiTrackData> tracks);
+
+    /**
+     * Like updateTracks(), but the snapshot is built here and only
+     * swapped in by the render side's next commitStaged().
      */
-    void updateTracks(const std::vector<MidiTrackData>& tracks);
+    void stageTracks(std::vector<MidiTrackData> tracks);
+
+    /** Make the last stageTracks() snapshot current. Render side; lock-free. */
+    void commitStaged() { snapshot_.commitStaged(); }
+
+    /**
+     * Replace one track (metadata and clips) by its index in the last
+     * updateTracks() list. Only that track's cursors are re-seeked.
+     * Returns false if [trackIndex] is out of range.
+     */
+    bool replaceTrack(size_t trackIndex, MidiTrackData track);
+
+    /**
+     * Replace the clips of one track that start in [startFrame, endFrame)
+     * with [clips] (clips starting outside the range are dropped). Track
+     * metadata is unchanged. Returns false if [trackIndex] is out of range.
+     */
+    bool replaceTrackRange(size_t trackIndex, int64_t startFrame, int64_t endFrame,
+                           const std::vector<MidiClipData>& clips);
 
     /**
      * Advance the sequencer and return note events for this chunk.
@@ -60,74 +111,150 @@ public:
      *
      * @param renderPos   Current render position in frames (global timeline).
      * @param chunkFrames Number of frames in this render chunk.
+     * @param tempo       Map the clips' ticks are resolved through.
+     * @param sampleRate  Engine rate the frames are measured in.
      * @return Reference to internal event buffer (valid until next tick).
      */
-    const std::vector<NoteEvent>& tick(int64_t renderPos, int32_t chunkFrames);
+    const std::vector<NoteEvent>& tick(int64_t renderPos, int32_t chunkFrames,
+                                       const TempoMap& tempo, int32_t sampleRate);
 
-    /**
-     * Reset playback state. On seek, uses binary search to find the correct
-     * event index for the new position.
-     */
+    /** Reset playback state: every cursor back to its clip's first event. */
     void reset();
 
     /**
-     * Reset to a specific position (used on seek).
-     * Binary-searches each track's events to find the correct starting index.
+     * Reset to a specific position (used on seek). Binary-searches each
+     * clip's events, resolved through [tempo], for the first one due.
      */
-    void resetToPosition(int64_t posFrames);
+    void resetToPosition(int64_t posFrames, const TempoMap& tempo, int32_t sampleRate);
 
     /**
-     * Get the maximum end frame across all MIDI tracks.
+     * Get the maximum end frame across all MIDI tracks under [tempo].
      * Used by AudioEngine to determine total timeline length.
      */
-    int64_t getMaxEndFrame() const;
+    int64_t getMaxEndFrame(const TempoMap& tempo, int32_t sampleRate) const;
 
-    /**
-     * Snapshot the current per-track (channel, program) assignments.
-     * Render-thread-callable lock-free read of the active snapshot. Used
-     * by SynthEngine to re-issue program changes on flush / play /
-     * loop-wrap so the first noteOn after a transport transition lands
-     * at the correct preset.
-     */
-    void forEachProgramAssignment(
-        const std::function<void(int channel, int program)>& fn) const;
+    /** Logical channel of track [trackIndex]; -1 if out of range. UI thread. */
+    int trackChannel(size_t trackIndex) const;
 
 private:
     /**
-     * Snapshot of all MIDI tracks. Double-buffered for lock-free reads.
+     * Snapshot of all MIDI tracks. Immutable once published.
+     *
+     * `generation` is bumped by every edit so the render thread can
+     * detect a swap and re-align cursors to the current render frame.
+     * Without this, a mid-playback edit would leave cursors pointing
+     * into stale event arrays, and the tick() guard at
+     * frame >= renderPos would silently consume every event before
+     * the playhead -- new content placed in the already-played region
+     * of the timeline never gets fired on the next loop pass.
      *
-     * `generation` is bumped by every updateTracks() call so the render
-     * thread can detect a swap and re-align its per-track cursors to
-     * the current render frame. Without this, a mid-playback edit would
-     * land cursors at index 0 while renderPos has advanced, and the
-     * tick() guard at framePos >= renderPos would silently consume
-     * every event before the playhead -- new content placed in the
-     * already-played region of the timeline never gets fired on the
-     * next loop pass.
+     * `trackVersions[t]` changes only when track t's data is replaced,
+     * so on a swap the render thread re-seeks just the tracks whose
+     * version moved. Cursors are one flat array with track t's clips
+     * starting at `clipBase[t]`.
      */
     struct Snapshot {
-        std::vector<MidiTrackData> tracks;
-        std::vector<size_t> nextEventIndex;  // per-track cursor
+        std::vector<std::shared_ptr<const MidiTrackData>> tracks;
+        std::vector<uint64_t> trackVersions;
+        std::vector<size_t> clipBase;
+        size_t clipCount = 0;
         uint64_t generation = 0;
+
+        /** Cursor buffers sized on the writer for snapshots past the
+         *  render-side reserve; the render thread swaps them in for its
+         *  own, which then go back to the reclaimer with the snapshot. */
+        struct Scratch {
+            std::vector<size_t> clips;
+            std::vector<size_t> bases;
+            std::vector<uint64_t> versions;
+            std::vector<size_t> firstOpen;
+        };
+        mutable Scratch scratch;
     };
 
-    Snapshot snapshotA_, snapshotB_;
-    std::atomic<Snapshot*> active_{&snapshotA_};
-    std::mutex editMutex_;
-    /** Monotonic counter incremented by updateTracks(). The next-issued
-     *  snapshot copies this into its `generation` before the atomic
-     *  swap. Render thread reads `active->generation` and compares to
-     *  [lastSeenGeneration_]. */
+    /** Hazard slot of the render side (render thread, or the offline
+     *  renderer while the render thread is stopped). */
+    static constexpr int kRenderReader = 0;
+
+    /** Snapshot of all of [tracks], each with a fresh version. Caller holds editMutex_. */
+    std::unique_ptr<Snapshot> withTracks(std::vector<MidiTrackData> tracks);
+
+    /** Index and stamp [next] with the next generation. Caller holds editMutex_. */
+    void stamp(Snapshot& next);
+
+    /** Stamp and publish [next]. Caller holds editMutex_. */
+    void publish(std::unique_ptr<Snapshot> next);
+
+    /** Copy of the current snapshot with [trackIndex] replaced by [track]. */
+    std::unique_ptr<Snapshot> withTrack(size_t trackIndex,
+                                        std::shared_ptr<const MidiTrackData> track);
+
+    /** Queue all-notes-off for [track] if it is muted and [previous] was not. */
+    void silenceIfNewlyMuted(const MidiTrackData& track, const MidiTrackData* previous);
+
+    /** Fill in clipBase / clipCount of [snap] from its tracks. */
+    static void indexClips(Snapshot& snap);
+
+    /** Clips sorted by offset, as every snapshot holds them. */
+    static std::vector<MidiClipData> sortedClips(std::vector<MidiClipData> clips);
+
+    /** Render-thread: align every cursor with [snap] at [posFrames]. */
+    void seekAll(const Snapshot& snap, int64_t posFrames, const TempoMap& tempo,
+                 int32_t sampleRate);
+
+    /** Point [track]'s clip cursors, starting at [cursors], at [posFrames]. */
+    static void seekTrack(const MidiTrackData& track, size_t* cursors, int64_t posFrames,
+                          const TempoMap& tempo, int32_t sampleRate);
+
+    /** Render-thread: swap in [spare] if [buffer] can't hold [count] without allocating. */
+    template <typename T>
+    static void fit(std::vector<T>& buffer, std::vector<T>& spare, size_t count) {
+        if (buffer.capacity() < count && spare.capacity() >= count) buffer.swap(spare);
+    }
+
+    /** Frame [e] sounds on: its tick resolved from the clip start, cut at the clip end. */
+    static int64_t eventFrame(const MidiClipData& clip, const MidiEvent& e,
+                              const TempoMap& tempo, int32_t sampleRate);
+
+    /** First index in [clip]'s events due at or after [posFrames]. */
+    static size_t lowerBound(const MidiClipData& clip, int64_t posFrames,
+                             const TempoMap& tempo, int32_t sampleRate);
+
+    SnapshotPublisher<Snapshot> snapshot_;
+    mutable std::mutex editMutex_;  // serializes UI-thread edits and reads
+    /** Monotonic counter incremented on every edit. The next-issued
+     *  snapshot copies this into its `generation` before it is
+     *  published. Render thread reads `snap->generation` and compares
+     *  to [lastSeenGeneration_]. */
     uint64_t generationCounter_ = 0;
-    /** Render-thread-local: the generation last observed during tick().
-     *  On a swap (mismatch), the render thread re-aligns cursors via
-     *  resetToPosition before iterating events. */
+    /** Source of per-track versions; guarded by editMutex_. */
+    uint64_t versionCounter_ = 0;
+
+    // Render-thread-local cursor state. Kept outside the snapshots (which
+    // are immutable) so a swap does not disturb the cursors of tracks
+    // that did not change.
+    /** The generation last observed during tick(). */
     uint64_t lastSeenGeneration_ = 0;
+    /** Tempo map generation the cursors were aligned under. A tempo
+     *  change moves every event, so it re-seeks everything. */
+    uint64_t lastSeenTempo_ = 0;
+    /** Per-clip next event index into the active snapshot, flat. */
+    std::vector<size_t> cursors_;
+    /** Spare buffer the cursors are rebuilt into on a swap. */
+    std::vector<size_t> nextCursors_;
+    /** Snapshot clipBase / trackVersions the cursors were aligned against. */
+    std::vector<size_t> cursorBases_;
+    std::vector<uint64_t> cursorVersions_;
+    /** Per-track index of the first clip with events left: clips before
+     *  it are skipped without a look. Rewound to 0 on every realign. */
+    std::vector<size_t> firstOpenClip_;
 
     std::vector<NoteEvent> pendingEvents_;
 
-    // Bitmask of channels that need all-notes-off (set by updateTracks, consumed by tick)
-    std::atomic<uint16_t> silenceChannelMask_{0};
+    // Bitset of logical channels that need all-notes-off (set by
+    // updateTracks, consumed by tick)
+    static constexpr int kSilenceWords = kMaxLogicalChannels / 64;
+    std::atomic<uint64_t> silenceChannels_[kSilenceWords] = {};
 };
 
 }  // namespace nightjar
@@ -0,0 +1,107 @@
+#include "mix_graph.h"
+#include "mix_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+namespace nightjar {
+
+void panGains(float volume, float pan, float& left, float& right) {
+    if (pan == 0.0f) {
+        left = right = volume;
+        return;
+    }
+    // Sweep a quarter circle: [cos, sin] has constant power at every
+    // position; sqrt(2) puts the center back at unity.
+    constexpr float kQuarterPi = 0.78539816f;
+    constexpr float kSqrt2 = 1.41421356f;
+    float angle = (std::clamp(pan, -1.0f, 1.0f) + 1.0f) * kQuarterPi;
+    left = volume * kSqrt2 * std::cos(angle);
+    right = volume * kSqrt2 * std::sin(angle);
+}
+
+void balanceGains(float volume, float pan, float& left, float& right) {
+    pan = std::clamp(pan, -1.0f, 1.0f);
+    left = volume * std::min(1.0f, 1.0f - pan);
+    right = volume * std::min(1.0f, 1.0f + pan);
+}
+
+void GainRamp::snap(float left, float right) {
+    gain[0] = target[0] = left;
+    gain[1] = target[1] = right;
+    step[0] = step[1] = 0.0f;
+    remaining = 0;
+}
+
+void GainRamp::retarget(float left, float right) {
+    if (left == target[0] && right == target[1]) return;
+    target[0] = left;
+    target[1] = right;
+    step[0] = (left - gain[0]) / kGainRampFrames;
+    step[1] = (right - gain[1]) / kGainRampFrames;
+    remaining = kGainRampFrames;
+}
+
+/** Advance [ramp] past [frames] ramped frames, landing exactly on its target. */
+static void advance(GainRamp& ramp, int32_t frames) {
+    ramp.remaining -= frames;
+    if (ramp.remaining == 0) {
+        ramp.gain[0] = ramp.target[0];
+        ramp.gain[1] = ramp.target[1];
+    } else {
+        ramp.gain[0] += ramp.step[0] * frames;
+        ramp.gain[1] += ramp.step[1] * frames;
+    }
+}
+
+void mixMonoThroughRamp(GainRamp& ramp, const float* mono, float* stereo, int32_t frames) {
+    int32_t ramped = std::min(frames, ramp.remaining);
+    if (ramped > 0) {
+        mixMonoToStereoRamp(mono, stereo, ramped, ramp.gain[0], ramp.gain[1],
+                            ramp.step[0], ramp.step[1]);
+        advance(ramp, ramped);
+    }
+    if (ramped == frames) return;
+    if (ramp.gain[0] == ramp.gain[1]) {
+        mixMonoToStereo(mono + ramped, stereo + 2 * ramped, frames - ramped, ramp.gain[0]);
+    } else {
+        mixMonoToStereo(mono + ramped, stereo + 2 * ramped, frames - ramped,
+                        ramp.gain[0], ramp.gain[1]);
+    }
+}
+
+void mixStereoThroughRamp(GainRamp& ramp, const float* src, float* dst, int32_t frames) {
+    int32_t ramped = std::min(frames, ramp.remaining);
+    if (ramped > 0) {
+        mixStereoRamp(dst, src, ramped, ramp.gain[0], ramp.step[0]);
+        advance(ramp, ramped);
+    }
+    if (ramped == frames) return;
+    mixScaled(dst + 2 * ramped, src + 2 * ramped, 2 * (frames - ramped), ramp.gain[0]);
+}
+
+void mixBalancedThroughRamp(GainRamp& ramp, const float* src, float* dst, int32_t frames) {
+    int32_t ramped = std::min(frames, ramp.remaining);
+    if (ramped > 0) {
+        mixStereoRamp(dst, src, ramped, ramp.gain[0], ramp.gain[1], ramp.step[0], ramp.step[1]);
+        advance(ramp, ramped);
+    }
+    if (ramped == frames) return;
+    if (ramp.gain[0] == ramp.gain[1]) {
+        mixScaled(dst + 2 * ramped, src + 2 * ramped, 2 * (frames - ramped), ramp.gain[0]);
+    } else {
+        mixStereoRamp(dst + 2 * ramped, src + 2 * ramped, frames - ramped,
+                      ramp.gain[0], ramp.gain[1], 0.0f, 0.0f);
+    }
+}
+
+void applyRamp(GainRamp& ramp, float* buffer, int32_t frames) {
+    int32_t ramped = std::min(frames, ramp.remaining);
+    if (ramped > 0) {
+        scaleStereoRamp(buffer, ramped, ramp.gain[0], ramp.step[0]);
+        advance(ramp, ramped);
+    }
+    if (ramped == frames || ramp.gain[0] == 1.0f) return;
+    scaleStereoRamp(buffer + 2 * ramped, frames - ramped, ramp.gain[0], 0.0f);
+}
+
+}  // namespace nightjar
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace nightjar {
+
+/**
+ * Building blocks of the TrackMixer's processing graph.
+ *
+ * Every track feeds a bus: the master bus (the mixer's output) or one of
+ * up to kMaxGroupBuses group buses, which sum into the master. Tracks
+ * and buses each have a volume, an optional chain of insert processors
+ * and, for tracks, a pan position.
+ *
+ * The graph is edited on the UI thread and compiled, on every commit,
+ * into a flat schedule stored with the published track list: each track
+ * entry knows the index of the bus it feeds and carries only the inserts
+ * that are not bypassed, and the buses are listed in the order they must
+ * run. The callback walks that schedule without lookups or allocation;
+ * a bypassed insert, an unused group bus, or a master bus at unity with
+ * no inserts costs nothing.
+ *
+ * Volume, pan and mute changes are not applied to the samples directly:
+ * each node's GainRamp glides to the new gains over kGainRampFrames, so
+ * moving a fader never produces zipper noise and muting never clicks.
+ */
+
+/** Bus id of the master bus; group buses use positive ids. */
+constexpr int32_t kMasterBus = 0;
+
+/** Group buses a project may have besides the master. */
+constexpr int32_t kMaxGroupBuses = 8;
+
+/** Insert slots per track and per bus. */
+constexpr int32_t kMaxInserts = 4;
+
+/** Length of a gain change: ~11ms at 44.1kHz. */
+constexpr int32_t kGainRampFrames = 512;
+
+/** Threads that render the graph (playback callback, offline export). */
+constexpr int32_t kRenderReaders = 2;
+
+/**
+ * Per-channel gains for a mono source at [volume] and [pan] (-1 = hard
+ * left, +1 = hard right). Constant power, normalized so the center gives
+ * [volume] on both channels as before pan existed.
+ */
+void panGains(float volume, float pan, float& left, float& right);
+
+/**
+ * Per-channel gains for a stereo source at [volume] and [pan], used as a
+ * balance control: the far channel fades out while the near one stays
+ * at [volume], so the center leaves the source untouched.
+ */
+void balanceGains(float volume, float pan, float& left, float& right);
+
+/**
+ * A processing stage in a track's or bus's insert chain.
+ *
+ * process() runs on the rendering thread and must not lock, allocate or
+ * block. Tracks run their inserts on the source before gain and pan
+ * (channels = 1 for a take, 2 for a frozen track); buses on their stereo
+ * sum before the bus volume (channels = 2). Playback and export never render at the same time, so
+ * a processor is only ever driven by one thread at a time.
+ */
+class InsertProcessor {
+public:
+    virtual ~InsertProcessor() = default;
+
+    /** Process [frames] interleaved frames of [channels] channels in place. */
+    virtual void process(float* buffer, int32_t frames, int32_t channels) = 0;
+};
+
+/**
+ * Smoothed stereo gain of one graph node, owned by one rendering thread.
+ *
+ * retarget() is called once per block with the gains the node's controls
+ * ask for; a change starts a linear ramp from the current gains that
+ * lasts kGainRampFrames, which the mix helpers below advance as they
+ * consume frames.
+ */
+struct GainRamp {
+    float gain[2] = {1.0f, 1.0f};
+    float target[2] = {1.0f, 1.0f};
+    float step[2] = {0.0f, 0.0f};
+    int32_t remaining = 0;
+
+    /** Jump straight to [left]/[right] (nothing audible came before). */
+    void snap(float left, float right);
+
+    /** Head for [left]/[right]; restarts the ramp if the target moved. */
+    void retarget(float left, float right);
+
+    /** True once settled at zero: the node can be skipped entirely. */
+    bool silent() const {
+        return remaining == 0 && gain[0] == 0.0f && gain[1] == 0.0f;
+    }
+
+    /** True once settled at unity on both channels. */
+    bool unity() const {
+        return remaining == 0 && gain[0] == 1.0f && gain[1] == 1.0f;
+    }
+};
+
+/** stereo += mono through [ramp]'s per-channel gains, advancing it. */
+void mixMonoThroughRamp(GainRamp& ramp, const float* mono, float* stereo, int32_t frames);
+
+/** dst += src (both stereo) through [ramp]'s left gain, advancing it. */
+void mixStereoThroughRamp(GainRamp& ramp, const float* src, float* dst, int32_t frames);
+
+/** dst += src (both stereo) through [ramp]'s per-channel gains, advancing it. */
+void mixBalancedThroughRamp(GainRamp& ramp, const float* src, float* dst, int32_t frames);
+
+/** Scale the stereo [buffer] in place through [ramp]'s left gain, advancing it. */
+void applyRamp(GainRamp& ramp, float* buffer, int32_t frames);
+
+/** Inserts left in a chain once bypassed ones are compiled out. */
+struct InsertChain {
+    int32_t count = 0;
+    InsertProcessor* stages[kMaxInserts] = {};
+
+    void run(float* buffer, int32_t frames, int32_t channels) const {
+        for (int32_t i = 0; i < count; ++i) stages[i]->process(buffer, frames, channels);
+    }
+};
+
+/** Edit-side insert slots of a node. Guarded by the mixer's edit mutex. */
+struct InsertSlots {
+    std::array<std::shared_ptr<InsertProcessor>, kMaxInserts> processors;
+    std::array<bool, kMaxInserts> bypassed{};
+};
+
+/**
+ * A group bus or the master bus.
+ *
+ * Volume and muted are atomic like a track's; the inserts are edit-side
+ * state that only reaches the callback through the compiled schedule.
+ */
+struct MixBus {
+    int32_t busId = kMasterBus;
+    std::atomic<float> volume{1.0f};
+    std::atomic<bool> muted{false};
+    InsertSlots inserts;
+    GainRamp ramp[kRenderReaders];   // ramp[reader], that thread only
+
+    /** Gain the controls ask for right now. */
+    float targetGain() const {
+        return muted.load(std::memory_order_relaxed)
+                   ? 0.0f : volume.load(std::memory_order_relaxed);
+    }
+};
+
+/** A bus in execution order in the compiled schedule. */
+struct BusNode {
+    MixBus* bus = nullptr;
+    int32_t output = -1;     // schedule index this bus sums into, -1 = mixer output
+    InsertChain inserts;
+};
+
+}  // namespace nightjar
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NIGHTJAR_HAVE_NEON 1
+#else
+#define NIGHTJAR_HAVE_NEON 0
+#endif
+
+namespace nightjar {
+
+/**
+ * Inner-loop kernels for the mix path.
+ *
+ * Each kernel has an ARM NEON body (armeabi-v7a and arm64-v8a, where NEON
+ * is always available on the devices we ship to) that processes 4 or 8
+ * samples per iteration, followed by a scalar loop for the remainder.
+ * On x86 builds only the scalar loop is compiled; the compiler is free
+ * to auto-vectorize it.
+ *
+ * All kernels are allocation-free and safe for the audio callback.
+ */
+
+constexpr float kInt16ToFloat = 1.0f / 32768.0f;
+
+/** dst[i] = src[i] / 32768 */
+inline void convertInt16ToFloat(const int16_t* src, float* dst, int32_t count) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float32x4_t scale = vdupq_n_f32(kInt16ToFloat);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(src + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+        vst1q_f32(dst + i, vmulq_f32(lo, scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(hi, scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = static_cast<float>(src[i]) * kInt16ToFloat;
+    }
+}
+
+/** dst[i] = clamp(src[i], -1, 1) * 32767, truncated toward zero. */
+inline void convertFloatToInt16(const float* src, int16_t* dst, int32_t count) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t scale = vdupq_n_f32(32767.0f);
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t a = vminq_f32(vmaxq_f32(vld1q_f32(src + i), lo), hi);
+        float32x4_t b = vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), lo), hi);
+        int32x4_t ia = vcvtq_s32_f32(vmulq_f32(a, scale));
+        int32x4_t ib = vcvtq_s32_f32(vmulq_f32(b, scale));
+        vst1q_s16(dst + i, vcombine_s16(vmovn_s32(ia), vmovn_s32(ib)));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = static_cast<int16_t>(std::max(-1.0f, std::min(1.0f, src[i])) * 32767.0f);
+    }
+}
+
+/** dst[i] += src[i] * gain */
+inline void mixScaled(float* dst, const float* src, int32_t count, float gain) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), vld1q_f32(src + i), g));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+/**
+ * Mono -> interleaved stereo with gain, accumulated into [stereo]:
+ * stereo[2i] += mono[i] * gain, stereo[2i + 1] += mono[i] * gain.
+ * [count] is in frames.
+ */
+inline void mixMonoToStereo(const float* mono, float* stereo, int32_t count, float gain) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t m = vmulq_f32(vld1q_f32(mono + i), g);
+        float32x4x2_t lr = vld2q_f32(stereo + 2 * i);
+        lr.val[0] = vaddq_f32(lr.val[0], m);
+        lr.val[1] = vaddq_f32(lr.val[1], m);
+        vst2q_f32(stereo + 2 * i, lr);
+    }
+#endif
+    for (; i < count; ++i) {
+        float s = mono[i] * gain;
+        stereo[2 * i]     += s;
+        stereo[2 * i + 1] += s;
+    }
+}
+
+/** As above with a separate gain per channel (a panned source). */
+inline void mixMonoToStereo(const float* mono, float* stereo, int32_t count,
+                            float gainL, float gainR) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float32x4_t gl = vdupq_n_f32(gainL);
+    const float32x4_t gr = vdupq_n_f32(gainR);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t m = vld1q_f32(mono + i);
+        float32x4x2_t lr = vld2q_f32(stereo + 2 * i);
+        lr.val[0] = vmlaq_f32(lr.val[0], m, gl);
+        lr.val[1] = vmlaq_f32(lr.val[1], m, gr);
+        vst2q_f32(stereo + 2 * i, lr);
+    }
+#endif
+    for (; i < count; ++i) {
+        stereo[2 * i]     += mono[i] * gainL;
+        stereo[2 * i + 1] += mono[i] * gainR;
+    }
+}
+
+/**
+ * int16 mono -> interleaved stereo with per-channel gains, accumulated:
+ * stereo[2i] += mono[i] / 32768 * gainL, and likewise on the right.
+ * The scale folds into the gains, so this is convertInt16ToFloat() and
+ * mixMonoToStereo() in one pass with the same result. [count] is in frames.
+ */
+inline void mixInt16MonoToStereo(const int16_t* mono, float* stereo, int32_t count,
+                                 float gainL, float gainR) {
+    gainL *= kInt16ToFloat;
+    gainR *= kInt16ToFloat;
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float32x4_t gl = vdupq_n_f32(gainL);
+    const float32x4_t gr = vdupq_n_f32(gainR);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(mono + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+        float32x4x2_t a = vld2q_f32(stereo + 2 * i);
+        float32x4x2_t b = vld2q_f32(stereo + 2 * i + 8);
+        a.val[0] = vmlaq_f32(a.val[0], lo, gl);
+        a.val[1] = vmlaq_f32(a.val[1], lo, gr);
+        b.val[0] = vmlaq_f32(b.val[0], hi, gl);
+        b.val[1] = vmlaq_f32(b.val[1], hi, gr);
+        vst2q_f32(stereo + 2 * i, a);
+        vst2q_f32(stereo + 2 * i + 8, b);
+    }
+#endif
+    for (; i < count; ++i) {
+        float m = static_cast<float>(mono[i]);
+        stereo[2 * i]     += m * gainL;
+        stereo[2 * i + 1] += m * gainR;
+    }
+}
+
+/**
+ * Mono -> interleaved stereo with per-channel gains that ramp linearly:
+ * frame i is scaled by gainL + i * stepL on the left and gainR + i * stepR
+ * on the right. [count] is in frames.
+ */
+inline void mixMonoToStereoRamp(const float* mono, float* stereo, int32_t count,
+                                float gainL, float gainR, float stepL, float stepR) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    const float32x4_t n = vld1q_f32(lanes);
+    float32x4_t gl = vmlaq_n_f32(vdupq_n_f32(gainL), n, stepL);
+    float32x4_t gr = vmlaq_n_f32(vdupq_n_f32(gainR), n, stepR);
+    const float32x4_t dl = vdupq_n_f32(4.0f * stepL);
+    const float32x4_t dr = vdupq_n_f32(4.0f * stepR);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t m = vld1q_f32(mono + i);
+        float32x4x2_t lr = vld2q_f32(stereo + 2 * i);
+        lr.val[0] = vmlaq_f32(lr.val[0], m, gl);
+        lr.val[1] = vmlaq_f32(lr.val[1], m, gr);
+        vst2q_f32(stereo + 2 * i, lr);
+        gl = vaddq_f32(gl, dl);
+        gr = vaddq_f32(gr, dr);
+    }
+#endif
+    for (; i < count; ++i) {
+        stereo[2 * i]     += mono[i] * (gainL + static_cast<float>(i) * stepL);
+        stereo[2 * i + 1] += mono[i] * (gainR + static_cast<float>(i) * stepR);
+    }
+}
+
+/**
+ * Interleaved stereo accumulate with a linear gain ramp:
+ * dst[2i + c] += src[2i + c] * (gain + i * step). [count] is in frames.
+ */
+inline void mixStereoRamp(float* dst, const float* src, int32_t count, float gain, float step) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    float32x4_t g = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(lanes), step);
+    const float32x4_t d = vdupq_n_f32(4.0f * step);
+    for (; i + 4 <= count; i += 4) {
+        float32x4x2_t s = vld2q_f32(src + 2 * i);
+        float32x4x2_t lr = vld2q_f32(dst + 2 * i);
+        lr.val[0] = vmlaq_f32(lr.val[0], s.val[0], g);
+        lr.val[1] = vmlaq_f32(lr.val[1], s.val[1], g);
+        vst2q_f32(dst + 2 * i, lr);
+        g = vaddq_f32(g, d);
+    }
+#endif
+    for (; i < count; ++i) {
+        float g = gain + static_cast<float>(i) * step;
+        dst[2 * i]     += src[2 * i] * g;
+        dst[2 * i + 1] += src[2 * i + 1] * g;
+    }
+}
+
+/**
+ * As above with a separate gain and step per channel (a balanced stereo
+ * source): left by gainL + i * stepL, right by gainR + i * stepR.
+ */
+inline void mixStereoRamp(float* dst, const float* src, int32_t count,
+                          float gainL, float gainR, float stepL, float stepR) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    const float32x4_t n = vld1q_f32(lanes);
+    float32x4_t gl = vmlaq_n_f32(vdupq_n_f32(gainL), n, stepL);
+    float32x4_t gr = vmlaq_n_f32(vdupq_n_f32(gainR), n, stepR);
+    const float32x4_t dl = vdupq_n_f32(4.0f * stepL);
+    const float32x4_t dr = vdupq_n_f32(4.0f * stepR);
+    for (; i + 4 <= count; i += 4) {
+        float32x4x2_t s = vld2q_f32(src + 2 * i);
+        float32x4x2_t lr = vld2q_f32(dst + 2 * i);
+        lr.val[0] = vmlaq_f32(lr.val[0], s.val[0], gl);
+        lr.val[1] = vmlaq_f32(lr.val[1], s.val[1], gr);
+        vst2q_f32(dst + 2 * i, lr);
+        gl = vaddq_f32(gl, dl);
+        gr = vaddq_f32(gr, dr);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[2 * i]     += src[2 * i] * (gainL + static_cast<float>(i) * stepL);
+        dst[2 * i + 1] += src[2 * i + 1] * (gainR + static_cast<float>(i) * stepR);
+    }
+}
+
+/** In-place interleaved stereo gain ramp: buf[2i + c] *= gain + i * step. */
+inline void scaleStereoRamp(float* buf, int32_t count, float gain, float step) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    float32x4_t g = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(lanes), step);
+    const float32x4_t d = vdupq_n_f32(4.0f * step);
+    for (; i + 4 <= count; i += 4) {
+        float32x4x2_t lr = vld2q_f32(buf + 2 * i);
+        lr.val[0] = vmulq_f32(lr.val[0], g);
+        lr.val[1] = vmulq_f32(lr.val[1], g);
+        vst2q_f32(buf + 2 * i, lr);
+        g = vaddq_f32(g, d);
+    }
+#endif
+    for (; i < count; ++i) {
+        float g = gain + static_cast<float>(i) * step;
+        buf[2 * i]     *= g;
+        buf[2 * i + 1] *= g;
+    }
+}
+
+/** max(|buf[i]|), 0 for an empty buffer */
+inline float peakAbs(const float* buf, int32_t count) {
+    int32_t i = 0;
+    float peak = 0.0f;
+#if NIGHTJAR_HAVE_NEON
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        acc = vmaxq_f32(acc, vabsq_f32(vld1q_f32(buf + i)));
+    }
+#if defined(__aarch64__)
+    peak = vmaxvq_f32(acc);
+#else
+    float32x2_t half = vpmax_f32(vget_low_f32(acc), vget_high_f32(acc));
+    peak = vget_lane_f32(vpmax_f32(half, half), 0);
+#endif
+#endif
+    for (; i < count; ++i) {
+        peak = std::max(peak, buf[i] < 0.0f ? -buf[i] : buf[i]);
+    }
+    return peak;
+}
+
+/**
+ * Soft-clip in place with a rational tanh approximation:
+ *   y = x (27 + x^2) / (27 + 9 x^2),  x clamped to [-3, 3].
+ *
+ * Matches tanh to within ~2% over the range, reaches exactly +/-1 at
+ * |x| = 3 with zero slope (so the clamp introduces no corner), and costs
+ * a handful of multiplies instead of a libm call per sample.
+ */
+inline void softClip(float* buf, int32_t count) {
+    int32_t i = 0;
+#if NIGHTJAR_HAVE_NEON
+    const float32x4_t hi = vdupq_n_f32(3.0f);
+    const float32x4_t lo = vdupq_n_f32(-3.0f);
+    const float32x4_t c27 = vdupq_n_f32(27.0f);
+    const float32x4_t c9 = vdupq_n_f32(9.0f);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vminq_f32(vmaxq_f32(vld1q_f32(buf + i), lo), hi);
+        float32x4_t x2 = vmulq_f32(x, x);
+        float32x4_t num = vmulq_f32(x, vaddq_f32(c27, x2));
+        float32x4_t den = vmlaq_f32(c27, c9, x2);
+#if defined(__aarch64__)
+        vst1q_f32(buf + i, vdivq_f32(num, den));
+#else
+        // ARMv7 has no vector divide: reciprocal estimate + two
+        // Newton-Raphson steps gives full single precision.
+        float32x4_t r = vrecpeq_f32(den);
+        r = vmulq_f32(vrecpsq_f32(den, r), r);
+        r = vmulq_f32(vrecpsq_f32(den, r), r);
+        vst1q_f32(buf + i, vmulq_f32(num, r));
+#endif
+    }
+#endif
+    for (; i < count; ++i) {
+        float x = std::clamp(buf[i], -3.0f, 3.0f);
+        float x2 = x * x;
+        buf[i] = x * (27.0f + x2) / (27.0f + 9.0f * x2);
+    }
+}
+
+}  // namespace nightjar
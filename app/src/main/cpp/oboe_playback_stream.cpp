@@ -1,24 +1,46 @@
 #include "oboe_playback_stream.h"
 #include "common.h"
-#include <cmath>
+#include "mix_kernels.h"
+#include "oboe_recording_stream.h"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <ctime>
+#include <thread>
 
 namespace nightjar {
 
+// How often the callback refreshes the output latency from a hardware
+// timestamp. It only moves when the device's buffering changes.
+static constexpr uint64_t kTimestampIntervalNanos = 250000000ULL;
+
+// Longest a play start is held for the synth to render its first chunk at
+// the start position. Normally that takes well under a burst.
+static constexpr int32_t kSynthPreRollMaxMs = 100;
+
+// Idle time after which the callback parks the stream. Long enough that
+// a pause between takes or preview notes keeps it running; restarting
+// costs a stream start (tens of ms) on the next action.
+static constexpr int32_t kOutputParkAfterMs = 5000;
+
 OboePlaybackStream::OboePlaybackStream(TrackMixer& mixer, AtomicTransport& transport,
+                                       EngineTelemetry& telemetry, EngineStatus& status,
                                        SynthEngine* synth)
-    : mixer_(mixer), transport_(transport), synth_(synth) {}
+    : mixer_(mixer), transport_(transport), telemetry_(telemetry), status_(status),
+      synth_(synth) {}
 
 OboePlaybackStream::~OboePlaybackStream() {
     stop();
 }
 
 bool OboePlaybackStream::start() {
+    std::lock_guard<std::mutex> lock(streamMutex_);
     if (stream_) return true;
     return openStream();
 }
 
 void OboePlaybackStream::stop() {
+    std::lock_guard<std::mutex> lock(streamMutex_);
     if (stream_) {
         stream_->requestStop();
         stream_->close();
@@ -34,11 +56,20 @@ bool OboePlaybackStream::openStream() {
     builder.setSharingMode(oboe::SharingMode::Exclusive);
     builder.setFormat(oboe::AudioFormat::Float);
     builder.setChannelCount(kOutputChannelCount);
-    builder.setSampleRate(kSampleRate);
+    if (rateChosen_) {
+        builder.setSampleRate(transport_.sampleRate.load(std::memory_order_relaxed));
+        builder.setSampleRateConversionQuality(oboe::SampleRateConversionQuality::Medium);
+    }
     builder.setUsage(oboe::Usage::Media);
     builder.setDataCallback(this);
     builder.setErrorCallback(this);
 
+    lastXRunCount_ = 0;
+    presentLatencyNanos_ = 0;
+    lastTimestampNanos_ = 0;
+    idleFrames_ = 0;
+    parking_.store(false, std::memory_order_seq_cst);
+    timeline_.reset();
     oboe::Result result = builder.openStream(stream_);
     if (result != oboe::Result::OK) {
         LOGE("OboePlaybackStream: failed to open: %s", oboe::convertToText(result));
@@ -53,6 +84,15 @@ bool OboePlaybackStream::openStream() {
          stream_->getChannelCount(),
          oboe::convertToText(stream_->getSharingMode()));
 
+    // Nothing reads the rate before the first open: AudioEngine opens
+    // the stream before tracks or a SoundFont can be loaded.
+    if (!rateChosen_) {
+        if (stream_->getSampleRate() > 0) {
+            transport_.sampleRate.store(stream_->getSampleRate(), std::memory_order_relaxed);
+        }
+        rateChosen_ = true;
+    }
+
     result = stream_->requestStart();
     if (result != oboe::Result::OK) {
         LOGE("OboePlaybackStream: failed to start: %s", oboe::convertToText(result));
@@ -61,11 +101,45 @@ bool OboePlaybackStream::openStream() {
         return false;
     }
 
+    // Synth ring fill targets are expressed in bursts.
+    if (synth_) synth_->setFramesPerBurst(stream_->getFramesPerBurst());
+
     LOGD("OboePlaybackStream: started");
     return true;
 }
 
+void OboePlaybackStream::wake() {
+    // Paired with shouldPark(): either the callback sees this activity
+    // and keeps running, or this sees parking_ and restarts the stream.
+    activity_.store(true, std::memory_order_seq_cst);
+    if (!parking_.load(std::memory_order_seq_cst)) return;
+
+    std::lock_guard<std::mutex> lock(streamMutex_);
+    if (!stream_ || !parking_.load(std::memory_order_seq_cst)) return;
+    // The callback returned Stop; let the stop finish, then start again
+    stream_->stop();
+    idleFrames_ = 0;
+    parking_.store(false, std::memory_order_seq_cst);
+    oboe::Result result = stream_->requestStart();
+    if (result != oboe::Result::OK) {
+        LOGE("OboePlaybackStream: failed to restart: %s", oboe::convertToText(result));
+        return;
+    }
+    LOGD("OboePlaybackStream: woken");
+}
+
+void OboePlaybackStream::setDuplexInput(OboeRecordingStream* input) {
+    duplexInput_.store(input, std::memory_order_seq_cst);
+    if (input) return;
+    // Paired with the callback: it either sees nullptr or is seen holding
+    // the old input, which it lets go of at the end of the block
+    while (duplexInUse_.load(std::memory_order_seq_cst)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
 int64_t OboePlaybackStream::getOutputLatencyMs() const {
+    std::lock_guard<std::mutex> lock(streamMutex_);
     if (!stream_) return -1;
     auto result = stream_->calculateLatencyMillis();
     if (result) {
@@ -77,13 +151,121 @@ int64_t OboePlaybackStream::getOutputLatencyMs() const {
 // ── Audio callback (real-time thread) ──────────────────────────────────
 
 oboe::DataCallbackResult OboePlaybackStream::onAudioReady(
-        oboe::AudioStream* /* stream */,
+        oboe::AudioStream* stream,
         void* audioData,
         int32_t numFrames) {
 
-    auto* output = static_cast<float*>(audioData);
+    uint64_t startNanos = EngineTelemetry::nowNanos();
+    int32_t rate = stream->getSampleRate() > 0 ? stream->getSampleRate()
+                                               : transport_.sampleRate.load(std::memory_order_relaxed);
+    blockStreamFrame_ = stream->getFramesWritten();
+    int64_t presentNanos = static_cast<int64_t>(startNanos) +
+                           presentationLatencyNanos(stream, startNanos);
+    // Until the first hardware timestamp: the block counts as heard then
+    timeline_.setAnchor(blockStreamFrame_, presentNanos, rate, false);
+
+    // Full duplex: take what the input captured since the last block
+    monitorFrames_ = nullptr;
+    monitorCount_ = 0;
+    duplexInUse_.store(true, std::memory_order_seq_cst);
+    if (OboeRecordingStream* input = duplexInput_.load(std::memory_order_seq_cst)) {
+        monitorCount_ = input->pullDuplex(timeline_, startNanos);
+        monitorFrames_ = input->duplexFrames();
+    }
+
+    renderAudio(static_cast<float*>(audioData), numFrames, presentNanos);
+    duplexInUse_.store(false, std::memory_order_seq_cst);
+    updateXRunCount(stream);
+
+    uint64_t periodNanos = static_cast<uint64_t>(numFrames) * 1000000000ULL /
+                           static_cast<uint64_t>(rate);
+    telemetry_.recordCallback(EngineTelemetry::nowNanos() - startNanos, periodNanos);
+
+    if (shouldPark(numFrames, rate)) return oboe::DataCallbackResult::Stop;
+    return oboe::DataCallbackResult::Continue;
+}
+
+bool OboePlaybackStream::shouldPark(int32_t numFrames, int32_t rate) {
+    bool idle = !transport_.playing.load(std::memory_order_relaxed) &&
+                !transport_.recording.load(std::memory_order_relaxed) &&
+                !duplexInput_.load(std::memory_order_relaxed) &&
+                (!synth_ || !synth_->isRunning() || synth_->isIdle());
+    if (activity_.exchange(false, std::memory_order_seq_cst) || !idle) {
+        idleFrames_ = 0;
+        return false;
+    }
+    idleFrames_ += numFrames;
+    if (idleFrames_ < static_cast<int64_t>(rate) * kOutputParkAfterMs / 1000) return false;
+
+    parking_.store(true, std::memory_order_seq_cst);
+    if (activity_.load(std::memory_order_seq_cst)) {
+        // A wake() landed meanwhile; it may still restart the stream,
+        // which costs a glitch-free stop/start of silence
+        parking_.store(false, std::memory_order_seq_cst);
+        idleFrames_ = 0;
+        return false;
+    }
+    LOGD("OboePlaybackStream: idle, parking");
+    return true;
+}
+
+void OboePlaybackStream::updateXRunCount(oboe::AudioStream* stream) {
+    // AAudio reports a plain counter; OpenSL ES returns Unimplemented.
+    auto xruns = stream->getXRunCount();
+    if (!xruns || xruns.value() <= lastXRunCount_) return;
+    telemetry_.xrunCount.fetch_add(static_cast<uint64_t>(xruns.value() - lastXRunCount_),
+                                   std::memory_order_relaxed);
+    lastXRunCount_ = xruns.value();
+}
+
+int64_t OboePlaybackStream::presentationLatencyNanos(oboe::AudioStream* stream,
+                                                     uint64_t nowNanos) {
+    if (nowNanos - lastTimestampNanos_ < kTimestampIntervalNanos) return presentLatencyNanos_;
+    lastTimestampNanos_ = nowNanos;
+
+    // Unavailable until the stream has played a little, and on OpenSL ES;
+    // keep the last estimate (0 at first: the block counts as heard now).
+    auto timestamp = stream->getTimestamp(CLOCK_MONOTONIC);
+    int32_t rate = stream->getSampleRate();
+    if (!timestamp || rate <= 0) return presentLatencyNanos_;
+
+    // The block about to be rendered starts at the next frame written
+    timeline_.setAnchor(timestamp.value().position, timestamp.value().timestamp, rate, true);
+    int64_t framesAhead = stream->getFramesWritten() - timestamp.value().position;
+    int64_t presentNanos = timestamp.value().timestamp +
+                           framesAhead * 1000000000LL / static_cast<int64_t>(rate);
+    presentLatencyNanos_ = std::max<int64_t>(0, presentNanos - static_cast<int64_t>(nowNanos));
+    return presentLatencyNanos_;
+}
+
+void OboePlaybackStream::publishStatus(bool playing, int64_t positionFrames,
+                                       int64_t presentNanos) {
+    EngineStatus::Writer status(status_, kStatTransportSeq);
+    status.set(kStatPlaying, int64_t{playing});
+    status.set(kStatRecording, int64_t{transport_.recording.load(std::memory_order_relaxed)});
+    status.set(kStatPositionFrames, positionFrames);
+    status.set(kStatTotalFrames, transport_.totalFrames.load(std::memory_order_relaxed));
+    status.set(kStatLoopResetCount, transport_.loopResetCount.load(std::memory_order_relaxed));
+    status.set(kStatPresentNanos, presentNanos);
+    status.set(kStatSampleRate,
+               int64_t{transport_.sampleRate.load(std::memory_order_relaxed)});
+}
+
+void OboePlaybackStream::mixMonitor(float* output, int32_t numFrames) {
+    float gain = monitorGain_.load(std::memory_order_relaxed);
+    if (gain <= 0.0f || monitorCount_ <= 0) return;
+    // The newest input, lined up with the end of the block
+    int32_t count = std::min(monitorCount_, numFrames);
+    mixMonoToStereo(monitorFrames_ + (monitorCount_ - count),
+                    output + (numFrames - count) * kOutputChannelCount, count, gain);
+}
+
+void OboePlaybackStream::renderAudio(float* output, int32_t numFrames, int64_t presentNanos) {
+    // Control changes queued since the last block all take effect here
+    mixer_.applyCommands();
 
     if (!transport_.playing.load(std::memory_order_acquire)) {
+        wasPlaying_ = false;
         // Paused: skip the timeline-driven track mixer and position
         // advance, but still mix in synth audio from the ring buffer
         // so direct synth API calls (preview noteOn from the piano
@@ -92,37 +274,66 @@ oboe::DataCallbackResult OboePlaybackStream::onAudioReady(
         std::memset(output, 0,
                     static_cast<size_t>(numFrames) * kOutputChannelCount * sizeof(float));
         if (synth_ && synth_->isRunning()) {
-            synth_->readFrames(output, numFrames);
+            int32_t got = synth_->readFrames(output, numFrames);
             // Soft-clip the synth output for symmetry with the playing
             // branch below; preview velocities are typically below 1.0
             // so this is rarely active, but keeps the signal path
-            // consistent.
-            int32_t totalSamples = numFrames * kOutputChannelCount;
-            for (int32_t i = 0; i < totalSamples; ++i) {
-                output[i] = std::tanh(output[i]);
-            }
+            // consistent. Only the frames actually read can be non-zero,
+            // so an empty ring costs nothing beyond the memset.
+            softClip(output, got * kOutputChannelCount);
+        }
+        if (monitorCount_ > 0 && monitorGain_.load(std::memory_order_relaxed) > 0.0f) {
+            mixMonitor(output, numFrames);
+            softClip(output, numFrames * kOutputChannelCount);
         }
-        return oboe::DataCallbackResult::Continue;
+        timeline_.addBlock(blockStreamFrame_, 0, numFrames, false, -1, -1);
+        publishStatus(false, transport_.posFrames.load(std::memory_order_relaxed), presentNanos);
+        return;
     }
 
     int64_t pos = transport_.posFrames.load(std::memory_order_relaxed);
+    const int64_t blockStart = pos;
     int64_t total = transport_.totalFrames.load(std::memory_order_relaxed);
+    bool synthRunning = synth_ && synth_->isRunning();
+
+    // Pre-roll: hold the transport at the start position until the synth
+    // has audio rendered for it, so the first block is already aligned.
+    if (!wasPlaying_) {
+        wasPlaying_ = true;
+        preRollFrames_ = 0;
+    }
+    if (preRollFrames_ >= 0) {
+        int32_t rate = transport_.sampleRate.load(std::memory_order_relaxed);
+        bool timedOut = preRollFrames_ >= rate / 1000 * kSynthPreRollMaxMs;
+        if (synthRunning && !timedOut && !synth_->isPrimedAt(pos)) {
+            std::memset(output, 0,
+                        static_cast<size_t>(numFrames) * kOutputChannelCount * sizeof(float));
+            preRollFrames_ += numFrames;
+            mixMonitor(output, numFrames);
+            softClip(output, numFrames * kOutputChannelCount);
+            timeline_.addBlock(blockStreamFrame_, pos, numFrames, false, -1, -1);
+            // The start frame is heard after this silent block
+            publishStatus(true, pos, presentNanos + static_cast<int64_t>(numFrames) *
+                                                    1000000000LL / std::max(rate, 1));
+            return;
+        }
+        if (timedOut) LOGW("OboePlaybackStream: synth pre-roll timed out");
+        preRollFrames_ = -1;
+    }
 
     // Render WAV track audio (zeros buffer first, then sums all tracks)
     mixer_.renderFrames(output, numFrames, pos);
 
-    // Sum synth audio from the render thread's ring buffer
-    if (synth_ && synth_->isRunning()) {
-        synth_->readFrames(output, numFrames);
+    // Sum synth audio rendered for this block's timeline frames
+    if (synthRunning) {
+        synth_->readFramesAt(output, numFrames, blockStart);
     }
+    mixMonitor(output, numFrames);
 
     // Soft-clip at the final mix point (after all sources are summed).
-    // tanh provides smooth saturation that prevents harsh digital clipping
-    // when many tracks + synth overlap.
-    int32_t totalSamples = numFrames * kOutputChannelCount;
-    for (int32_t i = 0; i < totalSamples; ++i) {
-        output[i] = std::tanh(output[i]);
-    }
+    // The tanh-shaped saturation prevents harsh digital clipping when
+    // many tracks + synth overlap.
+    softClip(output, numFrames * kOutputChannelCount);
 
     // Advance position
     pos += numFrames;
@@ -130,11 +341,13 @@ oboe::DataCallbackResult OboePlaybackStream::onAudioReady(
     // Loop check
     int64_t loopEnd = transport_.loopEndFrames.load(std::memory_order_relaxed);
     int64_t loopStart = transport_.loopStartFrames.load(std::memory_order_relaxed);
+    timeline_.addBlock(blockStreamFrame_, blockStart, numFrames, true, loopStart, loopEnd);
     if (loopStart >= 0 && loopEnd > loopStart && pos >= loopEnd) {
-        pos = loopStart;
+        // Carry the frames played past loopEnd into the next pass, as the
+        // synth render thread does with renderPos_; the two stay aligned.
+        int64_t overshoot = pos - loopEnd;
+        pos = loopStart + (overshoot < loopEnd - loopStart ? overshoot : 0);
         transport_.loopResetCount.fetch_add(1, std::memory_order_release);
-        // Loop detection for synth audio is handled in the render thread
-        // (SynthEngine wraps renderPos_ at loop boundaries seamlessly)
     }
 
     // End-of-timeline check
@@ -143,16 +356,21 @@ oboe::DataCallbackResult OboePlaybackStream::onAudioReady(
         // Playback finished — stop and reset to 0
         transport_.playing.store(false, std::memory_order_release);
         transport_.posFrames.store(0, std::memory_order_relaxed);
+        publishStatus(false, 0, presentNanos);
     } else {
         transport_.posFrames.store(pos, std::memory_order_relaxed);
+        publishStatus(true, blockStart, presentNanos);
     }
-
-    return oboe::DataCallbackResult::Continue;
 }
 
 void OboePlaybackStream::onErrorAfterClose(
-        oboe::AudioStream* /* stream */,
+        oboe::AudioStream* stream,
         oboe::Result error) {
+    // Runs on Oboe's error thread: serialized with wake(), start() and
+    // stop(), which use stream_ too. A stream stop() already closed, or
+    // one start() has since replaced, isn't reopened.
+    std::lock_guard<std::mutex> lock(streamMutex_);
+    if (stream_.get() != stream) return;
     LOGW("OboePlaybackStream: error after close: %s — reopening",
          oboe::convertToText(error));
     // Auto-reopen on device change (headphone unplug, BT disconnect)
@@ -4,10 +4,17 @@
 #include "track_mixer.h"
 #include "synth_engine.h"
 #include "atomic_transport.h"
+#include "engine_status.h"
+#include "engine_telemetry.h"
+#include "output_timeline.h"
 #include <oboe/Oboe.h>
+#include <atomic>
+#include <mutex>
 
 namespace nightjar {
 
+class OboeRecordingStream;
+
 /**
  * Oboe output stream for multi-track playback.
  *
@@ -15,13 +22,49 @@ namespace nightjar {
  * TrackMixer::renderFrames(), advances the position, and handles
  * loop boundaries and end-of-timeline.
  *
- * Stream config: stereo, float, low-latency, 44.1kHz.
- * Auto-reopens on device change (headphone unplug).
+ * Stream config: stereo, float, low-latency, at the device's native
+ * rate so no resampler sits in the output path (and the MMAP fast path
+ * stays available). The first open publishes that rate as the engine
+ * rate (AtomicTransport::sampleRate).
+ * Auto-reopens on device change (headphone unplug); a reopened stream
+ * asks for the engine rate and lets Oboe convert if the new device
+ * differs, since everything already loaded is laid out in it.
+ *
+ * Each block starts by applying the mixer's queued control changes
+ * (TrackMixer::applyCommands()). Every callback is timed against its
+ * buffer period and the stream's xrun count is folded into
+ * EngineTelemetry.
+ *
+ * Each block also publishes the transport section of EngineStatus: the
+ * frame the block started at and when that frame reaches the output,
+ * from a hardware timestamp refreshed a few times a second, so the UI
+ * can extrapolate the playhead between blocks.
+ *
+ * Synth audio is read for the block's timeline frames
+ * (SynthEngine::readFramesAt()). A play start is pre-rolled: the
+ * transport holds at the start position, outputting silence, until the
+ * synth has rendered audio for it (at most ~100 ms), so synth and WAV
+ * tracks start together.
+ *
+ * With nothing to play -- transport stopped, not recording, the synth
+ * render thread parked (SynthEngine::isIdle()) -- for kOutputParkAfterMs,
+ * the callback stops the stream instead of mixing silence. wake()
+ * restarts it; AudioEngine calls it ahead of play, seeks, recording and
+ * synth notes, so a parked stream costs one stream start on the next
+ * action and nothing until then.
+ *
+ * Every block is also recorded in an OutputTimeline (which timeline
+ * frames it plays, anchored by the hardware timestamp), and a full-duplex
+ * recording (setDuplexInput()) is pulled at the start of each block and
+ * stamped against it. Input monitoring mixes the frames just pulled into
+ * the end of the block being rendered, before the soft clip, so the
+ * performer hears themselves one output buffer late and no more.
  */
 class OboePlaybackStream : public oboe::AudioStreamDataCallback,
                            public oboe::AudioStreamErrorCallback {
 public:
     OboePlaybackStream(TrackMixer& mixer, AtomicTransport& transport,
+                       EngineTelemetry& telemetry, EngineStatus& status,
                        SynthEngine* synth = nullptr);
     ~OboePlaybackStream();
 
@@ -31,8 +74,18 @@ public:
     /** Stop and close the output stream. */
     void stop();
 
-    /** Returns true if the stream is open and started. */
-    bool isStreamOpen() const { return stream_ != nullptr; }
+    /** Returns true if the stream is open (running or parked). */
+    bool isStreamOpen() const {
+        std::lock_guard<std::mutex> lock(streamMutex_);
+        return stream_ != nullptr;
+    }
+
+    /**
+     * Restart the stream if the callback parked it; otherwise just note
+     * the activity so it isn't parked for another kOutputParkAfterMs.
+     * Control threads only.
+     */
+    void wake();
 
     /**
      * Returns the output pipeline latency in ms via hardware timestamps.
@@ -42,6 +95,19 @@ public:
      */
     int64_t getOutputLatencyMs() const;
 
+    /**
+     * Pull [input] (started with OboeRecordingStream::startDuplex()) from
+     * the output callback from the next block on; nullptr detaches and
+     * returns once the callback is done with the previous input. The
+     * stream is not parked while an input is attached. Control threads only.
+     */
+    void setDuplexInput(OboeRecordingStream* input);
+
+    /** Mix the full-duplex input into the output at [gain]; 0 turns it off. */
+    void setInputMonitoring(float gain) {
+        monitorGain_.store(gain, std::memory_order_relaxed);
+    }
+
     // ── Oboe callbacks ──────────────────────────────────────────────────
 
     oboe::DataCallbackResult onAudioReady(
@@ -54,10 +120,51 @@ public:
         oboe::Result error) override;
 
 private:
-    bool openStream();
+    bool openStream();  // caller holds streamMutex_
+
+    /** The mix itself; onAudioReady() wraps it with telemetry. The
+     *  block's first frame reaches the output at [presentNanos]. */
+    void renderAudio(float* output, int32_t numFrames, int64_t presentNanos);
+
+    /** Time from now until the next frame written is heard, from the
+     *  stream's hardware timestamp. Throttled; callback only. */
+    int64_t presentationLatencyNanos(oboe::AudioStream* stream, uint64_t nowNanos);
+
+    /** The transport section of EngineStatus, after a block. */
+    void publishStatus(bool playing, int64_t positionFrames, int64_t presentNanos);
+
+    /** The full-duplex input pulled this block, into the end of [output]. */
+    void mixMonitor(float* output, int32_t numFrames);
+
+    /** After a block: count idle frames and decide whether to park.
+     *  True means the callback returns Stop. */
+    bool shouldPark(int32_t numFrames, int32_t rate);
+
+    /** Fold the stream's xrun counter into telemetry as a delta so
+     *  reopening the stream (which restarts the count) loses nothing. */
+    void updateXRunCount(oboe::AudioStream* stream);
 
     TrackMixer& mixer_;
     AtomicTransport& transport_;
+    EngineTelemetry& telemetry_;
+    EngineStatus& status_;
+    int32_t lastXRunCount_ = 0;  // audio thread only; zeroed on reopen
+    int64_t presentLatencyNanos_ = 0;  // audio thread only; zeroed on reopen
+    uint64_t lastTimestampNanos_ = 0;
+    bool wasPlaying_ = false;    // audio thread only
+    int32_t preRollFrames_ = -1; // frames held so far this start; -1 once running
+    bool rateChosen_ = false;    // engine rate published by a previous open
+    int64_t idleFrames_ = 0;     // audio thread: idle frames in a row
+    std::atomic<bool> parking_{false};   // the callback stopped the stream to park it
+    std::atomic<bool> activity_{false};  // set by wake(); restarts the idle count
+    mutable std::mutex streamMutex_;     // guards replacing and restarting stream_
+    OutputTimeline timeline_;            // audio thread only; reset on reopen
+    int64_t blockStreamFrame_ = 0;       // stream frame this block starts at
+    std::atomic<OboeRecordingStream*> duplexInput_{nullptr};
+    std::atomic<bool> duplexInUse_{false};  // the callback holds duplexInput_
+    std::atomic<float> monitorGain_{0.0f};
+    const float* monitorFrames_ = nullptr;  // input pulled this block
+    int32_t monitorCount_ = 0;
     SynthEngine* synth_;  // nullable, owned by AudioEngine
     std::shared_ptr<oboe::AudioStream> stream_;
 };
@@ -1,13 +1,21 @@
 #include "oboe_recording_stream.h"
 #include "common.h"
+#include "mix_kernels.h"
 #include <algorithm>
 #include <cmath>
 #include <chrono>
+#include <ctime>
 #include <thread>
 
 namespace nightjar {
 
-OboeRecordingStream::OboeRecordingStream() = default;
+// How often a full-duplex pull refreshes the input's hardware timestamp.
+// Capture times follow the frame count in between.
+static constexpr uint64_t kInputTimestampIntervalNanos = 250000000ULL;
+
+OboeRecordingStream::OboeRecordingStream(EngineTelemetry& telemetry, EngineStatus& status,
+                                         const AtomicTransport& transport)
+    : telemetry_(telemetry), status_(status), transport_(transport), wavWriter_(telemetry) {}
 
 OboeRecordingStream::~OboeRecordingStream() {
     if (active_.load(std::memory_order_acquire)) {
@@ -15,7 +23,18 @@ OboeRecordingStream::~OboeRecordingStream() {
     }
 }
 
-bool OboeRecordingStream::start(const std::string& filePath) {
+bool OboeRecordingStream::start(const std::string& filePath, bool splitTakesAtLoop) {
+    return open(filePath, splitTakesAtLoop, false);
+}
+
+bool OboeRecordingStream::startDuplex(const std::string& filePath, bool splitTakesAtLoop,
+                                      int64_t startFrame) {
+    takeStartFrame_ = startFrame;
+    return open(filePath, splitTakesAtLoop, true);
+}
+
+bool OboeRecordingStream::open(const std::string& filePath, bool splitTakesAtLoop,
+                               bool duplex) {
     if (active_.load(std::memory_order_acquire)) {
         LOGE("OboeRecordingStream: already recording");
         return false;
@@ -26,9 +45,35 @@ bool OboeRecordingStream::start(const std::string& filePath) {
     pipelineHot_.store(false, std::memory_order_relaxed);
     writeGateOpen_.store(false, std::memory_order_relaxed);
     peakAmplitude_.store(0.0f, std::memory_order_relaxed);
+    splitTakes_ = splitTakesAtLoop;
+    duplex_ = duplex;
+    takeStarted_ = false;
+    inputHasTimestamp_ = false;
+    lastInputTimestampNanos_ = 0;
+    recordedStartFrame_.store(-1, std::memory_order_relaxed);
+    // Stamps decide what is written in full duplex, not the gate
+    writeGateOpen_.store(duplex, std::memory_order_relaxed);
+    capturedSamples_ = 0;
+    lastLoopResetCount_ = transport_.loopResetCount.load(std::memory_order_acquire);
+    envelopeFill_ = 0;
+    {
+        // Points of a previous recording nobody drained
+        std::lock_guard<std::mutex> lock(envelopeMutex_);
+        envelope_.drain([](const EnvelopePoint&) {});
+    }
+    {
+        // No callback runs yet, so this thread is the section's only writer
+        EngineStatus::Writer status(status_, kStatInputSeq);
+        status.set(kStatInputPeak, 0.0);
+        status.set(kStatRecordedFrames, int64_t{0});
+    }
+
+    // Record at the engine rate, so takes line up with playback frame
+    // for frame (Oboe converts if the input runs at another rate).
+    int32_t sampleRate = transport_.sampleRate.load(std::memory_order_relaxed);
 
     // Open WAV file
-    if (!wavWriter_.open(filePath)) {
+    if (!wavWriter_.open(filePath, sampleRate)) {
         return false;
     }
 
@@ -39,9 +84,11 @@ bool OboeRecordingStream::start(const std::string& filePath) {
     builder.setSharingMode(oboe::SharingMode::Exclusive);
     builder.setFormat(oboe::AudioFormat::Float);
     builder.setChannelCount(kChannelCount);
-    builder.setSampleRate(kSampleRate);
+    builder.setSampleRate(sampleRate);
+    builder.setSampleRateConversionQuality(oboe::SampleRateConversionQuality::Medium);
     builder.setInputPreset(oboe::InputPreset::Unprocessed);
-    builder.setDataCallback(this);
+    // Full duplex: no callback; the playback callback reads the stream
+    if (!duplex) builder.setDataCallback(this);
     builder.setErrorCallback(this);
 
     oboe::Result result = builder.openStream(stream_);
@@ -75,7 +122,8 @@ bool OboeRecordingStream::start(const std::string& filePath) {
     }
 
     active_.store(true, std::memory_order_release);
-    LOGD("OboeRecordingStream: recording started → %s", filePath.c_str());
+    LOGD("OboeRecordingStream: recording started → %s%s", filePath.c_str(),
+         duplex ? " (full duplex)" : "");
     return true;
 }
 
@@ -115,6 +163,9 @@ int64_t OboeRecordingStream::stop() {
         stream_.reset();
     }
 
+    // The callback is gone; hand the UI the last partial window too
+    if (envelopeFill_ > 0) pushEnvelopePoint();
+
     // Stop the WavWriter (drains remaining ring buffer data, patches header)
     wavWriter_.stopConsuming();
 
@@ -148,11 +199,7 @@ oboe::DataCallbackResult OboeRecordingStream::onAudioReady(
     auto* floatData = static_cast<const float*>(audioData);
 
     // Compute peak amplitude for UI visualization
-    float peak = 0.0f;
-    for (int32_t i = 0; i < numFrames; ++i) {
-        float abs = std::fabs(floatData[i]);
-        if (abs > peak) peak = abs;
-    }
+    float peak = peakAbs(floatData, numFrames);
     peakAmplitude_.store(peak, std::memory_order_relaxed);
 
     // Signal that the pipeline is hot (first callback)
@@ -162,12 +209,155 @@ oboe::DataCallbackResult OboeRecordingStream::onAudioReady(
 
     // Only push to ring buffer when the write gate is open
     if (writeGateOpen_.load(std::memory_order_acquire)) {
-        ringBuffer_.write(floatData, static_cast<size_t>(numFrames));
+        // A wrap seen here starts a new take at the first sample of this
+        // buffer. Wraps before the gate opened land at sample 0, which
+        // the writer ignores.
+        if (splitTakes_) {
+            int64_t resets = transport_.loopResetCount.load(std::memory_order_acquire);
+            if (resets != lastLoopResetCount_) {
+                lastLoopResetCount_ = resets;
+                wavWriter_.markTakeBoundary(capturedSamples_);
+                if (envelopeFill_ > 0) pushEnvelopePoint();
+            }
+        }
+        queueCaptured(floatData, numFrames);
     }
 
+    publishInput(peak);
     return oboe::DataCallbackResult::Continue;
 }
 
+void OboeRecordingStream::queueCaptured(const float* samples, int32_t count) {
+    accumulateEnvelope(samples, count);
+
+    auto wanted = static_cast<size_t>(count);
+    size_t written = ringBuffer_.write(samples, wanted);
+    capturedSamples_ += static_cast<int64_t>(written);
+    if (written < wanted) {
+        telemetry_.recordDroppedSamples.fetch_add(wanted - written,
+                                                  std::memory_order_relaxed);
+    }
+    // Wake the writer in batches so it writes whole blocks; the
+    // notify is a single atomic add unless the writer is parked.
+    if (ringBuffer_.availableToRead() >= kWriterWakeSamples) {
+        wavWriter_.notifyDataReady();
+    }
+}
+
+void OboeRecordingStream::publishInput(float peak) {
+    EngineStatus::Writer status(status_, kStatInputSeq);
+    status.set(kStatInputPeak, static_cast<double>(peak));
+    status.set(kStatRecordedFrames, capturedSamples_ / kChannelCount);
+}
+
+// ── Full duplex (playback callback — same rules as the audio callback) ──
+
+int32_t OboeRecordingStream::pullDuplex(const OutputTimeline& timeline, uint64_t nowNanos) {
+    if (!duplex_ || !stream_ || !active_.load(std::memory_order_acquire)) return 0;
+
+    // Non-blocking: whatever the input has captured since the last pull
+    auto read = stream_->read(duplexBuf_, kDuplexReadFrames, 0);
+    if (!read || read.value() <= 0) return 0;
+    int32_t frames = read.value();
+    int64_t firstFrame = stream_->getFramesRead() - frames;
+
+    float peak = peakAbs(duplexBuf_, frames * kChannelCount);
+    peakAmplitude_.store(peak, std::memory_order_relaxed);
+    if (!pipelineHot_.load(std::memory_order_relaxed)) {
+        pipelineHot_.store(true, std::memory_order_release);
+    }
+
+    // The stream frame the output was playing when the first sample was
+    // captured; both streams run at the engine rate, so the rest follow
+    // one for one.
+    int64_t heard = timeline.streamFrameAt(captureNanos(firstFrame, nowNanos));
+    int32_t done = 0;
+    while (done < frames) {
+        TimelineRun run = timeline.runAt(heard + done);
+        int32_t n = std::min(frames - done, std::max(run.frames, 1));
+        captureRun(duplexBuf_ + done * kChannelCount, n, run);
+        done += n;
+    }
+
+    publishInput(peak);
+    return frames;
+}
+
+void OboeRecordingStream::captureRun(const float* samples, int32_t count,
+                                     const TimelineRun& run) {
+    // Nothing on the timeline was playing: not part of the take
+    if (!run.playing) return;
+
+    int64_t frame = run.frame;
+    if (!takeStarted_) {
+        int64_t skip = std::max<int64_t>(takeStartFrame_ - frame, 0);
+        if (skip >= count) return;
+        samples += skip * kChannelCount;
+        count -= static_cast<int32_t>(skip);
+        frame += skip;
+        takeStarted_ = true;
+        recordedStartFrame_.store(frame, std::memory_order_release);
+    } else if (frame != nextTimelineFrame_ && splitTakes_) {
+        // The heard timeline jumped back: a loop wrap starts a new take
+        wavWriter_.markTakeBoundary(capturedSamples_);
+        if (envelopeFill_ > 0) pushEnvelopePoint();
+    }
+    nextTimelineFrame_ = frame + count;
+    queueCaptured(samples, count * kChannelCount);
+}
+
+int64_t OboeRecordingStream::captureNanos(int64_t frame, uint64_t nowNanos) {
+    int32_t rate = std::max(stream_->getSampleRate(), 1);
+    if (nowNanos - lastInputTimestampNanos_ >= kInputTimestampIntervalNanos) {
+        lastInputTimestampNanos_ = nowNanos;
+        auto timestamp = stream_->getTimestamp(CLOCK_MONOTONIC);
+        if (timestamp) {
+            inputAnchorFrame_ = timestamp.value().position;
+            inputAnchorNanos_ = timestamp.value().timestamp;
+            inputHasTimestamp_ = true;
+        }
+    }
+    if (inputHasTimestamp_) {
+        return inputAnchorNanos_ + (frame - inputAnchorFrame_) * 1000000000LL / rate;
+    }
+    // No timestamps (OpenSL ES, or too early): the newest captured frame
+    // counts as captured now
+    return static_cast<int64_t>(nowNanos) -
+           (stream_->getFramesWritten() - frame) * 1000000000LL / rate;
+}
+
+void OboeRecordingStream::accumulateEnvelope(const float* samples, int32_t count) {
+    for (int32_t i = 0; i < count; ++i) {
+        float s = samples[i];
+        if (envelopeFill_ == 0) {
+            envelopeMin_ = s;
+            envelopeMax_ = s;
+            envelopeSumSquares_ = 0.0;
+        } else {
+            envelopeMin_ = std::min(envelopeMin_, s);
+            envelopeMax_ = std::max(envelopeMax_, s);
+        }
+        envelopeSumSquares_ += static_cast<double>(s) * s;
+        if (++envelopeFill_ == kEnvelopeWindowFrames) pushEnvelopePoint();
+    }
+}
+
+void OboeRecordingStream::pushEnvelopePoint() {
+    EnvelopePoint point{envelopeMin_, envelopeMax_,
+                        static_cast<float>(std::sqrt(envelopeSumSquares_ / envelopeFill_))};
+    // A full ring means the UI stopped draining; the point only feeds the
+    // live display, so it is dropped rather than blocking the callback.
+    envelope_.push(&point, 1);
+    envelopeFill_ = 0;
+}
+
+size_t OboeRecordingStream::drainEnvelope(EnvelopePoint* out, size_t maxPoints) {
+    std::lock_guard<std::mutex> lock(envelopeMutex_);
+    size_t n = 0;
+    envelope_.drain([&](const EnvelopePoint& point) { out[n++] = point; }, maxPoints);
+    return n;
+}
+
 void OboeRecordingStream::onErrorAfterClose(
         oboe::AudioStream* /* stream */,
         oboe::Result error) {
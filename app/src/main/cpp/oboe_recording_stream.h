@@ -1,14 +1,37 @@
 #pragma once
 
+#include "atomic_transport.h"
 #include "audio_engine.h"
+#include "command_ring.h"
+#include "engine_status.h"
+#include "output_timeline.h"
+#include "peak_cache.h"
 #include "spsc_ring_buffer.h"
 #include "wav_writer.h"
 #include <oboe/Oboe.h>
 #include <atomic>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace nightjar {
 
+/** Min, max and RMS of one window of captured samples. */
+struct EnvelopePoint {
+    float min;
+    float max;
+    float rms;
+};
+
+// Input frames per envelope point: two peak cache base blocks, so the live
+// waveform lines up with the take's `.peaks` sidecar.
+static constexpr int32_t kEnvelopeWindowFrames = 2 * kPeakBaseFrames;
+// Points the capture callback can queue ahead of the UI (~40 s at 48 kHz).
+static constexpr size_t kEnvelopeRingCapacity = 4096;
+// Most input frames a full-duplex pull reads in one output block; a
+// backlog beyond that is caught up over the next blocks.
+static constexpr int32_t kDuplexReadFrames = 4096;
+
 /**
  * Oboe input stream for recording.
  *
@@ -23,20 +46,76 @@ namespace nightjar {
  * The audio callback computes peak amplitude (atomic) and pushes
  * float32 samples into the SPSC ring buffer. The WavWriter consumer
  * thread converts to int16 and writes to disk — no file I/O in the
- * callback.
+ * callback. Samples the ring cannot take (writer fell behind) are
+ * counted in EngineTelemetry rather than silently lost.
+ *
+ * Each callback also publishes the input section of EngineStatus (peak
+ * and frames captured) for the UI's meters.
+ *
+ * For the live waveform, every kEnvelopeWindowFrames of the take (from
+ * the write gate on) become one EnvelopePoint in a small SPSC ring, so no
+ * peak is lost however rarely the UI drains it (drainEnvelope()). Windows
+ * restart at each take boundary, matching each take's peak cache.
+ *
+ * For loop recording the callback also watches the transport's
+ * loopResetCount and marks a take boundary in the WavWriter at every
+ * wrap, so each loop pass lands in its own WAV as it is recorded.
+ *
+ * Full duplex (startDuplex()) replaces all of that timing with stamps.
+ * The input stream runs without a callback; the playback callback pulls
+ * whatever it has captured once per output block (pullDuplex()), so the
+ * two streams move in lockstep. Each pulled block is stamped, from the
+ * input's hardware timestamp and the OutputTimeline, with the timeline
+ * frame the output was playing when its first sample was captured. The
+ * take starts at exactly the requested timeline frame with no write gate,
+ * and a jump in the stamps (a loop wrap) is a take boundary, so takes
+ * land on the grid with no latency estimate or calibration.
  */
 class OboeRecordingStream : public oboe::AudioStreamDataCallback,
                             public oboe::AudioStreamErrorCallback {
 public:
-    OboeRecordingStream();
+    OboeRecordingStream(EngineTelemetry& telemetry, EngineStatus& status,
+                        const AtomicTransport& transport);
     ~OboeRecordingStream();
 
     /**
      * Open Oboe input stream + WAV file, start the stream.
      * Samples flow into the ring buffer but the writer does NOT write
      * to disk until openWriteGate() is called.
+     * With [splitTakesAtLoop], every loop wrap after the gate opens
+     * starts a new take file (see getTakePaths()).
+     */
+    bool start(const std::string& filePath, bool splitTakesAtLoop);
+
+    /**
+     * Open the input stream for full-duplex recording into [filePath].
+     * Nothing is captured until the playback callback pulls it; the take
+     * begins with the sample heard against timeline frame [startFrame].
+     * No write gate: awaitFirstBuffer() and openWriteGate() are not needed.
+     */
+    bool startDuplex(const std::string& filePath, bool splitTakesAtLoop, int64_t startFrame);
+
+    /**
+     * Full duplex, from the playback callback: read the input captured
+     * since the last pull, stamp it against [timeline] and record what
+     * falls in the take. Returns the frames read; duplexFrames() holds
+     * them until the next pull (for monitoring). Real-time safe.
+     */
+    int32_t pullDuplex(const OutputTimeline& timeline, uint64_t nowNanos);
+
+    /** The input frames of the last pullDuplex(). */
+    const float* duplexFrames() const { return duplexBuf_; }
+
+    bool isDuplex() const { return duplex_; }
+
+    /**
+     * Timeline frame of the take's first sample: the start frame given
+     * to startDuplex() unless playback began after it. -1 until the take
+     * has started, and always in callback mode.
      */
-    bool start(const std::string& filePath);
+    int64_t getRecordedStartFrame() const {
+        return recordedStartFrame_.load(std::memory_order_acquire);
+    }
 
     /**
      * Block until the first audio callback has fired, or timeout.
@@ -58,6 +137,11 @@ public:
      */
     int64_t stop();
 
+    /** Files written by the last recording, one per take. Valid after stop(). */
+    const std::vector<std::string>& getTakePaths() const {
+        return wavWriter_.getTakePaths();
+    }
+
     /** Returns true if recording is in progress. */
     bool isActive() const {
         return active_.load(std::memory_order_acquire);
@@ -75,6 +159,12 @@ public:
         return peakAmplitude_.load(std::memory_order_relaxed);
     }
 
+    /**
+     * Move up to [maxPoints] envelope points into [out], oldest first.
+     * Returns how many. Any thread; one consumer at a time.
+     */
+    size_t drainEnvelope(EnvelopePoint* out, size_t maxPoints);
+
     /** Duration of audio written to the WAV file so far, in ms. */
     int64_t getRecordedDurationMs() const {
         return wavWriter_.getDurationMs();
@@ -92,6 +182,24 @@ public:
         oboe::Result error) override;
 
 private:
+    /** start() and startDuplex(): open the WAV and the input stream. */
+    bool open(const std::string& filePath, bool splitTakesAtLoop, bool duplex);
+
+    /** Queue captured samples for the writer and the envelope. */
+    void queueCaptured(const float* samples, int32_t count);
+
+    /** The input section of EngineStatus, after a block. */
+    void publishInput(float peak);
+
+    /** Full duplex: record the part of [run] that falls in the take. */
+    void captureRun(const float* samples, int32_t count, const TimelineRun& run);
+
+    /** Full duplex: CLOCK_MONOTONIC time input frame [frame] was captured. */
+    int64_t captureNanos(int64_t frame, uint64_t nowNanos);
+
+    EngineTelemetry& telemetry_;
+    EngineStatus& status_;
+    const AtomicTransport& transport_;
     std::shared_ptr<oboe::AudioStream> stream_;
     SpscRingBuffer<kRingBufferCapacity> ringBuffer_;
     WavWriter wavWriter_;
@@ -100,6 +208,39 @@ private:
     std::atomic<bool> pipelineHot_{false};
     std::atomic<bool> writeGateOpen_{false};
     std::atomic<float> peakAmplitude_{0.0f};
+
+    /** Fold captured samples into the current envelope window. */
+    void accumulateEnvelope(const float* samples, int32_t count);
+
+    /** Queue the current window as a point and start the next one. */
+    void pushEnvelopePoint();
+
+    CommandRing<EnvelopePoint, kEnvelopeRingCapacity> envelope_;
+    std::mutex envelopeMutex_;  // serializes the ring's consumers
+
+    // Current envelope window; the callback's (or, once it is stopped,
+    // stop()'s) alone.
+    int32_t envelopeFill_ = 0;
+    float envelopeMin_ = 0.0f;
+    float envelopeMax_ = 0.0f;
+    double envelopeSumSquares_ = 0.0;
+
+    // Set by start() before the stream runs; callback-only afterwards.
+    bool splitTakes_ = false;
+    int64_t capturedSamples_ = 0;      // samples queued since the gate opened
+    int64_t lastLoopResetCount_ = 0;
+
+    // Full duplex. Set by startDuplex(); playback-callback-only afterwards.
+    bool duplex_ = false;
+    int64_t takeStartFrame_ = 0;
+    bool takeStarted_ = false;
+    int64_t nextTimelineFrame_ = 0;     // stamp the next captured sample continues
+    int64_t inputAnchorFrame_ = 0;      // input frame captured at inputAnchorNanos_
+    int64_t inputAnchorNanos_ = 0;
+    bool inputHasTimestamp_ = false;
+    uint64_t lastInputTimestampNanos_ = 0;
+    std::atomic<int64_t> recordedStartFrame_{-1};
+    float duplexBuf_[kDuplexReadFrames * kChannelCount];
 };
 
 }  // namespace nightjar
@@ -0,0 +1,156 @@
+#include "offline_renderer.h"
+#include "track_mixer.h"
+#include "synth_engine.h"
+#include "atomic_transport.h"
+#include "wav_writer.h"
+#include "mix_kernels.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace nightjar {
+
+// Render block size. Matches the synth's render chunk so each block is a
+// single renderSubBuffer() pass; large enough that per-block overhead
+// (mixer list walk, fwrite) is negligible.
+static constexpr int32_t kOfflineBlockFrames = kSynthRenderChunkFrames;
+static constexpr int32_t kOfflineBlockSamples = kOfflineBlockFrames * kOutputChannelCount;
+
+OfflineRenderer::OfflineRenderer(TrackMixer& mixer, SynthEngine* synth,
+                                 AtomicTransport& transport)
+    : mixer_(mixer), synth_(synth), transport_(transport) {}
+
+OfflineRenderer::~OfflineRenderer() {
+    cancel();
+    join();
+}
+
+bool OfflineRenderer::start(const std::string& filePath, bool includeMetronome) {
+    if (isRunning()) {
+        LOGW("OfflineRenderer: export already running");
+        return false;
+    }
+    join();  // reap a previous, finished worker
+
+    int64_t total = transport_.totalFrames.load(std::memory_order_relaxed);
+    if (total <= 0) {
+        LOGW("OfflineRenderer: nothing to export (empty timeline)");
+        return false;
+    }
+
+    FILE* file = fopen(filePath.c_str(), "wb");
+    if (!file) {
+        LOGE("OfflineRenderer: failed to open %s", filePath.c_str());
+        return false;
+    }
+    writePcmWavHeader(file, transport_.sampleRate.load(std::memory_order_relaxed),
+                      kOutputChannelCount);
+
+    filePath_ = filePath;
+    cancelRequested_.store(false, std::memory_order_relaxed);
+    framesRendered_.store(0, std::memory_order_relaxed);
+    totalFrames_.store(total, std::memory_order_relaxed);
+    state_.store(OfflineRenderState::Running, std::memory_order_release);
+
+    worker_ = std::thread(&OfflineRenderer::renderLoop, this, file, total, includeMetronome);
+    LOGD("OfflineRenderer: export started -> %s (%lld frames, metronome=%d)",
+         filePath.c_str(), (long long)total, includeMetronome ? 1 : 0);
+    return true;
+}
+
+void OfflineRenderer::cancel() {
+    cancelRequested_.store(true, std::memory_order_release);
+}
+
+void OfflineRenderer::join() {
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+float OfflineRenderer::getProgress() const {
+    int64_t total = totalFrames_.load(std::memory_order_relaxed);
+    if (total <= 0) return 0.0f;
+    int64_t done = framesRendered_.load(std::memory_order_relaxed);
+    return std::min(1.0f, static_cast<float>(done) / static_cast<float>(total));
+}
+
+// ── Worker thread ──────────────────────────────────────────────────────
+
+void OfflineRenderer::renderLoop(FILE* file, int64_t totalFrames, bool includeMetronome) {
+    float mixBuf[kOfflineBlockSamples];
+    float synthBuf[kOfflineBlockSamples];
+    int16_t pcmBuf[kOfflineBlockSamples];
+
+    bool synthActive = synth_ && synth_->beginOfflineRender(0, includeMetronome);
+    float synthVolume = synth_ ? synth_->getVolume() : 0.0f;
+
+    // The callback keeps its own cursor; sharing it would make both
+    // sides re-locate on every block.
+    TrackMixer::RenderCursor cursor;
+    cursor.reader = TrackMixer::kOfflineReader;
+
+    bool ok = true;
+    int64_t pos = 0;
+    int64_t bytesWritten = 0;
+
+    while (pos < totalFrames) {
+        if (cancelRequested_.load(std::memory_order_acquire)) break;
+
+        auto frames = static_cast<int32_t>(
+            std::min<int64_t>(kOfflineBlockFrames, totalFrames - pos));
+        int32_t samples = frames * kOutputChannelCount;
+
+        mixer_.renderFrames(mixBuf, frames, pos, cursor);
+
+        if (synthActive) {
+            if (!synth_->renderOffline(synthBuf, frames)) {
+                LOGE("OfflineRenderer: synth render failed at frame %lld", (long long)pos);
+                ok = false;
+                break;
+            }
+            mixScaled(mixBuf, synthBuf, samples, synthVolume);
+        }
+
+        // Final mix point: identical soft-clip to the playback callback,
+        // then the recorder's float -> int16 scaling (the clipper's
+        // output is already within [-1, 1], so no clamp is needed).
+        softClip(mixBuf, samples);
+        for (int32_t i = 0; i < samples; ++i) {
+            pcmBuf[i] = static_cast<int16_t>(mixBuf[i] * 32767.0f);
+        }
+
+        size_t written = fwrite(pcmBuf, sizeof(int16_t), static_cast<size_t>(samples), file);
+        if (written != static_cast<size_t>(samples)) {
+            LOGE("OfflineRenderer: short write at frame %lld", (long long)pos);
+            ok = false;
+            break;
+        }
+        bytesWritten += static_cast<int64_t>(written * sizeof(int16_t));
+
+        pos += frames;
+        framesRendered_.store(pos, std::memory_order_relaxed);
+    }
+
+    if (synthActive) {
+        synth_->endOfflineRender();
+    }
+
+    bool cancelled = cancelRequested_.load(std::memory_order_acquire) && pos < totalFrames;
+    if (ok && !cancelled) {
+        patchPcmWavHeader(file, bytesWritten);
+    }
+    fclose(file);
+
+    if (!ok || cancelled) {
+        std::remove(filePath_.c_str());
+    }
+
+    OfflineRenderState finalState = cancelled ? OfflineRenderState::Cancelled
+                                  : ok        ? OfflineRenderState::Completed
+                                              : OfflineRenderState::Failed;
+    state_.store(finalState, std::memory_order_release);
+    LOGD("OfflineRenderer: export finished (state=%d, frames=%lld/%lld)",
+         static_cast<int>(finalState), (long long)pos, (long long)totalFrames);
+}
+
+}  // namespace nightjar
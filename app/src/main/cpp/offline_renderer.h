@@ -0,0 +1,83 @@
+#pragma once
+
+#include "common.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace nightjar {
+
+class TrackMixer;
+class SynthEngine;
+struct AtomicTransport;
+
+/** Lifecycle of an offline export. Values are mirrored in Kotlin. */
+enum class OfflineRenderState : int32_t {
+    Idle = 0,
+    Running = 1,
+    Completed = 2,
+    Failed = 3,
+    Cancelled = 4,
+};
+
+/**
+ * Faster-than-realtime mixdown of the whole arrangement to a stereo
+ * 16-bit WAV file.
+ *
+ * A worker thread drives TrackMixer::renderFrames() and
+ * SynthEngine::renderOffline() in lockstep, sums them exactly like
+ * OboePlaybackStream::onAudioReady() does (synth * master volume, then
+ * the final soft-clip), and streams the result to disk. Neither the
+ * Oboe stream nor the synth ring buffer is involved, so the render runs
+ * as fast as the CPU allows.
+ *
+ * The synth render thread is parked for the duration of the export and
+ * restarted afterwards. Progress and state are atomics polled over JNI.
+ */
+class OfflineRenderer {
+public:
+    OfflineRenderer(TrackMixer& mixer, SynthEngine* synth, AtomicTransport& transport);
+    ~OfflineRenderer();
+
+    OfflineRenderer(const OfflineRenderer&) = delete;
+    OfflineRenderer& operator=(const OfflineRenderer&) = delete;
+
+    /**
+     * Start exporting [0, totalFrames) to [filePath]. Returns false if an
+     * export is already running, the timeline is empty, or the file
+     * cannot be created.
+     */
+    bool start(const std::string& filePath, bool includeMetronome);
+
+    /** Request cancellation. The partial file is deleted by the worker. */
+    void cancel();
+
+    /** Join the worker thread (after it finished or was cancelled). */
+    void join();
+
+    OfflineRenderState getState() const {
+        return state_.load(std::memory_order_acquire);
+    }
+
+    bool isRunning() const { return getState() == OfflineRenderState::Running; }
+
+    /** Fraction of the timeline rendered so far, 0.0 - 1.0. */
+    float getProgress() const;
+
+private:
+    void renderLoop(FILE* file, int64_t totalFrames, bool includeMetronome);
+
+    TrackMixer& mixer_;
+    SynthEngine* synth_;   // nullable, owned by AudioEngine
+    AtomicTransport& transport_;
+
+    std::thread worker_;
+    std::string filePath_;
+    std::atomic<OfflineRenderState> state_{OfflineRenderState::Idle};
+    std::atomic<bool> cancelRequested_{false};
+    std::atomic<int64_t> framesRendered_{0};
+    std::atomic<int64_t> totalFrames_{0};
+};
+
+}  // namespace nightjar
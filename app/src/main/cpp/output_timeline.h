@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+namespace nightjar {
+
+// Output blocks remembered for stamping captured audio: enough to reach
+// back over the output latency (Bluetooth included) at the smallest bursts.
+static constexpr size_t kOutputTimelineBlocks = 512;
+
+/**
+ * Timeline frames heard back to back: [frame, frame + frames). While the
+ * transport is stopped (or a play start is pre-rolling) nothing on the
+ * timeline is heard and [playing] is false.
+ */
+struct TimelineRun {
+    int64_t frame = 0;
+    int32_t frames = 0;
+    bool playing = false;
+};
+
+/**
+ * Which timeline frame the output is playing at a given moment, for
+ * stamping captured audio in full-duplex recording.
+ *
+ * The playback callback records every block it writes: the stream frame
+ * it starts at (frames written so far), the timeline frame it plays and
+ * its length. A block that crosses the loop end is stored as two runs,
+ * the part past loopEnd counted from loopStart, since that is where the
+ * performer is in the next pass. An anchor -- a stream frame and the
+ * CLOCK_MONOTONIC time it reaches the output, from the stream's hardware
+ * timestamp -- turns a moment into the stream frame heard then, and the
+ * history turns that into a timeline frame.
+ *
+ * Audio thread only: written and read by the output callback.
+ */
+class OutputTimeline {
+public:
+    void reset() {
+        count_ = 0;
+        next_ = 0;
+        anchorNanos_ = 0;
+        anchorFrame_ = 0;
+        sampleRate_ = 0;
+        hardwareAnchor_ = false;
+    }
+
+    /**
+     * The block starting at [streamFrame] plays [frames] frames from
+     * timeline frame [timelineFrame], or nothing if not [playing].
+     * Pass the loop region (loopStart < 0 for none) to wrap it.
+     */
+    void addBlock(int64_t streamFrame, int64_t timelineFrame, int32_t frames, bool playing,
+                  int64_t loopStart, int64_t loopEnd) {
+        if (frames <= 0) return;
+        bool looping = playing && loopStart >= 0 && loopEnd > loopStart;
+        if (looping && timelineFrame < loopEnd && timelineFrame + frames > loopEnd) {
+            auto head = static_cast<int32_t>(loopEnd - timelineFrame);
+            push(streamFrame, timelineFrame, head, true);
+            push(streamFrame + head, loopStart, frames - head, true);
+            return;
+        }
+        push(streamFrame, timelineFrame, frames, playing);
+    }
+
+    /**
+     * [streamFrame] reaches the output at [nanos]. A [hardware] anchor
+     * (from a stream timestamp) is exact and replaces any estimate; an
+     * estimated one is only used until the first hardware anchor.
+     */
+    void setAnchor(int64_t streamFrame, int64_t nanos, int32_t sampleRate, bool hardware) {
+        if (!hardware && hardwareAnchor_) return;
+        anchorFrame_ = streamFrame;
+        anchorNanos_ = nanos;
+        sampleRate_ = sampleRate;
+        hardwareAnchor_ = hardwareAnchor_ || hardware;
+    }
+
+    /** Stream frame reaching the output at [nanos], extrapolated from the anchor. */
+    int64_t streamFrameAt(int64_t nanos) const {
+        if (sampleRate_ <= 0) return anchorFrame_;
+        return anchorFrame_ + (nanos - anchorNanos_) * sampleRate_ / 1000000000LL;
+    }
+
+    /**
+     * The run of timeline frames heard from [streamFrame] on, to the end
+     * of the block it falls in. Frames later than the newest block or
+     * older than the oldest remembered are extrapolated from it.
+     */
+    TimelineRun runAt(int64_t streamFrame) const {
+        TimelineRun run;
+        if (count_ == 0) return run;
+        for (size_t i = 0; i < count_; ++i) {
+            const Block& block = blocks_[(next_ + kOutputTimelineBlocks - 1 - i) % kOutputTimelineBlocks];
+            if (streamFrame < block.streamFrame && i + 1 < count_) continue;
+            int64_t into = streamFrame - block.streamFrame;
+            run.playing = block.playing;
+            run.frame = block.timelineFrame + into;
+            if (into < 0) {
+                // Before the oldest block: runs up to it
+                run.frames = static_cast<int32_t>(std::min<int64_t>(-into, INT32_MAX));
+            } else if (into < block.frames) {
+                run.frames = static_cast<int32_t>(block.frames - into);
+            } else {
+                // Past the newest block: carries on from it
+                run.frames = INT32_MAX;
+            }
+            return run;
+        }
+        return run;
+    }
+
+private:
+    struct Block {
+        int64_t streamFrame = 0;
+        int64_t timelineFrame = 0;
+        int32_t frames = 0;
+        bool playing = false;
+    };
+
+    void push(int64_t streamFrame, int64_t timelineFrame, int32_t frames, bool playing) {
+        blocks_[next_] = {streamFrame, timelineFrame, frames, playing};
+        next_ = (next_ + 1) % kOutputTimelineBlocks;
+        count_ = std::min(count_ + 1, kOutputTimelineBlocks);
+    }
+
+    Block blocks_[kOutputTimelineBlocks];
+    size_t count_ = 0;
+    size_t next_ = 0;
+    int64_t anchorFrame_ = 0;
+    int64_t anchorNanos_ = 0;
+    int32_t sampleRate_ = 0;
+    bool hardwareAnchor_ = false;
+};
+
+}  // namespace nightjar
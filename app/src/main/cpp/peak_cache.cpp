@@ -0,0 +1,317 @@
+#include "peak_cache.h"
+#include "compressed_audio.h"
+#include "wav_track_source.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+namespace nightjar {
+
+namespace {
+
+constexpr char kPeakMagic[4] = {'N', 'J', 'P', 'K'};
+constexpr uint32_t kPeakVersion = 1;
+
+// On-disk layout (native endianness; the file never leaves the device):
+//   PeakFileHeader, kPeakLevelCount x PeakLevelHeader, level data.
+struct PeakFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t sampleRate;
+    uint32_t levelCount;
+    int64_t totalFrames;
+    int64_t sourceBytes;   // size of the take this was built from
+};
+
+struct PeakLevelHeader {
+    uint32_t framesPerPeak;
+    uint32_t reserved;
+    int64_t count;
+    int64_t offset;        // byte offset of the PeakPair array
+};
+
+int64_t fileSize(const std::string& path) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) return -1;
+    return static_cast<int64_t>(st.st_size);
+}
+
+const PeakFileHeader* header(const void* mapped) {
+    return static_cast<const PeakFileHeader*>(mapped);
+}
+
+const PeakLevelHeader* levels(const void* mapped) {
+    return reinterpret_cast<const PeakLevelHeader*>(
+        static_cast<const uint8_t*>(mapped) + sizeof(PeakFileHeader));
+}
+
+}  // namespace
+
+// ── Builder ────────────────────────────────────────────────────────────
+
+void PeakCacheBuilder::reset() {
+    base_.clear();
+    totalFrames_ = 0;
+    blockFill_ = 0;
+    block_ = {0, 0};
+}
+
+void PeakCacheBuilder::append(const int16_t* samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int16_t s = samples[i];
+        if (blockFill_ == 0) {
+            block_ = {s, s};
+        } else {
+            block_.min = std::min(block_.min, s);
+            block_.max = std::max(block_.max, s);
+        }
+        if (++blockFill_ == kPeakBaseFrames) {
+            base_.push_back(block_);
+            blockFill_ = 0;
+        }
+    }
+    totalFrames_ += static_cast<int64_t>(count);
+}
+
+bool PeakCacheBuilder::write(const std::string& peaksPath, int64_t sourceBytes,
+                             int32_t sampleRate) {
+    std::vector<PeakPair> pyramid[kPeakLevelCount];
+    pyramid[0] = base_;
+    if (blockFill_ > 0) pyramid[0].push_back(block_);
+
+    for (int32_t l = 1; l < kPeakLevelCount; ++l) {
+        const auto& finer = pyramid[l - 1];
+        auto& level = pyramid[l];
+        level.reserve((finer.size() + kPeakLevelFactor - 1) / kPeakLevelFactor);
+        for (size_t i = 0; i < finer.size(); i += kPeakLevelFactor) {
+            PeakPair p = finer[i];
+            size_t end = std::min(finer.size(), i + kPeakLevelFactor);
+            for (size_t j = i + 1; j < end; ++j) {
+                p.min = std::min(p.min, finer[j].min);
+                p.max = std::max(p.max, finer[j].max);
+            }
+            level.push_back(p);
+        }
+    }
+
+    PeakFileHeader fh{};
+    std::memcpy(fh.magic, kPeakMagic, sizeof(kPeakMagic));
+    fh.version = kPeakVersion;
+    fh.sampleRate = static_cast<uint32_t>(sampleRate);
+    fh.levelCount = kPeakLevelCount;
+    fh.totalFrames = totalFrames_;
+    fh.sourceBytes = sourceBytes;
+
+    PeakLevelHeader lh[kPeakLevelCount]{};
+    int64_t offset = sizeof(PeakFileHeader) + sizeof(lh);
+    uint32_t framesPerPeak = kPeakBaseFrames;
+    for (int32_t l = 0; l < kPeakLevelCount; ++l) {
+        lh[l].framesPerPeak = framesPerPeak;
+        lh[l].count = static_cast<int64_t>(pyramid[l].size());
+        lh[l].offset = offset;
+        offset += lh[l].count * static_cast<int64_t>(sizeof(PeakPair));
+        framesPerPeak *= kPeakLevelFactor;
+    }
+
+    // Unique temp name: two threads may race to build the same sidecar.
+    std::string tmpPath = peaksPath + ".tmp" +
+        std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        LOGE("PeakCache: failed to create %s", tmpPath.c_str());
+        return false;
+    }
+    bool ok = fwrite(&fh, sizeof(fh), 1, f) == 1 &&
+              fwrite(lh, sizeof(lh), 1, f) == 1;
+    for (int32_t l = 0; ok && l < kPeakLevelCount; ++l) {
+        if (pyramid[l].empty()) continue;
+        ok = fwrite(pyramid[l].data(), sizeof(PeakPair), pyramid[l].size(), f) ==
+             pyramid[l].size();
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), peaksPath.c_str()) != 0) {
+        LOGE("PeakCache: failed to write %s", peaksPath.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    LOGD("PeakCache: wrote %s (%lld frames)", peaksPath.c_str(), (long long)totalFrames_);
+    return true;
+}
+
+// ── Reader ─────────────────────────────────────────────────────────────
+
+PeakCacheReader::~PeakCacheReader() {
+    close();
+}
+
+std::string PeakCacheReader::sidecarPath(const std::string& path) {
+    return path + ".peaks";
+}
+
+bool PeakCacheReader::openForTake(const std::string& path) {
+    close();
+    int64_t sourceBytes = fileSize(path);
+    if (sourceBytes < 0) return false;
+
+    std::string peaksPath = sidecarPath(path);
+    if (mapSidecar(peaksPath, sourceBytes)) return true;
+
+    // Missing or stale (the take was re-recorded, split, compressed or
+    // written by an older build): rebuild from the PCM data once and map
+    // the result.
+    if (!generate(path, sourceBytes)) return false;
+    return mapSidecar(peaksPath, sourceBytes);
+}
+
+bool PeakCacheReader::adoptSidecar(const std::string& fromTake, const std::string& toTake) {
+    int64_t toBytes = fileSize(toTake);
+    PeakCacheReader from;
+    if (toBytes < 0 || !from.mapSidecar(sidecarPath(fromTake), fileSize(fromTake))) return false;
+
+    // Same pyramid; only the size it is checked against changes
+    PeakFileHeader fh = *header(from.mapped_);
+    fh.sourceBytes = toBytes;
+    std::string peaksPath = sidecarPath(toTake);
+    std::string tmpPath = peaksPath + ".tmp" +
+        std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        LOGE("PeakCache: failed to create %s", tmpPath.c_str());
+        return false;
+    }
+    const auto* rest = static_cast<const uint8_t*>(from.mapped_) + sizeof(fh);
+    size_t restSize = from.mappedSize_ - sizeof(fh);
+    bool ok = fwrite(&fh, sizeof(fh), 1, f) == 1 &&
+              fwrite(rest, 1, restSize, f) == restSize;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), peaksPath.c_str()) != 0) {
+        LOGE("PeakCache: failed to write %s", peaksPath.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void PeakCacheReader::close() {
+    if (mapped_) {
+        munmap(mapped_, mappedSize_);
+        mapped_ = nullptr;
+        mappedSize_ = 0;
+    }
+}
+
+bool PeakCacheReader::mapSidecar(const std::string& peaksPath, int64_t expectedSourceBytes) {
+    int fd = ::open(peaksPath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(PeakFileHeader) + sizeof(PeakLevelHeader) * kPeakLevelCount) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    auto size = static_cast<size_t>(st.st_size);
+    const PeakFileHeader* fh = header(mapped);
+    bool valid = std::memcmp(fh->magic, kPeakMagic, sizeof(kPeakMagic)) == 0 &&
+                 fh->version == kPeakVersion &&
+                 fh->levelCount == static_cast<uint32_t>(kPeakLevelCount) &&
+                 fh->sourceBytes == expectedSourceBytes;
+    for (int32_t l = 0; valid && l < kPeakLevelCount; ++l) {
+        const PeakLevelHeader& lh = levels(mapped)[l];
+        valid = lh.framesPerPeak > 0 && lh.count >= 0 && lh.offset >= 0 &&
+                static_cast<size_t>(lh.offset + lh.count * static_cast<int64_t>(sizeof(PeakPair))) <= size;
+    }
+    if (!valid) {
+        munmap(mapped, size);
+        return false;
+    }
+
+    mapped_ = mapped;
+    mappedSize_ = size;
+    return true;
+}
+
+bool PeakCacheReader::generate(const std::string& path, int64_t sourceBytes) {
+    PeakCacheBuilder builder;
+    if (CompressedAudioFile::sniff(path)) {
+        // Decoded a block at a time; the builder keeps only the peaks
+        CompressedAudioFile source;
+        if (!source.open(path)) return false;
+        std::vector<int16_t> block(kCompressedBlockFrames);
+        for (int64_t b = 0; b < source.blockCount(); ++b) {
+            int32_t n = source.decodeBlock(b, block.data());
+            if (n != source.blockFrames(b)) return false;
+            builder.append(block.data(), static_cast<size_t>(n));
+        }
+        return builder.write(sidecarPath(path), sourceBytes, source.sampleRate());
+    }
+
+    WavTrackSource source;
+    if (!source.open(path) || source.channelCount() != kChannelCount) return false;
+    builder.append(source.pcmData(), static_cast<size_t>(source.totalFrames()));
+    return builder.write(sidecarPath(path), sourceBytes, source.sampleRate());
+}
+
+int64_t PeakCacheReader::totalFrames() const {
+    return mapped_ ? header(mapped_)->totalFrames : 0;
+}
+
+bool PeakCacheReader::readBars(int64_t startFrame, int64_t endFrame, int32_t bars,
+                               float* out) const {
+    if (!mapped_ || bars <= 0 || !out) return false;
+
+    int64_t total = totalFrames();
+    if (endFrame < 0 || endFrame > total) endFrame = total;
+    startFrame = std::clamp<int64_t>(startFrame, 0, endFrame);
+    if (endFrame <= startFrame) {
+        std::fill(out, out + bars, 0.0f);
+        return true;
+    }
+
+    // Coarsest level that still has a few peaks per bar. Peaks straddling
+    // a bar edge count towards both bars, so this keeps the bleed between
+    // neighbouring bars to a fraction of a bar.
+    double framesPerBar = static_cast<double>(endFrame - startFrame) / bars;
+    int32_t pick = 0;
+    for (int32_t l = 1; l < kPeakLevelCount; ++l) {
+        if (static_cast<double>(levels(mapped_)[l].framesPerPeak) * kPeakLevelFactor <=
+            framesPerBar) {
+            pick = l;
+        }
+    }
+    const PeakLevelHeader& lh = levels(mapped_)[pick];
+    const auto* peaks = reinterpret_cast<const PeakPair*>(
+        static_cast<const uint8_t*>(mapped_) + lh.offset);
+    if (lh.count == 0) {
+        std::fill(out, out + bars, 0.0f);
+        return true;
+    }
+
+    for (int32_t b = 0; b < bars; ++b) {
+        auto fs = startFrame + static_cast<int64_t>(b * framesPerBar);
+        auto fe = startFrame + static_cast<int64_t>((b + 1) * framesPerBar);
+        int64_t first = std::min<int64_t>(fs / lh.framesPerPeak, lh.count - 1);
+        int64_t last = std::clamp<int64_t>((fe + lh.framesPerPeak - 1) / lh.framesPerPeak,
+                                           first + 1, lh.count);
+        int32_t peak = 0;
+        for (int64_t i = first; i < last; ++i) {
+            peak = std::max({peak, std::abs(static_cast<int32_t>(peaks[i].min)),
+                             std::abs(static_cast<int32_t>(peaks[i].max))});
+        }
+        out[b] = static_cast<float>(peak) / 32768.0f;
+    }
+    return true;
+}
+
+}  // namespace nightjar
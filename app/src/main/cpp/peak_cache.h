@@ -0,0 +1,112 @@
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nightjar {
+
+// Pyramid levels, in samples per peak. Each level is 4x coarser than the
+// one below, so any requested bar width is served by reading at most a
+// handful of entries per bar from the best-fitting level.
+static constexpr int32_t kPeakLevelCount = 5;
+static constexpr int32_t kPeakBaseFrames = 256;
+static constexpr int32_t kPeakLevelFactor = 4;
+
+/** Min/max of one block of 16-bit samples. */
+struct PeakPair {
+    int16_t min;
+    int16_t max;
+};
+
+/**
+ * Accumulates a min/max peak pyramid from a stream of 16-bit mono samples
+ * and writes it to a sidecar file next to the take (`<take>.peaks`).
+ *
+ * Only the finest level is built while appending; the coarser levels are
+ * derived from it when the file is written. Not thread-safe: owned by
+ * whichever thread feeds it (the WavWriter consumer thread during
+ * recording).
+ */
+class PeakCacheBuilder {
+public:
+    PeakCacheBuilder() = default;
+
+    /** Forget everything appended so far. */
+    void reset();
+
+    /** Fold [count] samples into the pyramid. */
+    void append(const int16_t* samples, size_t count);
+
+    /** Samples appended since the last reset(). */
+    int64_t totalFrames() const { return totalFrames_; }
+
+    /**
+     * Write the pyramid to [peaksPath] (via a temp file + rename, so
+     * readers never see a partial file). [sourceBytes] is the size of
+     * the take it describes; readers use it to detect a stale sidecar.
+     */
+    bool write(const std::string& peaksPath, int64_t sourceBytes, int32_t sampleRate);
+
+private:
+    std::vector<PeakPair> base_;
+    int64_t totalFrames_ = 0;
+    int32_t blockFill_ = 0;
+    PeakPair block_{0, 0};
+};
+
+/**
+ * Read-only view of a `.peaks` sidecar, memory-mapped.
+ *
+ * readBars() picks the coarsest level that still resolves one bar, so
+ * the cost is proportional to the number of bars, not the audio length.
+ */
+class PeakCacheReader {
+public:
+    PeakCacheReader() = default;
+    ~PeakCacheReader();
+
+    PeakCacheReader(const PeakCacheReader&) = delete;
+    PeakCacheReader& operator=(const PeakCacheReader&) = delete;
+
+    /**
+     * Map the sidecar for the take at [path] (WAV or `.njca`), building
+     * it from the audio first if it is missing or was written for a
+     * different version of the file. Returns false if neither works
+     * (e.g. [path] is not a 16-bit mono take).
+     */
+    bool openForTake(const std::string& path);
+
+    void close();
+
+    int64_t totalFrames() const;
+
+    /**
+     * Fill [out] with [bars] absolute peaks (0..1, not normalised) for
+     * the frame range [startFrame, endFrame). An [endFrame] < 0 means the
+     * end of the file.
+     */
+    bool readBars(int64_t startFrame, int64_t endFrame, int32_t bars, float* out) const;
+
+    /** Sidecar path for the take at [path]. */
+    static std::string sidecarPath(const std::string& path);
+
+    /**
+     * Give [toTake] a copy of [fromTake]'s sidecar, where both hold the
+     * same PCM (a WAV and its compacted `.njca`), so the waveform isn't
+     * rebuilt from the audio. False if [fromTake] has no current sidecar.
+     */
+    static bool adoptSidecar(const std::string& fromTake, const std::string& toTake);
+
+private:
+    bool mapSidecar(const std::string& peaksPath, int64_t expectedSourceBytes);
+
+    /** Build and write the sidecar from the take's PCM data. */
+    static bool generate(const std::string& path, int64_t sourceBytes);
+
+    void* mapped_ = nullptr;
+    size_t mappedSize_ = 0;
+};
+
+}  // namespace nightjar
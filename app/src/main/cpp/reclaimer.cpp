@@ -0,0 +1,110 @@
+#include "reclaimer.h"
+#include "common.h"
+#include <chrono>
+
+namespace nightjar {
+
+// How often pending snapshots are re-checked while a reader still holds
+// one. A callback holds its snapshot for at most one burst, so a couple
+// of passes is normally enough.
+static constexpr auto kReclaimInterval = std::chrono::milliseconds(20);
+
+Reclaimer::Reclaimer() {
+    thread_ = std::thread(&Reclaimer::threadLoop, this);
+}
+
+Reclaimer::~Reclaimer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopRequested_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    // Every publisher has drained by now; free whatever is left.
+    for (const auto& r : retired_) {
+        r.deleter(r.ptr);
+    }
+    retired_.clear();
+}
+
+void Reclaimer::retire(const void* ptr, Deleter deleter, const HazardSlots* hazards) {
+    if (!ptr) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_.push_back({ptr, deleter, hazards});
+    }
+    cv_.notify_one();
+}
+
+void Reclaimer::drain(const HazardSlots* hazards) {
+    std::vector<Retired> mine;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // A pass reads the hazard slots of the entries it took; once it
+        // is done, whatever it left is back in retired_
+        passDone_.wait(lock, [this] { return !passRunning_; });
+        auto it = retired_.begin();
+        while (it != retired_.end()) {
+            if (it->hazards == hazards) {
+                mine.push_back(*it);
+                it = retired_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const auto& r : mine) {
+        r.deleter(r.ptr);
+    }
+}
+
+void Reclaimer::threadLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopRequested_) {
+        if (retired_.empty()) {
+            cv_.wait(lock, [this] { return stopRequested_ || !retired_.empty(); });
+            continue;
+        }
+
+        lock.unlock();
+        reclaimPass();
+        lock.lock();
+
+        // Back off before re-checking anything a reader still holds.
+        if (!retired_.empty() && !stopRequested_) {
+            cv_.wait_for(lock, kReclaimInterval);
+        }
+    }
+}
+
+void Reclaimer::reclaimPass() {
+    std::vector<Retired> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.swap(retired_);
+        passRunning_ = true;
+    }
+
+    // Run deleters without holding the lock so a slow free (munmap of a
+    // large take) never stalls a writer calling retire().
+    std::vector<Retired> stillHeld;
+    for (const auto& r : pending) {
+        if (r.hazards->protects(r.ptr)) {
+            stillHeld.push_back(r);
+        } else {
+            r.deleter(r.ptr);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_.insert(retired_.end(), stillHeld.begin(), stillHeld.end());
+        passRunning_ = false;
+    }
+    passDone_.notify_all();
+}
+
+}  // namespace nightjar
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nightjar {
+
+/**
+ * Per-publisher hazard slots. Each real-time reader owns one slot and
+ * stores the snapshot pointer it is reading; the reclaimer never frees
+ * a pointer that appears in any slot.
+ */
+struct HazardSlots {
+    static constexpr int kMaxReaders = 4;
+
+    std::atomic<const void*> slots[kMaxReaders] = {};
+
+    bool protects(const void* ptr) const {
+        for (const auto& slot : slots) {
+            if (slot.load(std::memory_order_seq_cst) == ptr) return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * Background thread that frees retired snapshots once no reader still
+ * announces them.
+ *
+ * Writers (UI thread) hand over the snapshot they just replaced; the
+ * reclaimer periodically scans the hazard slots and runs the deleter
+ * for anything no longer in use. Freeing -- including the last
+ * shared_ptr<WavTrackSource> reference and its munmap -- therefore
+ * always happens here, never on the audio callback, and writers never
+ * wait for a reader to finish.
+ */
+class Reclaimer {
+public:
+    using Deleter = void (*)(const void*);
+
+    Reclaimer();
+    ~Reclaimer();
+
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+
+    /** Queue [ptr] for deletion once [hazards] no longer protect it. */
+    void retire(const void* ptr, Deleter deleter, const HazardSlots* hazards);
+
+    /**
+     * Synchronously free everything retired against [hazards]. The
+     * caller guarantees the publisher's readers have stopped (used when
+     * a publisher is destroyed). Waits for a running reclaim pass first,
+     * which may hold [hazards]'s entries; so [hazards] can be freed once
+     * this returns. Never call it from a deleter.
+     */
+    void drain(const HazardSlots* hazards);
+
+private:
+    struct Retired {
+        const void* ptr;
+        Deleter deleter;
+        const HazardSlots* hazards;
+    };
+
+    void threadLoop();
+
+    /** Free every retired entry that is no longer protected. */
+    void reclaimPass();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable passDone_;  // signalled when passRunning_ clears
+    std::vector<Retired> retired_;  // guarded by mutex_
+    bool passRunning_ = false;      // guarded by mutex_: entries are out of retired_
+    bool stopRequested_ = false;    // guarded by mutex_
+    std::thread thread_;
+};
+
+}  // namespace nightjar
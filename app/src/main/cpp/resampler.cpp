@@ -0,0 +1,236 @@
+#include "resampler.h"
+#include "compressed_audio.h"
+#include "wav_track_source.h"
+#include "wav_writer.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <numeric>
+#include <thread>
+#include <unistd.h>
+
+namespace nightjar {
+
+// Kaiser window shape: ~80dB stopband with kResamplerTaps taps.
+static constexpr double kKaiserBeta = 8.0;
+// Passband edge as a fraction of the (lower) Nyquist frequency; the
+// transition band sits between this and Nyquist.
+static constexpr double kCutoff = 0.92;
+// Output frames converted per write.
+static constexpr int32_t kResampleChunkFrames = 8192;
+
+/** Modified Bessel function of the first kind, order 0 (series). */
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+PolyphaseResampler::PolyphaseResampler(int32_t fromRate, int32_t toRate) {
+    if (fromRate <= 0 || toRate <= 0) {
+        LOGE("PolyphaseResampler: invalid rates %d -> %d", fromRate, toRate);
+        fromRate = toRate = 1;
+    }
+    int64_t g = std::gcd<int64_t>(fromRate, toRate);
+    up_ = toRate / g;
+    down_ = fromRate / g;
+    phases_ = static_cast<int32_t>(std::min<int64_t>(up_, kResamplerMaxPhases));
+
+    // Cutoff relative to the input rate: the lower of the two Nyquists.
+    double fc = kCutoff * std::min(1.0, static_cast<double>(up_) / static_cast<double>(down_));
+    constexpr int32_t half = kResamplerTaps / 2;
+    double i0Beta = besselI0(kKaiserBeta);
+
+    table_.assign(static_cast<size_t>(phases_) * kResamplerTaps, 0.0f);
+    for (int32_t p = 0; p < phases_; ++p) {
+        double frac = static_cast<double>(p) / static_cast<double>(phases_);
+        float* row = table_.data() + static_cast<size_t>(p) * kResamplerTaps;
+        double sum = 0.0;
+        for (int32_t k = 0; k < kResamplerTaps; ++k) {
+            // Tap k multiplies input (i - half + 1 + k); t is its distance
+            // from the output point at i + frac.
+            double t = static_cast<double>(k - half + 1) - frac;
+            double x = M_PI * fc * t;
+            double sinc = (t == 0.0) ? 1.0 : std::sin(x) / x;
+            double w = t / half;
+            double window = (std::fabs(w) >= 1.0)
+                ? 0.0 : besselI0(kKaiserBeta * std::sqrt(1.0 - w * w)) / i0Beta;
+            double h = fc * sinc * window;
+            row[k] = static_cast<float>(h);
+            sum += h;
+        }
+        // Unity gain at DC for every phase, so no phase ripples the level.
+        for (int32_t k = 0; k < kResamplerTaps; ++k) {
+            row[k] = static_cast<float>(row[k] / sum);
+        }
+    }
+}
+
+int64_t PolyphaseResampler::outputFrames(int64_t inputFrames) const {
+    if (inputFrames <= 0) return 0;
+    return (inputFrames * up_ + down_ - 1) / down_;
+}
+
+void PolyphaseResampler::inputSpan(int64_t firstOutput, int32_t count,
+                                   int64_t& first, int64_t& end) const {
+    constexpr int32_t half = kResamplerTaps / 2;
+    int64_t last = firstOutput + std::max<int32_t>(count, 1) - 1;
+    first = firstOutput * down_ / up_ - half + 1;
+    end = last * down_ / up_ - half + 1 + kResamplerTaps;
+}
+
+void PolyphaseResampler::process(const int16_t* input, int64_t inputStart, int64_t inputFrames,
+                                 int64_t firstOutput, int32_t count, int16_t* output) const {
+    constexpr int32_t half = kResamplerTaps / 2;
+    for (int32_t n = 0; n < count; ++n) {
+        int64_t num = (firstOutput + n) * down_;
+        int64_t i = num / up_;
+        int64_t phase = num % up_;
+        if (phases_ != up_) phase = phase * phases_ / up_;
+        const float* row = table_.data() + static_cast<size_t>(phase) * kResamplerTaps;
+
+        int64_t first = i - half + 1 - inputStart;
+        float acc = 0.0f;
+        if (first >= 0 && first + kResamplerTaps <= inputFrames) {
+            const int16_t* x = input + first;
+            for (int32_t k = 0; k < kResamplerTaps; ++k) acc += row[k] * x[k];
+        } else {
+            for (int32_t k = 0; k < kResamplerTaps; ++k) {
+                int64_t at = first + k;
+                if (at >= 0 && at < inputFrames) acc += row[k] * input[at];
+            }
+        }
+        float rounded = std::nearbyint(acc);
+        output[n] = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, rounded)));
+    }
+}
+
+std::string resampledPathFor(const std::string& path, int32_t sampleRate) {
+    return path + "." + std::to_string(sampleRate) + "hz.wav";
+}
+
+bool resampleToWavFile(const ResampleInput& input, int64_t frameCount,
+                       int32_t fromRate, int32_t toRate, const std::string& outPath) {
+    PolyphaseResampler resampler(fromRate, toRate);
+    int64_t outFrames = resampler.outputFrames(frameCount);
+
+    std::string tmpPath = outPath + ".tmp" +
+        std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        LOGE("Resampler: failed to create %s", tmpPath.c_str());
+        return false;
+    }
+    writePcmWavHeader(f, toRate, kChannelCount);
+
+    std::vector<int16_t> chunk(kResampleChunkFrames);
+    std::vector<int16_t> window;
+    bool ok = true;
+    for (int64_t done = 0; ok && done < outFrames;) {
+        auto n = static_cast<int32_t>(std::min<int64_t>(kResampleChunkFrames, outFrames - done));
+        // Just the input this chunk's taps reach, clamped to the take
+        int64_t first, end;
+        resampler.inputSpan(done, n, first, end);
+        first = std::max<int64_t>(first, 0);
+        end = std::min(end, frameCount);
+        auto span = static_cast<int32_t>(std::max<int64_t>(end - first, 0));
+        window.resize(static_cast<size_t>(span));
+        ok = span == 0 || input(first, span, window.data());
+        if (!ok) break;
+        resampler.process(window.data(), first, span, done, n, chunk.data());
+        ok = fwrite(chunk.data(), sizeof(int16_t), static_cast<size_t>(n), f) ==
+             static_cast<size_t>(n);
+        done += n;
+    }
+    if (ok) patchPcmWavHeader(f, outFrames * kBytesPerSample);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), outPath.c_str()) != 0) {
+        LOGE("Resampler: failed to write %s", outPath.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    LOGD("Resampler: wrote %s (%lld -> %lld frames, %d -> %d Hz)", outPath.c_str(),
+         (long long)frameCount, (long long)outFrames, fromRate, toRate);
+    return true;
+}
+
+std::string resampledTakeIfCurrent(const std::string& path, int32_t toRate) {
+    std::string outPath = resampledPathFor(path, toRate);
+    struct stat in{}, out{};
+    if (stat(outPath.c_str(), &out) == 0 && stat(path.c_str(), &in) == 0 &&
+        out.st_mtime >= in.st_mtime) {
+        return outPath;
+    }
+    return "";
+}
+
+std::string resampleTakeFile(const std::string& path, int32_t toRate) {
+    std::string outPath = resampledTakeIfCurrent(path, toRate);
+    if (!outPath.empty()) return outPath;
+    outPath = resampledPathFor(path, toRate);
+
+    bool ok;
+    if (CompressedAudioFile::sniff(path)) {
+        CompressedAudioFile file;
+        if (!file.open(path)) return "";
+        // Blocks decoded as the windows reach them; consecutive windows
+        // overlap by the filter length, so the last block is kept.
+        std::vector<int16_t> block(kCompressedBlockFrames);
+        int64_t cached = -1;
+        auto read = [&](int64_t first, int32_t count, int16_t* out) {
+            while (count > 0) {
+                int64_t b = first / kCompressedBlockFrames;
+                if (b != cached) {
+                    // A bad block plays as silence, as in CompressedTrackSource
+                    if (file.decodeBlock(b, block.data()) == 0) {
+                        std::fill(block.begin(), block.end(), static_cast<int16_t>(0));
+                    }
+                    cached = b;
+                }
+                auto at = static_cast<int32_t>(first - b * kCompressedBlockFrames);
+                int32_t n = std::min(count, kCompressedBlockFrames - at);
+                std::copy(block.data() + at, block.data() + at + n, out);
+                first += n;
+                out += n;
+                count -= n;
+            }
+            return true;
+        };
+        ok = resampleToWavFile(read, file.totalFrames(), file.sampleRate(), toRate, outPath);
+    } else {
+        WavTrackSource source;
+        if (!source.open(path) || source.channelCount() != kChannelCount) return "";
+        const int16_t* pcm = source.pcmData();
+        auto read = [pcm](int64_t first, int32_t count, int16_t* out) {
+            std::copy(pcm + first, pcm + first + count, out);
+            return true;
+        };
+        ok = resampleToWavFile(read, source.totalFrames(), source.sampleRate(), toRate, outPath);
+    }
+    return ok ? outPath : "";
+}
+
+bool prepareTakeFile(const std::string& path, int32_t toRate) {
+    int32_t fileRate;
+    if (CompressedAudioFile::sniff(path)) {
+        CompressedAudioFile file;
+        if (!file.open(path)) return false;
+        fileRate = file.sampleRate();
+    } else {
+        WavTrackSource source;
+        if (!source.open(path)) return false;
+        fileRate = source.sampleRate();
+    }
+    if (fileRate == toRate) return true;
+    LOGD("Resampler: preparing %s (%d Hz) for %d Hz", path.c_str(), fileRate, toRate);
+    return !resampleTakeFile(path, toRate).empty();
+}
+
+}  // namespace nightjar
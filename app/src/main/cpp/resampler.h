@@ -0,0 +1,111 @@
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace nightjar {
+
+// Filter taps per output sample (half on each side of the input point).
+static constexpr int32_t kResamplerTaps = 32;
+// Most filter phases held in the table. Ratios that need more (rare,
+// odd rates) use the nearest tabulated phase.
+static constexpr int32_t kResamplerMaxPhases = 1024;
+
+/**
+ * Windowed-sinc polyphase resampler for 16-bit mono audio, used to
+ * convert whole takes between a file's rate and the engine rate.
+ *
+ * The ratio is reduced to L/M (44.1k -> 48k is 160/147); output sample n
+ * falls at input position n*M/L, and its fractional phase selects one
+ * row of a precomputed Kaiser-windowed sinc table. Downsampling moves
+ * the cutoff below the new Nyquist frequency.
+ *
+ * Meant for conversion at load time, not for the audio callback.
+ */
+class PolyphaseResampler {
+public:
+    PolyphaseResampler(int32_t fromRate, int32_t toRate);
+
+    /** Output frames produced for [inputFrames] input frames. */
+    int64_t outputFrames(int64_t inputFrames) const;
+
+    /**
+     * Produce output frames [firstOutput, firstOutput + count) of the
+     * conversion of [input] ([inputFrames] long) into [output]. Input
+     * beyond either end reads as silence.
+     */
+    void process(const int16_t* input, int64_t inputFrames,
+                 int64_t firstOutput, int32_t count, int16_t* output) const {
+        process(input, 0, inputFrames, firstOutput, count, output);
+    }
+
+    /**
+     * As above, with [input] holding only input frames [inputStart,
+     * inputStart + inputFrames); everything else reads as silence. Given
+     * the inputSpan() of the output range (clamped to the take), the
+     * result is the same as converting the whole take at once.
+     */
+    void process(const int16_t* input, int64_t inputStart, int64_t inputFrames,
+                 int64_t firstOutput, int32_t count, int16_t* output) const;
+
+    /**
+     * Input frames [first, end) that output frames [firstOutput,
+     * firstOutput + count) read. May reach past either end of the take.
+     */
+    void inputSpan(int64_t firstOutput, int32_t count, int64_t& first, int64_t& end) const;
+
+private:
+    int64_t up_ = 1;       // L
+    int64_t down_ = 1;     // M
+    int32_t phases_ = 1;   // rows in table_
+    std::vector<float> table_;   // phases_ x kResamplerTaps
+};
+
+/**
+ * Resampled copy of [path] at [sampleRate], kept next to it
+ * (`take.wav.48000hz.wav`). Delete it together with the take.
+ */
+std::string resampledPathFor(const std::string& path, int32_t sampleRate);
+
+/**
+ * Source of the samples to resample: fills [out] with [count] input
+ * frames starting at [first] (always within the take). False on a read
+ * error.
+ */
+using ResampleInput = std::function<bool(int64_t first, int32_t count, int16_t* out)>;
+
+/**
+ * Resample [frameCount] samples read from [input] from [fromRate] to
+ * [toRate] and write them as a WAV at [outPath] (via a temp file +
+ * rename). The input is read a chunk at a time, so the take never has
+ * to be in memory whole. Returns true on success.
+ */
+bool resampleToWavFile(const ResampleInput& input, int64_t frameCount,
+                       int32_t fromRate, int32_t toRate, const std::string& outPath);
+
+/**
+ * resampledPathFor(path, toRate) if that copy exists and is newer than
+ * the take at [path], else "". Only checks the file times.
+ */
+std::string resampledTakeIfCurrent(const std::string& path, int32_t toRate);
+
+/**
+ * Resample the take at [path] (WAV or `.njca`) to [toRate] as a WAV at
+ * resampledPathFor(path, toRate), unless that file is already newer
+ * than the take. Returns the resampled path, or "" on failure.
+ */
+std::string resampleTakeFile(const std::string& path, int32_t toRate);
+
+/**
+ * Get the take at [path] ready to be opened at [toRate]: nothing to do
+ * if it is at that rate already, else its resampled copy is made (or
+ * found current). Slow for a take that needs converting, so never call
+ * it where the caller can't wait; the mixer only opens copies this made.
+ * Returns false if the take can't be read or converted.
+ */
+bool prepareTakeFile(const std::string& path, int32_t toRate);
+
+}  // namespace nightjar
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "reclaimer.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace nightjar {
+
+/**
+ * RCU-style publication of an immutable snapshot of type T.
+ *
+ * Writers (serialized by the owning class, usually its editMutex_)
+ * build a complete new T, then publish() it; the replaced snapshot is
+ * handed to the Reclaimer and freed on its thread once no reader
+ * announces it. Writers never modify a snapshot a reader can see, and
+ * never block on or free memory for a reader.
+ *
+ * Real-time readers take a ReadGuard with their own reader slot
+ * (0 .. HazardSlots::kMaxReaders - 1). acquire/release are a few
+ * atomic operations: no locks, no allocation. Each reader may hold at
+ * most one guard per publisher at a time.
+ *
+ * A writer can also stage() a snapshot instead of publishing it; it
+ * becomes current when the reader side calls commitStaged(), so the
+ * swap lands at a point the reader picks (the render thread's command
+ * drain). The snapshot a commit replaces is retired by the writer's
+ * next stage() or publish().
+ */
+template <typename T>
+class SnapshotPublisher {
+public:
+    explicit SnapshotPublisher(Reclaimer& reclaimer)
+        : reclaimer_(reclaimer), current_(new T()) {}
+
+    ~SnapshotPublisher() {
+        // Readers are stopped by the time a publisher is destroyed.
+        settle();
+        reclaimer_.drain(&hazards_);
+        delete current_.load(std::memory_order_acquire);
+    }
+
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    /**
+     * Announce and return the current snapshot for [reader]. Retries
+     * until the announced pointer is still current, so the reclaimer
+     * is guaranteed to see the announcement before it could free it.
+     */
+    const T* acquire(int reader) const {
+        auto& slot = hazards_.slots[reader];
+        const T* snap = current_.load(std::memory_order_acquire);
+        for (;;) {
+            slot.store(snap, std::memory_order_seq_cst);
+            const T* again = current_.load(std::memory_order_seq_cst);
+            if (again == snap) return snap;
+            snap = again;
+        }
+    }
+
+    /** Stop announcing the snapshot held by [reader]. */
+    void release(int reader) const {
+        hazards_.slots[reader].store(nullptr, std::memory_order_release);
+    }
+
+    /**
+     * The current snapshot, for the writer side only: the staged one if
+     * there is one, so the next edit builds on it. Safe to read without
+     * a guard because only writers retire snapshots and the caller
+     * serializes them.
+     */
+    const T* current() const {
+        return staged_ ? staged_ : current_.load(std::memory_order_acquire);
+    }
+
+    /** Make [next] current and retire the previous snapshot. */
+    void publish(std::unique_ptr<T> next) {
+        settle();
+        const T* old = current_.exchange(next.release(), std::memory_order_seq_cst);
+        reclaimer_.retire(old, &destroy, &hazards_);
+    }
+
+    /**
+     * Hand [next] to the reader side, which makes it current on its
+     * next commitStaged(). Replaces a staged snapshot not yet committed.
+     */
+    void stage(std::unique_ptr<T> next) {
+        settle();
+        replaced_ = current_.load(std::memory_order_acquire);
+        staged_ = next.release();
+        handoff_.store(staged_, std::memory_order_release);
+    }
+
+    /**
+     * Reader side: make the staged snapshot current, if there is one.
+     * A few atomic operations; the writer retires what it replaced.
+     */
+    void commitStaged() {
+        const T* next = handoff_.load(std::memory_order_acquire);
+        if (!next || !handoff_.compare_exchange_strong(next, nullptr,
+                                                        std::memory_order_acq_rel)) {
+            return;
+        }
+        current_.store(next, std::memory_order_seq_cst);
+    }
+
+    /** RAII reader: acquire on construction, release on destruction. */
+    class ReadGuard {
+    public:
+        ReadGuard(const SnapshotPublisher& publisher, int reader)
+            : publisher_(publisher), reader_(reader), snap_(publisher.acquire(reader)) {}
+        ~ReadGuard() { publisher_.release(reader_); }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const T* get() const { return snap_; }
+        const T* operator->() const { return snap_; }
+        const T& operator*() const { return *snap_; }
+
+    private:
+        const SnapshotPublisher& publisher_;
+        int reader_;
+        const T* snap_;
+    };
+
+private:
+    static void destroy(const void* ptr) {
+        delete static_cast<const T*>(ptr);
+    }
+
+    /**
+     * Writer side: finish the last stage(). Either the reader committed
+     * it, and the snapshot it replaced is retired, or it is taken back
+     * and freed (no reader ever saw it).
+     */
+    void settle() {
+        if (!staged_) return;
+        const T* pending = handoff_.exchange(nullptr, std::memory_order_acq_rel);
+        if (pending) {
+            delete pending;
+        } else {
+            // The reader took it; wait out the store that makes it current
+            while (current_.load(std::memory_order_acquire) != staged_) {
+                std::this_thread::yield();
+            }
+            reclaimer_.retire(replaced_, &destroy, &hazards_);
+        }
+        staged_ = nullptr;
+        replaced_ = nullptr;
+    }
+
+    Reclaimer& reclaimer_;
+    std::atomic<const T*> current_;
+    mutable HazardSlots hazards_;
+
+    // stage() / commitStaged() handoff
+    std::atomic<const T*> handoff_{nullptr};
+    const T* staged_ = nullptr;    // writer only: last stage() not yet settled
+    const T* replaced_ = nullptr;  // writer only: current_ when staged_ was staged
+};
+
+}  // namespace nightjar
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "common.h"
 #include <atomic>
 #include <cstddef>
 #include <cstring>
@@ -15,32 +16,87 @@ namespace nightjar {
  *
  * Operates on float samples. Capacity must be a power of 2.
  * No allocations, no mutexes, no syscalls — safe for real-time use.
+ *
+ * Besides the copying write()/read(), either side can work on ring
+ * memory in place: reserveWrite()/commitWrite() hand the producer the
+ * free space to fill directly, peekRead()/consumeRead() hand the
+ * consumer the queued samples. A region may wrap past the end of the
+ * buffer, so it comes as up to two spans. Each index sits on its own
+ * cache line next to the owning side's cached copy of the other index,
+ * so the two cores only share a line when one side actually runs out.
  */
 template<size_t N>
 class SpscRingBuffer {
     static_assert((N & (N - 1)) == 0, "N must be a power of 2");
 
 public:
-    SpscRingBuffer() : writePos_(0), readPos_(0) {
+    /** A run of contiguous samples inside the ring. */
+    template <typename T>
+    struct Span {
+        T* data = nullptr;
+        size_t size = 0;
+    };
+
+    /** A region of the ring: [first] then, after the wrap, [second]. */
+    template <typename T>
+    struct Region {
+        Span<T> first;
+        Span<T> second;
+        size_t size() const { return first.size + second.size; }
+    };
+
+    SpscRingBuffer() {
         std::memset(buffer_, 0, sizeof(buffer_));
     }
 
+    /**
+     * Producer: up to [count] samples of free space, first to last. Fill
+     * them in place, then publish with commitWrite().
+     */
+    Region<float> reserveWrite(size_t count) {
+        size_t w = writePos_.load(std::memory_order_relaxed);
+        if (N - (w - cachedReadPos_) < count) {
+            cachedReadPos_ = readPos_.load(std::memory_order_acquire);
+        }
+        return region(buffer_, w, std::min(count, N - (w - cachedReadPos_)));
+    }
+
+    /** Producer: publish the first [count] samples of the last reservation. */
+    void commitWrite(size_t count) {
+        writePos_.store(writePos_.load(std::memory_order_relaxed) + count,
+                        std::memory_order_release);
+    }
+
+    /**
+     * Consumer: up to [count] queued samples, oldest first, left queued.
+     * Release them with consumeRead() once done with them.
+     */
+    Region<const float> peekRead(size_t count) {
+        size_t r = readPos_.load(std::memory_order_relaxed);
+        if (cachedWritePos_ - r < count) {
+            cachedWritePos_ = writePos_.load(std::memory_order_acquire);
+        }
+        return region(static_cast<const float*>(buffer_), r,
+                      std::min(count, cachedWritePos_ - r));
+    }
+
+    /** Consumer: drop [count] samples from the front, e.g. after peekRead(). */
+    void consumeRead(size_t count) {
+        readPos_.store(readPos_.load(std::memory_order_relaxed) + count,
+                       std::memory_order_release);
+    }
+
     /**
      * Producer: write samples into the ring buffer.
      * Returns the number of samples actually written (may be less than
      * count if the buffer is nearly full).
      */
     size_t write(const float* data, size_t count) {
-        size_t w = writePos_.load(std::memory_order_relaxed);
-        size_t r = readPos_.load(std::memory_order_acquire);
-        size_t available = N - (w - r);
-        size_t toWrite = std::min(count, available);
-
-        for (size_t i = 0; i < toWrite; ++i) {
-            buffer_[(w + i) & (N - 1)] = data[i];
-        }
-        writePos_.store(w + toWrite, std::memory_order_release);
-        return toWrite;
+        Region<float> free = reserveWrite(count);
+        std::memcpy(free.first.data, data, free.first.size * sizeof(float));
+        std::memcpy(free.second.data, data + free.first.size, free.second.size * sizeof(float));
+        commitWrite(free.size());
+        return free.size();
     }
 
     /**
@@ -49,16 +105,12 @@ public:
      * count if the buffer doesn't have enough data).
      */
     size_t read(float* data, size_t count) {
-        size_t r = readPos_.load(std::memory_order_relaxed);
-        size_t w = writePos_.load(std::memory_order_acquire);
-        size_t available = w - r;
-        size_t toRead = std::min(count, available);
-
-        for (size_t i = 0; i < toRead; ++i) {
-            data[i] = buffer_[(r + i) & (N - 1)];
-        }
-        readPos_.store(r + toRead, std::memory_order_release);
-        return toRead;
+        Region<const float> queued = peekRead(count);
+        std::memcpy(data, queued.first.data, queued.first.size * sizeof(float));
+        std::memcpy(data + queued.first.size, queued.second.data,
+                    queued.second.size * sizeof(float));
+        consumeRead(queued.size());
+        return queued.size();
     }
 
     /** Number of samples available for reading. */
@@ -71,12 +123,30 @@ public:
     void reset() {
         writePos_.store(0, std::memory_order_relaxed);
         readPos_.store(0, std::memory_order_relaxed);
+        cachedReadPos_ = 0;
+        cachedWritePos_ = 0;
     }
 
 private:
+    template <typename T>
+    static Region<T> region(T* base, size_t pos, size_t count) {
+        size_t start = pos & (N - 1);
+        size_t first = std::min(count, N - start);
+        Region<T> out;
+        out.first = {base + start, first};
+        out.second = {base, count - first};
+        return out;
+    }
+
     float buffer_[N];
-    std::atomic<size_t> writePos_;
-    std::atomic<size_t> readPos_;
+
+    // Producer line: its index and its last view of the consumer's
+    alignas(kCacheLine) std::atomic<size_t> writePos_{0};
+    size_t cachedReadPos_ = 0;
+
+    // Consumer line: its index and its last view of the producer's
+    alignas(kCacheLine) std::atomic<size_t> readPos_{0};
+    size_t cachedWritePos_ = 0;
 };
 
 }  // namespace nightjar
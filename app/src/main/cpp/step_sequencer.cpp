@@ -5,26 +5,111 @@
 
 namespace nightjar {
 
-StepSequencer::StepSequencer() {
+// Step positions come out of a frame -> tick round trip; this keeps a
+// chunk that starts exactly on a step from reading as the step before.
+static constexpr double kStepEpsilon = 1.0e-9;
+
+StepSequencer::StepSequencer(Reclaimer& reclaimer) : pattern_(reclaimer) {
     pendingEvents_.reserve(16);
 }
 
-void StepSequencer::updatePattern(float volume, bool muted,
-                                   const std::vector<ClipSlot>& clips) {
+StepSequencer::CompiledPattern StepSequencer::compile(const PatternData& data, float volume) {
+    CompiledPattern out;
+    int beatsPerBar = data.beatsPerBar > 0 ? data.beatsPerBar : 4;
+    out.totalSteps = std::max(0, data.totalSteps);
+    out.stepsPerBeat = data.stepsPerBar / static_cast<double>(beatsPerBar);
+    out.stepBegin.assign(out.totalSteps + 1, 0);
+
+    // Counting sort by step, stable so same-step hits keep their order.
+    // Hits beyond totalSteps are preserved in data but silent
+    // (uniform-clip-length), as are hits the volume scales to zero.
+    auto scaled = [volume](const DrumHit& hit) {
+        return std::clamp(static_cast<int>(static_cast<float>(hit.velocity) * volume), 0, 127);
+    };
+    auto sounds = [&](const DrumHit& hit) {
+        return hit.stepIndex >= 0 && hit.stepIndex < out.totalSteps && scaled(hit) > 0;
+    };
+    for (const auto& hit : data.hits) {
+        if (sounds(hit)) ++out.stepBegin[hit.stepIndex + 1];
+    }
+    for (int step = 0; step < out.totalSteps; ++step) {
+        out.stepBegin[step + 1] += out.stepBegin[step];
+    }
+    out.hits.resize(out.stepBegin[out.totalSteps]);
+    std::vector<uint32_t> next(out.stepBegin.begin(), out.stepBegin.end() - 1);
+    for (const auto& hit : data.hits) {
+        if (sounds(hit)) out.hits[next[hit.stepIndex]++] = {hit.drumNote, scaled(hit)};
+    }
+    return out;
+}
+
+void StepSequencer::updatePatterns(float volume, bool muted,
+                                   const std::vector<PatternData>& patterns,
+                                   const std::vector<ClipPlacement>& clips) {
+    auto next = compilePatterns(volume, muted, patterns, clips);
+    // Step tracking is resized by tick() on the render thread when it
+    // sees the new clip count.
     std::lock_guard<std::mutex> lock(editMutex_);
-    Pattern* active = activePattern_.load(std::memory_order_acquire);
-    Pattern* inactive = (active == &patternA_) ? &patternB_ : &patternA_;
+    pattern_.publish(std::move(next));
+}
 
-    inactive->volume = volume;
-    inactive->muted = muted;
-    inactive->clips = clips;
+void StepSequencer::stagePatterns(float volume, bool muted,
+                                  const std::vector<PatternData>& patterns,
+                                  const std::vector<ClipPlacement>& clips) {
+    auto next = compilePatterns(volume, muted, patterns, clips);
+    std::lock_guard<std::mutex> lock(editMutex_);
+    pattern_.stage(std::move(next));
+}
 
-    commitToActive();
+std::unique_ptr<StepSequencer::Pattern> StepSequencer::compilePatterns(
+        float volume, bool muted,
+        const std::vector<PatternData>& patterns,
+        const std::vector<ClipPlacement>& clips) {
+    auto next = std::make_unique<Pattern>();
+    next->muted = muted;
+    next->patterns.reserve(patterns.size());
+    for (const auto& data : patterns) {
+        next->patterns.push_back(compile(data, volume));
+        const auto& compiled = next->patterns.back();
+        if (compiled.stepsPerBeat > 0.0) {
+            next->maxLengthBeats = std::max(next->maxLengthBeats,
+                                            compiled.totalSteps / compiled.stepsPerBeat);
+        }
+    }
 
-    // Resize step tracking to match clip count
-    if (lastStepIndices_.size() != clips.size()) {
-        lastStepIndices_.assign(clips.size(), -1);
+    next->clips.reserve(clips.size());
+    for (const auto& clip : clips) {
+        if (clip.pattern < 0 || clip.pattern >= static_cast<int>(patterns.size())) {
+            LOGW("StepSequencer: clip names pattern %d of %zu, dropped",
+                 clip.pattern, patterns.size());
+            continue;
+        }
+        next->clips.push_back({clip.offsetFrames, static_cast<uint32_t>(clip.pattern)});
     }
+    std::stable_sort(next->clips.begin(), next->clips.end(),
+                     [](const Placement& a, const Placement& b) {
+                         return a.offsetFrames < b.offsetFrames;
+                     });
+    return next;
+}
+
+void StepSequencer::updatePattern(float volume, bool muted,
+                                   const std::vector<ClipSlot>& clips) {
+    std::vector<PatternData> patterns;
+    std::vector<ClipPlacement> placements;
+    placements.reserve(clips.size());
+    for (const auto& clip : clips) {
+        auto same = std::find_if(patterns.begin(), patterns.end(), [&](const PatternData& p) {
+            return p.stepsPerBar == clip.stepsPerBar && p.totalSteps == clip.totalSteps &&
+                   p.beatsPerBar == clip.beatsPerBar && p.hits == clip.hits;
+        });
+        if (same == patterns.end()) {
+            patterns.push_back({clip.stepsPerBar, clip.totalSteps, clip.beatsPerBar, clip.hits});
+            same = patterns.end() - 1;
+        }
+        placements.push_back({static_cast<int>(same - patterns.begin()), clip.offsetFrames});
+    }
+    updatePatterns(volume, muted, patterns, placements);
 }
 
 void StepSequencer::updatePattern(int stepsPerBar, int bars, int64_t offsetFrames,
@@ -32,33 +117,22 @@ void StepSequencer::updatePattern(int stepsPerBar, int bars, int64_t offsetFrame
                                    const std::vector<DrumHit>& hits,
                                    const std::vector<int64_t>& clipOffsetFrames,
                                    int beatsPerBar) {
-    // Convert legacy single-pattern call to per-clip format.
-    // Legacy callers pass `bars`; translate to totalSteps here.
-    std::vector<ClipSlot> clips;
-    int bpb = beatsPerBar > 0 ? beatsPerBar : 4;
-    int totalSteps = stepsPerBar * bars;
-
+    // Convert legacy single-pattern call to one pooled pattern placed at
+    // each offset. Legacy callers pass `bars`; translate to totalSteps here.
+    std::vector<PatternData> patterns(1);
+    patterns[0].stepsPerBar = stepsPerBar;
+    patterns[0].totalSteps = stepsPerBar * bars;
+    patterns[0].beatsPerBar = beatsPerBar > 0 ? beatsPerBar : 4;
+    patterns[0].hits = hits;
+
+    std::vector<ClipPlacement> clips;
     if (clipOffsetFrames.empty()) {
-        ClipSlot slot;
-        slot.stepsPerBar = stepsPerBar;
-        slot.totalSteps = totalSteps;
-        slot.beatsPerBar = bpb;
-        slot.offsetFrames = offsetFrames;
-        slot.hits = hits;
-        clips.push_back(std::move(slot));
+        clips.push_back({0, offsetFrames});
     } else {
-        for (int64_t clipOffset : clipOffsetFrames) {
-            ClipSlot slot;
-            slot.stepsPerBar = stepsPerBar;
-            slot.totalSteps = totalSteps;
-            slot.beatsPerBar = bpb;
-            slot.offsetFrames = clipOffset;
-            slot.hits = hits;
-            clips.push_back(std::move(slot));
-        }
+        for (int64_t clipOffset : clipOffsetFrames) clips.push_back({0, clipOffset});
     }
 
-    updatePattern(volume, muted, clips);
+    updatePatterns(volume, muted, patterns, clips);
 }
 
 void StepSequencer::reset() {
@@ -67,11 +141,11 @@ void StepSequencer::reset() {
 }
 
 const std::vector<NoteEvent>& StepSequencer::tick(
-        int64_t renderPos, int32_t chunkFrames, double bpm) {
+        int64_t renderPos, int32_t chunkFrames, const TempoMap& tempo, int32_t sampleRate) {
     pendingEvents_.clear();
 
-    Pattern* pat = activePattern_.load(std::memory_order_acquire);
-    if (!pat || pat->muted || pat->clips.empty() || bpm <= 0.0) {
+    SnapshotPublisher<Pattern>::ReadGuard pat(pattern_, kRenderReader);
+    if (pat->muted || pat->clips.empty()) {
         return pendingEvents_;
     }
 
@@ -80,34 +154,45 @@ const std::vector<NoteEvent>& StepSequencer::tick(
         lastStepIndices_.assign(pat->clips.size(), -1);
     }
 
-    // Process each clip independently with its own step tracking
-    for (size_t ci = 0; ci < pat->clips.size(); ++ci) {
-        const auto& clip = pat->clips[ci];
-        int totalSteps = clip.totalSteps;
-        if (totalSteps <= 0 || clip.hits.empty()) continue;
-
-        double stepsPerBeat = clip.stepsPerBar / static_cast<double>(clip.beatsPerBar);
-        double framesPerStep = (static_cast<double>(kSampleRate) * 60.0) / (bpm * stepsPerBeat);
-        double totalPatternFrames = framesPerStep * totalSteps;
+    // Only clips starting within one longest-pattern length (at the
+    // map's slowest tempo) before the chunk can still be sounding; clips
+    // are sorted by offset.
+    const double framesPerBeat = static_cast<double>(sampleRate) * tempo.maxSecondsPerBeat();
+    const auto reach = static_cast<int64_t>(std::ceil(pat->maxLengthBeats * framesPerBeat)) + 1;
+    const auto& clips = pat->clips;
+    auto first = std::lower_bound(clips.begin(), clips.end(), renderPos - reach,
+                                  [](const Placement& p, int64_t pos) {
+                                      return p.offsetFrames < pos;
+                                  });
 
-        if (totalPatternFrames <= 0.0) continue;
+    // Process each clip independently with its own step tracking
+    for (auto it = first; it != clips.end(); ++it) {
+        const Placement& clip = *it;
+        // Clip hasn't started yet (nor has any later one)
+        if (clip.offsetFrames >= renderPos + chunkFrames) break;
 
-        int64_t localPos = renderPos - clip.offsetFrames;
+        const CompiledPattern& pattern = pat->patterns[clip.pattern];
+        int totalSteps = pattern.totalSteps;
+        if (totalSteps <= 0 || pattern.hits.empty() || pattern.stepsPerBeat <= 0.0) continue;
 
-        // Clip hasn't started yet
-        if (localPos + chunkFrames <= 0) continue;
+        const double ticksPerStep = static_cast<double>(kTicksPerBeat) / pattern.stepsPerBeat;
 
         // Clip already finished (one-shot: no looping)
-        if (localPos >= static_cast<int64_t>(totalPatternFrames)) continue;
-
-        // Clamp to clip start
-        if (localPos < 0) localPos = 0;
+        if (renderPos >= tempo.frameAfter(clip.offsetFrames, ticksPerStep * totalSteps,
+                                          sampleRate)) {
+            continue;
+        }
 
-        int currentStep = static_cast<int>(std::floor(
-            static_cast<double>(localPos) / framesPerStep));
-        currentStep = std::min(currentStep, totalSteps - 1);
+        // Clamped to the clip start
+        int currentStep = 0;
+        if (renderPos > clip.offsetFrames) {
+            double localSteps =
+                tempo.ticksBetween(clip.offsetFrames, renderPos, sampleRate) / ticksPerStep;
+            currentStep = std::min(static_cast<int>(std::floor(localSteps + kStepEpsilon)),
+                                   totalSteps - 1);
+        }
 
-        int& lastStep = lastStepIndices_[ci];
+        int& lastStep = lastStepIndices_[it - clips.begin()];
 
         if (currentStep != lastStep) {
             int stepsToProcess;
@@ -131,26 +216,21 @@ const std::vector<NoteEvent>& StepSequencer::tick(
                     if (step >= totalSteps) break;  // one-shot: don't wrap
                 }
 
+                uint32_t begin = pattern.stepBegin[step];
+                uint32_t end = pattern.stepBegin[step + 1];
+                if (begin == end) continue;
+
                 // Exact frame where this step lands on the global timeline
-                auto stepFrame = static_cast<int64_t>(
-                    step * framesPerStep) + clip.offsetFrames;
+                int64_t stepFrame = tempo.frameAfter(clip.offsetFrames, step * ticksPerStep,
+                                                     sampleRate);
                 int32_t offset = static_cast<int32_t>(
                     std::clamp(stepFrame - renderPos,
                                static_cast<int64_t>(0),
                                static_cast<int64_t>(chunkFrames - 1)));
 
-                for (const auto& hit : clip.hits) {
-                    // Honor the clip length ceiling: any hit beyond totalSteps
-                    // is preserved in data but silent (uniform-clip-length).
-                    if (hit.stepIndex >= totalSteps) continue;
-                    if (hit.stepIndex == step) {
-                        int vel = static_cast<int>(
-                            static_cast<float>(hit.velocity) * pat->volume);
-                        vel = std::clamp(vel, 0, 127);
-                        if (vel > 0) {
-                            pendingEvents_.push_back({9, hit.drumNote, vel, offset});
-                        }
-                    }
+                for (uint32_t h = begin; h < end; ++h) {
+                    const StepHit& hit = pattern.hits[h];
+                    pendingEvents_.push_back({9, hit.drumNote, hit.velocity, offset});
                 }
             }
 
@@ -161,30 +241,22 @@ const std::vector<NoteEvent>& StepSequencer::tick(
     return pendingEvents_;
 }
 
-int64_t StepSequencer::getMaxEndFrame(double bpm) const {
-    Pattern* pat = activePattern_.load(std::memory_order_acquire);
-    if (!pat || bpm <= 0.0) return 0;
+int64_t StepSequencer::getMaxEndFrame(const TempoMap& tempo, int32_t sampleRate) const {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    const Pattern* pat = pattern_.current();
 
     int64_t maxEnd = 0;
     for (const auto& clip : pat->clips) {
-        int totalSteps = clip.totalSteps;
-        if (totalSteps <= 0) continue;
-
-        double stepsPerBeat = clip.stepsPerBar / static_cast<double>(clip.beatsPerBar);
-        double framesPerStep = (static_cast<double>(kSampleRate) * 60.0) / (bpm * stepsPerBeat);
-        auto totalPatternFrames = static_cast<int64_t>(framesPerStep * totalSteps);
+        const CompiledPattern& pattern = pat->patterns[clip.pattern];
+        int totalSteps = pattern.totalSteps;
+        if (totalSteps <= 0 || pattern.stepsPerBeat <= 0.0) continue;
 
-        int64_t end = clip.offsetFrames + totalPatternFrames;
+        double ticksPerStep = static_cast<double>(kTicksPerBeat) / pattern.stepsPerBeat;
+        int64_t end = tempo.frameAfter(clip.offsetFrames, ticksPerStep * totalSteps, sampleRate);
         if (end > maxEnd) maxEnd = end;
     }
 
     return maxEnd;
 }
 
-void StepSequencer::commitToActive() {
-    Pattern* current = activePattern_.load(std::memory_order_acquire);
-    Pattern* newActive = (current == &patternA_) ? &patternB_ : &patternA_;
-    activePattern_.store(newActive, std::memory_order_release);
-}
-
 }  // namespace nightjar
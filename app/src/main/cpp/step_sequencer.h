@@ -1,5 +1,7 @@
 #pragma once
 
+#include "snapshot_publisher.h"
+#include "tempo_map.h"
 #include <atomic>
 #include <cstdint>
 #include <mutex>
@@ -12,6 +14,10 @@ struct DrumHit {
     int stepIndex;   // 0-based position in pattern
     int drumNote;    // GM drum note number (e.g. 36 = kick)
     int velocity;    // MIDI velocity 0-127
+
+    bool operator==(const DrumHit& o) const {
+        return stepIndex == o.stepIndex && drumNote == o.drumNote && velocity == o.velocity;
+    }
 };
 
 /** A note event produced by the sequencer for SynthEngine to process. */
@@ -25,20 +31,44 @@ struct NoteEvent {
 /**
  * Step sequencer that plays drum patterns in sync with the timeline.
  *
- * Each clip slot has its own pattern (stepsPerBar, bars, hits) and timeline
- * offset, with independent step tracking so clips play correctly even when
- * overlapping.
+ * Patterns (stepsPerBar, length, hits) live in a shared pool and clips are
+ * placements of a pattern at a timeline offset, so linked clips cost one
+ * pattern however many times they repeat. Each placement has independent
+ * step tracking so clips play correctly even when overlapping.
+ *
+ * On update every pattern is compiled to a per-step hit table (step ->
+ * contiguous span of hits, velocities already scaled by the track volume)
+ * and placements are sorted by offset. tick() binary-searches the
+ * placements that can sound in the chunk and reads only the spans of the
+ * steps it crosses, so its cost follows the hits that fire rather than
+ * clips x hits.
  *
- * Pattern data is double-buffered (same strategy as TrackMixer):
- * UI writes to the inactive buffer under a mutex, then atomically swaps.
- * The render thread reads lock-free from the active buffer.
+ * Pattern data is RCU-published (same strategy as TrackMixer): the UI
+ * builds a new pattern under a mutex and publishes it; the render thread
+ * reads lock-free through a hazard slot, and replaced patterns are freed
+ * on the Reclaimer thread.
  *
  * tick() is called from SynthEngine's render thread between render chunks.
  * It returns a list of NoteEvent to fire into FluidSynth.
  */
 class StepSequencer {
 public:
-    StepSequencer();
+    explicit StepSequencer(Reclaimer& reclaimer);
+
+    /** One pattern's grid and hits, shared by every clip that plays it. */
+    struct PatternData {
+        int stepsPerBar = 16;
+        // Authoritative step count (DrumPatternEntity.lengthSteps).
+        int totalSteps = 16;
+        int beatsPerBar = 4;
+        std::vector<DrumHit> hits;
+    };
+
+    /** A clip: pattern [pattern] of the pool placed at [offsetFrames]. */
+    struct ClipPlacement {
+        int pattern = 0;
+        int64_t offsetFrames = 0;
+    };
 
     /** A single clip with its own pattern data and timeline position. */
     struct ClipSlot {
@@ -52,8 +82,28 @@ public:
     };
 
     /**
-     * Replace the entire pattern with per-clip data. Called from UI thread (JNI).
-     * Mutex-protected, writes to inactive buffer, then swaps.
+     * Replace the pattern pool and clip placements. Called from UI thread
+     * (JNI). Mutex-protected, compiles a new snapshot, then publishes it.
+     * Placements naming a pattern outside [patterns] are dropped.
+     */
+    void updatePatterns(float volume, bool muted,
+                        const std::vector<PatternData>& patterns,
+                        const std::vector<ClipPlacement>& clips);
+
+    /**
+     * Like updatePatterns(), but the snapshot is compiled here and only
+     * swapped in by the render side's next commitStaged().
+     */
+    void stagePatterns(float volume, bool muted,
+                       const std::vector<PatternData>& patterns,
+                       const std::vector<ClipPlacement>& clips);
+
+    /** Make the last stagePatterns() snapshot current. Render side; lock-free. */
+    void commitStaged() { pattern_.commitStaged(); }
+
+    /**
+     * Replace the entire pattern with per-clip data. Clips with identical
+     * pattern data share one pool entry.
      */
     void updatePattern(float volume, bool muted,
                        const std::vector<ClipSlot>& clips);
@@ -71,8 +121,11 @@ public:
     /**
      * Advance the sequencer and return note events for this chunk.
      * Called from the render thread -- lock-free read of active pattern.
+     * Steps are tick lengths, placed from each clip's start through
+     * [tempo] at the engine's [sampleRate].
      */
-    const std::vector<NoteEvent>& tick(int64_t renderPos, int32_t chunkFrames, double bpm);
+    const std::vector<NoteEvent>& tick(int64_t renderPos, int32_t chunkFrames,
+                                       const TempoMap& tempo, int32_t sampleRate);
 
     /** Reset step tracking state. Call on flush (seek/loop). */
     void reset();
@@ -81,24 +134,54 @@ public:
      * Compute the maximum end frame across all clip placements.
      * Used by AudioEngine to determine total timeline length.
      */
-    int64_t getMaxEndFrame(double bpm) const;
+    int64_t getMaxEndFrame(const TempoMap& tempo, int32_t sampleRate) const;
 
 private:
+    /** A hit as fired: velocity already scaled by the track volume. */
+    struct StepHit {
+        int drumNote;
+        int velocity;
+    };
+
+    /** A pattern compiled for playback. */
+    struct CompiledPattern {
+        int totalSteps = 0;
+        double stepsPerBeat = 0.0;
+        // Hits of step s are hits[stepBegin[s] .. stepBegin[s + 1]).
+        std::vector<uint32_t> stepBegin;
+        std::vector<StepHit> hits;
+    };
+
+    struct Placement {
+        int64_t offsetFrames;
+        uint32_t pattern;
+    };
+
     struct Pattern {
-        float volume = 1.0f;
         bool muted = false;
-        std::vector<ClipSlot> clips;
+        std::vector<CompiledPattern> patterns;
+        std::vector<Placement> clips;  // sorted by offsetFrames
+        double maxLengthBeats = 0.0;   // longest pattern, for the tick() window
     };
 
-    Pattern patternA_, patternB_;
-    std::atomic<Pattern*> activePattern_{&patternA_};
-    std::mutex editMutex_;
+    static CompiledPattern compile(const PatternData& data, float volume);
+
+    /** Snapshot of [patterns] placed at [clips]. */
+    static std::unique_ptr<Pattern> compilePatterns(float volume, bool muted,
+                                                    const std::vector<PatternData>& patterns,
+                                                    const std::vector<ClipPlacement>& clips);
 
-    // Per-clip step tracking (indexed by clip slot position)
+    /** Hazard slot of the render side (render thread, or the offline
+     *  renderer while the render thread is stopped). */
+    static constexpr int kRenderReader = 0;
+
+    SnapshotPublisher<Pattern> pattern_;
+    mutable std::mutex editMutex_;  // serializes UI-thread edits and reads
+
+    // Per-clip step tracking (indexed by clip slot position).
+    // Render-thread only.
     std::vector<int> lastStepIndices_;
     std::vector<NoteEvent> pendingEvents_;
-
-    void commitToActive();
 };
 
 }  // namespace nightjar
@@ -0,0 +1,379 @@
+#include "synth_channel_map.h"
+#include "common.h"
+#include <algorithm>
+#include <climits>
+
+namespace nightjar {
+
+// Free channels tracks leave for the preview keyboard and auditions while
+// they can still share.
+static constexpr int kLiveReserveChannels = 2;
+
+SynthChannelMap::SynthChannelMap() {
+    for (auto& slot : slotOf_) slot.store(-1, std::memory_order_relaxed);
+}
+
+void SynthChannelMap::configure(int32_t instances, bool releasePrograms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    instances = std::max(instances, 1);
+    auto count = static_cast<size_t>(instances * kSynthInstanceChannels);
+    releasePrograms_ = releasePrograms;
+
+    logical_.assign(kMaxLogicalChannels, Logical{});
+    slots_.assign(count, Slot{});
+    program_ = std::vector<std::atomic<int>>(count);
+    for (auto& program : program_) program.store(-1, std::memory_order_relaxed);
+    for (auto& slot : slotOf_) slot.store(-1, std::memory_order_relaxed);
+
+    // Channel by channel across the instances, so consecutive bindings
+    // land on different partitions. Every channel 9 of 16 is left out:
+    // FluidSynth sets those up as drum channels.
+    order_.clear();
+    for (int channel = 0; channel < kSynthInstanceChannels; ++channel) {
+        if (channel % 16 == kPercussionChannel) continue;
+        for (int32_t i = 0; i < instances; ++i) {
+            order_.push_back(SynthPartitions::physicalChannel(i, channel));
+        }
+    }
+
+    slotOf_[kPercussionChannel].store(kPercussionChannel, std::memory_order_relaxed);
+    slots_[kPercussionChannel].occupants.push_back(kPercussionChannel);
+    bump();
+}
+
+int SynthChannelMap::programAt(int physical) const {
+    if (physical < 0 || physical >= static_cast<int>(program_.size())) return -1;
+    return program_[physical].load(std::memory_order_acquire);
+}
+
+// ── Tracks ─────────────────────────────────────────────────────────────
+
+void SynthChannelMap::assignTracks(const std::vector<MidiTrackData>& tracks,
+                                   int64_t releaseFrames, std::vector<ChannelChange>& changes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slots_.empty()) return;
+
+    // New track state per logical channel. Two tracks on one channel
+    // (a project from before channels were unbounded) play as one.
+    std::vector<bool> listed(kMaxLogicalChannels, false);
+    std::vector<int> placeOrder;
+    for (const auto& track : tracks) {
+        int channel = track.channel;
+        if (channel < 0 || channel >= kMaxLogicalChannels || channel == kPercussionChannel) {
+            LOGW("SynthChannelMap: track channel %d out of range", channel);
+            continue;
+        }
+        Logical& logical = logical_[channel];
+        std::vector<Span> spans = spansOf(track.clips, releaseFrames);
+        bool sounding = !track.muted && !spans.empty();
+        if (!listed[channel]) {
+            listed[channel] = true;
+            placeOrder.push_back(channel);
+            logical.track = true;
+            logical.program = track.program;
+            logical.spans.clear();
+            logical.muted = true;
+            logical.sounding = false;
+        }
+        logical.spans.insert(logical.spans.end(), spans.begin(), spans.end());
+        logical.muted = logical.muted && track.muted;
+        logical.sounding = logical.sounding || sounding;
+    }
+
+    // Tracks that are gone give their channels back
+    for (int channel = 0; channel < kMaxLogicalChannels; ++channel) {
+        Logical& logical = logical_[channel];
+        if (logical.track && !listed[channel]) {
+            unbind(channel, changes);
+            logical = Logical{};
+        }
+    }
+
+    for (int channel : placeOrder) {
+        std::sort(logical_[channel].spans.begin(), logical_[channel].spans.end(),
+                  [](const Span& a, const Span& b) { return a.start < b.start; });
+        logical_[channel].busy = merged(logical_[channel].spans);
+    }
+
+    // Tracks that stay where they are first, so moving tracks can't take
+    // their channels; then the rest, earliest first, so sharing follows
+    // the timeline.
+    std::vector<int> toPlace;
+    for (int channel : placeOrder) {
+        const Logical& logical = logical_[channel];
+        int slot = slotOf_[channel].load(std::memory_order_relaxed);
+        if (!logical.sounding) {
+            unbind(channel, changes);
+        } else if (slot >= 0 && fits(channel, slot)) {
+            setProgram(slot, logical.program, changes);
+        } else {
+            // Off its channel now, so the tracks after it can stay
+            unbind(channel, changes);
+            toPlace.push_back(channel);
+        }
+    }
+    std::stable_sort(toPlace.begin(), toPlace.end(), [this](int a, int b) {
+        return logical_[a].busy.front().start < logical_[b].busy.front().start;
+    });
+    for (int channel : toPlace) placeTrack(channel, changes);
+
+    if (!changes.empty()) bump();
+}
+
+void SynthChannelMap::assignTrack(const MidiTrackData& track, int64_t releaseFrames,
+                                  std::vector<ChannelChange>& changes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int channel = track.channel;
+    if (slots_.empty() || channel < 0 || channel >= kMaxLogicalChannels ||
+        channel == kPercussionChannel) {
+        return;
+    }
+    Logical& logical = logical_[channel];
+    logical.track = true;
+    logical.program = track.program;
+    logical.spans = spansOf(track.clips, releaseFrames);
+    logical.busy = merged(logical.spans);
+    logical.muted = track.muted;
+    logical.sounding = !track.muted && !logical.spans.empty();
+    if (logical.sounding) {
+        placeTrack(channel, changes);
+    } else {
+        unbind(channel, changes);
+    }
+    if (!changes.empty()) bump();
+}
+
+void SynthChannelMap::assignTrackRange(int channel, int64_t startFrame, int64_t endFrame,
+                                       const std::vector<MidiClipData>& clips,
+                                       int64_t releaseFrames,
+                                       std::vector<ChannelChange>& changes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slots_.empty() || channel < 0 || channel >= kMaxLogicalChannels ||
+        !logical_[channel].track) {
+        return;
+    }
+    // The same rule the sequencer patches the clips by
+    Logical& logical = logical_[channel];
+    auto inRange = [&](int64_t start) { return start >= startFrame && start < endFrame; };
+    logical.spans.erase(std::remove_if(logical.spans.begin(), logical.spans.end(),
+                                       [&](const Span& span) { return inRange(span.start); }),
+                        logical.spans.end());
+    for (const Span& span : spansOf(clips, releaseFrames)) {
+        if (inRange(span.start)) logical.spans.push_back(span);
+    }
+    std::sort(logical.spans.begin(), logical.spans.end(),
+              [](const Span& a, const Span& b) { return a.start < b.start; });
+    logical.busy = merged(logical.spans);
+    logical.sounding = !logical.muted && !logical.spans.empty();
+    if (logical.sounding) {
+        placeTrack(channel, changes);
+    } else {
+        unbind(channel, changes);
+    }
+    if (!changes.empty()) bump();
+}
+
+void SynthChannelMap::placeTrack(int channel, std::vector<ChannelChange>& changes) {
+    const Logical& logical = logical_[channel];
+    int slot = slotOf_[channel].load(std::memory_order_relaxed);
+    if (slot >= 0 && fits(channel, slot)) {
+        setProgram(slot, logical.program, changes);
+        return;
+    }
+    unbind(channel, changes);
+    slot = findSlotForTrack(channel);
+    if (slot < 0) {
+        LOGW("SynthChannelMap: no synth channel left for track channel %d", channel);
+        return;
+    }
+    // Out of free channels, findSlotForTrack() may hand back one taken
+    // by a live binding
+    for (int occupant : std::vector<int>(slots_[slot].occupants)) {
+        if (!logical_[occupant].track) unbind(occupant, changes);
+    }
+    bind(channel, slot, changes);
+}
+
+// ── Live channels ──────────────────────────────────────────────────────
+
+int SynthChannelMap::bindLive(int channel, int program, std::vector<ChannelChange>& changes) {
+    if (channel == kPercussionChannel) return kPercussionChannel;
+    if (channel < 0 || channel >= kMaxLogicalChannels) return -1;
+
+    // Already bound: the lock-free read is enough
+    int slot = slotOf_[channel].load(std::memory_order_acquire);
+    if (slot >= 0 && program < 0) return slot;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slots_.empty()) return -1;
+    Logical& logical = logical_[channel];
+    slot = slotOf_[channel].load(std::memory_order_relaxed);
+    if (slot < 0) {
+        slot = findFreeSlot(/* evictLive */ true);
+        if (slot < 0) {
+            LOGW("SynthChannelMap: no synth channel left for live channel %d", channel);
+            return -1;
+        }
+        for (int occupant : std::vector<int>(slots_[slot].occupants)) unbind(occupant, changes);
+        bind(channel, slot, changes);
+    }
+    logical.lastUse = ++useCounter_;
+    // A track's channel plays the track's program
+    if (program >= 0 && !logical.track) {
+        logical.program = program;
+        setProgram(slot, program, changes);
+    }
+    if (!changes.empty()) bump();
+    return slot;
+}
+
+// ── Allocation ─────────────────────────────────────────────────────────
+
+std::vector<SynthChannelMap::Span> SynthChannelMap::spansOf(
+        const std::vector<MidiClipData>& clips, int64_t releaseFrames) {
+    std::vector<Span> spans;
+    spans.reserve(clips.size());
+    for (const auto& clip : clips) {
+        if (clip.events.empty()) continue;
+        Span span;
+        span.start = clip.offsetFrames;
+        // An unbounded clip may be playing anywhere after its start
+        span.end = clip.lengthFrames > 0
+            ? clip.offsetFrames + clip.lengthFrames + releaseFrames
+            : INT64_MAX;
+        spans.push_back(span);
+    }
+    return spans;
+}
+
+std::vector<SynthChannelMap::Span> SynthChannelMap::merged(const std::vector<Span>& spans) {
+    std::vector<Span> out;
+    for (const Span& span : spans) {
+        if (!out.empty() && span.start < out.back().end) {
+            out.back().end = std::max(out.back().end, span.end);
+        } else {
+            out.push_back(span);
+        }
+    }
+    return out;
+}
+
+bool SynthChannelMap::overlaps(const std::vector<Span>& a, const std::vector<Span>& b) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a[i].end <= b[j].start) {
+            ++i;
+        } else if (b[j].end <= a[i].start) {
+            ++j;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SynthChannelMap::fits(int channel, int slot) const {
+    const Logical& logical = logical_[channel];
+    for (int occupant : slots_[slot].occupants) {
+        if (occupant == channel) continue;
+        const Logical& other = logical_[occupant];
+        if (!other.track || other.program != logical.program) return false;
+        if (overlaps(logical.busy, other.busy)) return false;
+    }
+    return true;
+}
+
+int SynthChannelMap::findSlotForTrack(int channel) const {
+    // A channel of its own while there are free ones, short of the last
+    // kLiveReserveChannels: those go to tracks only when nothing can share
+    int free = 0;
+    for (int candidate : order_) free += slots_[candidate].occupants.empty() ? 1 : 0;
+    int slot = findFreeSlot(/* evictLive */ false);
+    if (free > kLiveReserveChannels) return slot;
+
+    // Then one whose tracks play the same program but never at the same
+    // time as this one
+    int best = -1;
+    for (int candidate : order_) {
+        if (slots_[candidate].occupants.empty() || !fits(channel, candidate)) continue;
+        if (best < 0 || slots_[candidate].occupants.size() < slots_[best].occupants.size()) {
+            best = candidate;
+        }
+    }
+    if (best >= 0) return best;
+
+    // Then a reserved one, or one held by a live binding, which binds
+    // again on next use
+    if (slot >= 0) return slot;
+    slot = findFreeSlot(/* evictLive */ true);
+    if (slot >= 0) return slot;
+
+    // Out of channels: share with the same program regardless of overlap
+    const Logical& logical = logical_[channel];
+    for (int candidate : order_) {
+        bool sameProgram = true;
+        for (int occupant : slots_[candidate].occupants) {
+            sameProgram = sameProgram && logical_[occupant].program == logical.program;
+        }
+        if (!sameProgram) continue;
+        if (best < 0 || slots_[candidate].occupants.size() < slots_[best].occupants.size()) {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+int SynthChannelMap::findFreeSlot(bool evictLive) const {
+    int oldest = -1;
+    uint64_t oldestUse = UINT64_MAX;
+    for (int slot : order_) {
+        const auto& occupants = slots_[slot].occupants;
+        if (occupants.empty()) return slot;
+        if (!evictLive) continue;
+        bool live = std::none_of(occupants.begin(), occupants.end(),
+                                 [this](int occupant) { return logical_[occupant].track; });
+        uint64_t lastUse = logical_[occupants.front()].lastUse;
+        if (live && lastUse < oldestUse) {
+            oldest = slot;
+            oldestUse = lastUse;
+        }
+    }
+    return oldest;
+}
+
+void SynthChannelMap::bind(int channel, int slot, std::vector<ChannelChange>& changes) {
+    slots_[slot].occupants.push_back(channel);
+    slotOf_[channel].store(slot, std::memory_order_release);
+    if (logical_[channel].track) setProgram(slot, logical_[channel].program, changes);
+}
+
+void SynthChannelMap::unbind(int channel, std::vector<ChannelChange>& changes) {
+    int slot = slotOf_[channel].load(std::memory_order_relaxed);
+    if (slot < 0 || slot == kPercussionChannel) return;
+    auto& occupants = slots_[slot].occupants;
+    occupants.erase(std::remove(occupants.begin(), occupants.end(), channel), occupants.end());
+    slotOf_[channel].store(-1, std::memory_order_release);
+
+    // Its notes would otherwise hang: their note-offs now go elsewhere
+    ChannelChange change;
+    change.physical = slot;
+    change.vacated = true;
+    changes.push_back(change);
+    if (occupants.empty() && releasePrograms_) setProgram(slot, 0, changes);
+}
+
+void SynthChannelMap::setProgram(int slot, int program, std::vector<ChannelChange>& changes) {
+    if (program_[slot].load(std::memory_order_relaxed) == program) return;
+    program_[slot].store(program, std::memory_order_release);
+    ChannelChange change;
+    change.physical = slot;
+    change.program = program;
+    changes.push_back(change);
+}
+
+void SynthChannelMap::bump() {
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+}  // namespace nightjar
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "midi_sequencer.h"   // MidiTrackData, kMaxLogicalChannels
+#include "synth_partitions.h"  // kSynthInstanceChannels
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace nightjar {
+
+// GM percussion: the drum sequencer and the metronome play on it, and it
+// is physical channel 9 of the first synth instance.
+static constexpr int kPercussionChannel = 9;
+
+/**
+ * Logical MIDI channels to synth channels.
+ *
+ * Tracks, the preview keyboard and the drums each play on a logical
+ * channel (kMaxLogicalChannels of them, far more than MIDI's 16). The
+ * synth has physical channels: kSynthInstanceChannels on each of the
+ * SynthPartitions instances, numbered partition * kSynthInstanceChannels
+ * + channel. This decides which physical channel a logical one plays on.
+ *
+ * Logical kPercussionChannel (drums and the metronome) is fixed on
+ * physical channel 9 of the first instance. Every other binding is made
+ * by use:
+ *
+ *  - assignTracks() binds each track that can sound (unmuted, with
+ *    clips). Two tracks share a physical channel when they have the same
+ *    program and their clips never overlap in time (with a release tail
+ *    between them), so a channel never changes program mid-song and no
+ *    note of one track can end a note of the other. A track keeps its
+ *    channel across edits while it still fits there. A muted or empty
+ *    track gives its channel up.
+ *  - bindLive() binds a channel played directly (preview notes, program
+ *    changes) to a channel no track uses, on first use.
+ *
+ * Consecutive free channels alternate between instances, so tracks
+ * spread over the render partitions. Each physical channel's program is
+ * kept here, and every change the caller must make to the synth is
+ * returned as a ChannelChange; nothing else sends program changes, so
+ * the synth's channel state only moves when an assignment does.
+ *
+ * Editing (assign*, bindLive) is for control threads and serialized by a
+ * mutex. physical(), programAt() and generation() are lock-free atomic
+ * reads for the render thread.
+ */
+class SynthChannelMap {
+public:
+    /** What the caller applies to the synth after an edit. */
+    struct ChannelChange {
+        int physical = -1;
+        int program = -1;     // select this program; -1 leaves it as is
+        bool vacated = false; // a logical channel left: end its notes
+    };
+
+    SynthChannelMap();
+
+    /**
+     * Physical channels on [instances] synths; drops every binding. With
+     * [releasePrograms] a channel left empty goes back to program 0, so
+     * a preset nothing plays any more can be unloaded.
+     */
+    void configure(int32_t instances, bool releasePrograms);
+
+    /** Physical channel of [logical], or -1 if it has none. */
+    int physical(int logical) const {
+        if (logical < 0 || logical >= kMaxLogicalChannels) return -1;
+        return slotOf_[logical].load(std::memory_order_acquire);
+    }
+
+    /** Program selected on [physical] as far as the map knows; -1 if none. */
+    int programAt(int physical) const;
+
+    /** Bumped by every edit that changes a binding or a program. */
+    uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+
+    /** Highest physical channel in use plus one (for scanning). */
+    int physicalCount() const { return static_cast<int>(slots_.size()); }
+
+    /**
+     * Rebind every track from [tracks] (the full list, as the sequencer
+     * gets it). Tracks missing from it lose their channels. Notes count
+     * as sounding for [releaseFrames] past their clip's end.
+     */
+    void assignTracks(const std::vector<MidiTrackData>& tracks, int64_t releaseFrames,
+                      std::vector<ChannelChange>& changes);
+
+    /** Rebind one track replaced in place, keeping every other binding. */
+    void assignTrack(const MidiTrackData& track, int64_t releaseFrames,
+                     std::vector<ChannelChange>& changes);
+
+    /** As assignTrack() after the sequencer's replaceTrackRange(): clips
+     *  starting in [startFrame, endFrame) are replaced by [clips]. */
+    void assignTrackRange(int logical, int64_t startFrame, int64_t endFrame,
+                          const std::vector<MidiClipData>& clips, int64_t releaseFrames,
+                          std::vector<ChannelChange>& changes);
+
+    /**
+     * Physical channel for [logical] played directly, binding it on first
+     * use. [program] >= 0 also selects that program on it (a track's
+     * channel ignores it: its program belongs to the track). Returns -1
+     * if every channel is taken.
+     */
+    int bindLive(int logical, int program, std::vector<ChannelChange>& changes);
+
+private:
+    /** A clip's time on the timeline, release tail included. */
+    struct Span {
+        int64_t start = 0;
+        int64_t end = 0;
+    };
+
+    /** Editing state of one logical channel. */
+    struct Logical {
+        bool track = false;      // bound by assignTracks(), not bindLive()
+        bool muted = false;
+        bool sounding = false;   // unmuted with clips: needs a channel
+        int program = 0;
+        std::vector<Span> spans;  // one per clip, sorted by start
+        std::vector<Span> busy;   // spans merged: when the track can sound
+        uint64_t lastUse = 0;     // live bindings: for reuse, oldest first
+    };
+
+    /** Editing state of one physical channel. */
+    struct Slot {
+        std::vector<int> occupants;  // logical channels bound to it
+    };
+
+    static std::vector<Span> spansOf(const std::vector<MidiClipData>& clips,
+                                     int64_t releaseFrames);
+    static std::vector<Span> merged(const std::vector<Span>& spans);
+    static bool overlaps(const std::vector<Span>& a, const std::vector<Span>& b);
+
+    /** Whether [logical] can share [slot] with every occupant but itself. */
+    bool fits(int logical, int slot) const;
+    /** A channel for track [logical]: shared, free, or (out of channels)
+     *  the least busy one with its program, or -1. */
+    int findSlotForTrack(int logical) const;
+    /** A channel with no track on it, live ones reused oldest first. */
+    int findFreeSlot(bool evictLive) const;
+
+    void bind(int logical, int slot, std::vector<ChannelChange>& changes);
+    void unbind(int logical, std::vector<ChannelChange>& changes);
+    /** Place track [logical]: keep its channel if it still fits there. */
+    void placeTrack(int logical, std::vector<ChannelChange>& changes);
+    void setProgram(int slot, int program, std::vector<ChannelChange>& changes);
+    /** Publish the edit; caller holds mutex_. */
+    void bump();
+
+    std::mutex mutex_;
+    std::vector<Logical> logical_;  // indexed by logical channel
+    std::vector<Slot> slots_;       // indexed by physical channel
+    std::vector<int> order_;        // physical channels in allocation order
+    uint64_t useCounter_ = 0;
+    bool releasePrograms_ = false;
+
+    // Render-thread view
+    std::atomic<int> slotOf_[kMaxLogicalChannels];
+    std::vector<std::atomic<int>> program_;  // per physical channel; sized by configure()
+    std::atomic<uint64_t> generation_{0};
+};
+
+}  // namespace nightjar
@@ -1,5 +1,6 @@
 #include "synth_engine.h"
 #include "atomic_transport.h"
+#include "mix_kernels.h"
 #include <fluidsynth.h>
 #include <algorithm>
 #include <chrono>
@@ -8,27 +9,47 @@
 
 namespace nightjar {
 
+static_assert(kSynthRenderChunkFrames <= kMaxPartitionBlockFrames,
+              "render chunks must fit a partition block");
+
+// Backstop for the render thread's wait on consumedSignal_. The callback
+// signals every burst (playing, or paused while the thread isn't parked),
+// so this only matters while the output stream is stopped.
+static constexpr auto kRenderIdleTimeout = std::chrono::milliseconds(20);
+
+// Backstop for the parked render thread; wake() and the playing callback
+// are what normally bring it back.
+static constexpr auto kRenderParkTimeout = std::chrono::seconds(1);
+
+// The bank FluidSynth keeps drum kits in.
+static constexpr int kPercussionBank = 128;
+
+// How long a track's notes may ring past the end of its last clip, for
+// deciding which tracks can share a synth channel.
+static constexpr int64_t kSynthChannelReleaseMs = 2000;
+
 // Typed accessors for the void* members (avoids FluidSynth header in synth_engine.h)
 #define FS_SETTINGS  static_cast<fluid_settings_t*>(settings_)
-#define FS_SYNTH     static_cast<fluid_synth_t*>(synth_)
+#define FS_CHANNEL(ch)  static_cast<fluid_synth_t*>(partitions_.synthForChannel(ch))
 
-SynthEngine::SynthEngine(AtomicTransport& transport)
-    : transport_(transport) {}
+SynthEngine::SynthEngine(AtomicTransport& transport, const TempoTrack& tempo,
+                         Reclaimer& reclaimer, EngineTelemetry& telemetry,
+                         EngineStatus& status)
+    : transport_(transport), tempo_(tempo), telemetry_(telemetry), status_(status),
+      sequencer_(reclaimer), midiSequencer_(reclaimer) {}
 
 SynthEngine::~SynthEngine() {
     stop();
 
-    if (synth_) {
-        delete_fluid_synth(FS_SYNTH);
-        synth_ = nullptr;
-    }
+    partitions_.destroy();
+    sampleLoader_.destroy();
     if (settings_) {
         delete_fluid_settings(FS_SETTINGS);
         settings_ = nullptr;
     }
 }
 
-bool SynthEngine::loadSoundFont(const std::string& path) {
+bool SynthEngine::loadSoundFont(const std::string& path, bool lazySamples) {
     if (soundFontLoaded_.load(std::memory_order_acquire)) {
         LOGW("SynthEngine: SoundFont already loaded");
         return true;
@@ -41,36 +62,66 @@ bool SynthEngine::loadSoundFont(const std::string& path) {
         return false;
     }
 
-    // Match our audio pipeline: 44.1kHz, 1 stereo pair, moderate polyphony
+    // Match our audio pipeline: the engine rate, 1 stereo pair, the
+    // governor's polyphony. The output stream has fixed the rate by now
+    // (it opens in AudioEngine::initialize(), before any SoundFont can
+    // load). Reverb is created active; the tier switches it on and off.
     fluid_settings_setnum(FS_SETTINGS, "synth.sample-rate",
-                          static_cast<double>(kSampleRate));
+                          static_cast<double>(transport_.sampleRate.load(std::memory_order_relaxed)));
     fluid_settings_setint(FS_SETTINGS, "synth.audio-channels", 1);   // 1 stereo pair
-    fluid_settings_setint(FS_SETTINGS, "synth.polyphony", 64);
+    fluid_settings_setint(FS_SETTINGS, "synth.midi-channels", kSynthInstanceChannels);
+    fluid_settings_setint(FS_SETTINGS, "synth.polyphony",
+                          synthTierSettings(SynthQualityTier::Full).polyphony);
     fluid_settings_setint(FS_SETTINGS, "synth.reverb.active", 1);
     fluid_settings_setint(FS_SETTINGS, "synth.chorus.active", 0);    // save CPU on mobile
 
-    // Create the synthesizer
-    synth_ = new_fluid_synth(FS_SETTINGS);
-    if (!synth_) {
-        LOGE("SynthEngine: failed to create FluidSynth instance");
+    // Voice stealing: when a tier's voice limit is hit, drums (channel 9)
+    // and freshly started notes survive, release tails go first.
+    fluid_settings_setnum(FS_SETTINGS, "synth.overflow.percussion", 10000.0);
+    fluid_settings_setnum(FS_SETTINGS, "synth.overflow.age", 3000.0);
+    fluid_settings_setnum(FS_SETTINGS, "synth.overflow.released", -4000.0);
+
+    // Lazy samples: sfload reads the preset tables only, and each
+    // preset's samples are read in when a channel selects it.
+    fluid_settings_setint(FS_SETTINGS, "synth.dynamic-sample-loading", lazySamples ? 1 : 0);
+
+    // Create the synthesizer partitions, each with the SoundFont loaded.
+    // Samples are shared through FluidSynth's sample cache, so extra
+    // partitions cost voice/channel state, not another copy of the SF2.
+    int32_t partitionCount = SynthPartitions::defaultCount();
+    if (!partitions_.create(settings_, path, partitionCount)) {
+        LOGE("SynthEngine: failed to create synth partitions for SoundFont: %s",
+             path.c_str());
         delete_fluid_settings(FS_SETTINGS);
         settings_ = nullptr;
         return false;
     }
 
-    // Load the SoundFont
-    sfontId_ = fluid_synth_sfload(FS_SYNTH, path.c_str(), 1);  // 1 = reset presets
-    if (sfontId_ == FLUID_FAILED) {
-        LOGE("SynthEngine: failed to load SoundFont: %s", path.c_str());
-        delete_fluid_synth(FS_SYNTH);
-        synth_ = nullptr;
-        delete_fluid_settings(FS_SETTINGS);
-        settings_ = nullptr;
-        return false;
+    if (lazySamples) {
+        // Keep the drum kit resident whatever the percussion channel
+        // selects, so the step sequencer never waits on a load.
+        auto* drums = FS_CHANNEL(kPercussionChannel);
+        fluid_sfont_t* sfont = fluid_synth_get_sfont(drums, 0);
+        if (!sfont || fluid_synth_pin_preset(drums, fluid_sfont_get_id(sfont),
+                                             kPercussionBank, 0) != FLUID_OK) {
+            LOGW("SynthEngine: could not pin the percussion kit");
+        }
+        if (!sampleLoader_.create(settings_, path, 1)) {
+            LOGW("SynthEngine: no sample loader; program changes read samples in place");
+        }
     }
 
+    channelMap_.configure(partitions_.count(), lazySamples);
+    reissuedGeneration_ = 0;
+
+    governor_.reset(SynthLoadGovernor::initialTier());
+    applyQualityTier(governor_.tier());
+
+    soundFontPath_ = path;
     soundFontLoaded_.store(true, std::memory_order_release);
-    LOGD("SynthEngine: loaded SoundFont (id=%d) from %s", sfontId_, path.c_str());
+    LOGD("SynthEngine: loaded SoundFont from %s (%d partition(s), tier %d, %s samples)",
+         path.c_str(), partitions_.count(), static_cast<int>(governor_.tier()),
+         lazySamples ? "lazy" : "all");
     return true;
 }
 
@@ -81,9 +132,16 @@ void SynthEngine::start() {
         return;
     }
 
+    // isRunning() is still false, so the callback isn't reading
     ringBuffer_.reset();
+    chunkTags_.clear();
+    chunkOffset_ = 0;
+    writtenSinceFlush_ = 0;
     renderPos_ = transport_.posFrames.load(std::memory_order_relaxed);
     wasPlaying_ = false;
+    silentChunks_ = 0;
+    idle_.store(false, std::memory_order_relaxed);
+    wakeRequested_.store(false, std::memory_order_relaxed);
     sequencer_.reset();
     midiSequencer_.reset();
     metronome_.reset();
@@ -96,10 +154,16 @@ void SynthEngine::stop() {
     if (!running_.load(std::memory_order_acquire)) return;
 
     running_.store(false, std::memory_order_release);
+    consumedSignal_.notify();
     if (renderThread_.joinable()) {
         renderThread_.join();
     }
+    // Nothing drains the queue until the next start(); apply it now so
+    // later direct changes can't be overtaken by stale ones.
+    drainCommands();
     ringBuffer_.reset();
+    chunkTags_.clear();
+    chunkOffset_ = 0;
     sequencer_.reset();
     midiSequencer_.reset();
     metronome_.reset();
@@ -107,64 +171,275 @@ void SynthEngine::stop() {
 }
 
 int32_t SynthEngine::readFrames(float* output, int32_t numFrames) {
-    // Stack buffer: max 2048 frames * 2 channels = 4096 floats = 16KB on stack
-    static constexpr int32_t kMaxStereoSamples = 2048 * kOutputChannelCount;
-    float temp[kMaxStereoSamples];
+    float vol = volume_.load(std::memory_order_relaxed);
+    int32_t done = 0;
+    while (done < numFrames && currentChunk()) {
+        int32_t n = std::min(kSynthRenderChunkFrames - chunkOffset_, numFrames - done);
+        consumeChunkFrames(output + done * kOutputChannelCount, n, vol);
+        done += n;
+    }
+
+    // Parked: the ring runs dry by design, so an empty read is neither an
+    // underrun nor a reason to wake the render thread
+    if (idle_.load(std::memory_order_acquire)) return done;
+    telemetry_.recordSynthRead(numFrames, done);
 
-    int32_t totalSamples = std::min(numFrames * kOutputChannelCount, kMaxStereoSamples);
-    size_t got = ringBuffer_.read(temp, static_cast<size_t>(totalSamples));
+    // Wake the render thread if it is parked at its fill target. Only
+    // enters the kernel when it is actually waiting.
+    consumedSignal_.notify();
+
+    return done;
+}
 
+int32_t SynthEngine::readFramesAt(float* output, int32_t numFrames, int64_t timelineFrame) {
     float vol = volume_.load(std::memory_order_relaxed);
-    for (size_t i = 0; i < got; ++i) {
-        output[i] += temp[i] * vol;
+    int32_t done = 0;
+    int32_t mixed = 0;
+    while (done < numFrames) {
+        int64_t early = alignTo(timelineFrame + done);
+        if (early < 0) break;  // underrun
+        if (early > 0) {
+            // Synth audio starts later in this block: leave silence before it
+            auto pad = static_cast<int32_t>(std::min<int64_t>(early, numFrames - done));
+            telemetry_.recordSynthAlignment(0, pad);
+            done += pad;
+            continue;
+        }
+        int32_t n = std::min(kSynthRenderChunkFrames - chunkOffset_, numFrames - done);
+        consumeChunkFrames(output + done * kOutputChannelCount, n, vol);
+        done += n;
+        mixed += n;
     }
+    telemetry_.recordSynthRead(numFrames, mixed);
+    consumedSignal_.notify();
+    return mixed;
+}
 
-    return static_cast<int32_t>(got) / kOutputChannelCount;
+bool SynthEngine::isPrimedAt(int64_t timelineFrame) {
+    bool primed = alignTo(timelineFrame) >= 0;
+    // Dropping stale chunks may have made room below the fill target
+    consumedSignal_.notify();
+    return primed;
 }
 
-void SynthEngine::noteOn(int channel, int note, int velocity) {
-    if (synth_) {
-        fluid_synth_noteon(FS_SYNTH, channel, note, velocity);
+const SynthChunkTag* SynthEngine::currentChunk() {
+    while (const SynthChunkTag* chunk = chunkTags_.front()) {
+        // Loaded after the tag, so a chunk of the new epoch is never
+        // compared against the old one
+        if (chunk->epoch == ringEpoch_.load(std::memory_order_acquire)) return chunk;
+        consumeChunkFrames(nullptr, kSynthRenderChunkFrames - chunkOffset_, 0.0f);
     }
+    return nullptr;
 }
 
-void SynthEngine::noteOff(int channel, int note) {
-    if (synth_) {
-        fluid_synth_noteoff(FS_SYNTH, channel, note);
+int64_t SynthEngine::alignTo(int64_t timelineFrame) {
+    constexpr auto kRingFrames = static_cast<int64_t>(kSynthRingChunks) * kSynthRenderChunkFrames;
+    int64_t loopStart = transport_.loopStartFrames.load(std::memory_order_relaxed);
+    int64_t loopEnd = transport_.loopEndFrames.load(std::memory_order_relaxed);
+
+    while (const SynthChunkTag* chunk = currentChunk()) {
+        int32_t left = kSynthRenderChunkFrames - chunkOffset_;
+        if (chunk->frame == kUntimedChunk) {
+            // Rendered before the render thread saw the play start
+            consumeChunkFrames(nullptr, left, 0.0f);
+            continue;
+        }
+        int64_t early = chunk->frame + chunkOffset_ - timelineFrame;
+        if (loopStart >= 0 && loopEnd > loopStart) {
+            // Both sides run past loopEnd to the end of their block or
+            // chunk and resume at the matching point after loopStart, so
+            // positions compare modulo the loop length.
+            int64_t length = loopEnd - loopStart;
+            early %= length;
+            if (early > length / 2) early -= length;
+            if (early < -(length / 2)) early += length;
+        }
+        if (early < -kRingFrames || early > kRingFrames) {
+            // Not a drift but a jump (a seek while playing): drop what was
+            // rendered for the old position and have the render thread
+            // restart at the new one.
+            consumeChunkFrames(nullptr, left, 0.0f);
+            requestFlush();
+            continue;
+        }
+        if (early >= 0) return early;
+        auto late = static_cast<int32_t>(std::min<int64_t>(-early, left));
+        telemetry_.recordSynthAlignment(late, 0);
+        consumeChunkFrames(nullptr, late, 0.0f);
     }
+    return -1;
 }
 
-void SynthEngine::programChange(int channel, int program) {
-    if (synth_) {
-        fluid_synth_program_change(FS_SYNTH, channel, program);
+void SynthEngine::consumeChunkFrames(float* output, int32_t frames, float volume) {
+    // Mixed straight out of ring memory; discarding costs nothing
+    auto queued = ringBuffer_.peekRead(static_cast<size_t>(frames) * kOutputChannelCount);
+    if (output) {
+        mixScaled(output, queued.first.data, static_cast<int32_t>(queued.first.size), volume);
+        mixScaled(output + queued.first.size, queued.second.data,
+                  static_cast<int32_t>(queued.second.size), volume);
     }
+    ringBuffer_.consumeRead(queued.size());
+    chunkOffset_ += frames;
+    if (chunkOffset_ >= kSynthRenderChunkFrames) {
+        chunkTags_.pop();
+        chunkOffset_ = 0;
+    }
+}
+
+void SynthEngine::noteOn(int channel, int note, int velocity) {
+    if (!hasSynth()) return;
+    std::vector<SynthChannelMap::ChannelChange> changes;
+    int physical = channelMap_.bindLive(channel, /* program */ -1, changes);
+    applyChannelChanges(changes);
+    if (physical < 0) return;
+    fluid_synth_noteon(FS_CHANNEL(physical), SynthPartitions::localChannel(physical),
+                       note, velocity);
+    wake();
+}
+
+void SynthEngine::noteOff(int channel, int note) {
+    if (!hasSynth()) return;
+    // An unbound channel has nothing sounding: unbinding ended its notes
+    int physical = channelMap_.physical(channel);
+    if (physical < 0) return;
+    fluid_synth_noteoff(FS_CHANNEL(physical), SynthPartitions::localChannel(physical), note);
+}
+
+void SynthEngine::programChange(int channel, int program) {
+    if (!hasSynth()) return;
+    std::vector<SynthChannelMap::ChannelChange> changes;
+    channelMap_.bindLive(channel, program, changes);
+    applyChannelChanges(changes);
 }
 
 void SynthEngine::reissueProgramChanges() {
-    if (!synth_) return;
-    midiSequencer_.forEachProgramAssignment([this](int channel, int program) {
-        fluid_synth_program_change(FS_SYNTH, channel, program);
-    });
+    if (!hasSynth()) return;
+    // Each program was already selected (and, with lazy samples, loaded)
+    // by the UI-thread call that assigned it, so this only sends the ones
+    // that haven't landed yet and the render thread doesn't read samples.
+    // If the map hasn't changed since the last pass, none can be missing.
+    uint64_t generation = channelMap_.generation();
+    if (generation == reissuedGeneration_) return;
+    reissuedGeneration_ = generation;
+    int count = channelMap_.physicalCount();
+    for (int physical = 0; physical < count; ++physical) {
+        int program = channelMap_.programAt(physical);
+        if (program >= 0) selectProgram(physical, program);
+    }
+}
+
+void SynthEngine::selectProgram(int physical, int program) {
+    auto* synth = FS_CHANNEL(physical);
+    int channel = SynthPartitions::localChannel(physical);
+    int sfontId = 0;
+    int bank = 0;
+    int current = -1;
+    if (fluid_synth_get_program(synth, channel, &sfontId, &bank, &current) == FLUID_OK &&
+        current == program) {
+        return;
+    }
+    fluid_synth_program_change(synth, channel, program);
+}
+
+void SynthEngine::applyChannelChanges(const std::vector<SynthChannelMap::ChannelChange>& changes) {
+    auto* loader = sampleLoader_.empty()
+        ? nullptr : static_cast<fluid_synth_t*>(sampleLoader_.synthAt(0));
+    fluid_sfont_t* loaderFont = loader ? fluid_synth_get_sfont(loader, 0) : nullptr;
+
+    for (const auto& change : changes) {
+        auto* synth = FS_CHANNEL(change.physical);
+        int channel = SynthPartitions::localChannel(change.physical);
+        if (change.vacated) fluid_synth_all_notes_off(synth, channel);
+        if (change.program < 0) continue;
+
+        // The samples are shared through the cache, so once the loader
+        // holds them the partition's program change reads nothing from
+        // the file. The partition keeps its own reference; the pin only
+        // has to last until the program change has taken it.
+        int sfontId = 0;
+        int bank = -1;
+        int current = -1;
+        bool pinned = loaderFont &&
+            fluid_synth_get_program(synth, channel, &sfontId, &bank, &current) == FLUID_OK &&
+            current != change.program &&
+            fluid_synth_pin_preset(loader, fluid_sfont_get_id(loaderFont), bank,
+                                   change.program) == FLUID_OK;
+        selectProgram(change.physical, change.program);
+        if (pinned) {
+            fluid_synth_unpin_preset(loader, fluid_sfont_get_id(loaderFont), bank,
+                                     change.program);
+        }
+    }
 }
 
 void SynthEngine::setVolume(float volume) {
     volume_.store(volume, std::memory_order_relaxed);
 }
 
+void SynthEngine::wake() {
+    wakeRequested_.store(true, std::memory_order_release);
+    consumedSignal_.notify();
+}
+
 void SynthEngine::requestFlush() {
     flushRequested_.store(true, std::memory_order_release);
+    consumedSignal_.notify();
 }
 
 void SynthEngine::requestPreviewFlush() {
     previewFlushRequested_.store(true, std::memory_order_release);
+    consumedSignal_.notify();
+}
+
+void SynthEngine::setFramesPerBurst(int32_t framesPerBurst) {
+    if (framesPerBurst <= 0) return;
+    framesPerBurst_.store(framesPerBurst, std::memory_order_relaxed);
+    LOGD("SynthEngine: framesPerBurst=%d (play fill=%d, live fill=%d frames)",
+         framesPerBurst, targetFillFrames(true), targetFillFrames(false));
+}
+
+void SynthEngine::setLatencyProfile(SynthLatencyProfile profile) {
+    playProfile_.store(profile, std::memory_order_relaxed);
+    consumedSignal_.notify();
+}
+
+int32_t SynthEngine::targetFillFrames(bool playing) const {
+    SynthLatencyProfile profile = playing
+        ? playProfile_.load(std::memory_order_relaxed)
+        : SynthLatencyProfile::LiveInput;
+    int32_t burst = framesPerBurst_.load(std::memory_order_relaxed);
+
+    int32_t target = (profile == SynthLatencyProfile::Play)
+        ? std::max(burst * kPlayFillBursts, kPlayMinFillFrames)
+        : std::max(burst * kLiveInputFillBursts, kLiveInputMinFillFrames);
+
+    // Leave room for one chunk of overshoot above the target.
+    constexpr auto kMaxTarget = static_cast<int32_t>(
+        kSynthRingBufferCapacity / kOutputChannelCount) - kSynthRenderChunkFrames;
+    return std::min(target, kMaxTarget);
 }
 
 void SynthEngine::allSoundsOff() {
-    if (synth_) {
-        fluid_synth_all_sounds_off(FS_SYNTH, -1);  // -1 = all channels
+    partitions_.allSoundsOff();
+}
+
+/** Set [tier]'s polyphony, reverb and interpolation on every partition of [partitions]. */
+static void applyTier(const SynthPartitions& partitions, SynthQualityTier tier) {
+    const SynthTierSettings& settings = synthTierSettings(tier);
+    for (int32_t i = 0; i < partitions.count(); ++i) {
+        auto* synth = static_cast<fluid_synth_t*>(partitions.synthAt(i));
+        // Lowering the limit below the sounding voices ends the excess
+        // right away; that is the point when the budget is being overrun.
+        fluid_synth_set_polyphony(synth, settings.polyphony);
+        fluid_synth_reverb_on(synth, -1, settings.reverb ? 1 : 0);
+        fluid_synth_set_interp_method(synth, -1, settings.interpolation);
     }
 }
 
+void SynthEngine::applyQualityTier(SynthQualityTier tier) {
+    applyTier(partitions_, tier);
+}
+
 // ── Step sequencer control ──────────────────────────────────────────────
 
 void SynthEngine::updateDrumPattern(int stepsPerBar, int bars, int64_t offsetFrames,
@@ -176,9 +451,11 @@ void SynthEngine::updateDrumPattern(int stepsPerBar, int bars, int64_t offsetFra
                              hits, clipOffsetFrames, beatsPerBar);
 }
 
-void SynthEngine::updateDrumPatternClips(float volume, bool muted,
-                                         const std::vector<StepSequencer::ClipSlot>& clips) {
-    sequencer_.updatePattern(volume, muted, clips);
+void SynthEngine::stageDrumPatternClips(
+        float volume, bool muted,
+        const std::vector<StepSequencer::PatternData>& patterns,
+        const std::vector<StepSequencer::ClipPlacement>& clips) {
+    sequencer_.stagePatterns(volume, muted, patterns, clips);
 }
 
 void SynthEngine::setSequencerEnabled(bool enabled) {
@@ -188,21 +465,83 @@ void SynthEngine::setSequencerEnabled(bool enabled) {
     }
 }
 
-int64_t SynthEngine::getSequencerMaxEndFrame(double bpm) const {
-    return sequencer_.getMaxEndFrame(bpm);
+void SynthEngine::post(const SynthCommand* commands, size_t count) {
+    if (count == 0) return;
+    if (running_.load(std::memory_order_acquire) && commands_.push(commands, count)) {
+        consumedSignal_.notify();
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) applyCommand(commands[i]);
+}
+
+void SynthEngine::applyCommand(const SynthCommand& command) {
+    switch (command.op) {
+        case SynthCommand::Op::DrumSequencerEnabled:
+            setSequencerEnabled(command.value != 0);
+            break;
+        case SynthCommand::Op::MidiSequencerEnabled:
+            setMidiSequencerEnabled(command.value != 0);
+            break;
+        case SynthCommand::Op::CommitDrumPatterns:
+            sequencer_.commitStaged();
+            break;
+        case SynthCommand::Op::CommitMidiTracks:
+            midiSequencer_.commitStaged();
+            break;
+    }
+}
+
+void SynthEngine::drainCommands() {
+    commands_.drain([this](const SynthCommand& command) { applyCommand(command); });
+}
+
+int64_t SynthEngine::getSequencerMaxEndFrame() const {
+    return sequencer_.getMaxEndFrame(tempo_.snapshot(),
+                                     transport_.sampleRate.load(std::memory_order_relaxed));
 }
 
 // ── MIDI sequencer control ─────────────────────────────────────────────
 
-void SynthEngine::updateMidiTracks(const std::vector<MidiTrackData>& tracks) {
-    if (!synth_) return;
+void SynthEngine::stageMidiTracks(std::vector<MidiTrackData> tracks) {
+    if (!hasSynth()) return;
 
-    // Apply program changes for each track
-    for (const auto& track : tracks) {
-        fluid_synth_program_change(FS_SYNTH, track.channel, track.program);
-    }
+    // Bind the tracks to synth channels and select their programs before
+    // the sequencer can play them; with lazy samples this is where a
+    // project's instruments load, and where channels nothing uses any
+    // more release theirs
+    std::vector<SynthChannelMap::ChannelChange> changes;
+    channelMap_.assignTracks(tracks, channelReleaseFrames(), changes);
+    applyChannelChanges(changes);
 
-    midiSequencer_.updateTracks(tracks);
+    midiSequencer_.stageTracks(std::move(tracks));
+}
+
+bool SynthEngine::replaceMidiTrack(int trackIndex, MidiTrackData track) {
+    if (!hasSynth() || trackIndex < 0) return false;
+
+    std::vector<SynthChannelMap::ChannelChange> changes;
+    channelMap_.assignTrack(track, channelReleaseFrames(), changes);
+    applyChannelChanges(changes);
+    return midiSequencer_.replaceTrack(static_cast<size_t>(trackIndex), std::move(track));
+}
+
+bool SynthEngine::replaceMidiTrackRange(int trackIndex, int64_t startFrame, int64_t endFrame,
+                                        const std::vector<MidiClipData>& clips) {
+    if (!hasSynth() || trackIndex < 0) return false;
+
+    // Moved clips can change which tracks may share a channel
+    int channel = midiSequencer_.trackChannel(static_cast<size_t>(trackIndex));
+    std::vector<SynthChannelMap::ChannelChange> changes;
+    channelMap_.assignTrackRange(channel, startFrame, endFrame, clips,
+                                 channelReleaseFrames(), changes);
+    applyChannelChanges(changes);
+    return midiSequencer_.replaceTrackRange(static_cast<size_t>(trackIndex),
+                                            startFrame, endFrame, clips);
+}
+
+int64_t SynthEngine::channelReleaseFrames() const {
+    return msToFrames(kSynthChannelReleaseMs,
+                      transport_.sampleRate.load(std::memory_order_relaxed));
 }
 
 void SynthEngine::setMidiSequencerEnabled(bool enabled) {
@@ -213,7 +552,8 @@ void SynthEngine::setMidiSequencerEnabled(bool enabled) {
 }
 
 int64_t SynthEngine::getMidiMaxEndFrame() const {
-    return midiSequencer_.getMaxEndFrame();
+    return midiSequencer_.getMaxEndFrame(tempo_.snapshot(),
+                                         transport_.sampleRate.load(std::memory_order_relaxed));
 }
 
 // ── Metronome control ──────────────────────────────────────────────────
@@ -229,10 +569,6 @@ void SynthEngine::setMetronomeVolume(float volume) {
     metronome_.setVolume(volume);
 }
 
-void SynthEngine::setMetronomeBeatsPerBar(int beatsPerBar) {
-    metronome_.setBeatsPerBar(beatsPerBar);
-}
-
 int64_t SynthEngine::getLastMetronomeBeatFrame() const {
     return metronome_.getLastBeatFrame();
 }
@@ -240,109 +576,194 @@ int64_t SynthEngine::getLastMetronomeBeatFrame() const {
 // ── Sub-buffer scheduling ──────────────────────────────────────────────────
 
 void SynthEngine::fireEvent(const NoteEvent& e) {
-    if (!synth_) return;
-    if (e.note < 0) {
-        // Sentinel: silence all notes on this channel (mute transition)
-        fluid_synth_all_notes_off(FS_SYNTH, e.channel);
-    } else if (e.velocity > 0) {
-        fluid_synth_noteon(FS_SYNTH, e.channel, e.note, e.velocity);
-    } else {
-        fluid_synth_noteoff(FS_SYNTH, e.channel, e.note);
-    }
+    NoteEvent mapped = e;
+    mapped.channel = channelMap_.physical(e.channel);
+    if (mapped.channel >= 0) partitions_.fireEvent(mapped);
 }
 
 bool SynthEngine::renderSubBuffer(float* buf, int32_t totalFrames,
                                    std::vector<NoteEvent>& events) {
-    if (events.empty()) {
-        // No events -- render the full chunk in one call
-        int result = fluid_synth_write_float(
-            FS_SYNTH, totalFrames,
-            buf, 0, 2, buf, 1, 2);
-        return result == FLUID_OK;
+    // Each partition splits its own render at its events' offsets; see
+    // SynthPartitions::render().
+    return partitions_.render(buf, totalFrames, events);
+}
+
+void SynthEngine::collectTimelineEvents(int64_t pos, int32_t frames,
+                                        bool includeMetronome) {
+    int32_t sampleRate = transport_.sampleRate.load(std::memory_order_relaxed);
+    // One tempo map for the whole chunk, so all three sequencers agree.
+    TempoTrack::ReadGuard tempo(tempo_, kTempoReader);
+    if (sequencerEnabled_.load(std::memory_order_relaxed)) {
+        const auto& events = sequencer_.tick(pos, frames, *tempo, sampleRate);
+        mergedEvents_.insert(mergedEvents_.end(), events.begin(), events.end());
     }
 
-    // Sort events by frame offset for correct sub-buffer ordering
-    std::sort(events.begin(), events.end(),
-              [](const NoteEvent& a, const NoteEvent& b) {
-                  return a.frameOffset < b.frameOffset;
-              });
-
-    int32_t rendered = 0;
-
-    for (size_t i = 0; i < events.size(); ++i) {
-        int32_t eventFrame = events[i].frameOffset;
-
-        // Render audio up to this event's frame position
-        int32_t framesToRender = eventFrame - rendered;
-        if (framesToRender > 0) {
-            int32_t sampleOffset = rendered * kOutputChannelCount;
-            int result = fluid_synth_write_float(
-                FS_SYNTH, framesToRender,
-                buf + sampleOffset, 0, 2,
-                buf + sampleOffset, 1, 2);
-            if (result != FLUID_OK) return false;
-            rendered += framesToRender;
+    if (midiSequencerEnabled_.load(std::memory_order_relaxed)) {
+        const auto& midiEvents = midiSequencer_.tick(pos, frames, *tempo, sampleRate);
+        // Logical channels to synth channels; a track without one is silent
+        for (NoteEvent e : midiEvents) {
+            e.channel = channelMap_.physical(e.channel);
+            if (e.channel >= 0) mergedEvents_.push_back(e);
         }
+    }
+
+    if (includeMetronome) {
+        const auto& metEvents = metronome_.tick(pos, frames, *tempo, sampleRate,
+                                                /* ignoreEnabled */ true);
+        mergedEvents_.insert(mergedEvents_.end(), metEvents.begin(), metEvents.end());
+    }
+}
+
+void SynthEngine::seekMidi(int64_t pos) {
+    TempoTrack::ReadGuard tempo(tempo_, kTempoReader);
+    midiSequencer_.resetToPosition(pos, *tempo,
+                                   transport_.sampleRate.load(std::memory_order_relaxed));
+}
+
+// ── Offline rendering ──────────────────────────────────────────────────────
+
+bool SynthEngine::beginOfflineRender(int64_t startPos, bool includeMetronome) {
+    if (!hasSynth() || offlineActive_) return false;
+
+    // Park the real-time render thread: the offline worker takes over as
+    // the only thread driving FluidSynth and the sequencers' cursors.
+    resumeAfterOffline_ = running_.load(std::memory_order_acquire);
+    stop();
+
+    partitions_.allSoundsOff();
+    sequencer_.reset();
+    seekMidi(startPos);
+    metronome_.reset();
+    reissueProgramChanges();
+
+    // An export has no deadline: render it at full quality.
+    applyQualityTier(SynthQualityTier::Full);
 
-        // Fire all events at this exact frame position
-        fireEvent(events[i]);
-        while (i + 1 < events.size() &&
-               events[i + 1].frameOffset == eventFrame) {
-            ++i;
-            fireEvent(events[i]);
+    offlinePos_ = startPos;
+    offlineMetronome_ = includeMetronome;
+    offlineActive_ = true;
+    LOGD("SynthEngine: offline render begin (pos=%lld, metronome=%d)",
+         (long long)startPos, includeMetronome ? 1 : 0);
+    return true;
+}
+
+bool SynthEngine::renderOffline(float* output, int32_t numFrames) {
+    if (!offlineActive_) return false;
+
+    int32_t done = 0;
+    while (done < numFrames) {
+        // Same chunk grid and event collection as the render thread, so
+        // events land on identical sample offsets.
+        int32_t frames = std::min(kSynthRenderChunkFrames, numFrames - done);
+        mergedEvents_.clear();
+        collectTimelineEvents(offlinePos_, frames, offlineMetronome_);
+        if (!renderSubBuffer(output + done * kOutputChannelCount, frames, mergedEvents_)) {
+            return false;
         }
+        offlinePos_ += frames;
+        done += frames;
     }
+    return true;
+}
 
-    // Render remaining frames after the last event
-    int32_t remaining = totalFrames - rendered;
-    if (remaining > 0) {
-        int32_t sampleOffset = rendered * kOutputChannelCount;
-        int result = fluid_synth_write_float(
-            FS_SYNTH, remaining,
-            buf + sampleOffset, 0, 2,
-            buf + sampleOffset, 1, 2);
-        if (result != FLUID_OK) return false;
+void SynthEngine::endOfflineRender() {
+    if (!offlineActive_) return;
+    offlineActive_ = false;
+
+    partitions_.allSoundsOff();
+    sequencer_.reset();
+    midiSequencer_.reset();
+    metronome_.reset();
+    applyQualityTier(governor_.tier());
+
+    if (resumeAfterOffline_) {
+        start();
     }
+    LOGD("SynthEngine: offline render end (resumed=%d)", resumeAfterOffline_ ? 1 : 0);
+}
 
+bool SynthEngine::createDetachedSynth(SynthPartitions& out) const {
+    if (!soundFontLoaded_.load(std::memory_order_acquire)) return false;
+    // The SoundFont's samples come from FluidSynth's sample cache, so
+    // this costs voice and channel state, not another copy of the SF2.
+    if (!out.create(settings_, soundFontPath_, 1)) {
+        LOGE("SynthEngine: failed to create a detached synth");
+        return false;
+    }
+    applyTier(out, SynthQualityTier::Full);
     return true;
 }
 
 // ── Render thread ──────────────────────────────────────────────────────────
 
+/** Time one render chunk lasts at [rate]: its real-time budget. */
+static uint64_t chunkBudgetNanos(int32_t rate) {
+    return static_cast<uint64_t>(kSynthRenderChunkFrames) * 1000000000ULL /
+           static_cast<uint64_t>(std::max(rate, 1));
+}
+
+int32_t SynthEngine::applyRenderThreadPolicy(PerformanceHintSession& hint) {
+    ThreadPolicy::applyToCurrentThread(ThreadRole::SynthRender);
+    ThreadPolicySettings settings = ThreadPolicy::settings();
+    hint.close();
+    if (settings.performanceHint) {
+        int32_t threads[1 + kMaxSynthPartitions];
+        threads[0] = ThreadPolicy::currentThreadId();
+        size_t count = 1 + partitions_.workerThreadIds(threads + 1, kMaxSynthPartitions);
+        int32_t rate = transport_.sampleRate.load(std::memory_order_relaxed);
+        hint.open(threads, count, static_cast<int64_t>(
+                      chunkBudgetNanos(rate) * settings.hintTargetPercent / 100));
+    }
+    return settings.hintTargetPercent;
+}
+
 void SynthEngine::renderThreadFunc() {
     constexpr size_t kChunkSamples = kSynthRenderChunkFrames * kOutputChannelCount;
     float renderBuf[kChunkSamples];
 
+    // Re-applied whenever the thread policy changes
+    uint32_t policy = ThreadPolicy::generation();
+    PerformanceHintSession hint;
+    int32_t hintPercent = applyRenderThreadPolicy(hint);
+
     while (running_.load(std::memory_order_acquire)) {
+        if (policy != ThreadPolicy::generation()) {
+            policy = ThreadPolicy::generation();
+            hintPercent = applyRenderThreadPolicy(hint);
+        }
+
+        // Sequencer switches queued since the last chunk
+        drainCommands();
+
         // Handle flush (triggered by seek/loop/play)
         if (flushRequested_.load(std::memory_order_acquire)) {
-            ringBuffer_.reset();
-            if (synth_) {
-                // CC 120 (All Sound Off) kills notes instantly with no release
-                // tail, giving a clean loop transition
-                fluid_synth_all_sounds_off(FS_SYNTH, -1);  // -1 = all channels
-            }
+            ringEpoch_.fetch_add(1, std::memory_order_release);
+            writtenSinceFlush_ = 0;
+            // CC 120 (All Sound Off) kills notes instantly with no release
+            // tail, giving a clean loop transition
+            partitions_.allSoundsOff();
             sequencer_.reset();
             metronome_.reset();
             renderPos_ = transport_.posFrames.load(std::memory_order_relaxed);
-            midiSequencer_.resetToPosition(renderPos_);
+            seekMidi(renderPos_);
             // Re-arm per-channel programs from the render thread so the
             // first noteOn after the flush lands on the correct preset.
             // The all-sounds-off above clears voices but the channel's
-            // preset assignment can drift if updateMidiTracks raced with
-            // the previous run -- this guarantees a clean baseline.
+            // preset assignment can drift if stageMidiTracks raced with
+            // the previous run. A no-op unless the channel map changed.
             reissueProgramChanges();
             flushRequested_.store(false, std::memory_order_release);
         }
 
         // Preview flush: drop queued audio so a freshly-fired preview
-        // noteOn isn't buried behind the ring buffer's near-capacity
-        // (~186ms) backlog of silence. Only honored when paused -- during
-        // playback the flush would glitch the arrangement audio, and the
-        // user is hearing scheduled notes anyway.
+        // noteOn isn't buried behind a backlog left over from the Play
+        // profile. Only honored when paused -- during playback the flush
+        // would glitch the arrangement audio, and the user is hearing
+        // scheduled notes anyway.
         if (previewFlushRequested_.exchange(false, std::memory_order_acq_rel) &&
             !transport_.playing.load(std::memory_order_relaxed)) {
-            ringBuffer_.reset();
+            ringEpoch_.fetch_add(1, std::memory_order_release);
+            writtenSinceFlush_ = 0;
         }
 
         // Track play/pause transitions
@@ -354,60 +775,74 @@ void SynthEngine::renderThreadFunc() {
             // pendingStartPos avoids a race where the audio callback
             // advances posFrames before this thread wakes up, which would
             // cause notes at the start position (e.g. frame 0) to be skipped.
-            ringBuffer_.reset();
+            ringEpoch_.fetch_add(1, std::memory_order_release);
+            writtenSinceFlush_ = 0;
             renderPos_ = transport_.pendingStartPos.load(std::memory_order_acquire);
             sequencer_.reset();
-            midiSequencer_.resetToPosition(renderPos_);
+            seekMidi(renderPos_);
             metronome_.reset();
         }
         if (!playing && wasPlaying_) {
             // Play stopped -- kill notes instantly (CC 120, no release tail)
-            if (synth_) {
-                fluid_synth_all_sounds_off(FS_SYNTH, -1);
-            }
+            partitions_.allSoundsOff();
             sequencer_.reset();
             midiSequencer_.reset();
             metronome_.reset();
         }
         wasPlaying_ = playing;
 
-        // Buffer-full backpressure runs in both playing and paused states.
-        // The render thread keeps cycling when paused so direct synth calls
-        // (preview notes via synthNoteOn) produce audible output without
-        // requiring transport.playing -- otherwise FluidSynth voice changes
-        // would never reach the audio ring buffer.
-        size_t buffered = ringBuffer_.availableToRead();
-        if (buffered + kChunkSamples > kSynthRingBufferCapacity) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        // Beats fired by the last chunk, or the reset above
+        {
+            EngineStatus::Writer status(status_, kStatSynthSeq);
+            status.set(kStatMetronomeBeatFrame, metronome_.getLastBeatFrame());
+        }
+
+        // Idle: paused, every voice done and the output silent for a
+        // while. Park rather than render silence; wake() and the playing
+        // callback bring the thread back. The token is taken before the
+        // last check so a wake() racing with it isn't lost.
+        if (playing || wakeRequested_.exchange(false, std::memory_order_acq_rel)) {
+            silentChunks_ = 0;
+            idle_.store(false, std::memory_order_release);
+        }
+        int32_t idleChunks = transport_.sampleRate.load(std::memory_order_relaxed) / 1000 *
+                             kSynthIdleAfterMs / kSynthRenderChunkFrames;
+        if (silentChunks_ >= idleChunks) {
+            uint32_t token = consumedSignal_.prepareWait();
+            if (!wakeRequested_.load(std::memory_order_acquire)) {
+                idle_.store(true, std::memory_order_release);
+                consumedSignal_.waitFor(token, kRenderParkTimeout);
+            }
             continue;
         }
 
+        // Demand-driven backpressure, in both playing and paused states:
+        // render until the ring holds the active profile's target, then
+        // park until the callback consumes a burst. Until it goes idle
+        // the render thread keeps cycling when paused so direct synth
+        // calls (preview notes via synthNoteOn) produce audible output
+        // without requiring transport.playing -- otherwise FluidSynth
+        // voice changes would never reach the audio ring buffer. The shallow paused target is
+        // what bounds preview latency. Stale chunks the callback has yet
+        // to drop take room but don't count towards the target.
+        size_t queued = ringBuffer_.availableToRead();
+        size_t buffered = std::min(queued, writtenSinceFlush_);
+        auto target = static_cast<size_t>(targetFillFrames(playing)) * kOutputChannelCount;
+        if (buffered >= target || queued + kChunkSamples > kSynthRingBufferCapacity) {
+            consumedSignal_.waitFor(kRenderIdleTimeout);
+            continue;
+        }
+
+        uint64_t chunkStartNanos = EngineTelemetry::nowNanos();
+
         // Collect timed events from sequencers ONLY while playing. When
         // paused we still render audio (so previewed voices are heard) but
         // don't advance the timeline or fire scheduled events.
         mergedEvents_.clear();
 
         if (playing) {
-            if (sequencerEnabled_.load(std::memory_order_relaxed)) {
-                double bpm = transport_.bpm.load(std::memory_order_relaxed);
-                const auto& events = sequencer_.tick(
-                    renderPos_, kSynthRenderChunkFrames, bpm);
-                mergedEvents_.insert(mergedEvents_.end(), events.begin(), events.end());
-            }
-
-            if (midiSequencerEnabled_.load(std::memory_order_relaxed)) {
-                const auto& midiEvents = midiSequencer_.tick(
-                    renderPos_, kSynthRenderChunkFrames);
-                mergedEvents_.insert(mergedEvents_.end(), midiEvents.begin(), midiEvents.end());
-            }
-
-            // Metronome tick (uses its own enabled_ atomic)
-            if (metronome_.isEnabled()) {
-                double bpm = transport_.bpm.load(std::memory_order_relaxed);
-                const auto& metEvents = metronome_.tick(
-                    renderPos_, kSynthRenderChunkFrames, bpm);
-                mergedEvents_.insert(mergedEvents_.end(), metEvents.begin(), metEvents.end());
-            }
+            collectTimelineEvents(renderPos_, kSynthRenderChunkFrames,
+                                  metronome_.isEnabled());
         }
 
         // Sub-buffer scheduling: split FluidSynth render at event boundaries
@@ -415,12 +850,46 @@ void SynthEngine::renderThreadFunc() {
         // mergedEvents_ vector (paused with no preview voices) the synth
         // renders silence over the full chunk; with active preview voices
         // it renders their decay tail.
-        if (!renderSubBuffer(renderBuf, kSynthRenderChunkFrames, mergedEvents_)) {
+        //
+        // Every write is a whole chunk and the ring holds whole chunks, so
+        // the free space never wraps mid-chunk and FluidSynth renders
+        // straight into ring memory; renderBuf only backs that up.
+        auto free = ringBuffer_.reserveWrite(kChunkSamples);
+        bool inPlace = free.first.size == kChunkSamples;
+        float* dst = inPlace ? free.first.data : renderBuf;
+        if (!renderSubBuffer(dst, kSynthRenderChunkFrames, mergedEvents_)) {
             std::this_thread::sleep_for(std::chrono::milliseconds(5));
             continue;
         }
+        if (!playing) {
+            bool silent = partitions_.activeVoiceCount() == 0 &&
+                          peakAbs(dst, kChunkSamples) < kSynthSilenceThreshold;
+            silentChunks_ = silent ? silentChunks_ + 1 : 0;
+        }
 
-        ringBuffer_.write(renderBuf, kChunkSamples);
+        // Samples first: the tag's release publishes the whole chunk
+        if (inPlace) {
+            ringBuffer_.commitWrite(kChunkSamples);
+        } else {
+            ringBuffer_.write(renderBuf, kChunkSamples);
+        }
+        SynthChunkTag tag;
+        tag.frame = playing ? renderPos_ : kUntimedChunk;
+        tag.epoch = ringEpoch_.load(std::memory_order_relaxed);
+        chunkTags_.push(&tag, 1);
+        writtenSinceFlush_ += kChunkSamples;
+        uint64_t chunkNanos = EngineTelemetry::nowNanos() - chunkStartNanos;
+        telemetry_.recordRenderChunk(chunkNanos, buffered / kOutputChannelCount);
+
+        // The chunk lasts kSynthRenderChunkFrames of output; rendering it
+        // must take comfortably less than that.
+        uint64_t budgetNanos =
+            chunkBudgetNanos(transport_.sampleRate.load(std::memory_order_relaxed));
+        if (governor_.onChunk(chunkNanos, budgetNanos)) {
+            applyQualityTier(governor_.tier());
+        }
+        hint.reportActual(static_cast<int64_t>(chunkNanos));
+        hint.updateTarget(static_cast<int64_t>(budgetNanos * hintPercent / 100));
 
         // Timeline advance + loop detection are playback-only: when paused
         // the render position stays put so a subsequent play() resumes
@@ -437,26 +906,27 @@ void SynthEngine::renderThreadFunc() {
         int64_t loopStart = transport_.loopStartFrames.load(std::memory_order_relaxed);
         if (loopStart >= 0 && loopEnd > loopStart && renderPos_ >= loopEnd) {
             int64_t overshoot = renderPos_ - loopEnd;
-            if (synth_) {
-                fluid_synth_all_sounds_off(FS_SYNTH, -1);
-            }
+            // A loop set behind the playhead restarts it at loopStart
+            if (overshoot >= loopEnd - loopStart) overshoot = 0;
+            partitions_.allSoundsOff();
             sequencer_.reset();
-            midiSequencer_.resetToPosition(loopStart);
+            seekMidi(loopStart);
             metronome_.reset();
             // Re-arm programs at the loop boundary so the first noteOn
-            // of the next iteration lands on the correct preset, even
-            // if a stray program-change drifted the channel state.
+            // of the next iteration lands on the correct preset; only
+            // channels the map moved since the last pass are touched.
             reissueProgramChanges();
 
             // Tick sequencers for the overshoot frames so events at
             // loopStart are not skipped on loop wrap
             if (overshoot > 0) {
                 auto overshootFrames = static_cast<int32_t>(overshoot);
+                int32_t sampleRate = transport_.sampleRate.load(std::memory_order_relaxed);
+                TempoTrack::ReadGuard tempo(tempo_, kTempoReader);
 
                 if (sequencerEnabled_.load(std::memory_order_relaxed)) {
-                    double bpm = transport_.bpm.load(std::memory_order_relaxed);
                     const auto& events = sequencer_.tick(
-                        loopStart, overshootFrames, bpm);
+                        loopStart, overshootFrames, *tempo, sampleRate);
                     for (const auto& e : events) {
                         fireEvent(e);
                     }
@@ -464,16 +934,15 @@ void SynthEngine::renderThreadFunc() {
 
                 if (midiSequencerEnabled_.load(std::memory_order_relaxed)) {
                     const auto& midiEvents = midiSequencer_.tick(
-                        loopStart, overshootFrames);
+                        loopStart, overshootFrames, *tempo, sampleRate);
                     for (const auto& e : midiEvents) {
                         fireEvent(e);
                     }
                 }
 
                 if (metronome_.isEnabled()) {
-                    double bpm = transport_.bpm.load(std::memory_order_relaxed);
                     const auto& metEvents = metronome_.tick(
-                        loopStart, overshootFrames, bpm);
+                        loopStart, overshootFrames, *tempo, sampleRate);
                     for (const auto& e : metEvents) {
                         fireEvent(e);
                     }
@@ -486,6 +955,6 @@ void SynthEngine::renderThreadFunc() {
 }
 
 #undef FS_SETTINGS
-#undef FS_SYNTH
+#undef FS_CHANNEL
 
 }  // namespace nightjar
@@ -1,10 +1,19 @@
 #pragma once
 
 #include "common.h"
+#include "command_ring.h"
+#include "engine_status.h"
+#include "engine_telemetry.h"
+#include "event_signal.h"
 #include "spsc_ring_buffer.h"
 #include "step_sequencer.h"
 #include "midi_sequencer.h"
 #include "metronome_sequencer.h"
+#include "synth_channel_map.h"
+#include "synth_load_governor.h"
+#include "synth_partitions.h"
+#include "tempo_map.h"
+#include "thread_policy.h"
 #include <atomic>
 #include <thread>
 #include <string>
@@ -14,14 +23,83 @@ namespace nightjar {
 struct AtomicTransport;
 
 // Synth ring buffer: 16384 float samples = 8192 stereo frames = ~186ms at 44.1kHz.
-// Large enough to absorb render-thread scheduling jitter, small enough for
-// acceptable latency when flushing on seek/loop.
+// This is only the ceiling; the render thread keeps the ring filled to the
+// active latency profile's target (see SynthLatencyProfile), which is far
+// below capacity.
 static constexpr size_t kSynthRingBufferCapacity = 16384;
 
 // Render chunk: 256 frames = ~5.8ms at 44.1kHz. Small chunks keep the
 // render thread responsive to flush requests and volume changes.
 static constexpr int32_t kSynthRenderChunkFrames = 256;
 
+// Chunks the ring holds when full; one SynthChunkTag is queued per chunk.
+static constexpr size_t kSynthRingChunks =
+    kSynthRingBufferCapacity / (kSynthRenderChunkFrames * kOutputChannelCount);
+static_assert(kSynthRingChunks * kSynthRenderChunkFrames * kOutputChannelCount ==
+              kSynthRingBufferCapacity, "the ring holds whole chunks");
+
+// Ring fill targets per latency profile, in output bursts, with a floor in
+// frames so devices with tiny bursts still keep a chunk or two of headroom.
+static constexpr int32_t kPlayFillBursts = 8;
+static constexpr int32_t kPlayMinFillFrames = 2048;                       // ~46ms
+static constexpr int32_t kLiveInputFillBursts = 2;
+static constexpr int32_t kLiveInputMinFillFrames = 2 * kSynthRenderChunkFrames;  // ~12ms
+
+// Burst size assumed until the playback stream reports the real one.
+static constexpr int32_t kDefaultFramesPerBurst = 192;
+
+// The paused render thread parks once it has rendered this long with no
+// active voices and every sample below kSynthSilenceThreshold (~-100 dBFS),
+// which lets reverb tails ring out first.
+static constexpr int32_t kSynthIdleAfterMs = 250;
+static constexpr float kSynthSilenceThreshold = 1.0e-5f;
+
+/**
+ * Where one rendered chunk sits on the timeline, queued alongside its
+ * samples. [frame] is the timeline frame of the chunk's first sample, or
+ * kUntimedChunk for a chunk rendered while paused (preview voices only).
+ * [epoch] is the flush it was rendered after; older chunks are stale.
+ */
+struct SynthChunkTag {
+    int64_t frame = 0;
+    uint32_t epoch = 0;
+};
+
+static constexpr int64_t kUntimedChunk = INT64_MIN;
+
+/**
+ * A sequencer control change queued for the render thread
+ * (SynthEngine::post()). The Commit ops swap in the drum or MIDI
+ * snapshot last staged on the UI thread.
+ */
+struct SynthCommand {
+    enum class Op : int32_t {
+        DrumSequencerEnabled,
+        MidiSequencerEnabled,
+        CommitDrumPatterns,
+        CommitMidiTracks,
+    };
+
+    Op op = Op::DrumSequencerEnabled;
+    int32_t value = 0;
+};
+
+// Sequencer control changes queued between two render chunks.
+static constexpr size_t kSynthCommandCapacity = 64;
+
+/**
+ * How far ahead of the audio callback the render thread works.
+ *
+ * Play keeps a deeper queue so arrangement playback rides out scheduling
+ * jitter. LiveInput keeps just enough to cover a couple of bursts so
+ * directly played or auditioned notes are heard within ~15ms. The
+ * transport being paused always uses LiveInput.
+ */
+enum class SynthLatencyProfile : int32_t {
+    Play = 0,
+    LiveInput = 1,
+};
+
 /**
  * FluidSynth wrapper with a dedicated render thread and integrated step sequencer.
  *
@@ -39,10 +117,52 @@ static constexpr int32_t kSynthRenderChunkFrames = 256;
  * MIDI events (noteOn/noteOff) go directly to FluidSynth, which is
  * internally thread-safe (uses its own mutex). These calls are fine from
  * any thread since they never touch the audio callback.
+ *
+ * Synthesis is split across SynthPartitions: one FluidSynth instance per
+ * partition, each owning kSynthInstanceChannels MIDI channels. Each render
+ * chunk the partitions render in parallel on worker threads and are summed
+ * before the result goes into the ring buffer. The partition count follows
+ * the device's core count.
+ *
+ * Callers play logical channels (one per track, any number up to
+ * kMaxLogicalChannels); SynthChannelMap binds them to synth channels by
+ * use and owns each synth channel's program. Its edits are applied to the
+ * synth on the calling thread, and every event is mapped on its way in.
+ *
+ * A SynthLoadGovernor watches how much of each chunk's real-time budget
+ * the render took and trades polyphony, reverb and interpolation quality
+ * for headroom when the device can't keep up (see SynthQualityTier).
+ * Voice stealing is biased to keep drums and recently started notes, and
+ * to take release tails first. Offline exports always render at Full.
+ *
+ * Sequencer switches from the command channel arrive through post() and
+ * are applied by the render thread before its next chunk, so a batch
+ * takes effect on one chunk boundary, on the thread that owns the voices.
+ * The render thread publishes the metronome's last beat into the synth
+ * section of EngineStatus as it goes.
+ *
+ * Every chunk in the ring is tagged with the timeline frame it was
+ * rendered for (SynthChunkTag). While playing, the callback reads with
+ * readFramesAt() at its own block position: late synth audio is skipped,
+ * early audio waits behind silence, and each correction is counted in
+ * EngineTelemetry, so the synth stays sample-locked to the WAV tracks
+ * however full the ring was. Flushes never touch the ring from the render
+ * thread; they start a new epoch and the callback drops the older chunks.
+ *
+ * The render thread and partition workers run under ThreadPolicy; each
+ * chunk's render time is reported to a performance hint session against
+ * a fraction of the chunk's duration.
+ *
+ * While paused and silent (see kSynthIdleAfterMs) the render thread
+ * parks instead of filling the ring with silence, and isIdle() tells the
+ * playback stream nothing is sounding. noteOn() wakes it, as do play
+ * (through the callback) and control requests; the ring is empty by
+ * then, so the first chunk after a wake is heard on the next burst.
  */
 class SynthEngine {
 public:
-    explicit SynthEngine(AtomicTransport& transport);
+    SynthEngine(AtomicTransport& transport, const TempoTrack& tempo, Reclaimer& reclaimer,
+                EngineTelemetry& telemetry, EngineStatus& status);
     ~SynthEngine();
 
     // Non-copyable, non-movable
@@ -52,8 +172,16 @@ public:
     /**
      * Load a SoundFont (.sf2) file by absolute path.
      * Must be called before start(). Returns true on success.
+     *
+     * With [lazySamples] only the preset tables are read up front; a
+     * preset's samples load when a channel first selects it and are
+     * released once no channel (or pin) uses it. Each partition starts
+     * with the default piano and the percussion kit, which stays pinned;
+     * a project's instruments load when stageMidiTracks() assigns them
+     * and an audition's when programChange() selects it. Otherwise every
+     * preset's samples load now, as before.
      */
-    bool loadSoundFont(const std::string& path);
+    bool loadSoundFont(const std::string& path, bool lazySamples);
 
     /** Start the render thread. Requires a loaded SoundFont. */
     void start();
@@ -68,9 +196,29 @@ public:
      * @param output Stereo interleaved float buffer to sum into.
      * @param numFrames Number of stereo frames to read.
      * @return Number of frames actually read (may be less on underrun).
+     *         Short reads and underruns are counted in EngineTelemetry.
+     *
+     * Used while paused: chunks are played in order whatever their
+     * timeline frame.
      */
     int32_t readFrames(float* output, int32_t numFrames);
 
+    /**
+     * readFrames() for a playing transport: ADD the synth audio for the
+     * timeline frames [timelineFrame, timelineFrame + numFrames), read
+     * against the chunk tags. Frames the ring has no audio for stay as
+     * they are. Audio thread only.
+     */
+    int32_t readFramesAt(float* output, int32_t numFrames, int64_t timelineFrame);
+
+    /**
+     * True once the ring holds audio rendered for [timelineFrame], after
+     * dropping stale and earlier chunks. The callback holds a play start
+     * until then (bounded), so the first block is already aligned.
+     * Audio thread only.
+     */
+    bool isPrimedAt(int64_t timelineFrame);
+
     /** Send a MIDI note-on. Thread-safe (FluidSynth uses internal mutex). */
     void noteOn(int channel, int note, int velocity);
 
@@ -91,30 +239,100 @@ public:
     void requestFlush();
 
     /** Drop pre-rendered audio from the ring buffer WITHOUT silencing
-     *  active voices. Used by the preview path so a freshly-fired
-     *  synthNoteOn isn't buried behind ~186ms of queued silence (the
-     *  ring buffer's near-capacity steady state when paused). The
-     *  render thread honors this only when transport is paused;
-     *  during playback the flag is consumed without flushing to avoid
-     *  a glitch in arrangement audio. */
+     *  active voices. The paused ring only holds the LiveInput target,
+     *  so this mainly matters right after a pause, when the Play
+     *  profile's deeper backlog is still queued. The render thread
+     *  honors this only when transport is paused; during playback the
+     *  flag is consumed without flushing to avoid a glitch in
+     *  arrangement audio. */
     void requestPreviewFlush();
 
+    /** Output stream burst size; ring fill targets scale with it.
+     *  Called by the playback stream whenever it (re)opens. */
+    void setFramesPerBurst(int32_t framesPerBurst);
+
+    /** Profile used while the transport is playing (paused always uses
+     *  LiveInput). Lock-free. */
+    void setLatencyProfile(SynthLatencyProfile profile);
+
+    /** Ring fill target in frames for the given transport state. */
+    int32_t targetFillFrames(bool playing) const;
+
     /** Immediately silence all sounding notes on all channels (CC 120). */
     void allSoundsOff();
 
     bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+    /** True while the render thread is parked: paused, no voices, silent. Any thread. */
+    bool isIdle() const { return idle_.load(std::memory_order_acquire); }
     bool isSoundFontLoaded() const { return soundFontLoaded_.load(std::memory_order_acquire); }
 
+    // ── Offline rendering (export) ───────────────────────────────────────
+
+    /**
+     * Hand FluidSynth and the sequencers to a non-real-time caller.
+     * Stops the render thread (restarted by endOfflineRender() if it was
+     * running), silences all voices and aligns every sequencer cursor to
+     * [startPos]. Returns false if no SoundFont is loaded or an offline
+     * render is already in progress.
+     */
+    bool beginOfflineRender(int64_t startPos, bool includeMetronome);
+
+    /**
+     * Render the next [numFrames] of timeline audio into [output]
+     * (stereo interleaved, overwritten -- not summed, master volume NOT
+     * applied). Events are collected on the same 256-frame chunk grid as
+     * the render thread so timing is sample-identical to live playback.
+     */
+    bool renderOffline(float* output, int32_t numFrames);
+
+    /** Leave offline mode and restart the render thread if it was running. */
+    void endOfflineRender();
+
+    /**
+     * Create a private single-partition synth in [out] from this
+     * engine's settings and SoundFont, at Full quality. It renders next
+     * to the live synth without touching its voices or sequencers (see
+     * TrackFreezer). Returns false if no SoundFont is loaded. Any thread.
+     */
+    bool createDetachedSynth(SynthPartitions& out) const;
+
+    /** Master synth volume as applied by readFrames(). */
+    float getVolume() const { return volume_.load(std::memory_order_relaxed); }
+
+    /** Quality tier the governor currently renders at. Any thread. */
+    SynthQualityTier getQualityTier() const { return governor_.tier(); }
+
+    /** Smoothed render load as a fraction of the real-time budget. Any thread. */
+    float getRenderLoad() const { return governor_.load(); }
+
 private:
-    /** Re-issue the per-channel program changes for every active MIDI
-     *  track from the render thread. Called on flush, play-after-pause,
-     *  and loop-wrap so the first noteOn at the new position lands on
-     *  the correct preset. The original updateMidiTracks() call sends
-     *  program changes from the UI thread, which races with the render
-     *  thread firing scheduled noteOns -- without this re-arm, the
-     *  first pass of any clip after a transport transition can sound
-     *  as Acoustic Grand. */
+    /** Re-issue the channel map's program on every synth channel from
+     *  the render thread. Called on flush, play-after-pause, and
+     *  loop-wrap so the first noteOn at the new position lands on the
+     *  correct preset. The assigning call sends program changes from the
+     *  UI thread, which races with the render thread firing scheduled
+     *  noteOns -- without this re-arm, the first pass of any clip after
+     *  a transport transition can sound as Acoustic Grand. Skipped while
+     *  the map's generation is the one last reissued. */
     void reissueProgramChanges();
+
+    /** Program change on synth channel [physical], skipped when it
+     *  already plays [program]: with lazy samples, reselecting a preset
+     *  would drop its samples and read them back from the file. */
+    void selectProgram(int physical, int program);
+
+    /** Send what a channel map edit changed to the synth. With lazy
+     *  samples each newly selected preset is read in on sampleLoader_
+     *  first, so the partition's program change only takes cached
+     *  samples while it holds the lock its render needs. UI thread. */
+    void applyChannelChanges(const std::vector<SynthChannelMap::ChannelChange>& changes);
+
+    /** kSynthChannelReleaseMs at the engine rate. */
+    int64_t channelReleaseFrames() const;
+
+    /** Bring a parked render thread back before new voices start. Any thread. */
+    void wake();
 public:
 
     // ── Step sequencer control ──────────────────────────────────────────
@@ -126,20 +344,43 @@ public:
                            const std::vector<int64_t>& clipOffsetFrames = {},
                            int beatsPerBar = 4);
 
-    /** Replace the drum pattern with per-clip data. Called from UI thread via JNI. */
-    void updateDrumPatternClips(float volume, bool muted,
-                                const std::vector<StepSequencer::ClipSlot>& clips);
+    /**
+     * Build the snapshot replacing the drum pattern pool and clip
+     * placements; it plays once a CommitDrumPatterns command is applied.
+     * Called from UI thread via JNI.
+     */
+    void stageDrumPatternClips(float volume, bool muted,
+                               const std::vector<StepSequencer::PatternData>& patterns,
+                               const std::vector<StepSequencer::ClipPlacement>& clips);
 
     /** Enable/disable the step sequencer. */
     void setSequencerEnabled(bool enabled);
 
+    /**
+     * Queue [count] sequencer control changes for the render thread,
+     * which applies them together before its next chunk. Applied right
+     * away when the render thread isn't running or they don't fit the
+     * queue. Callers serialize.
+     */
+    void post(const SynthCommand* commands, size_t count);
+
     /** Get max end frame from the step sequencer for timeline length. */
-    int64_t getSequencerMaxEndFrame(double bpm) const;
+    int64_t getSequencerMaxEndFrame() const;
 
     // ── MIDI sequencer control ───────────────────────────────────────────
 
-    /** Replace all MIDI track data. Called from UI thread via JNI. */
-    void updateMidiTracks(const std::vector<MidiTrackData>& tracks);
+    /**
+     * Build the snapshot replacing all MIDI track data; it plays once a
+     * CommitMidiTracks command is applied. Called from UI thread via JNI.
+     */
+    void stageMidiTracks(std::vector<MidiTrackData> tracks);
+
+    /** Replace one MIDI track by index. Called from UI thread via JNI. */
+    bool replaceMidiTrack(int trackIndex, MidiTrackData track);
+
+    /** Replace one MIDI track's clips starting in [startFrame, endFrame). */
+    bool replaceMidiTrackRange(int trackIndex, int64_t startFrame, int64_t endFrame,
+                               const std::vector<MidiClipData>& clips);
 
     /** Enable/disable the MIDI sequencer. */
     void setMidiSequencerEnabled(bool enabled);
@@ -151,12 +392,15 @@ public:
 
     void setMetronomeEnabled(bool enabled);
     void setMetronomeVolume(float volume);
-    void setMetronomeBeatsPerBar(int beatsPerBar);
     int64_t getLastMetronomeBeatFrame() const;
 
 private:
     void renderThreadFunc();
 
+    /** Apply ThreadPolicy to the render thread and (re)open [hint] over
+     *  it and the partition workers. Returns the hint target percentage. */
+    int32_t applyRenderThreadPolicy(PerformanceHintSession& hint);
+
     /**
      * Sub-buffer scheduling: render a chunk by splitting fluid_synth_write_float()
      * at event boundaries so MIDI events fire at exact sample positions.
@@ -168,13 +412,69 @@ private:
     /** Fire a single NoteEvent into FluidSynth. */
     void fireEvent(const NoteEvent& e);
 
+    /** Set [tier]'s polyphony, reverb and interpolation on every partition. */
+    void applyQualityTier(SynthQualityTier tier);
+
+    /** Append drum, MIDI and (optionally) metronome events for the chunk
+     *  [pos, pos + frames) to mergedEvents_. Shared by the render thread
+     *  and the offline path so both schedule identically. */
+    void collectTimelineEvents(int64_t pos, int32_t frames, bool includeMetronome);
+
+    /** Re-seek the MIDI cursors to [pos] under the current tempo map. */
+    void seekMidi(int64_t pos);
+
+    void applyCommand(const SynthCommand& command);
+
+    // Ring consumer side (audio callback only)
+
+    /** The chunk at the read head after dropping stale ones; null if none. */
+    const SynthChunkTag* currentChunk();
+
+    /** Skip chunks until the head holds audio for [timelineFrame] or later,
+     *  then return how many frames early the head is; -1 if the ring ran
+     *  out. Counts each correction. */
+    int64_t alignTo(int64_t timelineFrame);
+
+    /** Take [frames] from the head chunk and ADD them into [output] at
+     *  [volume]; a null [output] discards them. */
+    void consumeChunkFrames(float* output, int32_t frames, float volume);
+
+    /** Apply everything post() queued. The queue's consumer only: the
+     *  render thread, or stop() once it has joined it. */
+    void drainCommands();
+
+    /** Hazard slot of the render side on the tempo map (render thread,
+     *  or the offline renderer while the render thread is stopped). */
+    static constexpr int kTempoReader = 0;
+
     AtomicTransport& transport_;
+    const TempoTrack& tempo_;
+    EngineTelemetry& telemetry_;
+    EngineStatus& status_;
 
     void* settings_ = nullptr;   // fluid_settings_t* (avoid header dependency)
-    void* synth_ = nullptr;      // fluid_synth_t*
-    int sfontId_ = -1;
+    std::string soundFontPath_;  // set once loadSoundFont() succeeds
+
+    /** With lazy samples, one synth that is never rendered, with the
+     *  SoundFont loaded. Pinning a preset on it reads the samples from
+     *  the file into FluidSynth's sample cache under its own lock
+     *  rather than a render partition's. Empty otherwise. UI thread. */
+    SynthPartitions sampleLoader_;
+
+    /** The FluidSynth instances; channels are split between them and
+     *  rendered in parallel. Empty until loadSoundFont() succeeds. */
+    SynthPartitions partitions_;
+    bool hasSynth() const { return !partitions_.empty(); }
+
+    /** Logical channels to synth channels; configured with partitions_. */
+    SynthChannelMap channelMap_;
+    uint64_t reissuedGeneration_ = 0;  // render side: map generation last reissued
 
     SpscRingBuffer<kSynthRingBufferCapacity> ringBuffer_;
+    CommandRing<SynthChunkTag, kSynthRingChunks> chunkTags_;  // one per chunk in ringBuffer_
+    std::atomic<uint32_t> ringEpoch_{0};  // bumped by each flush (render thread)
+    size_t writtenSinceFlush_ = 0;        // render thread: samples queued this epoch
+    int32_t chunkOffset_ = 0;             // callback: frames already read from the head chunk
 
     std::thread renderThread_;
     std::atomic<bool> running_{false};
@@ -182,6 +482,18 @@ private:
     std::atomic<float> volume_{1.0f};
     std::atomic<bool> flushRequested_{false};
     std::atomic<bool> previewFlushRequested_{false};
+    std::atomic<bool> idle_{false};           // render thread parked (see isIdle())
+    std::atomic<bool> wakeRequested_{false};  // set by wake(), taken by the render thread
+    int32_t silentChunks_ = 0;                // render thread: silent paused chunks in a row
+    std::atomic<int32_t> framesPerBurst_{kDefaultFramesPerBurst};
+    std::atomic<SynthLatencyProfile> playProfile_{SynthLatencyProfile::Play};
+
+    /** Adapts rendering quality to the measured render load. */
+    SynthLoadGovernor governor_;
+
+    /** Raised by readFrames() (and control requests) to wake the render
+     *  thread once the ring has room below its fill target. */
+    EventSignal consumedSignal_;
 
     // Step sequencer
     StepSequencer sequencer_;
@@ -194,9 +506,17 @@ private:
     // Metronome
     MetronomeSequencer metronome_;
 
+    CommandRing<SynthCommand, kSynthCommandCapacity> commands_;  // UI -> render thread
+
     int64_t renderPos_ = 0;       // render thread's timeline position
     bool wasPlaying_ = false;     // for detecting play/pause transitions
 
+    // Offline render state (owned by the offline worker while active)
+    bool offlineActive_ = false;
+    bool offlineMetronome_ = false;
+    bool resumeAfterOffline_ = false;
+    int64_t offlinePos_ = 0;
+
     // Scratch buffer for merged events (reused across render iterations)
     std::vector<NoteEvent> mergedEvents_;
 };
@@ -0,0 +1,90 @@
+#include "synth_load_governor.h"
+#include "common.h"
+#include <fluidsynth.h>
+#include <algorithm>
+#include <thread>
+
+namespace nightjar {
+
+// Weight of the newest chunk in the smoothed load (~8-chunk memory).
+static constexpr float kLoadSmoothing = 1.0f / 8.0f;
+
+static const SynthTierSettings kTierSettings[kSynthQualityTierCount] = {
+    {64, true, FLUID_INTERP_4THORDER},
+    {40, true, FLUID_INTERP_4THORDER},
+    {24, false, FLUID_INTERP_LINEAR},
+    {12, false, FLUID_INTERP_LINEAR},
+};
+
+const SynthTierSettings& synthTierSettings(SynthQualityTier tier) {
+    auto index = std::clamp(static_cast<int32_t>(tier), 0, kSynthQualityTierCount - 1);
+    return kTierSettings[index];
+}
+
+SynthQualityTier SynthLoadGovernor::initialTier() {
+    // Four cores or fewer are low-end parts where a full-quality chord
+    // pad overruns the budget before the governor has measured anything.
+    return std::thread::hardware_concurrency() <= 4 ? SynthQualityTier::Reduced
+                                                    : SynthQualityTier::Full;
+}
+
+SynthLoadGovernor::SynthLoadGovernor() : tier_(initialTier()) {}
+
+void SynthLoadGovernor::reset(SynthQualityTier tier) {
+    tier_.store(tier, std::memory_order_relaxed);
+    load_.store(0.0f, std::memory_order_relaxed);
+    smoothed_ = 0.0f;
+    overChunks_ = 0;
+    underChunks_ = 0;
+    settleChunks_ = 0;
+    recoverHold_ = kGovernorRecoverChunks;
+    chunksSinceRecover_ = INT64_MAX / 2;
+}
+
+bool SynthLoadGovernor::onChunk(uint64_t nanos, uint64_t budgetNanos) {
+    if (budgetNanos == 0) return false;
+    float utilization = static_cast<float>(nanos) / static_cast<float>(budgetNanos);
+    smoothed_ += (utilization - smoothed_) * kLoadSmoothing;
+    load_.store(smoothed_, std::memory_order_relaxed);
+    ++chunksSinceRecover_;
+
+    // A long stable stretch earns back the short recovery hold.
+    if (chunksSinceRecover_ > kGovernorMaxRecoverChunks) recoverHold_ = kGovernorRecoverChunks;
+
+    if (settleChunks_ > 0) {
+        --settleChunks_;
+        return false;
+    }
+
+    overChunks_ = smoothed_ > kGovernorDegradeLoad ? overChunks_ + 1 : 0;
+    underChunks_ = smoothed_ < kGovernorRecoverLoad ? underChunks_ + 1 : 0;
+
+    auto current = static_cast<int32_t>(tier());
+    if (overChunks_ >= kGovernorDegradeChunks && current < kSynthQualityTierCount - 1) {
+        // Falling back soon after recovering means the better tier does
+        // not fit: wait twice as long before trying it again.
+        if (chunksSinceRecover_ < recoverHold_) {
+            recoverHold_ = std::min(recoverHold_ * 2, kGovernorMaxRecoverChunks);
+        }
+        moveTo(static_cast<SynthQualityTier>(current + 1));
+        LOGD("SynthLoadGovernor: load %.2f, down to tier %d (recover hold %d chunks)",
+             smoothed_, current + 1, recoverHold_);
+        return true;
+    }
+    if (underChunks_ >= recoverHold_ && current > 0) {
+        moveTo(static_cast<SynthQualityTier>(current - 1));
+        chunksSinceRecover_ = 0;
+        LOGD("SynthLoadGovernor: load %.2f, up to tier %d", smoothed_, current - 1);
+        return true;
+    }
+    return false;
+}
+
+void SynthLoadGovernor::moveTo(SynthQualityTier tier) {
+    tier_.store(tier, std::memory_order_relaxed);
+    overChunks_ = 0;
+    underChunks_ = 0;
+    settleChunks_ = kGovernorSettleChunks;
+}
+
+}  // namespace nightjar
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace nightjar {
+
+/**
+ * Synth quality tiers, from full quality down to the cheapest setting
+ * that still plays everything. Values are mirrored in Kotlin.
+ */
+enum class SynthQualityTier : int32_t {
+    Full = 0,       // 64 voices, reverb, 4th-order interpolation
+    Reduced = 1,    // 40 voices, reverb, 4th-order interpolation
+    Low = 2,        // 24 voices, no reverb, linear interpolation
+    Minimal = 3,    // 12 voices, no reverb, linear interpolation
+};
+
+constexpr int32_t kSynthQualityTierCount = 4;
+
+/** What a tier sets on every FluidSynth partition. */
+struct SynthTierSettings {
+    int32_t polyphony;       // per partition
+    bool reverb;
+    int32_t interpolation;   // fluid_interp value
+};
+
+const SynthTierSettings& synthTierSettings(SynthQualityTier tier);
+
+// Smoothed load above which the governor steps down a tier, and below
+// which it steps back up. The gap between them is the hysteresis band;
+// the target sits in the middle.
+static constexpr float kGovernorDegradeLoad = 0.75f;
+static constexpr float kGovernorRecoverLoad = 0.40f;
+
+// Chunks the smoothed load must stay past a threshold before acting:
+// ~23ms to step down, ~3s to step up at 44.1kHz.
+static constexpr int32_t kGovernorDegradeChunks = 4;
+static constexpr int32_t kGovernorRecoverChunks = 512;
+
+// Longest recovery hold after repeated degrade/recover cycles (~24s).
+static constexpr int32_t kGovernorMaxRecoverChunks = 8 * kGovernorRecoverChunks;
+
+// Chunks after a tier change during which nothing else changes, so the
+// smoothed load reflects the new settings before it is judged again.
+static constexpr int32_t kGovernorSettleChunks = 64;
+
+/**
+ * Keeps synth rendering inside its real-time budget.
+ *
+ * The render thread reports how long each chunk took against the time
+ * the chunk lasts. The governor smooths that utilization and moves one
+ * tier at a time: down once it stays above kGovernorDegradeLoad for a few
+ * chunks, up once it stays below kGovernorRecoverLoad for seconds. A
+ * tier that had to be left again shortly after recovering to it doubles
+ * the recovery hold, so a borderline arrangement settles on the cheaper
+ * tier instead of oscillating.
+ *
+ * onChunk() is called from the render thread only; tier() and load()
+ * may be read from any thread.
+ */
+class SynthLoadGovernor {
+public:
+    /** Starting tier for this device: Reduced on phones with few cores. */
+    static SynthQualityTier initialTier();
+
+    SynthLoadGovernor();
+
+    /**
+     * Record one chunk that took [nanos] of a [budgetNanos] real-time
+     * budget. Returns true if the tier changed and must be applied.
+     */
+    bool onChunk(uint64_t nanos, uint64_t budgetNanos);
+
+    /** Forget the load history and start over at [tier]. */
+    void reset(SynthQualityTier tier);
+
+    SynthQualityTier tier() const { return tier_.load(std::memory_order_relaxed); }
+
+    /** Smoothed render load (fraction of the real-time budget). */
+    float load() const { return load_.load(std::memory_order_relaxed); }
+
+private:
+    void moveTo(SynthQualityTier tier);
+
+    std::atomic<SynthQualityTier> tier_;
+    std::atomic<float> load_{0.0f};
+
+    // Render thread only.
+    float smoothed_ = 0.0f;
+    int32_t overChunks_ = 0;
+    int32_t underChunks_ = 0;
+    int32_t settleChunks_ = 0;
+    int32_t recoverHold_ = kGovernorRecoverChunks;
+    int64_t chunksSinceRecover_ = INT64_MAX / 2;
+};
+
+}  // namespace nightjar
@@ -0,0 +1,249 @@
+#include "synth_partitions.h"
+#include "mix_kernels.h"
+#include "thread_policy.h"
+#include <fluidsynth.h>
+#include <algorithm>
+#include <chrono>
+
+namespace nightjar {
+
+#define FS(synth) static_cast<fluid_synth_t*>(synth)
+
+// Workers park between blocks; the timeout only bounds how long a
+// shutdown request can go unnoticed.
+static constexpr auto kWorkerIdleTimeout = std::chrono::milliseconds(50);
+
+// The caller's wait for workers. A block takes well under its 5.8ms
+// duration; the timeout is a backstop, not a pacing mechanism.
+static constexpr auto kBlockWaitTimeout = std::chrono::milliseconds(2);
+
+/** Apply one NoteEvent (on a physical channel) to [synth]. */
+static void fireInto(fluid_synth_t* synth, const NoteEvent& e) {
+    int channel = SynthPartitions::localChannel(e.channel);
+    if (e.note < 0) {
+        // Sentinel: silence all notes on this channel (mute transition)
+        fluid_synth_all_notes_off(synth, channel);
+    } else if (e.velocity > 0) {
+        fluid_synth_noteon(synth, channel, e.note, e.velocity);
+    } else {
+        fluid_synth_noteoff(synth, channel, e.note);
+    }
+}
+
+SynthPartitions::~SynthPartitions() {
+    destroy();
+}
+
+int32_t SynthPartitions::defaultCount() {
+    auto cores = static_cast<int32_t>(std::thread::hardware_concurrency());
+    return std::clamp((cores - 2) / 2, 1, kMaxSynthPartitions);
+}
+
+bool SynthPartitions::create(void* settings, const std::string& soundFontPath,
+                             int32_t count) {
+    destroy();
+    count = std::clamp(count, 1, kMaxSynthPartitions);
+
+    for (int32_t i = 0; i < count; ++i) {
+        auto partition = std::make_unique<Partition>();
+        partition->synth = new_fluid_synth(static_cast<fluid_settings_t*>(settings));
+        if (!partition->synth) {
+            LOGE("SynthPartitions: failed to create synth %d", i);
+            destroy();
+            return false;
+        }
+        partitions_.push_back(std::move(partition));
+
+        // Later loads of the same file hit FluidSynth's sample cache.
+        if (fluid_synth_sfload(FS(partitions_.back()->synth),
+                               soundFontPath.c_str(), 1) == FLUID_FAILED) {
+            LOGE("SynthPartitions: failed to load SoundFont into synth %d: %s",
+                 i, soundFontPath.c_str());
+            destroy();
+            return false;
+        }
+        partitions_.back()->events.reserve(64);
+    }
+
+    workersRunning_.store(true, std::memory_order_release);
+    for (int32_t i = 1; i < count; ++i) {
+        Partition* p = partitions_[i].get();
+        p->worker = std::thread(&SynthPartitions::workerLoop, this, p);
+    }
+
+    LOGD("SynthPartitions: %d partition(s)", count);
+    return true;
+}
+
+void SynthPartitions::destroy() {
+    workersRunning_.store(false, std::memory_order_release);
+    for (auto& p : partitions_) {
+        p->start.notify();
+        if (p->worker.joinable()) {
+            p->worker.join();
+        }
+    }
+    for (auto& p : partitions_) {
+        if (p->synth) {
+            delete_fluid_synth(FS(p->synth));
+        }
+    }
+    partitions_.clear();
+}
+
+void* SynthPartitions::synthForChannel(int channel) const {
+    if (partitions_.empty()) return nullptr;
+    return partitions_[partitionForChannel(channel)]->synth;
+}
+
+void SynthPartitions::fireEvent(const NoteEvent& e) const {
+    fluid_synth_t* synth = FS(synthForChannel(e.channel));
+    if (synth) fireInto(synth, e);
+}
+
+void SynthPartitions::allSoundsOff() const {
+    for (const auto& p : partitions_) {
+        fluid_synth_all_sounds_off(FS(p->synth), -1);  // -1 = all channels
+    }
+}
+
+int32_t SynthPartitions::activeVoiceCount() const {
+    int32_t voices = 0;
+    for (const auto& p : partitions_) {
+        voices += fluid_synth_get_active_voice_count(FS(p->synth));
+    }
+    return voices;
+}
+
+bool SynthPartitions::render(float* out, int32_t frames, std::vector<NoteEvent>& events) {
+    if (partitions_.empty()) return false;
+    frames = std::min(frames, kMaxPartitionBlockFrames);
+
+    // Sort events by frame offset for correct sub-buffer ordering. Stable
+    // so same-frame events keep their sequencer order.
+    std::stable_sort(events.begin(), events.end(),
+                     [](const NoteEvent& a, const NoteEvent& b) {
+                         return a.frameOffset < b.frameOffset;
+                     });
+
+    const int32_t n = count();
+    if (n == 1) {
+        partitions_[0]->events.swap(events);
+        bool ok = renderPartition(*partitions_[0], out, frames);
+        partitions_[0]->events.swap(events);
+        return ok;
+    }
+
+    // Route events to the partition that owns their channel (order is
+    // preserved, so each partition's list stays sorted).
+    for (auto& p : partitions_) p->events.clear();
+    for (const auto& e : events) {
+        partitions_[partitionForChannel(e.channel)]->events.push_back(e);
+    }
+
+    // Kick the workers, render partition 0 here, then wait for the rest.
+    blockFrames_.store(frames, std::memory_order_relaxed);
+    pending_.store(n - 1, std::memory_order_relaxed);
+    blockSeq_.fetch_add(1, std::memory_order_release);
+    for (int32_t i = 1; i < n; ++i) {
+        partitions_[i]->start.notify();
+    }
+
+    bool ok = renderPartition(*partitions_[0], out, frames);
+
+    for (;;) {
+        uint32_t token = done_.prepareWait();
+        if (pending_.load(std::memory_order_acquire) == 0) break;
+        done_.waitFor(token, kBlockWaitTimeout);
+    }
+
+    int32_t samples = frames * kOutputChannelCount;
+    for (int32_t i = 1; i < n; ++i) {
+        Partition& p = *partitions_[i];
+        ok = ok && p.ok;
+        mixScaled(out, p.buffer, samples, 1.0f);
+    }
+    return ok;
+}
+
+size_t SynthPartitions::workerThreadIds(int32_t* out, size_t max) const {
+    size_t n = 0;
+    for (size_t i = 1; i < partitions_.size() && n < max; ++i) {
+        int32_t id = partitions_[i]->threadId.load(std::memory_order_acquire);
+        if (id != 0) out[n++] = id;
+    }
+    return n;
+}
+
+void SynthPartitions::workerLoop(Partition* partition) {
+    uint64_t seenSeq = blockSeq_.load(std::memory_order_acquire);
+    uint32_t policy = ThreadPolicy::generation();
+    ThreadPolicy::applyToCurrentThread(ThreadRole::SynthWorker);
+    partition->threadId.store(ThreadPolicy::currentThreadId(), std::memory_order_release);
+
+    while (workersRunning_.load(std::memory_order_acquire)) {
+        if (policy != ThreadPolicy::generation()) {
+            policy = ThreadPolicy::generation();
+            ThreadPolicy::applyToCurrentThread(ThreadRole::SynthWorker);
+        }
+
+        uint32_t token = partition->start.prepareWait();
+        uint64_t seq = blockSeq_.load(std::memory_order_acquire);
+        if (seq == seenSeq) {
+            partition->start.waitFor(token, kWorkerIdleTimeout);
+            continue;
+        }
+        seenSeq = seq;
+
+        int32_t frames = blockFrames_.load(std::memory_order_relaxed);
+        partition->ok = renderPartition(*partition, partition->buffer, frames);
+
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done_.notify();
+        }
+    }
+}
+
+bool SynthPartitions::renderPartition(Partition& partition, float* out, int32_t frames) {
+    fluid_synth_t* synth = FS(partition.synth);
+    const auto& events = partition.events;
+
+    if (events.empty()) {
+        // No events -- render the full block in one call
+        return fluid_synth_write_float(synth, frames, out, 0, 2, out, 1, 2) == FLUID_OK;
+    }
+
+    int32_t rendered = 0;
+
+    for (size_t i = 0; i < events.size(); ++i) {
+        int32_t eventFrame = events[i].frameOffset;
+
+        // Render audio up to this event's frame position
+        int32_t framesToRender = eventFrame - rendered;
+        if (framesToRender > 0) {
+            float* dst = out + rendered * kOutputChannelCount;
+            if (fluid_synth_write_float(synth, framesToRender,
+                                        dst, 0, 2, dst, 1, 2) != FLUID_OK) {
+                return false;
+            }
+            rendered += framesToRender;
+        }
+
+        // Fire the event at this exact frame position
+        fireInto(synth, events[i]);
+    }
+
+    // Render remaining frames after the last event
+    int32_t remaining = frames - rendered;
+    if (remaining > 0) {
+        float* dst = out + rendered * kOutputChannelCount;
+        if (fluid_synth_write_float(synth, remaining, dst, 0, 2, dst, 1, 2) != FLUID_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#undef FS
+
+}  // namespace nightjar
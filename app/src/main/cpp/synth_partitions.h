@@ -0,0 +1,147 @@
+#pragma once
+
+#include "common.h"
+#include "event_signal.h"
+#include "step_sequencer.h"  // for NoteEvent
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nightjar {
+
+// Upper bound on synth partitions, regardless of core count.
+static constexpr int32_t kMaxSynthPartitions = 4;
+
+// Largest block render() accepts. Matches SynthEngine's render chunk.
+static constexpr int32_t kMaxPartitionBlockFrames = 256;
+
+// MIDI channels of each instance ("synth.midi-channels"). Channel state
+// is small; voices are what cost, and those are capped by polyphony.
+static constexpr int32_t kSynthInstanceChannels = 64;
+
+/**
+ * A set of FluidSynth instances that each own kSynthInstanceChannels MIDI
+ * channels and render in parallel.
+ *
+ * Each partition is a full fluid_synth_t created from the same settings
+ * and the same SoundFont file. FluidSynth's sample cache keys loaded
+ * sample data by file, so the SoundFont's samples are held in memory
+ * once no matter how many partitions load it. With dynamic sample
+ * loading the same holds per preset, for the presets some partition's
+ * channel has selected.
+ *
+ * Channel numbers here are physical: partition * kSynthInstanceChannels
+ * plus the channel on that partition's synth (one past the last partition
+ * falls on the last). SynthChannelMap decides which physical channel each
+ * track plays on, so every track, the drum channel and the metronome stay
+ * on a single instance and keep their own program and controller state.
+ *
+ * render() is driven by one caller thread (the SynthEngine render thread,
+ * or the offline renderer while that thread is parked). Partition 0 is
+ * rendered on the caller; partitions 1..N-1 each have a worker thread
+ * that wakes per block, renders its channels' events into a private
+ * buffer, and signals completion. The caller then sums the buffers.
+ * With a single partition no workers exist and render() is exactly the
+ * old single-synth path. Workers run under ThreadRole::SynthWorker.
+ */
+class SynthPartitions {
+public:
+    SynthPartitions() = default;
+    ~SynthPartitions();
+
+    SynthPartitions(const SynthPartitions&) = delete;
+    SynthPartitions& operator=(const SynthPartitions&) = delete;
+
+    /**
+     * Partition count for this device: roughly half the cores beyond the
+     * two kept for the UI and audio callback threads, clamped to
+     * [1, kMaxSynthPartitions].
+     */
+    static int32_t defaultCount();
+
+    /**
+     * Create [count] synths from [settings] (a fluid_settings_t*), load
+     * [soundFontPath] into each, and start the workers. Returns false
+     * (and leaves the set empty) if any synth or SoundFont load fails.
+     */
+    bool create(void* settings, const std::string& soundFontPath, int32_t count);
+
+    /** Stop the workers and delete every synth. */
+    void destroy();
+
+    int32_t count() const { return static_cast<int32_t>(partitions_.size()); }
+    bool empty() const { return partitions_.empty(); }
+
+    /** fluid_synth_t* that owns physical [channel]. Null if the set is empty. */
+    void* synthForChannel(int channel) const;
+
+    /** Physical [channel] as the channel number on its own synth. */
+    static int localChannel(int channel) {
+        return channel >= 0 ? channel % kSynthInstanceChannels : 0;
+    }
+
+    /** Physical channel of [channel] on partition [index]. */
+    static int physicalChannel(int32_t index, int channel) {
+        return index * kSynthInstanceChannels + channel;
+    }
+
+    /** fluid_synth_t* of partition [index]. */
+    void* synthAt(int32_t index) const { return partitions_[index]->synth; }
+
+    /** Fire a single NoteEvent into the partition that owns its channel. */
+    void fireEvent(const NoteEvent& e) const;
+
+    /** CC 120 on every channel of every partition. */
+    void allSoundsOff() const;
+
+    /** Voices playing or releasing, summed over the partitions. */
+    int32_t activeVoiceCount() const;
+
+    /**
+     * Render [frames] (<= kMaxPartitionBlockFrames) stereo frames into
+     * [out] (overwritten), firing [events] at their frame offsets on
+     * their channels' partitions. [events] is sorted in place.
+     * Returns false if any FluidSynth render fails.
+     */
+    bool render(float* out, int32_t frames, std::vector<NoteEvent>& events);
+
+    /** Kernel ids of the running workers, up to [max] of them, into
+     *  [out]; returns how many (0 with a single partition). */
+    size_t workerThreadIds(int32_t* out, size_t max) const;
+
+private:
+    struct Partition {
+        void* synth = nullptr;            // fluid_synth_t*
+        std::vector<NoteEvent> events;    // this block's events, sorted
+        float buffer[kMaxPartitionBlockFrames * kOutputChannelCount];
+        bool ok = true;
+
+        // Worker side (partitions 1..N-1 only)
+        std::thread worker;
+        EventSignal start;
+        std::atomic<int32_t> threadId{0};  // set by the worker once running
+    };
+
+    int32_t partitionForChannel(int channel) const {
+        return channel >= 0 ? std::min(channel / kSynthInstanceChannels, count() - 1) : 0;
+    }
+
+    void workerLoop(Partition* partition);
+
+    /** Render one partition's block, splitting at its event offsets. */
+    static bool renderPartition(Partition& partition, float* out, int32_t frames);
+
+    std::vector<std::unique_ptr<Partition>> partitions_;
+
+    // Block hand-off between the caller and the workers.
+    std::atomic<bool> workersRunning_{false};
+    std::atomic<uint64_t> blockSeq_{0};
+    std::atomic<int32_t> blockFrames_{0};
+    std::atomic<int32_t> pending_{0};
+    EventSignal done_;
+};
+
+}  // namespace nightjar
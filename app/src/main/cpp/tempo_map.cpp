@@ -0,0 +1,141 @@
+#include "tempo_map.h"
+#include "common.h"
+#include <algorithm>
+#include <cmath>
+
+namespace nightjar {
+
+// Frame positions are floored; this absorbs the rounding error of the
+// seconds round trip so a tick that lands exactly on a frame stays on it.
+static constexpr double kFrameEpsilon = 1.0e-6;
+
+TempoMap::TempoMap() : segments_(1) {
+    buildCache();
+}
+
+TempoMap::TempoMap(std::vector<TempoSegment> segments) {
+    segments.erase(std::remove_if(segments.begin(), segments.end(),
+                                  [](const TempoSegment& s) {
+                                      return !(s.bpm > 0.0) || !std::isfinite(s.bpm);
+                                  }),
+                   segments.end());
+    std::stable_sort(segments.begin(), segments.end(),
+                     [](const TempoSegment& a, const TempoSegment& b) {
+                         return a.startTick < b.startTick;
+                     });
+    for (auto& segment : segments) {
+        if (segment.beatsPerBar <= 0) segment.beatsPerBar = 4;
+        if (!segments_.empty() && segments_.back().startTick == segment.startTick) {
+            segments_.back() = segment;
+        } else {
+            segments_.push_back(segment);
+        }
+    }
+    if (segments_.empty()) segments_.emplace_back();
+    segments_.front().startTick = 0;
+    buildCache();
+}
+
+void TempoMap::buildCache() {
+    startSeconds_.resize(segments_.size());
+    secondsPerTick_.resize(segments_.size());
+    ticksPerSecond_.resize(segments_.size());
+    maxSecondsPerBeat_ = 0.0;
+    double seconds = 0.0;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        if (i > 0) {
+            seconds += static_cast<double>(segments_[i].startTick - segments_[i - 1].startTick) *
+                       secondsPerTick_[i - 1];
+        }
+        startSeconds_[i] = seconds;
+        secondsPerTick_[i] = 60.0 / (segments_[i].bpm * static_cast<double>(kTicksPerBeat));
+        ticksPerSecond_[i] = segments_[i].bpm * static_cast<double>(kTicksPerBeat) / 60.0;
+        maxSecondsPerBeat_ = std::max(maxSecondsPerBeat_, 60.0 / segments_[i].bpm);
+    }
+}
+
+size_t TempoMap::indexAtTick(double tick) const {
+    auto it = std::upper_bound(segments_.begin() + 1, segments_.end(), tick,
+                               [](double t, const TempoSegment& s) {
+                                   return t < static_cast<double>(s.startTick);
+                               });
+    return static_cast<size_t>(it - segments_.begin()) - 1;
+}
+
+size_t TempoMap::indexAtSeconds(double seconds) const {
+    auto it = std::upper_bound(startSeconds_.begin() + 1, startSeconds_.end(), seconds);
+    return static_cast<size_t>(it - startSeconds_.begin()) - 1;
+}
+
+double TempoMap::secondsAtTick(double tick) const {
+    size_t i = indexAtTick(tick);
+    return startSeconds_[i] +
+           (tick - static_cast<double>(segments_[i].startTick)) * secondsPerTick_[i];
+}
+
+double TempoMap::tickAtSeconds(double seconds) const {
+    size_t i = indexAtSeconds(seconds);
+    return static_cast<double>(segments_[i].startTick) +
+           (seconds - startSeconds_[i]) * ticksPerSecond_[i];
+}
+
+double TempoMap::tickAtFrame(int64_t frame, int32_t sampleRate) const {
+    return tickAtSeconds(static_cast<double>(frame) / static_cast<double>(sampleRate));
+}
+
+int64_t TempoMap::frameAtTick(double tick, int32_t sampleRate) const {
+    return static_cast<int64_t>(
+        std::floor(secondsAtTick(tick) * static_cast<double>(sampleRate) + kFrameEpsilon));
+}
+
+int64_t TempoMap::frameAfter(int64_t startFrame, double ticks, int32_t sampleRate) const {
+    double rate = static_cast<double>(sampleRate);
+    double startSeconds = static_cast<double>(startFrame) / rate;
+    double seconds = secondsAtTick(tickAtSeconds(startSeconds) + ticks) - startSeconds;
+    return startFrame + static_cast<int64_t>(std::floor(seconds * rate + kFrameEpsilon));
+}
+
+double TempoMap::ticksBetween(int64_t startFrame, int64_t frame, int32_t sampleRate) const {
+    return tickAtFrame(frame, sampleRate) - tickAtFrame(startFrame, sampleRate);
+}
+
+// ── TempoTrack ─────────────────────────────────────────────────────────
+
+TempoTrack::TempoTrack(Reclaimer& reclaimer) : map_(reclaimer) {}
+
+void TempoTrack::setSegments(std::vector<TempoSegment> segments) {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    publish(TempoMap(std::move(segments)));
+    LOGD("TempoTrack: %zu segments (gen=%llu)", map_.current()->segments().size(),
+         (unsigned long long)generationCounter_);
+}
+
+void TempoTrack::setBpm(double bpm) {
+    if (!(bpm > 0.0)) {
+        LOGW("TempoTrack: ignoring tempo %.2f", bpm);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(editMutex_);
+    int beatsPerBar = map_.current()->segments().front().beatsPerBar;
+    publish(TempoMap({{0, bpm, beatsPerBar}}));
+}
+
+void TempoTrack::setBeatsPerBar(int beatsPerBar) {
+    if (beatsPerBar <= 0) return;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    std::vector<TempoSegment> segments = map_.current()->segments();
+    for (auto& segment : segments) segment.beatsPerBar = beatsPerBar;
+    publish(TempoMap(std::move(segments)));
+}
+
+TempoMap TempoTrack::snapshot() const {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    return *map_.current();
+}
+
+void TempoTrack::publish(TempoMap next) {
+    next.generation_ = ++generationCounter_;
+    map_.publish(std::make_unique<TempoMap>(std::move(next)));
+}
+
+}  // namespace nightjar
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "snapshot_publisher.h"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace nightjar {
+
+/** Musical time resolution: ticks per quarter-note beat. */
+static constexpr int64_t kTicksPerBeat = 960;
+
+/** A tempo and time signature in force from [startTick] to the next segment. */
+struct TempoSegment {
+    int64_t startTick = 0;
+    double bpm = 120.0;
+    int beatsPerBar = 4;
+};
+
+/**
+ * Piecewise-constant tempo map converting between timeline frames and
+ * musical ticks (kTicksPerBeat per beat). Shared by the drum, MIDI and
+ * metronome sequencers so all three follow the same tempo changes.
+ *
+ * Immutable once built. Each segment caches the time it starts at and
+ * its length of a tick, so a lookup is a binary search over the
+ * segments -- almost always one -- and a multiply. Frames convert
+ * through seconds at the caller's sample rate, so one map serves any
+ * engine rate. The first segment is extended back past tick 0 (the
+ * count-in) and the last one forward forever.
+ */
+class TempoMap {
+public:
+    /** 120 BPM, 4/4. */
+    TempoMap();
+
+    /**
+     * Build from [segments] in any order. Segments with a non-positive
+     * tempo are dropped, a later segment at the same tick wins, and the
+     * first segment is moved to tick 0. An empty list gives the default.
+     */
+    explicit TempoMap(std::vector<TempoSegment> segments);
+
+    const std::vector<TempoSegment>& segments() const { return segments_; }
+
+    /** Segment in force at [tick]. */
+    const TempoSegment& segmentAtTick(double tick) const { return segments_[indexAtTick(tick)]; }
+
+    double secondsAtTick(double tick) const;
+    double tickAtSeconds(double seconds) const;
+
+    double tickAtFrame(int64_t frame, int32_t sampleRate) const;
+    /** First frame at or after [tick]. */
+    int64_t frameAtTick(double tick, int32_t sampleRate) const;
+
+    /**
+     * Frame [ticks] after [startFrame]. Exact at ticks == 0, so content
+     * placed in ticks relative to a frame-positioned clip starts on the
+     * clip's own frame.
+     */
+    int64_t frameAfter(int64_t startFrame, double ticks, int32_t sampleRate) const;
+
+    /** Ticks elapsed from [startFrame] to [frame]. */
+    double ticksBetween(int64_t startFrame, int64_t frame, int32_t sampleRate) const;
+
+    /** Length of the longest beat anywhere in the map (its slowest tempo). */
+    double maxSecondsPerBeat() const { return maxSecondsPerBeat_; }
+
+    /** Changes whenever TempoTrack publishes a new map. */
+    uint64_t generation() const { return generation_; }
+
+private:
+    friend class TempoTrack;
+
+    void buildCache();
+    size_t indexAtTick(double tick) const;
+    size_t indexAtSeconds(double seconds) const;
+
+    std::vector<TempoSegment> segments_;
+    std::vector<double> startSeconds_;    // per segment
+    std::vector<double> secondsPerTick_;  // per segment
+    std::vector<double> ticksPerSecond_;  // per segment, its reciprocal
+    double maxSecondsPerBeat_ = 0.0;
+    uint64_t generation_ = 0;
+};
+
+/**
+ * The engine's live tempo map, published RCU-style like the sequencer
+ * snapshots: UI-thread edits build a new TempoMap under a mutex and
+ * publish it; the render side reads it lock-free through a ReadGuard.
+ *
+ * A tempo edit replaces only the segment list. MIDI content is stored
+ * in ticks and drum steps are tick multiples, so nothing else needs
+ * re-uploading when the tempo changes.
+ */
+class TempoTrack {
+public:
+    explicit TempoTrack(Reclaimer& reclaimer);
+
+    /** Replace the whole map. */
+    void setSegments(std::vector<TempoSegment> segments);
+
+    /** Single tempo for the whole song, keeping the opening time signature. */
+    void setBpm(double bpm);
+
+    /** Set the time signature of every segment (the project-wide setting). */
+    void setBeatsPerBar(int beatsPerBar);
+
+    /** Copy of the current map, for the UI side (length math, freezes). */
+    TempoMap snapshot() const;
+
+    /** Render-side read of the current map on hazard slot [reader]. */
+    class ReadGuard : public SnapshotPublisher<TempoMap>::ReadGuard {
+    public:
+        ReadGuard(const TempoTrack& track, int reader)
+            : SnapshotPublisher<TempoMap>::ReadGuard(track.map_, reader) {}
+    };
+
+private:
+    /** Stamp and publish [next]. Caller holds editMutex_. */
+    void publish(TempoMap next);
+
+    SnapshotPublisher<TempoMap> map_;
+    mutable std::mutex editMutex_;
+    uint64_t generationCounter_ = 0;
+};
+
+}  // namespace nightjar
@@ -0,0 +1,103 @@
+#include "compressed_audio.h"
+#include "peak_cache.h"
+#include "test_util.h"
+#include "wav_track_source.h"
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace nightjar;
+
+namespace {
+
+/** A take as recorded: a tone, then silence, then noise; not a whole number of blocks. */
+std::vector<int16_t> takeSamples() {
+    std::vector<int16_t> pcm(kCompressedBlockFrames * 3 + 123);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> noise(-32768, 32767);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        if (i < static_cast<size_t>(kCompressedBlockFrames)) {
+            pcm[i] = static_cast<int16_t>(std::sin(static_cast<double>(i) * 0.03) * 12000.0);
+        } else if (i >= static_cast<size_t>(kCompressedBlockFrames) * 2) {
+            pcm[i] = static_cast<int16_t>(noise(rng));
+        }
+    }
+    return pcm;
+}
+
+/** A 44.1 kHz WAV of [pcm] at [path]. */
+bool writeWav(const std::string& path, const std::vector<int16_t>& pcm) {
+    return test::writeWav(path, pcm, 44100);
+}
+
+class CompressedAudio : public test::TempDirTest {};
+
+}  // namespace
+
+TEST_F(CompressedAudio, CompressThenExpandGivesTheTakeBack) {
+    std::vector<int16_t> pcm = takeSamples();
+    ASSERT_TRUE(writeWav(path("take.wav"), pcm));
+
+    ASSERT_TRUE(compressWavFile(path("take.wav"), path("take.njca")));
+    EXPECT_TRUE(CompressedAudioFile::sniff(path("take.njca")));
+    ASSERT_TRUE(expandCompressedAudio(path("take.njca"), path("shared.wav")));
+
+    WavTrackSource expanded;
+    ASSERT_TRUE(expanded.open(path("shared.wav")));
+    EXPECT_EQ(expanded.sampleRate(), 44100);
+    ASSERT_EQ(expanded.totalFrames(), static_cast<int64_t>(pcm.size()));
+    EXPECT_TRUE(std::equal(pcm.begin(), pcm.end(), expanded.pcmData()));
+}
+
+TEST_F(CompressedAudio, PeaksOfACompressedTakeMatchItsWav) {
+    std::vector<int16_t> pcm = takeSamples();
+    ASSERT_TRUE(writeWav(path("take.wav"), pcm));
+    ASSERT_TRUE(compressWavFile(path("take.wav"), path("take.njca")));
+
+    constexpr int32_t kBars = 48;
+    std::vector<float> fromWav(kBars), fromCompressed(kBars);
+    PeakCacheReader wav, compressed;
+    ASSERT_TRUE(wav.openForTake(path("take.wav")));
+    ASSERT_TRUE(compressed.openForTake(path("take.njca")));
+    EXPECT_EQ(compressed.totalFrames(), static_cast<int64_t>(pcm.size()));
+    ASSERT_TRUE(wav.readBars(0, -1, kBars, fromWav.data()));
+    ASSERT_TRUE(compressed.readBars(0, -1, kBars, fromCompressed.data()));
+    EXPECT_EQ(fromWav, fromCompressed);
+}
+
+// The WAV's sidecar carries over to the compacted take and is current
+// for it: opening the .njca maps it instead of decoding the audio.
+TEST_F(CompressedAudio, CompactedTakeAdoptsTheWavSidecar) {
+    std::vector<int16_t> pcm = takeSamples();
+    ASSERT_TRUE(writeWav(path("take.wav"), pcm));
+    EXPECT_FALSE(PeakCacheReader::adoptSidecar(path("take.wav"), path("take.njca")));
+
+    PeakCacheReader wav;
+    ASSERT_TRUE(wav.openForTake(path("take.wav")));
+    ASSERT_TRUE(compressWavFile(path("take.wav"), path("take.njca")));
+    ASSERT_TRUE(PeakCacheReader::adoptSidecar(path("take.wav"), path("take.njca")));
+
+    // Unreadable audio, so only the adopted sidecar can satisfy the open
+    struct stat st{};
+    ASSERT_EQ(stat(path("take.njca").c_str(), &st), 0);
+    FILE* f = fopen(path("take.njca").c_str(), "r+b");
+    ASSERT_NE(f, nullptr);
+    std::vector<char> zeros(static_cast<size_t>(st.st_size), 0);
+    ASSERT_EQ(fwrite(zeros.data(), 1, zeros.size(), f), zeros.size());
+    fclose(f);
+
+    PeakCacheReader compressed;
+    ASSERT_TRUE(compressed.openForTake(path("take.njca")));
+    EXPECT_EQ(compressed.totalFrames(), static_cast<int64_t>(pcm.size()));
+}
+
+TEST_F(CompressedAudio, ExpandRefusesAWav) {
+    ASSERT_TRUE(writeWav(path("take.wav"), takeSamples()));
+    EXPECT_FALSE(expandCompressedAudio(path("take.wav"), path("shared.wav")));
+    EXPECT_NE(access(path("shared.wav").c_str(), F_OK), 0);
+}
@@ -0,0 +1,113 @@
+#include "engine_commands.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace nightjar;
+
+namespace {
+
+/** Builds a batch the way EngineCommandBuffer lays it out. */
+class BatchBuilder {
+public:
+    explicit BatchBuilder(int commands) {
+        bytes_.resize(kCommandHeaderBytes);
+        put<uint32_t>(0, kCommandMagic);
+        put<uint16_t>(4, kCommandFormatVersion);
+        put<uint16_t>(6, static_cast<uint16_t>(commands));
+    }
+
+    /** A command whose payload is one byte array, padded to 8. */
+    void byteArray(CommandOp op, const std::vector<uint8_t>& elements) {
+        size_t payload = 8 + ((elements.size() + 7) & ~size_t{7});
+        size_t at = bytes_.size();
+        bytes_.resize(at + kCommandRecordHeaderBytes + payload);
+        put<uint16_t>(at, static_cast<uint16_t>(op));
+        put<uint32_t>(at + 4, static_cast<uint32_t>(payload));
+        put<int32_t>(at + 8, static_cast<int32_t>(elements.size()));
+        std::memcpy(bytes_.data() + at + 16, elements.data(), elements.size());
+    }
+
+    /** The finished batch, its length field cut to [length] bytes if given. */
+    std::vector<uint8_t> finish(size_t length = 0) {
+        std::vector<uint8_t> out = bytes_;
+        if (length) out.resize(length);
+        uint32_t byteLength = static_cast<uint32_t>(out.size());
+        std::memcpy(out.data() + 8, &byteLength, sizeof(byteLength));
+        return out;
+    }
+
+private:
+    template <typename T>
+    void put(size_t at, T value) { std::memcpy(bytes_.data() + at, &value, sizeof(T)); }
+
+    std::vector<uint8_t> bytes_;
+};
+
+/** How many commands the reader yields before stopping. */
+int drain(CommandBatchReader& batch) {
+    CommandOp op;
+    CommandReader payload(nullptr, 0);
+    int n = 0;
+    while (batch.next(op, payload)) ++n;
+    return n;
+}
+
+}  // namespace
+
+TEST(EngineCommands, BooleanBytesAreTrueWhenNonzero) {
+    BatchBuilder builder(1);
+    builder.byteArray(CommandOp::MidiTracks, {0, 1, 2, 0x80, 0xFF});
+    std::vector<uint8_t> bytes = builder.finish();
+
+    CommandBatchReader batch;
+    ASSERT_TRUE(batch.open(bytes.data(), bytes.size()));
+    CommandOp op;
+    CommandReader payload(nullptr, 0);
+    ASSERT_TRUE(batch.next(op, payload));
+
+    int32_t count = 0;
+    const uint8_t* muted = payload.u8s(count);
+    ASSERT_TRUE(payload.ok());
+    ASSERT_EQ(count, 5);
+    std::vector<bool> values;
+    for (int32_t i = 0; i < count; ++i) values.push_back(muted[i] != 0);
+    EXPECT_EQ(values, (std::vector<bool>{false, true, true, true, true}));
+}
+
+TEST(EngineCommands, WholeBatchValidates) {
+    BatchBuilder builder(2);
+    builder.byteArray(CommandOp::MidiTracks, {1});
+    builder.byteArray(CommandOp::MidiTracks, {0, 1, 0});
+    std::vector<uint8_t> bytes = builder.finish();
+
+    CommandBatchReader batch;
+    ASSERT_TRUE(batch.open(bytes.data(), bytes.size()));
+    EXPECT_TRUE(batch.validate());
+    EXPECT_EQ(drain(batch), 2);
+    EXPECT_TRUE(batch.complete());
+}
+
+// Cut after the header, inside the second record's header, and inside
+// its payload: each is refused before a byte past the length is read,
+// and validate() catches it before the first command applies.
+TEST(EngineCommands, TruncatedBatchFailsCleanly) {
+    BatchBuilder builder(2);
+    builder.byteArray(CommandOp::MidiTracks, {1});
+    builder.byteArray(CommandOp::MidiTracks, {0, 1, 0});
+    size_t first = kCommandHeaderBytes + kCommandRecordHeaderBytes + 16;
+
+    for (size_t cut : {kCommandHeaderBytes, first + 4, first + kCommandRecordHeaderBytes + 8}) {
+        std::vector<uint8_t> full = builder.finish(cut);
+        // Exactly [cut] bytes on the heap, so ASan flags any overread
+        std::unique_ptr<uint8_t[]> bytes(new uint8_t[cut]);
+        std::memcpy(bytes.get(), full.data(), cut);
+
+        CommandBatchReader batch;
+        ASSERT_TRUE(batch.open(bytes.get(), cut)) << "cut " << cut;
+        EXPECT_FALSE(batch.validate()) << "cut " << cut;
+        EXPECT_EQ(drain(batch), cut > first ? 1 : 0) << "cut " << cut;
+        EXPECT_FALSE(batch.complete()) << "cut " << cut;
+    }
+}
@@ -0,0 +1,97 @@
+#include "common.h"
+#include "midi_sequencer.h"
+#include "reclaimer.h"
+#include "tempo_map.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using namespace nightjar;
+
+// Counts operator new calls on a thread while it is asked to, so a test
+// can check the render side of a swap allocates nothing.
+namespace {
+thread_local bool countAllocations = false;
+thread_local int allocations = 0;
+}  // namespace
+
+void* operator new(size_t size) {
+    if (countAllocations) ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    if (countAllocations) ++allocations;
+    return std::malloc(size ? size : 1);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+constexpr int32_t kChunk = 256;
+
+/** [clips] clips of one short note each on [channel], one every [spacing] frames. */
+MidiTrackData trackOf(int channel, int clips, int64_t spacing) {
+    MidiTrackData track;
+    track.channel = channel;
+    for (int c = 0; c < clips; ++c) {
+        MidiClipData clip;
+        clip.offsetFrames = c * spacing;
+        clip.lengthFrames = spacing;
+        clip.events.push_back({0, channel, 60, 100});
+        clip.events.push_back({kTicksPerBeat / 8, channel, 60, 0});
+        track.clips.push_back(std::move(clip));
+    }
+    return track;
+}
+
+std::vector<MidiTrackData> tracksOf(int tracks, int clips, int64_t spacing) {
+    std::vector<MidiTrackData> out;
+    for (int t = 0; t < tracks; ++t) out.push_back(trackOf(t, clips, spacing));
+    return out;
+}
+
+}  // namespace
+
+// More tracks and clips than the render side reserves: swapping to the
+// snapshot (a full realign, then a single-track one) takes the buffers
+// the writer sized, and every note still plays.
+TEST(MidiSequencer, LargeSnapshotSwapsWithoutRenderAllocations) {
+    constexpr int kTracks = 100;
+    constexpr int kClips = 16;  // 1600 clips
+    constexpr int64_t kSpacing = kChunk * 8;
+    Reclaimer reclaimer;
+    const TempoMap tempo;
+    MidiSequencer sequencer(reclaimer);
+
+    // Warm up on a small song so the event buffer has grown
+    sequencer.updateTracks(tracksOf(kTracks, 1, kSpacing));
+    sequencer.resetToPosition(0, tempo, kDefaultSampleRate);
+    sequencer.tick(0, kChunk, tempo, kDefaultSampleRate);
+
+    sequencer.updateTracks(tracksOf(kTracks, kClips, kSpacing));
+    int noteOns = 0;
+    int64_t pos = kChunk;
+    auto tickCounted = [&] {
+        countAllocations = true;
+        const auto& due = sequencer.tick(pos, kChunk, tempo, kDefaultSampleRate);
+        countAllocations = false;
+        for (const NoteEvent& e : due) noteOns += e.velocity > 0;
+        pos += kChunk;
+    };
+    allocations = 0;
+    tickCounted();
+    EXPECT_EQ(allocations, 0);
+
+    // Played up to here; swap in one changed track, then play the rest
+    while (pos < kSpacing * (kClips / 2)) tickCounted();
+    ASSERT_TRUE(sequencer.replaceTrack(3, trackOf(3, kClips, kSpacing)));
+    allocations = 0;
+    while (pos < kSpacing * kClips) tickCounted();
+    EXPECT_EQ(allocations, 0);
+
+    // The first clip of each track started before the big snapshot
+    EXPECT_EQ(noteOns, kTracks * (kClips - 1));
+}
@@ -0,0 +1,85 @@
+#include "compressed_audio.h"
+#include "resampler.h"
+#include "test_util.h"
+#include "wav_track_source.h"
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace nightjar;
+using nightjar::test::writeWav;
+
+namespace {
+
+std::vector<int16_t> chirp(int64_t frames) {
+    std::vector<int16_t> pcm(static_cast<size_t>(frames));
+    for (int64_t i = 0; i < frames; ++i) {
+        double t = static_cast<double>(i);
+        pcm[static_cast<size_t>(i)] = static_cast<int16_t>(std::sin(t * (0.01 + t * 2e-6)) * 14000.0);
+    }
+    return pcm;
+}
+
+/** The whole take converted in one process() call. */
+std::vector<int16_t> convertWhole(const std::vector<int16_t>& pcm, int32_t from, int32_t to) {
+    PolyphaseResampler resampler(from, to);
+    std::vector<int16_t> out(static_cast<size_t>(resampler.outputFrames(
+        static_cast<int64_t>(pcm.size()))));
+    resampler.process(pcm.data(), static_cast<int64_t>(pcm.size()), 0,
+                      static_cast<int32_t>(out.size()), out.data());
+    return out;
+}
+
+class Resampler : public test::TempDirTest {
+protected:
+    /** PCM of the WAV at [wavPath], checking its rate. */
+    static std::vector<int16_t> readWav(const std::string& wavPath, int32_t rate) {
+        WavTrackSource source;
+        if (!source.open(wavPath) || source.sampleRate() != rate) return {};
+        return {source.pcmData(), source.pcmData() + source.totalFrames()};
+    }
+};
+
+}  // namespace
+
+// Chunked conversion reads only a window of input per chunk; the result
+// must not depend on where the chunks fall.
+TEST_F(Resampler, StreamedMatchesWholeTake) {
+    std::vector<int16_t> pcm = chirp(70000);
+    for (auto [from, to] : {std::pair{44100, 48000}, {48000, 44100}, {48000, 8000}}) {
+        int64_t reads = 0;
+        auto input = [&](int64_t first, int32_t count, int16_t* out) {
+            EXPECT_GE(first, 0);
+            EXPECT_LE(first + count, static_cast<int64_t>(pcm.size()));
+            std::copy(pcm.data() + first, pcm.data() + first + count, out);
+            ++reads;
+            return true;
+        };
+        ASSERT_TRUE(resampleToWavFile(input, static_cast<int64_t>(pcm.size()), from, to,
+                                      path("out.wav")));
+        EXPECT_GT(reads, 1) << from << " -> " << to;
+        EXPECT_EQ(readWav(path("out.wav"), to), convertWhole(pcm, from, to))
+            << from << " -> " << to;
+    }
+}
+
+TEST_F(Resampler, CompressedTakeConvertsLikeItsWav) {
+    std::vector<int16_t> pcm = chirp(kCompressedBlockFrames * 5 + 77);
+    ASSERT_TRUE(writeWav(path("take.wav"), pcm, 44100));
+    ASSERT_TRUE(compressWavFile(path("take.wav"), path("take.njca")));
+
+    EXPECT_EQ(resampledTakeIfCurrent(path("take.njca"), 48000), "");
+    ASSERT_TRUE(prepareTakeFile(path("take.njca"), 48000));
+    std::string copy = resampledTakeIfCurrent(path("take.njca"), 48000);
+    EXPECT_EQ(copy, resampledPathFor(path("take.njca"), 48000));
+    EXPECT_EQ(readWav(copy, 48000), convertWhole(pcm, 44100, 48000));
+}
+
+TEST_F(Resampler, TakeAtTheEngineRateNeedsNoCopy) {
+    ASSERT_TRUE(writeWav(path("take.wav"), chirp(1000), 48000));
+    EXPECT_TRUE(prepareTakeFile(path("take.wav"), 48000));
+    EXPECT_NE(access(resampledPathFor(path("take.wav"), 48000).c_str(), F_OK), 0);
+    EXPECT_FALSE(prepareTakeFile(path("missing.wav"), 48000));
+}
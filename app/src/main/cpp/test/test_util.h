@@ -0,0 +1,48 @@
+#pragma once
+
+#include "common.h"
+#include "wav_writer.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Shared helpers for the tests that work on take files.
+
+namespace nightjar::test {
+
+/** Write [pcm] to [path] as a 16-bit mono WAV at [rate], as a recording is. */
+inline bool writeWav(const std::string& path, const std::vector<int16_t>& pcm, int32_t rate) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    writePcmWavHeader(f, rate, kChannelCount);
+    bool ok = fwrite(pcm.data(), sizeof(int16_t), pcm.size(), f) == pcm.size();
+    if (ok) patchPcmWavHeader(f, static_cast<int64_t>(pcm.size()) * kBytesPerSample);
+    return (fclose(f) == 0) && ok;
+}
+
+/** Fixture giving each test an empty directory of its own, removed afterwards. */
+class TempDirTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::string dir =
+            (std::filesystem::temp_directory_path() / "nightjar-test-XXXXXX").string();
+        ASSERT_NE(mkdtemp(dir.data()), nullptr);
+        dir_ = dir;
+    }
+
+    void TearDown() override {
+        std::error_code ignored;
+        std::filesystem::remove_all(dir_, ignored);
+    }
+
+    /** Path of [name] in the test's directory. */
+    std::string path(const char* name) const { return (dir_ / name).string(); }
+
+    std::filesystem::path dir_;
+};
+
+}  // namespace nightjar::test
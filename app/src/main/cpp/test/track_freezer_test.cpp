@@ -0,0 +1,68 @@
+#include "midi_sequencer.h"
+#include "reclaimer.h"
+#include "tempo_map.h"
+#include "track_freezer.h"
+#include <gtest/gtest.h>
+
+using namespace nightjar;
+
+namespace {
+
+/** One bounded clip of [notes] quarter notes on logical [channel]. */
+MidiTrackData trackOn(int channel, int program, int notes) {
+    MidiTrackData track;
+    track.channel = channel;
+    track.program = program;
+    MidiClipData clip;
+    clip.lengthFrames = msToFrames(500 * notes, kDefaultSampleRate);
+    for (int n = 0; n < notes; ++n) {
+        clip.events.push_back({n * kTicksPerBeat, channel, 60 + n, 100});
+        clip.events.push_back({n * kTicksPerBeat + kTicksPerBeat / 2, channel, 60 + n, 0});
+    }
+    track.clips.push_back(std::move(clip));
+    return track;
+}
+
+/** Every event the freeze's sequencer plays for [track], as startMidi() sets it up. */
+std::vector<NoteEvent> playFrozen(MidiTrackData track) {
+    Reclaimer reclaimer;
+    const TempoMap tempo;  // 120 BPM
+    int64_t length = track.clips.front().lengthFrames;
+
+    MidiSequencer sequencer(reclaimer);
+    std::vector<MidiTrackData> tracks;
+    tracks.push_back(std::move(track));
+    sequencer.updateTracks(std::move(tracks));
+    sequencer.resetToPosition(0, tempo, kDefaultSampleRate);
+
+    std::vector<NoteEvent> played;
+    for (int64_t pos = 0; pos < length; pos += 256) {
+        const auto& due = sequencer.tick(pos, 256, tempo, kDefaultSampleRate);
+        played.insert(played.end(), due.begin(), due.end());
+    }
+    return played;
+}
+
+}  // namespace
+
+TEST(TrackFreezer, FreezeChannelIsMelodic) {
+    EXPECT_NE(kFreezeMidiChannel % 16, 9);
+}
+
+// The freeze selects the track's program on kFreezeMidiChannel only, so
+// the program that plays is the track's exactly when every note lands
+// there.
+TEST(TrackFreezer, NotesOfAnyLogicalChannelPlayOnTheProgramChannel) {
+    for (int channel : {1, 7, 25, 200}) {  // 25: a drum channel of its own synth
+        MidiTrackData track = trackOn(channel, 40, 4);
+        TrackFreezer::moveToFreezeChannel(track);
+        EXPECT_EQ(track.channel, kFreezeMidiChannel);
+        EXPECT_EQ(track.program, 40);
+
+        std::vector<NoteEvent> played = playFrozen(std::move(track));
+        ASSERT_EQ(played.size(), 8u) << "channel " << channel;
+        for (const NoteEvent& e : played) {
+            EXPECT_EQ(e.channel, kFreezeMidiChannel) << "channel " << channel;
+        }
+    }
+}
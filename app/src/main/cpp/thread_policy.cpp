@@ -0,0 +1,236 @@
+#include "thread_policy.h"
+#include "common.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__ANDROID__)
+#include <dlfcn.h>
+#endif
+
+namespace nightjar {
+
+// Nice levels of Android's THREAD_PRIORITY_URGENT_AUDIO and
+// THREAD_PRIORITY_AUDIO, for processes that may not use SCHED_FIFO.
+static constexpr int kUrgentAudioNice = -19;
+static constexpr int kAudioNice = -16;
+
+// SCHED_FIFO priority for the synth threads: ahead of all normal work,
+// behind the AAudio callback they feed, which runs at a higher one.
+static constexpr int kSynthFifoPriority = 2;
+
+std::atomic<uint32_t> ThreadPolicy::generation_{0};
+
+static std::mutex sSettingsMutex;
+static ThreadPolicySettings sSettings;
+
+ThreadPolicySettings ThreadPolicy::settings() {
+    std::lock_guard<std::mutex> lock(sSettingsMutex);
+    return sSettings;
+}
+
+void ThreadPolicy::setSettings(const ThreadPolicySettings& settings) {
+    {
+        std::lock_guard<std::mutex> lock(sSettingsMutex);
+        sSettings = settings;
+        sSettings.hintTargetPercent = std::clamp(settings.hintTargetPercent, 10, 100);
+    }
+    generation_.fetch_add(1, std::memory_order_release);
+    LOGD("ThreadPolicy: realtime=%d performanceCores=%d hint=%d target=%d%%",
+         settings.realtimePriority ? 1 : 0, settings.performanceCores ? 1 : 0,
+         settings.performanceHint ? 1 : 0, settings.hintTargetPercent);
+}
+
+int32_t ThreadPolicy::currentThreadId() {
+#if defined(__linux__)
+    return static_cast<int32_t>(syscall(SYS_gettid));
+#else
+    return 0;
+#endif
+}
+
+#if defined(__linux__)
+
+/**
+ * The CPUs of every cluster but the slowest, by maximum clock, read once
+ * from cpufreq. Null on a CPU with a single cluster (nothing to choose)
+ * or when cpufreq can't be read.
+ */
+static const cpu_set_t* performanceCores() {
+    static cpu_set_t cores;
+    static const bool found = [] {
+        CPU_ZERO(&cores);
+        long count = std::min<long>(sysconf(_SC_NPROCESSORS_CONF), CPU_SETSIZE);
+        std::vector<long> maxFreq(static_cast<size_t>(std::max(count, 0L)), 0);
+        for (long cpu = 0; cpu < count; ++cpu) {
+            char path[80];
+            std::snprintf(path, sizeof(path),
+                          "/sys/devices/system/cpu/cpu%ld/cpufreq/cpuinfo_max_freq", cpu);
+            if (FILE* file = std::fopen(path, "r")) {
+                if (std::fscanf(file, "%ld", &maxFreq[cpu]) != 1) maxFreq[cpu] = 0;
+                std::fclose(file);
+            }
+        }
+
+        long slowest = LONG_MAX;
+        long fastest = 0;
+        for (long freq : maxFreq) {
+            if (freq <= 0) continue;
+            slowest = std::min(slowest, freq);
+            fastest = std::max(fastest, freq);
+        }
+        if (fastest == 0 || slowest == fastest) return false;
+
+        for (long cpu = 0; cpu < count; ++cpu) {
+            if (maxFreq[cpu] > slowest) CPU_SET(cpu, &cores);
+        }
+        LOGD("ThreadPolicy: %d performance core(s) of %ld", CPU_COUNT(&cores), count);
+        return true;
+    }();
+    return found ? &cores : nullptr;
+}
+
+static void setPriority(pid_t tid, ThreadRole role, bool realtime) {
+    bool synth = role != ThreadRole::RecordWriter;
+    sched_param param{};
+
+    if (!realtime) {
+        // Back to the defaults, for a setting switched off at runtime
+        sched_setscheduler(tid, SCHED_OTHER, &param);
+        setpriority(PRIO_PROCESS, static_cast<id_t>(tid), 0);
+        return;
+    }
+
+    // App processes normally may not use SCHED_FIFO; the nice levels
+    // below are what Process.setThreadPriority() would give them.
+    if (synth) {
+        param.sched_priority = kSynthFifoPriority;
+        if (sched_setscheduler(tid, SCHED_FIFO, &param) == 0) return;
+    }
+    int nice = synth ? kUrgentAudioNice : kAudioNice;
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), nice) != 0) {
+        static std::once_flag warned;
+        std::call_once(warned, [nice] {
+            LOGW("ThreadPolicy: could not set nice %d on engine threads", nice);
+        });
+    }
+}
+
+static void setCores(pid_t tid, bool preferPerformance) {
+    const cpu_set_t* cores = preferPerformance ? performanceCores() : nullptr;
+    cpu_set_t all;
+    if (!cores) {
+        // Homogeneous CPU, or the setting is off: allow every core
+        CPU_ZERO(&all);
+        long count = std::min<long>(sysconf(_SC_NPROCESSORS_CONF), CPU_SETSIZE);
+        for (long cpu = 0; cpu < count; ++cpu) CPU_SET(cpu, &all);
+        cores = &all;
+    }
+    if (sched_setaffinity(tid, sizeof(cpu_set_t), cores) != 0) {
+        LOGD("ThreadPolicy: could not set core affinity");
+    }
+}
+
+#endif  // __linux__
+
+void ThreadPolicy::applyToCurrentThread(ThreadRole role) {
+#if defined(__linux__)
+    ThreadPolicySettings current = settings();
+    auto tid = static_cast<pid_t>(currentThreadId());
+    setPriority(tid, role, current.realtimePriority);
+    // The writer is I/O bound; where it runs hardly matters
+    if (role != ThreadRole::RecordWriter) setCores(tid, current.performanceCores);
+#else
+    (void)role;
+#endif
+}
+
+// ── Performance hint session ───────────────────────────────────────────
+
+#if defined(__ANDROID__)
+
+/** The APerformanceHint entry points, if this device has them (API 33+). */
+struct HintApi {
+    void* (*getManager)() = nullptr;
+    void* (*createSession)(void*, const int32_t*, size_t, int64_t) = nullptr;
+    int (*updateTarget)(void*, int64_t) = nullptr;
+    int (*reportActual)(void*, int64_t) = nullptr;
+    void (*closeSession)(void*) = nullptr;
+
+    bool available() const {
+        return getManager && createSession && updateTarget && reportActual && closeSession;
+    }
+};
+
+static const HintApi& hintApi() {
+    static const HintApi api = [] {
+        HintApi found;
+        // Already loaded: the engine links against libandroid
+        void* lib = dlopen("libandroid.so", RTLD_NOW);
+        if (!lib) return found;
+        found.getManager = reinterpret_cast<void* (*)()>(
+            dlsym(lib, "APerformanceHint_getManager"));
+        found.createSession = reinterpret_cast<void* (*)(void*, const int32_t*, size_t, int64_t)>(
+            dlsym(lib, "APerformanceHint_createSession"));
+        found.updateTarget = reinterpret_cast<int (*)(void*, int64_t)>(
+            dlsym(lib, "APerformanceHint_updateTargetWorkDuration"));
+        found.reportActual = reinterpret_cast<int (*)(void*, int64_t)>(
+            dlsym(lib, "APerformanceHint_reportActualWorkDuration"));
+        found.closeSession = reinterpret_cast<void (*)(void*)>(
+            dlsym(lib, "APerformanceHint_closeSession"));
+        return found;
+    }();
+    return api;
+}
+
+bool PerformanceHintSession::open(const int32_t* threadIds, size_t count, int64_t targetNanos) {
+    close();
+    const HintApi& api = hintApi();
+    if (!api.available() || count == 0 || targetNanos <= 0) return false;
+    void* manager = api.getManager();
+    if (!manager) return false;
+    session_ = api.createSession(manager, threadIds, count, targetNanos);
+    if (!session_) {
+        LOGW("ThreadPolicy: could not create a performance hint session");
+        return false;
+    }
+    targetNanos_ = targetNanos;
+    LOGD("ThreadPolicy: performance hint session for %zu thread(s), target %lld ns",
+         count, (long long)targetNanos);
+    return true;
+}
+
+void PerformanceHintSession::reportActual(int64_t nanos) {
+    if (session_ && nanos > 0) hintApi().reportActual(session_, nanos);
+}
+
+void PerformanceHintSession::updateTarget(int64_t targetNanos) {
+    if (!session_ || targetNanos <= 0 || targetNanos == targetNanos_) return;
+    if (hintApi().updateTarget(session_, targetNanos) == 0) targetNanos_ = targetNanos;
+}
+
+void PerformanceHintSession::close() {
+    if (session_) hintApi().closeSession(session_);
+    session_ = nullptr;
+    targetNanos_ = 0;
+}
+
+#else  // !__ANDROID__
+
+bool PerformanceHintSession::open(const int32_t*, size_t, int64_t) { return false; }
+void PerformanceHintSession::reportActual(int64_t) {}
+void PerformanceHintSession::updateTarget(int64_t) {}
+void PerformanceHintSession::close() {}
+
+#endif
+
+}  // namespace nightjar
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace nightjar {
+
+/** What an engine-owned thread does, which decides how it is scheduled. */
+enum class ThreadRole : int32_t {
+    SynthRender,   // SynthEngine's render loop; feeds the audio callback
+    SynthWorker,   // SynthPartitions workers; part of every render chunk
+    RecordWriter,  // WavWriter; drains the capture ring to disk
+};
+
+/**
+ * Tunables for engine thread scheduling. Mirrored by the Kotlin
+ * EngineThreadPolicy; every field defaults on.
+ */
+struct ThreadPolicySettings {
+    /** Raise thread priority: SCHED_FIFO where the process may use it,
+     *  otherwise the audio nice levels. */
+    bool realtimePriority = true;
+    /** Keep synth threads on the faster cores of a big/little CPU. */
+    bool performanceCores = true;
+    /** Report render work to an APerformanceHint session (API 33+). */
+    bool performanceHint = true;
+    /** Work duration the hint session aims for, as a percentage of each
+     *  chunk's real-time budget. Lower asks for higher clocks. */
+    int32_t hintTargetPercent = 50;
+};
+
+/**
+ * Scheduling for the engine's own threads. The audio callbacks run on
+ * Oboe's threads and are scheduled by AAudio; everything the engine
+ * spawns to keep them fed starts out at default priority, where the
+ * scheduler treats it as background work and parks it on little cores.
+ *
+ * Each thread calls applyToCurrentThread() with its role when it starts;
+ * long-lived loops also re-apply when generation() changes, so settings
+ * changed at runtime reach threads that are already running. Every step
+ * is best effort: what the platform refuses is logged once and skipped.
+ *
+ * Settings are process-wide. Any thread.
+ */
+class ThreadPolicy {
+public:
+    static ThreadPolicySettings settings();
+    static void setSettings(const ThreadPolicySettings& settings);
+
+    /** Bumped by every setSettings(). */
+    static uint32_t generation() { return generation_.load(std::memory_order_acquire); }
+
+    /** Priority and core placement of [role] for the calling thread. */
+    static void applyToCurrentThread(ThreadRole role);
+
+    /** Kernel id of the calling thread (for performance hint sessions). */
+    static int32_t currentThreadId();
+
+private:
+    static std::atomic<uint32_t> generation_;
+};
+
+/**
+ * An APerformanceHint session over one repeating unit of work, e.g. a
+ * synth render chunk across the render thread and its partition workers.
+ * The platform adjusts CPU clocks so each unit takes about the target.
+ *
+ * The NDK calls are looked up at runtime (they exist from API 33); on
+ * older devices and host builds open() fails and the rest are no-ops.
+ * Not thread-safe; owned by the thread doing the work.
+ */
+class PerformanceHintSession {
+public:
+    PerformanceHintSession() = default;
+    ~PerformanceHintSession() { close(); }
+
+    PerformanceHintSession(const PerformanceHintSession&) = delete;
+    PerformanceHintSession& operator=(const PerformanceHintSession&) = delete;
+
+    /** Start a session for the threads [threadIds] aiming at [targetNanos] per unit. */
+    bool open(const int32_t* threadIds, size_t count, int64_t targetNanos);
+
+    /** One unit of work took [nanos]. */
+    void reportActual(int64_t nanos);
+
+    /** Aim at [targetNanos] per unit from now on. */
+    void updateTarget(int64_t targetNanos);
+
+    void close();
+
+    bool isOpen() const { return session_ != nullptr; }
+
+private:
+    void* session_ = nullptr;  // APerformanceHintSession*
+    int64_t targetNanos_ = 0;
+};
+
+}  // namespace nightjar
@@ -0,0 +1,199 @@
+#include "track_freezer.h"
+#include "atomic_transport.h"
+#include "mix_kernels.h"
+#include "synth_engine.h"
+#include "synth_partitions.h"
+#include "wav_writer.h"
+#include <fluidsynth.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace nightjar {
+
+// Same chunk grid as the live render thread, so frozen notes land on the
+// frames they would have played on.
+static constexpr int32_t kFreezeBlockFrames = kSynthRenderChunkFrames;
+static constexpr int32_t kFreezeBlockSamples = kFreezeBlockFrames * kOutputChannelCount;
+
+TrackFreezer::TrackFreezer(SynthEngine& synth, Reclaimer& reclaimer,
+                           const AtomicTransport& transport, const TempoTrack& tempo)
+    : synth_(synth), reclaimer_(reclaimer), transport_(transport), tempo_(tempo) {}
+
+TrackFreezer::~TrackFreezer() {
+    cancel();
+    join();
+}
+
+bool TrackFreezer::startMidi(const std::string& filePath, MidiTrackData track) {
+    if (track.clips.size() != 1 || track.clips.front().lengthFrames <= 0) {
+        LOGW("TrackFreezer: nothing to freeze (empty MIDI clip)");
+        return false;
+    }
+    auto job = std::make_unique<Job>();
+    moveToFreezeChannel(track);
+    job->channel = track.channel;
+    job->program = track.program;
+    job->tempo = tempo_.snapshot();
+    job->sampleRate = transport_.sampleRate.load(std::memory_order_relaxed);
+    job->lengthFrames = track.clips.front().lengthFrames;
+    track.muted = false;
+    track.clips.front().offsetFrames = 0;
+
+    job->midi = std::make_unique<MidiSequencer>(reclaimer_);
+    std::vector<MidiTrackData> tracks;
+    tracks.push_back(std::move(track));
+    job->midi->updateTracks(std::move(tracks));
+    job->midi->resetToPosition(0, job->tempo, job->sampleRate);
+    return launch(filePath, std::move(job));
+}
+
+bool TrackFreezer::startDrums(const std::string& filePath, float volume,
+                              StepSequencer::ClipSlot clip) {
+    auto job = std::make_unique<Job>();
+    job->tempo = tempo_.snapshot();
+    job->sampleRate = transport_.sampleRate.load(std::memory_order_relaxed);
+    clip.offsetFrames = 0;
+
+    job->drums = std::make_unique<StepSequencer>(reclaimer_);
+    job->drums->updatePattern(volume, false, {clip});
+    job->lengthFrames = job->drums->getMaxEndFrame(job->tempo, job->sampleRate);
+    if (job->lengthFrames <= 0) {
+        LOGW("TrackFreezer: nothing to freeze (empty drum clip)");
+        return false;
+    }
+    return launch(filePath, std::move(job));
+}
+
+bool TrackFreezer::launch(const std::string& filePath, std::unique_ptr<Job> job) {
+    if (isRunning()) {
+        LOGW("TrackFreezer: a freeze is already running");
+        return false;
+    }
+    join();  // reap a previous, finished worker
+
+    std::string partPath = filePath + ".part";
+    FILE* file = fopen(partPath.c_str(), "wb");
+    if (!file) {
+        LOGE("TrackFreezer: failed to open %s", partPath.c_str());
+        return false;
+    }
+    writePcmWavHeader(file, job->sampleRate, kOutputChannelCount);
+
+    filePath_ = filePath;
+    partPath_ = partPath;
+    cancelRequested_.store(false, std::memory_order_relaxed);
+    framesRendered_.store(0, std::memory_order_relaxed);
+    totalFrames_.store(job->lengthFrames, std::memory_order_relaxed);
+    state_.store(OfflineRenderState::Running, std::memory_order_release);
+
+    LOGD("TrackFreezer: freeze started -> %s (%lld frames, %s)", filePath.c_str(),
+         (long long)job->lengthFrames, job->midi ? "midi" : "drums");
+    worker_ = std::thread(&TrackFreezer::renderLoop, this, file, std::move(job));
+    return true;
+}
+
+void TrackFreezer::cancel() {
+    cancelRequested_.store(true, std::memory_order_release);
+}
+
+void TrackFreezer::join() {
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+float TrackFreezer::getProgress() const {
+    int64_t total = totalFrames_.load(std::memory_order_relaxed);
+    if (total <= 0) return 0.0f;
+    int64_t done = framesRendered_.load(std::memory_order_relaxed);
+    return std::min(1.0f, static_cast<float>(done) / static_cast<float>(total));
+}
+
+// ── Worker thread ──────────────────────────────────────────────────────
+
+void TrackFreezer::renderLoop(FILE* file, std::unique_ptr<Job> job) {
+    float buf[kFreezeBlockSamples];
+    int16_t pcmBuf[kFreezeBlockSamples];
+    std::vector<NoteEvent> events;
+
+    // Creating the synth loads the SoundFont preset data; do it here so
+    // the UI thread that asked for the freeze never waits on it.
+    SynthPartitions synth;
+    bool ok = synth_.createDetachedSynth(synth);
+    if (ok && job->midi) {
+        fluid_synth_program_change(static_cast<fluid_synth_t*>(synth.synthForChannel(job->channel)),
+                                   job->channel, job->program);
+    }
+
+    const int64_t length = job->lengthFrames;
+    const int64_t end = length + msToFrames(kFreezeMaxTailMs, job->sampleRate);
+    const int64_t quietNeeded = msToFrames(kFreezeQuietMs, job->sampleRate);
+    int64_t quietFrames = 0;
+    int64_t pos = 0;
+    int64_t bytesWritten = 0;
+
+    while (ok && pos < end) {
+        if (cancelRequested_.load(std::memory_order_acquire)) break;
+
+        events.clear();
+        if (pos < length) {
+            const auto& due = job->midi
+                ? job->midi->tick(pos, kFreezeBlockFrames, job->tempo, job->sampleRate)
+                : job->drums->tick(pos, kFreezeBlockFrames, job->tempo, job->sampleRate);
+            events.insert(events.end(), due.begin(), due.end());
+        }
+        if (!synth.render(buf, kFreezeBlockFrames, events)) {
+            LOGE("TrackFreezer: synth render failed at frame %lld", (long long)pos);
+            ok = false;
+            break;
+        }
+
+        // The live synth is summed unclipped into the final soft-clip;
+        // here the int16 conversion clamps. A single instrument reaching
+        // full scale on its own is rare enough not to matter.
+        convertFloatToInt16(buf, pcmBuf, kFreezeBlockSamples);
+        size_t written = fwrite(pcmBuf, sizeof(int16_t), kFreezeBlockSamples, file);
+        if (written != static_cast<size_t>(kFreezeBlockSamples)) {
+            LOGE("TrackFreezer: short write at frame %lld", (long long)pos);
+            ok = false;
+            break;
+        }
+        bytesWritten += static_cast<int64_t>(written * sizeof(int16_t));
+        pos += kFreezeBlockFrames;
+        framesRendered_.store(pos, std::memory_order_relaxed);
+
+        // Past the clip, stop once the release tail has died away.
+        if (pos > length) {
+            float peak = 0.0f;
+            for (float s : buf) peak = std::max(peak, std::fabs(s));
+            quietFrames = peak < kFreezeSilencePeak ? quietFrames + kFreezeBlockFrames : 0;
+            if (quietFrames >= quietNeeded) break;
+        }
+    }
+    synth.destroy();
+
+    bool cancelled = cancelRequested_.load(std::memory_order_acquire);
+    if (ok && !cancelled) {
+        patchPcmWavHeader(file, bytesWritten);
+    }
+    fclose(file);
+
+    if (ok && !cancelled && std::rename(partPath_.c_str(), filePath_.c_str()) != 0) {
+        LOGE("TrackFreezer: failed to move %s into place", partPath_.c_str());
+        ok = false;
+    }
+    if (!ok || cancelled) {
+        std::remove(partPath_.c_str());
+    }
+
+    OfflineRenderState finalState = cancelled ? OfflineRenderState::Cancelled
+                                  : ok        ? OfflineRenderState::Completed
+                                              : OfflineRenderState::Failed;
+    state_.store(finalState, std::memory_order_release);
+    LOGD("TrackFreezer: freeze finished (state=%d, frames=%lld, clip=%lld)",
+         static_cast<int>(finalState), (long long)pos, (long long)length);
+}
+
+}  // namespace nightjar
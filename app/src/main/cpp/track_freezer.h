@@ -0,0 +1,139 @@
+#pragma once
+
+#include "common.h"
+#include "midi_sequencer.h"
+#include "offline_renderer.h"  // for OfflineRenderState
+#include "step_sequencer.h"
+#include "tempo_map.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace nightjar {
+
+class SynthEngine;
+class Reclaimer;
+struct AtomicTransport;
+
+// Longest release tail rendered past the end of a clip (4s).
+static constexpr int64_t kFreezeMaxTailMs = 4000;
+
+// The tail ends once every sample stays below this peak (-80 dBFS) for
+// kFreezeQuietMs.
+static constexpr float kFreezeSilencePeak = 1.0e-4f;
+static constexpr int64_t kFreezeQuietMs = 100;
+
+// Channel a MIDI freeze plays on in its detached synth, which plays
+// nothing else; not a drum channel.
+static constexpr int kFreezeMidiChannel = 0;
+
+/**
+ * Renders one MIDI or drum clip to a stereo 16-bit WAV, so its track can
+ * be frozen: played by the TrackMixer as a regular slot instead of being
+ * synthesized live on every pass.
+ *
+ * A clip is rendered in its own time, from frame 0 to its length, then
+ * on until its release tail dies away (at most kFreezeMaxTailMs). Linked
+ * clips share one render that the mixer places at each clip's offset.
+ *
+ * Events are scheduled as in live playback and export: a private
+ * MidiSequencer or StepSequencer holding only the clip is ticked on the
+ * kSynthRenderChunkFrames grid, and FluidSynth renders each chunk split
+ * at the event offsets. The synth is a detached partition created from
+ * the live engine's settings and SoundFont (see
+ * SynthEngine::createDetachedSynth()), so a freeze runs alongside
+ * playback instead of parking the render thread like an export. Track
+ * volume scales note velocities as it does live, so it is part of the
+ * render; master synth volume is not. The tempo map is copied when the
+ * render starts and applied from the clip's own start, which matches
+ * live playback exactly while the song has a single tempo.
+ *
+ * The file is written under a temporary name and renamed into place when
+ * complete: a frozen clip's file that exists is always whole. One render
+ * runs at a time; state and progress are atomics polled over JNI.
+ */
+class TrackFreezer {
+public:
+    TrackFreezer(SynthEngine& synth, Reclaimer& reclaimer, const AtomicTransport& transport,
+                 const TempoTrack& tempo);
+    ~TrackFreezer();
+
+    TrackFreezer(const TrackFreezer&) = delete;
+    TrackFreezer& operator=(const TrackFreezer&) = delete;
+
+    /**
+     * Render the single clip of [track] (its offset is ignored) to
+     * [filePath]; the render runs for the clip's length. Returns false
+     * if a render is already running, the clip is empty, or the file
+     * cannot be created.
+     */
+    bool startMidi(const std::string& filePath, MidiTrackData track);
+
+    /**
+     * Move [track] and every event of its clips onto kFreezeMidiChannel,
+     * where startMidi() selects the track's program. Events carry their
+     * own channel (the track's logical one), so moving the track alone
+     * would play them with the default program.
+     */
+    static void moveToFreezeChannel(MidiTrackData& track) {
+        track.channel = kFreezeMidiChannel;
+        for (auto& clip : track.clips) {
+            for (auto& event : clip.events) event.channel = kFreezeMidiChannel;
+        }
+    }
+
+    /**
+     * Render drum clip [clip] (its offset is ignored) at [volume] and the
+     * current tempo to [filePath]. Returns false as startMidi() does.
+     */
+    bool startDrums(const std::string& filePath, float volume, StepSequencer::ClipSlot clip);
+
+    /** Request cancellation. The partial file is deleted by the worker. */
+    void cancel();
+
+    /** Join the worker thread (after it finished or was cancelled). */
+    void join();
+
+    OfflineRenderState getState() const {
+        return state_.load(std::memory_order_acquire);
+    }
+
+    bool isRunning() const { return getState() == OfflineRenderState::Running; }
+
+    /** Fraction of the clip rendered so far, 0.0 - 1.0. */
+    float getProgress() const;
+
+private:
+    /** What one render plays: exactly one of the two sequencers is set. */
+    struct Job {
+        std::unique_ptr<MidiSequencer> midi;
+        std::unique_ptr<StepSequencer> drums;
+        int channel = 0;
+        int program = 0;
+        TempoMap tempo;
+        int32_t sampleRate = kDefaultSampleRate;
+        int64_t lengthFrames = 0;
+    };
+
+    /** Open the temporary file for [filePath] and start the worker on [job]. */
+    bool launch(const std::string& filePath, std::unique_ptr<Job> job);
+
+    void renderLoop(FILE* file, std::unique_ptr<Job> job);
+
+    SynthEngine& synth_;
+    Reclaimer& reclaimer_;
+    const AtomicTransport& transport_;
+    const TempoTrack& tempo_;
+
+    std::thread worker_;
+    std::string filePath_;
+    std::string partPath_;
+    std::atomic<OfflineRenderState> state_{OfflineRenderState::Idle};
+    std::atomic<bool> cancelRequested_{false};
+    std::atomic<int64_t> framesRendered_{0};
+    std::atomic<int64_t> totalFrames_{0};
+};
+
+}  // namespace nightjar
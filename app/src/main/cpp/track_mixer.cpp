@@ -1,23 +1,89 @@
 #include "track_mixer.h"
 #include "common.h"
+#include "compressed_audio.h"
+#include "compressed_track_source.h"
+#include "mix_kernels.h"
+#include "resampler.h"
+#include "wav_track_source.h"
 #include <algorithm>
+#include <climits>
 #include <cstring>
 
 namespace nightjar {
 
-// Stack-allocated mix buffer for one callback's worth of mono samples.
+// Stack-allocated source buffer: one callback's worth of frames, room
+// for a stereo source.
 static constexpr int32_t kMaxFramesPerCallback = 2048;
 
-TrackMixer::TrackMixer() = default;
+// Floats in one group bus's stereo block.
+static constexpr int32_t kBusBlockSamples = kMaxFramesPerCallback * kOutputChannelCount;
+
+TrackMixer::TrackMixer(Reclaimer& reclaimer, const AtomicTransport& transport)
+    : transport_(transport),
+      busScratch_(std::make_unique<float[]>(kRenderReaders * kMaxGroupBuses * kBusBlockSamples)),
+      lists_(reclaimer) {}
 TrackMixer::~TrackMixer() = default;
 
+/**
+ * Open the copy of [filePath] converted to [sampleRate]. prepareTakeFile()
+ * makes it beforehand, off this thread; addTrack() never converts a take
+ * itself, since that takes as long as the take is.
+ */
+static std::shared_ptr<TrackSource> openResampled(const std::string& filePath,
+                                                  int32_t fileRate, int32_t sampleRate) {
+    std::string path = resampledTakeIfCurrent(filePath, sampleRate);
+    if (path.empty()) {
+        LOGE("TrackMixer: %s is %d Hz, engine runs at %d Hz, and it wasn't prepared",
+             filePath.c_str(), fileRate, sampleRate);
+        return nullptr;
+    }
+    auto source = std::make_shared<WavTrackSource>();
+    if (!source->open(path) || source->sampleRate() != sampleRate) return nullptr;
+    return source;
+}
+
+/**
+ * Open [filePath] with the source that matches its format, at the
+ * engine's [sampleRate].
+ */
+static std::shared_ptr<TrackSource> openSource(const std::string& filePath,
+                                               TrackPrefetcher& prefetcher, int32_t sampleRate) {
+    std::shared_ptr<TrackSource> source;
+    if (CompressedAudioFile::sniff(filePath)) {
+        auto compressed = std::make_shared<CompressedTrackSource>();
+        if (!compressed->open(filePath)) return nullptr;
+        if (compressed->sampleRate() == sampleRate) {
+            source = compressed;
+        } else {
+            source = openResampled(filePath, compressed->sampleRate(), sampleRate);
+        }
+    } else {
+        auto wav = std::make_shared<WavTrackSource>();
+        if (!wav->open(filePath)) return nullptr;
+        if (wav->sampleRate() == sampleRate) {
+            source = wav;
+        } else if (wav->channelCount() != kChannelCount) {
+            // Only takes are converted; a frozen track is rendered again
+            // at the engine rate instead.
+            LOGE("TrackMixer: stereo %s is %d Hz, engine runs at %d Hz", filePath.c_str(),
+                 wav->sampleRate(), sampleRate);
+            return nullptr;
+        } else {
+            source = openResampled(filePath, wav->sampleRate(), sampleRate);
+        }
+    }
+    if (source) prefetcher.add(source);
+    return source;
+}
+
 bool TrackMixer::addTrack(int trackId, const std::string& filePath,
                           int64_t durationMs, int64_t offsetMs,
                           int64_t trimStartMs, int64_t trimEndMs,
                           float volume, bool muted) {
 
-    auto source = std::make_shared<WavTrackSource>();
-    if (!source->open(filePath)) {
+    int32_t sampleRate = transport_.sampleRate.load(std::memory_order_relaxed);
+    auto source = openSource(filePath, prefetcher_, sampleRate);
+    if (!source) {
         LOGE("TrackMixer: failed to open track %d: %s", trackId, filePath.c_str());
         return false;
     }
@@ -25,12 +91,18 @@ bool TrackMixer::addTrack(int trackId, const std::string& filePath,
     auto slot = std::make_shared<TrackSlot>();
     slot->trackId = trackId;
     slot->source = source;
-    slot->offsetFrames = msToFrames(offsetMs);
-    slot->trimStartFrames = msToFrames(trimStartMs);
-    slot->trimEndFrames = msToFrames(trimEndMs);
-    slot->effectiveFrames = msToFrames(durationMs - trimStartMs - trimEndMs);
+    slot->channels = source->channelCount();
+    slot->offsetFrames = msToFrames(offsetMs, sampleRate);
+    slot->trimStartFrames = msToFrames(trimStartMs, sampleRate);
+    slot->trimEndFrames = msToFrames(trimEndMs, sampleRate);
+    slot->effectiveFrames = durationMs < 0
+        ? std::max<int64_t>(0, source->totalFrames() - slot->trimStartFrames - slot->trimEndFrames)
+        : msToFrames(durationMs - trimStartMs - trimEndMs, sampleRate);
     slot->volume.store(volume, std::memory_order_relaxed);
     slot->muted.store(muted, std::memory_order_relaxed);
+    float left, right;
+    slot->targetGains(left, right);
+    for (auto& ramp : slot->ramp) ramp.snap(left, right);
 
     LOGD("TrackMixer: addTrack id=%d, offset=%lld, trimStart=%lld, trimEnd=%lld, "
          "effective=%lld frames, volume=%.2f, muted=%d",
@@ -40,12 +112,13 @@ bool TrackMixer::addTrack(int trackId, const std::string& filePath,
 
     {
         std::lock_guard<std::mutex> lock(editMutex_);
-        // Edit the inactive list
-        SlotList* active = activeList_.load(std::memory_order_acquire);
-        SlotList* inactive = (active == &listA_) ? &listB_ : &listA_;
-        *inactive = *active;  // copy current state
-        inactive->push_back(slot);
-        commitToActive();
+        source->cue(kCueTrackStart, slot->trimStartFrames);
+        cueSlot(*slot, kCueLoopStart, cuePositions_[kCueLoopStart]);
+        cueSlot(*slot, kCueSeek, cuePositions_[kCueSeek]);
+
+        auto next = copyCurrent();
+        next->slots.push_back(slot);
+        commit(std::move(next));
     }
 
     return true;
@@ -53,54 +126,267 @@ bool TrackMixer::addTrack(int trackId, const std::string& filePath,
 
 void TrackMixer::removeTrack(int trackId) {
     std::lock_guard<std::mutex> lock(editMutex_);
-    SlotList* active = activeList_.load(std::memory_order_acquire);
-    SlotList* inactive = (active == &listA_) ? &listB_ : &listA_;
-    *inactive = *active;
+    auto next = copyCurrent();
 
-    inactive->erase(
-        std::remove_if(inactive->begin(), inactive->end(),
+    auto& slots = next->slots;
+    slots.erase(
+        std::remove_if(slots.begin(), slots.end(),
             [trackId](const std::shared_ptr<TrackSlot>& s) {
                 return s->trackId == trackId;
             }),
-        inactive->end()
+        slots.end()
     );
 
-    commitToActive();
+    commit(std::move(next));
 }
 
 void TrackMixer::removeAllTracks() {
     std::lock_guard<std::mutex> lock(editMutex_);
-    SlotList* active = activeList_.load(std::memory_order_acquire);
-    SlotList* inactive = (active == &listA_) ? &listB_ : &listA_;
-    inactive->clear();
-    commitToActive();
+    auto next = std::make_unique<SlotList>();
+    next->buses = lists_.current()->buses;
+    commit(std::move(next));
+}
+
+TrackSlot* TrackMixer::findSlot(int trackId) const {
+    for (auto& slot : lists_.current()->slots) {
+        if (slot->trackId == trackId) return slot.get();
+    }
+    return nullptr;
+}
+
+MixBus* TrackMixer::findBus(int32_t busId) const {
+    if (busId == kMasterBus) return const_cast<MixBus*>(&master_);
+    for (auto& bus : lists_.current()->buses) {
+        if (bus->busId == busId) return bus.get();
+    }
+    return nullptr;
 }
 
 void TrackMixer::setTrackVolume(int trackId, float volume) {
-    // Lock-free — just scan the active list and write the atomic.
-    SlotList* list = activeList_.load(std::memory_order_acquire);
-    for (auto& slot : *list) {
-        if (slot->trackId == trackId) {
-            slot->volume.store(volume, std::memory_order_relaxed);
-            return;
-        }
+    // The mutex only excludes other UI-thread edits; the callback sees
+    // the atomic write on its next block.
+    std::lock_guard<std::mutex> lock(editMutex_);
+    if (TrackSlot* slot = findSlot(trackId)) {
+        slot->volume.store(volume, std::memory_order_relaxed);
     }
 }
 
 void TrackMixer::setTrackMuted(int trackId, bool muted) {
-    SlotList* list = activeList_.load(std::memory_order_acquire);
-    for (auto& slot : *list) {
-        if (slot->trackId == trackId) {
-            slot->muted.store(muted, std::memory_order_relaxed);
-            return;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    if (TrackSlot* slot = findSlot(trackId)) {
+        slot->muted.store(muted, std::memory_order_relaxed);
+    }
+}
+
+void TrackMixer::setTrackPan(int trackId, float pan) {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    if (TrackSlot* slot = findSlot(trackId)) {
+        slot->pan.store(std::clamp(pan, -1.0f, 1.0f), std::memory_order_relaxed);
+    }
+}
+
+void TrackMixer::setTrackBus(int trackId, int32_t busId) {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    TrackSlot* slot = findSlot(trackId);
+    if (!slot || slot->busId == busId) return;
+    slot->busId = busId;
+    commit(copyCurrent());
+}
+
+void TrackMixer::setTrackInsert(int trackId, int32_t index,
+                                std::shared_ptr<InsertProcessor> processor) {
+    if (index < 0 || index >= kMaxInserts) return;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    TrackSlot* slot = findSlot(trackId);
+    if (!slot) return;
+    // The current list still holds the old processor, so the callback
+    // keeps a live one until the new schedule replaces it.
+    slot->inserts.processors[index] = std::move(processor);
+    commit(copyCurrent());
+}
+
+void TrackMixer::setTrackInsertBypassed(int trackId, int32_t index, bool bypassed) {
+    if (index < 0 || index >= kMaxInserts) return;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    TrackSlot* slot = findSlot(trackId);
+    if (!slot || slot->inserts.bypassed[index] == bypassed) return;
+    slot->inserts.bypassed[index] = bypassed;
+    commit(copyCurrent());
+}
+
+void TrackMixer::post(const MixerCommand* commands, size_t count) {
+    if (count == 0) return;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    const SlotList* list = lists_.current();
+    // Resolve each track against the list the callback will most likely
+    // still be reading, so it doesn't have to search for it.
+    MixerCommand resolved[kMixerCommandCapacity];
+    bool fits = count <= kMixerCommandCapacity;
+    for (size_t i = 0; fits && i < count; ++i) {
+        resolved[i] = commands[i];
+        resolved[i].slotIndex = -1;
+        resolved[i].generation = list->generation;
+        for (size_t s = 0; s < list->slots.size(); ++s) {
+            if (list->slots[s]->trackId == commands[i].id) {
+                resolved[i].slotIndex = static_cast<int32_t>(s);
+                break;
+            }
+        }
+    }
+    if (fits && commands_.push(resolved, count)) return;
+
+    LOGW("TrackMixer: command queue full, applying %zu changes directly", count);
+    for (size_t i = 0; i < count; ++i) applyCommand(*list, commands[i]);
+}
+
+void TrackMixer::apply(const MixerCommand* commands, size_t count) {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    const SlotList* list = lists_.current();
+    for (size_t i = 0; i < count; ++i) applyCommand(*list, commands[i]);
+}
+
+void TrackMixer::applyCommands() {
+    if (commands_.empty()) return;
+    SnapshotPublisher<SlotList>::ReadGuard list(lists_, kLiveReader);
+    commands_.drain([&](const MixerCommand& command) { applyCommand(*list, command); });
+}
+
+void TrackMixer::applyCommand(const SlotList& list, const MixerCommand& command) {
+    using Op = MixerCommand::Op;
+    if (command.op == Op::BusVolume || command.op == Op::BusMuted) {
+        MixBus* bus = command.id == kMasterBus ? &master_ : nullptr;
+        for (size_t i = 0; !bus && i < list.buses.size(); ++i) {
+            if (list.buses[i]->busId == command.id) bus = list.buses[i].get();
+        }
+        if (!bus) return;
+        if (command.op == Op::BusVolume) {
+            bus->volume.store(command.value, std::memory_order_relaxed);
+        } else {
+            bus->muted.store(command.value != 0.0f, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    TrackSlot* slot = nullptr;
+    if (command.generation == list.generation && command.slotIndex >= 0 &&
+        static_cast<size_t>(command.slotIndex) < list.slots.size()) {
+        slot = list.slots[command.slotIndex].get();
+    } else {
+        // The list changed since post(); find the track again.
+        for (const auto& s : list.slots) {
+            if (s->trackId == command.id) {
+                slot = s.get();
+                break;
+            }
+        }
+    }
+    if (!slot) return;
+    switch (command.op) {
+        case Op::TrackVolume:
+            slot->volume.store(command.value, std::memory_order_relaxed);
+            break;
+        case Op::TrackMuted:
+            slot->muted.store(command.value != 0.0f, std::memory_order_relaxed);
+            break;
+        case Op::TrackPan:
+            slot->pan.store(std::clamp(command.value, -1.0f, 1.0f), std::memory_order_relaxed);
+            break;
+        default:
+            break;
+    }
+}
+
+bool TrackMixer::addBus(int32_t busId) {
+    if (busId <= kMasterBus) return false;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    if (findBus(busId)) return false;
+    if (lists_.current()->buses.size() >= static_cast<size_t>(kMaxGroupBuses)) {
+        LOGE("TrackMixer: no room for bus %d (max %d)", busId, kMaxGroupBuses);
+        return false;
+    }
+    auto bus = std::make_shared<MixBus>();
+    bus->busId = busId;
+    auto next = copyCurrent();
+    next->buses.push_back(std::move(bus));
+    commit(std::move(next));
+    return true;
+}
+
+void TrackMixer::removeBus(int32_t busId) {
+    if (busId == kMasterBus) return;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    auto next = copyCurrent();
+    auto& buses = next->buses;
+    auto it = std::find_if(buses.begin(), buses.end(),
+        [busId](const std::shared_ptr<MixBus>& b) { return b->busId == busId; });
+    if (it == buses.end()) return;
+    buses.erase(it);
+    for (auto& slot : next->slots) {
+        if (slot->busId == busId) slot->busId = kMasterBus;
+    }
+    commit(std::move(next));
+}
+
+void TrackMixer::setBusVolume(int32_t busId, float volume) {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    if (MixBus* bus = findBus(busId)) bus->volume.store(volume, std::memory_order_relaxed);
+}
+
+void TrackMixer::setBusMuted(int32_t busId, bool muted) {
+    std::lock_guard<std::mutex> lock(editMutex_);
+    if (MixBus* bus = findBus(busId)) bus->muted.store(muted, std::memory_order_relaxed);
+}
+
+void TrackMixer::setBusInsert(int32_t busId, int32_t index,
+                              std::shared_ptr<InsertProcessor> processor) {
+    if (index < 0 || index >= kMaxInserts) return;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    MixBus* bus = findBus(busId);
+    if (!bus) return;
+    bus->inserts.processors[index] = std::move(processor);
+    commit(copyCurrent());
+}
+
+void TrackMixer::setBusInsertBypassed(int32_t busId, int32_t index, bool bypassed) {
+    if (index < 0 || index >= kMaxInserts) return;
+    std::lock_guard<std::mutex> lock(editMutex_);
+    MixBus* bus = findBus(busId);
+    if (!bus || bus->inserts.bypassed[index] == bypassed) return;
+    bus->inserts.bypassed[index] = bypassed;
+    commit(copyCurrent());
+}
+
+void TrackMixer::cueAt(TrackCue cue, int64_t positionFrames, bool faultIn) {
+    std::vector<std::shared_ptr<TrackSlot>> slots;
+    {
+        std::lock_guard<std::mutex> lock(editMutex_);
+        cuePositions_[cue] = positionFrames;
+        slots = lists_.current()->slots;
+        for (const auto& slot : slots) {
+            cueSlot(*slot, cue, positionFrames);
         }
     }
+    // Outside the lock: this may block on storage, and edits needn't wait.
+    if (faultIn) {
+        for (const auto& slot : slots) slot->source->prepare(cue);
+    }
+}
+
+void TrackMixer::cueSlot(const TrackSlot& slot, TrackCue cue, int64_t positionFrames) {
+    // A position before the slot lands on its start, which is always
+    // cued; one past its end never reads it.
+    int64_t localFrame = positionFrames - slot.offsetFrames;
+    if (positionFrames < 0 || localFrame < 0 || localFrame >= slot.effectiveFrames) {
+        slot.source->cue(cue, -1);
+    } else {
+        slot.source->cue(cue, slot.trimStartFrames + localFrame);
+    }
 }
 
 int64_t TrackMixer::computeTotalFrames() const {
-    SlotList* list = activeList_.load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lock(editMutex_);
     int64_t maxEnd = 0;
-    for (const auto& slot : *list) {
+    for (const auto& slot : lists_.current()->slots) {
         int64_t end = slot->offsetFrames + slot->effectiveFrames;
         if (end > maxEnd) maxEnd = end;
     }
@@ -108,72 +394,320 @@ int64_t TrackMixer::computeTotalFrames() const {
 }
 
 void TrackMixer::renderFrames(float* output, int32_t numFrames, int64_t positionFrames) {
+    renderFrames(output, numFrames, positionFrames, liveCursor_);
+}
+
+void TrackMixer::renderFrames(float* output, int32_t numFrames, int64_t positionFrames,
+                              RenderCursor& cursor) {
     // Zero the stereo output buffer
     std::memset(output, 0, static_cast<size_t>(numFrames) * kOutputChannelCount * sizeof(float));
 
-    SlotList* list = activeList_.load(std::memory_order_acquire);
-    if (!list || list->empty()) return;
+    SnapshotPublisher<SlotList>::ReadGuard list(lists_, cursor.reader);
+    if (list->byStart.empty()) return;
 
-    // Stack-allocated mono mix buffer
-    float monoBuf[kMaxFramesPerCallback];
+    // Stack-allocated source buffer (mono takes, stereo frozen tracks)
+    float sourceBuf[kMaxFramesPerCallback * kOutputChannelCount];
     int32_t framesToProcess = std::min(numFrames, kMaxFramesPerCallback);
+    int64_t blockEnd = positionFrames + framesToProcess;
+    int reader = cursor.reader;
+
+    // A seek, loop wrap or list swap invalidates the cursor.
+    bool valid = cursor.generation == list->generation &&
+                 cursor.expectedPos == positionFrames;
+    bool located = valid || relocate(*list, cursor, positionFrames);
+
+    BusBlock buses;
+    buses.output = output;
+    buses.scratch = busScratch_.get() + reader * kMaxGroupBuses * kBusBlockSamples;
+    buses.frames = framesToProcess;
+    beginBuses(*list, buses, reader);
+
+    const auto& byStart = list->byStart;
+    if (!located) {
+        // More overlapping slots than the cursor holds: scan everything
+        // that has started and re-locate on the next block.
+        for (size_t i = 0; i < byStart.size() && byStart[i].slot->offsetFrames < blockEnd; ++i) {
+            mixSlot(*list, byStart[i], buses, sourceBuf, positionFrames, reader);
+        }
+        mixBuses(*list, buses, reader);
+        cursor.expectedPos = -1;
+        return;
+    }
+
+    // Activate slots that start inside this block. Nothing of theirs
+    // has sounded yet, so their gains start where the controls are.
+    while (cursor.nextIndex < byStart.size() &&
+           byStart[cursor.nextIndex].slot->offsetFrames < blockEnd) {
+        if (cursor.activeCount == RenderCursor::kMaxActive) {
+            // Overflow: render the rest without the cursor this time.
+            for (size_t i = cursor.nextIndex;
+                 i < byStart.size() && byStart[i].slot->offsetFrames < blockEnd; ++i) {
+                mixSlot(*list, byStart[i], buses, sourceBuf, positionFrames, reader);
+            }
+            for (int32_t i = 0; i < cursor.activeCount; ++i) {
+                mixSlot(*list, *cursor.active[i], buses, sourceBuf, positionFrames, reader);
+            }
+            mixBuses(*list, buses, reader);
+            cursor.expectedPos = -1;
+            return;
+        }
+        const TrackEntry& entry = byStart[cursor.nextIndex++];
+        float left, right;
+        entry.slot->targetGains(left, right);
+        entry.slot->ramp[reader].snap(left, right);
+        cursor.active[cursor.activeCount++] = &entry;
+    }
+
+    // Mix the active set, retiring slots that end within this block.
+    int32_t kept = 0;
+    for (int32_t i = 0; i < cursor.activeCount; ++i) {
+        const TrackEntry* entry = cursor.active[i];
+        mixSlot(*list, *entry, buses, sourceBuf, positionFrames, reader);
+        if (entry->slot->offsetFrames + entry->slot->effectiveFrames > blockEnd) {
+            cursor.active[kept++] = entry;
+        }
+    }
+    cursor.activeCount = kept;
+    cursor.expectedPos = blockEnd;
 
-    for (const auto& slot : *list) {
-        if (slot->muted.load(std::memory_order_relaxed)) continue;
-        if (!slot->source || !slot->source->isOpen()) continue;
+    mixBuses(*list, buses, reader);
 
-        float vol = slot->volume.load(std::memory_order_relaxed);
-        if (vol <= 0.0f) continue;
+    // Note: soft-clip is applied in OboePlaybackStream::onAudioReady()
+    // AFTER all audio sources (tracks + synth) have been summed together.
+}
 
-        // Map global position → local frame within this track
-        // Global position corresponds to: offset + trimStart + localPlayFrame
-        // So localPlayFrame = globalPos - offset
-        // And the source frame = trimStart + localPlayFrame
-        int64_t localFrame = positionFrames - slot->offsetFrames;
+float* TrackMixer::BusBlock::buffer(const SlotList& list, int32_t bus) {
+    if (bus == static_cast<int32_t>(list.schedule.size()) - 1) return output;
+    float* block = scratch + bus * kBusBlockSamples;
+    if (!used[bus]) {
+        std::memset(block, 0, static_cast<size_t>(frames) * kOutputChannelCount * sizeof(float));
+        used[bus] = true;
+    }
+    return block;
+}
 
-        // Skip if this track hasn't started or has ended
-        if (localFrame >= slot->effectiveFrames || localFrame + framesToProcess <= 0) continue;
+void TrackMixer::beginBuses(const SlotList& list, BusBlock& block, int reader) {
+    auto count = static_cast<int32_t>(list.schedule.size());
+    for (int32_t i = 0; i < count; ++i) {
+        MixBus& bus = *list.schedule[i].bus;
+        float gain = bus.targetGain();
+        bus.ramp[reader].retarget(gain, gain);
+        block.silent[i] = bus.ramp[reader].silent();
+    }
+    // Everything feeds the master, so a silent master silences it all.
+    if (block.silent[count - 1]) {
+        for (int32_t i = 0; i < count - 1; ++i) block.silent[i] = true;
+    }
+}
 
-        // Clamp to the portion of this callback that overlaps the track
-        int32_t skipOutput = 0;  // frames to skip in the output buffer
-        int64_t sourceStart = slot->trimStartFrames + localFrame;
-        int32_t readCount = framesToProcess;
+void TrackMixer::mixSlot(const SlotList& list, const TrackEntry& entry, BusBlock& buses,
+                         float* sourceBuf, int64_t positionFrames, int reader) {
+    TrackSlot& slot = *entry.slot;
+    if (buses.silent[entry.bus]) return;
+    if (!slot.source || !slot.source->isOpen()) return;
+
+    // A muted or zero-volume track is skipped once its ramp has faded out.
+    float left, right;
+    slot.targetGains(left, right);
+    GainRamp& ramp = slot.ramp[reader];
+    ramp.retarget(left, right);
+    if (ramp.silent()) return;
+
+    // Map global position → local frame within this track
+    // Global position corresponds to: offset + trimStart + localPlayFrame
+    // So localPlayFrame = globalPos - offset
+    // And the source frame = trimStart + localPlayFrame
+    int32_t framesToProcess = buses.frames;
+    int64_t localFrame = positionFrames - slot.offsetFrames;
+
+    // Skip if this track hasn't started or has ended
+    if (localFrame >= slot.effectiveFrames || localFrame + framesToProcess <= 0) return;
+
+    // Clamp to the portion of this callback that overlaps the track
+    int32_t skipOutput = 0;  // frames to skip in the output buffer
+    int64_t sourceStart = slot.trimStartFrames + localFrame;
+    int32_t readCount = framesToProcess;
+
+    if (localFrame < 0) {
+        // Track starts partway through this callback
+        skipOutput = static_cast<int32_t>(-localFrame);
+        sourceStart = slot.trimStartFrames;
+        readCount = framesToProcess - skipOutput;
+    }
 
-        if (localFrame < 0) {
-            // Track starts partway through this callback
-            skipOutput = static_cast<int32_t>(-localFrame);
-            sourceStart = slot->trimStartFrames;
-            readCount = framesToProcess - skipOutput;
-        }
+    int64_t remaining = slot.effectiveFrames - std::max(localFrame, (int64_t)0);
+    if (readCount > remaining) {
+        readCount = static_cast<int32_t>(remaining);
+    }
+
+    if (readCount <= 0) return;
+
+    float* bus = buses.buffer(list, entry.bus) + skipOutput * kOutputChannelCount;
+
+    // A steady mono take with no inserts converts, pans and mixes in one
+    // pass where its source allows
+    if (entry.inserts.count == 0 && ramp.remaining == 0 && slot.channels == 1) {
+        int64_t mixed = slot.source->mixFrames(bus, sourceStart, readCount, ramp.gain[0],
+                                               ramp.gain[1], reader == kOfflineReader);
+        if (mixed >= 0) return;
+    }
+
+    // Read samples from the source (mapping or decoded cache)
+    int64_t read = reader == kOfflineReader
+                       ? slot.source->readFramesOffline(sourceBuf, sourceStart, readCount)
+                       : slot.source->readFrames(sourceBuf, sourceStart, readCount);
+    auto frames = static_cast<int32_t>(read);
+    if (frames <= 0) return;
+
+    // Inserts see the source as it is; gain and pan place it in the bus.
+    entry.inserts.run(sourceBuf, frames, slot.channels);
+    if (slot.channels == kOutputChannelCount) {
+        mixBalancedThroughRamp(ramp, sourceBuf, bus, frames);
+    } else {
+        mixMonoThroughRamp(ramp, sourceBuf, bus, frames);
+    }
+}
 
-        int64_t remaining = slot->effectiveFrames - std::max(localFrame, (int64_t)0);
-        if (readCount > remaining) {
-            readCount = static_cast<int32_t>(remaining);
+void TrackMixer::mixBuses(const SlotList& list, BusBlock& buses, int reader) {
+    auto master = static_cast<int32_t>(list.schedule.size()) - 1;
+    for (int32_t i = 0; i < master; ++i) {
+        if (!buses.used[i]) continue;   // nothing sounded into it this block
+        const BusNode& node = list.schedule[i];
+        float* sum = buses.scratch + i * kBusBlockSamples;
+        node.inserts.run(sum, buses.frames, kOutputChannelCount);
+        mixStereoThroughRamp(node.bus->ramp[reader], sum, buses.output, buses.frames);
+    }
+
+    const BusNode& node = list.schedule[master];
+    node.inserts.run(buses.output, buses.frames, kOutputChannelCount);
+    GainRamp& ramp = node.bus->ramp[reader];
+    if (!ramp.unity()) applyRamp(ramp, buses.output, buses.frames);
+}
+
+bool TrackMixer::relocate(const SlotList& list, RenderCursor& cursor, int64_t positionFrames) {
+    const auto& byStart = list.byStart;
+    // After a jump nothing carries over from the last block, so ramps
+    // start at their targets instead of gliding from stale gains.
+    bool jumped = cursor.expectedPos != positionFrames;
+    int reader = cursor.reader;
+    cursor.generation = list.generation;
+    cursor.expectedPos = positionFrames;
+    cursor.activeCount = 0;
+
+    if (jumped) {
+        for (const BusNode& node : list.schedule) {
+            float gain = node.bus->targetGain();
+            node.bus->ramp[reader].snap(gain, gain);
         }
+    }
 
-        if (readCount <= 0) continue;
+    // First slot starting at or after the position; everything from here
+    // on is activated by the forward walk in renderFrames().
+    auto it = std::lower_bound(byStart.begin(), byStart.end(), positionFrames,
+        [](const TrackEntry& entry, int64_t pos) { return entry.slot->offsetFrames < pos; });
+    cursor.nextIndex = static_cast<size_t>(it - byStart.begin());
+
+    // Walk backwards collecting earlier slots still sounding at the
+    // position. Once the running max end is at or before the position,
+    // nothing further back can overlap.
+    for (size_t i = cursor.nextIndex; i-- > 0 && list.maxEndPrefix[i] > positionFrames;) {
+        const TrackEntry& entry = byStart[i];
+        TrackSlot* slot = entry.slot;
+        if (slot->offsetFrames + slot->effectiveFrames <= positionFrames) continue;
+        if (cursor.activeCount == RenderCursor::kMaxActive) {
+            cursor.expectedPos = -1;
+            return false;
+        }
+        if (jumped) {
+            float left, right;
+            slot->targetGains(left, right);
+            slot->ramp[reader].snap(left, right);
+        }
+        cursor.active[cursor.activeCount++] = &entry;
+    }
+    return true;
+}
 
-        // Read mono samples from the mmap'd source
-        int64_t read = slot->source->readFrames(monoBuf, sourceStart, readCount);
+/** Append the non-bypassed processors of [slots] to [chain], kept alive by [list]. */
+static void compileInserts(const InsertSlots& slots, InsertChain& chain,
+                           TrackMixer::SlotList& list) {
+    for (int32_t i = 0; i < kMaxInserts; ++i) {
+        const auto& processor = slots.processors[i];
+        if (!processor || slots.bypassed[i]) continue;
+        chain.stages[chain.count++] = processor.get();
+        list.processors.push_back(processor);
+    }
+}
 
-        // Mix into stereo output: mono → L+R (center pan)
-        for (int64_t i = 0; i < read; ++i) {
-            float sample = monoBuf[i] * vol;
-            int32_t outIdx = (skipOutput + static_cast<int32_t>(i)) * kOutputChannelCount;
-            output[outIdx]     += sample;  // Left
-            output[outIdx + 1] += sample;  // Right
+void TrackMixer::compile(SlotList& list) const {
+    list.byStart.clear();
+    list.maxEndPrefix.clear();
+    list.schedule.clear();
+    list.processors.clear();
+
+    // Group buses that some track feeds, in creation order, then the
+    // master. Unfed buses are left out of the schedule entirely.
+    int32_t scheduleIndex[kMaxGroupBuses];
+    for (size_t b = 0; b < list.buses.size(); ++b) {
+        scheduleIndex[b] = -1;
+        const MixBus& bus = *list.buses[b];
+        bool fed = std::any_of(list.slots.begin(), list.slots.end(),
+            [&bus](const std::shared_ptr<TrackSlot>& slot) {
+                return slot->busId == bus.busId && slot->effectiveFrames > 0;
+            });
+        if (!fed) continue;
+        BusNode node;
+        node.bus = list.buses[b].get();
+        compileInserts(bus.inserts, node.inserts, list);
+        scheduleIndex[b] = static_cast<int32_t>(list.schedule.size());
+        list.schedule.push_back(node);
+    }
+    auto master = static_cast<int32_t>(list.schedule.size());
+    for (BusNode& node : list.schedule) node.output = master;
+    BusNode masterNode;
+    masterNode.bus = const_cast<MixBus*>(&master_);
+    compileInserts(master_.inserts, masterNode.inserts, list);
+    list.schedule.push_back(masterNode);
+
+    for (const auto& slot : list.slots) {
+        if (slot->effectiveFrames <= 0) continue;
+        TrackEntry entry;
+        entry.slot = slot.get();
+        entry.bus = master;
+        for (size_t b = 0; b < list.buses.size(); ++b) {
+            if (list.buses[b]->busId == slot->busId) entry.bus = scheduleIndex[b];
         }
+        compileInserts(slot->inserts, entry.inserts, list);
+        list.byStart.push_back(entry);
+    }
+    std::stable_sort(list.byStart.begin(), list.byStart.end(),
+        [](const TrackEntry& a, const TrackEntry& b) {
+            return a.slot->offsetFrames < b.slot->offsetFrames;
+        });
+
+    list.maxEndPrefix.reserve(list.byStart.size());
+    int64_t maxEnd = INT64_MIN;
+    for (const TrackEntry& entry : list.byStart) {
+        maxEnd = std::max(maxEnd, entry.slot->offsetFrames + entry.slot->effectiveFrames);
+        list.maxEndPrefix.push_back(maxEnd);
     }
+}
 
-    // Note: soft-clip (tanh) is applied in OboePlaybackStream::onAudioReady()
-    // AFTER all audio sources (tracks + synth) have been summed together.
+std::unique_ptr<TrackMixer::SlotList> TrackMixer::copyCurrent() const {
+    // Only the slots and buses are carried over; the index and schedule
+    // are rebuilt on commit.
+    auto next = std::make_unique<SlotList>();
+    next->slots = lists_.current()->slots;
+    next->buses = lists_.current()->buses;
+    return next;
 }
 
-void TrackMixer::commitToActive() {
-    // Swap: the inactive list (which we just edited) becomes active.
-    SlotList* current = activeList_.load(std::memory_order_acquire);
-    SlotList* newActive = (current == &listA_) ? &listB_ : &listA_;
-    activeList_.store(newActive, std::memory_order_release);
+void TrackMixer::commit(std::unique_ptr<SlotList> next) {
+    compile(*next);
+    next->generation = ++generation_;
+    // The replaced list is retired to the reclaimer, so a callback still
+    // mixing from it keeps a valid view until it releases its slot.
+    lists_.publish(std::move(next));
 }
 
 }  // namespace nightjar
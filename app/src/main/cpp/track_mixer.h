@@ -1,7 +1,12 @@
 #pragma once
 
-#include "wav_track_source.h"
+#include "track_source.h"
+#include "command_ring.h"
+#include "mix_graph.h"
+#include "track_prefetcher.h"
 #include "audio_engine.h"
+#include "atomic_transport.h"
+#include "snapshot_publisher.h"
 #include <atomic>
 #include <memory>
 #include <mutex>
@@ -13,46 +18,131 @@ namespace nightjar {
 /**
  * Per-track slot in the mixer.
  *
- * Volume and muted are atomic — the audio callback reads them,
+ * Volume, pan and muted are atomic — the audio callback reads them,
  * the UI thread writes them. No locking needed.
- * The WavTrackSource is immutable once set (replaced on track list swap).
+ * The TrackSource is immutable once set (replaced on track list swap).
+ * Routing and inserts are edit-side state, guarded by the mixer's edit
+ * mutex; the callback only sees them through the compiled schedule.
  */
 struct TrackSlot {
     int trackId = 0;
-    std::shared_ptr<WavTrackSource> source;
+    std::shared_ptr<TrackSource> source;
     int64_t offsetFrames = 0;
     int64_t trimStartFrames = 0;
     int64_t trimEndFrames = 0;
     int64_t effectiveFrames = 0;  // duration - trimStart - trimEnd
+    int32_t channels = kChannelCount;  // the source's; 2 for a frozen track
     std::atomic<float> volume{1.0f};
+    std::atomic<float> pan{0.0f};
     std::atomic<bool> muted{false};
+
+    int32_t busId = kMasterBus;
+    InsertSlots inserts;
+    GainRamp ramp[kRenderReaders];   // ramp[reader], that thread only
+
+    /** Per-channel gains the controls ask for right now. */
+    void targetGains(float& left, float& right) const {
+        if (muted.load(std::memory_order_relaxed)) {
+            left = right = 0.0f;
+            return;
+        }
+        float v = volume.load(std::memory_order_relaxed);
+        float p = pan.load(std::memory_order_relaxed);
+        if (channels == kOutputChannelCount) {
+            balanceGains(v, p, left, right);
+        } else {
+            panGains(v, p, left, right);
+        }
+    }
 };
 
 /**
- * Multi-track mixer using double-buffered track list.
+ * A control change queued for the audio callback (TrackMixer::post()).
+ * [slotIndex] and [generation] locate the track in the list post() saw,
+ * so the callback finds it without a search unless the list changed.
+ */
+struct MixerCommand {
+    enum class Op : int32_t { TrackVolume, TrackMuted, TrackPan, BusVolume, BusMuted };
+
+    Op op = Op::TrackVolume;
+    int32_t id = 0;           // track or bus id
+    float value = 0.0f;       // volume, pan, or 0/1 for muted
+    int32_t slotIndex = -1;   // track commands: index in the list's slots
+    uint64_t generation = 0;  // list generation slotIndex refers to
+};
+
+// Control changes queued between two callbacks. A full queue falls back
+// to applying the changes directly, so this only bounds batching.
+static constexpr size_t kMixerCommandCapacity = 256;
+
+/**
+ * Multi-track mixer using an RCU-published track list.
  *
- * The audio callback reads from the active list via an atomic pointer.
- * The UI thread modifies the inactive list under a mutex, then swaps
- * the pointer. The audio callback NEVER blocks.
+ * The audio callback reads the current list through a SnapshotPublisher
+ * hazard slot. The UI thread builds a fresh list under a mutex and
+ * publishes it; the replaced list (and any TrackSource whose last
+ * reference it held) is freed on the Reclaimer thread once no reader
+ * announces it. The audio callback NEVER blocks and never frees.
  *
  * ## Rendering
- * For each non-muted track, maps the global position to a local frame
- * (accounting for offset + trim), reads from the mmap'd WAV source,
- * multiplies by volume, and sums into the output buffer. The result
- * is soft-clipped via tanh() to prevent harsh digital clipping when
- * many tracks overlap.
+ * For each sounding track, maps the global position to a local frame
+ * (accounting for offset + trim), reads from the track's source, runs
+ * its inserts, and sums it through its gain/pan ramp into the bus it
+ * feeds. Group buses then run their inserts and sum into the output
+ * through their own ramps, and the master bus is applied last (see
+ * mix_graph.h). The final mix is soft-clipped by the playback callback
+ * (see mix_kernels.h) to prevent harsh digital clipping when many
+ * tracks overlap.
+ *
+ * ## Interval index
+ * Every commit rebuilds a start-sorted view of the slot list with a
+ * running maximum of end frames. A RenderCursor walks that view as
+ * playback advances, so a callback only visits slots that intersect
+ * the block being rendered; cost scales with what is sounding rather
+ * than with the number of takes in the project. Seeks, loop wraps and
+ * list swaps are detected by the cursor and resolved with a binary
+ * search plus a short backward walk bounded by the running maximum.
+ *
+ * ## Sources
+ * addTrack() picks the source by file content: WAV takes are read from
+ * their mapping, `.njca` takes through a CompressedTrackSource. The
+ * mixer's TrackPrefetcher keeps both ready ahead of the playhead --
+ * faulting WAV pages in, decoding compressed blocks -- so the callback
+ * only copies resident memory. cueAt() tells every source where the
+ * next jump (loop wrap, seek) will land so it is prepared in advance.
+ *
+ * A take at another rate than the engine (recorded before the engine
+ * followed the device, or imported) is converted once, to a WAV kept
+ * next to it, and that copy is played instead. The conversion is made
+ * by prepareTakeFile() on a worker thread before addTrack(), which only
+ * opens the copy.
+ *
+ * ## Control changes
+ * Volume, pan and mute are atomics on the slots and buses. Edits from
+ * the command channel are queued with post() instead of written
+ * directly: the callback applies everything queued at the start of its
+ * next block (applyCommands()), so a batch -- a solo toggle muting a
+ * dozen takes, say -- lands on one block boundary rather than straddling
+ * two.
  *
  * ## Output format
- * Mono source → stereo output (same sample to L+R channels, panned center).
+ * Mono source → stereo output, placed by the track's constant-power pan
+ * (the same sample on L+R at the center). Stereo sources -- the renders
+ * of frozen MIDI and drum tracks -- are mixed as they are, with pan as a
+ * balance control.
  */
 class TrackMixer {
 public:
-    TrackMixer();
+    /** Track positions are converted at [transport]'s sample rate. */
+    TrackMixer(Reclaimer& reclaimer, const AtomicTransport& transport);
     ~TrackMixer();
 
     /**
      * Add a track to the mixer. Called from the UI thread.
-     * The source is opened (mmap'd) here.
+     * The source is opened (mmap'd) here; compressed takes also start
+     * decoding their first blocks. A negative [durationMs] plays the
+     * whole source (frozen tracks, whose length is only known from the
+     * rendered file).
      */
     bool addTrack(int trackId, const std::string& filePath,
                   int64_t durationMs, int64_t offsetMs,
@@ -65,18 +155,139 @@ public:
     /** Remove all tracks. Called from the UI thread. */
     void removeAllTracks();
 
-    /** Set volume for a track. Lock-free (atomic write). */
+    /** Set volume for a track. Atomic write; never blocks the callback. */
     void setTrackVolume(int trackId, float volume);
 
-    /** Set muted state for a track. Lock-free (atomic write). */
+    /** Set muted state for a track. Atomic write; never blocks the callback. */
     void setTrackMuted(int trackId, bool muted);
 
+    /** Set pan (-1 left … +1 right) for a track. Atomic write. */
+    void setTrackPan(int trackId, float pan);
+
+    /**
+     * Queue [count] control changes for the audio callback, which applies
+     * them together at the start of one block. Applied right away instead
+     * if they don't fit the queue. UI thread.
+     */
+    void post(const MixerCommand* commands, size_t count);
+
+    /** Apply [count] control changes now, bypassing the queue. UI thread. */
+    void apply(const MixerCommand* commands, size_t count);
+
+    /**
+     * Apply everything post() queued. Audio callback only, at the start
+     * of a block (playing or paused).
+     */
+    void applyCommands();
+
+    /**
+     * Route a track into bus [busId] (kMasterBus, or a group bus from
+     * addBus()). An unknown bus routes to the master. Recompiles the
+     * schedule.
+     */
+    void setTrackBus(int trackId, int32_t busId);
+
+    /**
+     * Put [processor] (nullptr clears) into insert slot [index] of a
+     * track. Recompiles the schedule; the replaced processor is freed on
+     * the reclaimer thread with the list that used it.
+     */
+    void setTrackInsert(int trackId, int32_t index, std::shared_ptr<InsertProcessor> processor);
+
+    /** Bypass insert slot [index] of a track; bypassed slots are compiled out. */
+    void setTrackInsertBypassed(int trackId, int32_t index, bool bypassed);
+
+    /**
+     * Create group bus [busId] (> 0). Returns false if it exists or the
+     * kMaxGroupBuses limit is reached.
+     */
+    bool addBus(int32_t busId);
+
+    /** Remove group bus [busId]; its tracks fall back to the master. */
+    void removeBus(int32_t busId);
+
+    /** Set volume of bus [busId] (kMasterBus included). Atomic write. */
+    void setBusVolume(int32_t busId, float volume);
+
+    /** Set muted state of bus [busId] (kMasterBus included). Atomic write. */
+    void setBusMuted(int32_t busId, bool muted);
+
+    /** Insert slot [index] of bus [busId], as setTrackInsert(). */
+    void setBusInsert(int32_t busId, int32_t index, std::shared_ptr<InsertProcessor> processor);
+
+    /** Bypass insert slot [index] of bus [busId]. */
+    void setBusInsertBypassed(int32_t busId, int32_t index, bool bypassed);
+
+    /**
+     * Tell every track that playback may jump to global [positionFrames]
+     * (-1 clears the cue), so streaming sources decode it ahead of time.
+     * Remembered and applied to tracks added later. UI thread.
+     *
+     * With [faultIn], also waits until every source can serve the
+     * position (see TrackSource::prepare()); used before playback starts
+     * or jumps there.
+     */
+    void cueAt(TrackCue cue, int64_t positionFrames, bool faultIn = false);
+
     /**
      * Compute the total timeline duration from all loaded tracks.
      * Returns duration in frames.
      */
     int64_t computeTotalFrames() const;
 
+    /** Hazard slots used by the two rendering threads. */
+    static constexpr int kLiveReader = 0;
+    static constexpr int kOfflineReader = 1;
+    static_assert(kRenderReaders == 2, "one GainRamp per rendering thread");
+
+    /** A track in the compiled schedule: its slot plus where it goes. */
+    struct TrackEntry {
+        TrackSlot* slot = nullptr;
+        int32_t bus = 0;         // schedule index of the bus it feeds
+        InsertChain inserts;
+    };
+
+    /**
+     * One published track list: the slots and group buses in insertion
+     * order plus the interval index and bus schedule compiled from them
+     * at commit time.
+     */
+    struct SlotList {
+        std::vector<std::shared_ptr<TrackSlot>> slots;
+        std::vector<std::shared_ptr<MixBus>> buses;   // group buses
+
+        /** Slots with a non-empty duration, sorted by offsetFrames. */
+        std::vector<TrackEntry> byStart;
+        /** maxEndPrefix[i] = max end frame over byStart[0..i]. */
+        std::vector<int64_t> maxEndPrefix;
+        /** Buses in execution order: used group buses, then the master. */
+        std::vector<BusNode> schedule;
+        /** Keeps every processor in the schedule alive with the list. */
+        std::vector<std::shared_ptr<InsertProcessor>> processors;
+        /** Bumped on every commit so cursors can detect a swap. */
+        uint64_t generation = 0;
+    };
+
+    /**
+     * Render-side position within the interval index.
+     *
+     * Each rendering thread owns one cursor (the playback callback uses
+     * the mixer's built-in cursor, the offline renderer its own). The
+     * cursor remembers which slots are currently sounding and the next
+     * slot to start, and re-locates itself whenever the render position
+     * or the active list is not what it expects.
+     */
+    struct RenderCursor {
+        static constexpr int32_t kMaxActive = 64;
+
+        int reader = kLiveReader;  // hazard slot of the owning thread
+        uint64_t generation = 0;   // list generation the cursor was built for
+        int64_t expectedPos = -1;  // position the next block should start at
+        size_t nextIndex = 0;      // first byStart entry not yet activated
+        int32_t activeCount = 0;
+        const TrackEntry* active[kMaxActive] = {};
+    };
+
     /**
      * Render mixed audio into the output buffer.
      * Called from the audio callback — must be lock-free.
@@ -87,20 +298,82 @@ public:
      */
     void renderFrames(float* output, int32_t numFrames, int64_t positionFrames);
 
+    /** As above, tracking position with a caller-owned [cursor]. */
+    void renderFrames(float* output, int32_t numFrames, int64_t positionFrames,
+                      RenderCursor& cursor);
+
 private:
-    using SlotList = std::vector<std::shared_ptr<TrackSlot>>;
+    /** Copy of the current slots, to be edited and then committed. */
+    std::unique_ptr<SlotList> copyCurrent() const;
+
+    /** Index and publish [next]. The audio callback picks up the new list. */
+    void commit(std::unique_ptr<SlotList> next);
+
+    /** Compile [list]'s interval index and bus schedule. */
+    void compile(SlotList& list) const;
 
-    /** Swap the active list pointer. The audio callback picks up the new list. */
-    void commitToActive();
+    /** Slot of [trackId] in the current list, or nullptr. editMutex_ held. */
+    TrackSlot* findSlot(int trackId) const;
+
+    /** Bus [busId] (the master included), or nullptr. editMutex_ held. */
+    MixBus* findBus(int32_t busId) const;
 
     /**
-     * Two slot lists — the audio callback reads from activeList_,
-     * the UI thread edits pendingList_ then swaps.
+     * Rebuild [cursor] for a block starting at [positionFrames].
+     * Returns false if more slots overlap the position than the cursor
+     * can hold; the caller then falls back to a full scan.
      */
-    SlotList listA_;
-    SlotList listB_;
-    std::atomic<SlotList*> activeList_{&listA_};
-    std::mutex editMutex_;  // protects UI-thread edits to the inactive list
+    static bool relocate(const SlotList& list, RenderCursor& cursor, int64_t positionFrames);
+
+    /** Per-block state of the schedule's buses for one render. */
+    struct BusBlock {
+        float* output = nullptr;      // the master bus sums here
+        float* scratch = nullptr;     // group bus sums, one block each
+        int32_t frames = 0;
+        bool used[kMaxGroupBuses + 1] = {};
+        bool silent[kMaxGroupBuses + 1] = {};
+
+        /** Buffer of schedule entry [bus], zeroed on first use in the block. */
+        float* buffer(const SlotList& list, int32_t bus);
+    };
+
+    /** Retarget the schedule's bus ramps and start [block]. */
+    static void beginBuses(const SlotList& list, BusBlock& block, int reader);
+
+    /**
+     * Mix the part of [entry]'s slot that overlaps the block into the
+     * buffer of the bus it feeds.
+     */
+    static void mixSlot(const SlotList& list, const TrackEntry& entry, BusBlock& buses,
+                        float* sourceBuf, int64_t positionFrames, int reader);
+
+    /** Run the schedule's buses once every track has been mixed. */
+    static void mixBuses(const SlotList& list, BusBlock& buses, int reader);
+
+    /** Apply a global cue position to [slot]'s source. */
+    static void cueSlot(const TrackSlot& slot, TrackCue cue, int64_t positionFrames);
+
+    /** Write [command]'s value to the slot or bus it names in [list]. */
+    void applyCommand(const SlotList& list, const MixerCommand& command);
+
+    const AtomicTransport& transport_;
+
+    // Declared before lists_ so it outlives every source it prefetches for.
+    TrackPrefetcher prefetcher_;
+
+    MixBus master_;
+
+    // Group bus sums, kMaxGroupBuses stereo blocks per rendering thread.
+    std::unique_ptr<float[]> busScratch_;
+
+    SnapshotPublisher<SlotList> lists_;
+    mutable std::mutex editMutex_;  // serializes UI-thread edits and reads
+    uint64_t generation_ = 0;  // guarded by editMutex_
+    int64_t cuePositions_[kCueCount] = {-1, -1, -1};  // guarded by editMutex_
+
+    RenderCursor liveCursor_;  // audio callback only
+
+    CommandRing<MixerCommand, kMixerCommandCapacity> commands_;  // UI -> callback
 };
 
 }  // namespace nightjar
@@ -0,0 +1,72 @@
+#include "track_prefetcher.h"
+#include "common.h"
+#include <algorithm>
+#include <chrono>
+
+namespace nightjar {
+
+// Blocks one source may decode per pass before the others get a turn;
+// a seek on one track can't starve the rest.
+static constexpr int32_t kServiceBudget = 4;
+// Idle re-check interval. While playing, the sources' read heads wake
+// the thread long before this; while paused it mostly sleeps.
+static constexpr auto kPrefetchIdleWait = std::chrono::milliseconds(500);
+
+void TrackSource::requestPrefetch() {
+    if (prefetcher_) prefetcher_->notify();
+}
+
+TrackPrefetcher::~TrackPrefetcher() {
+    running_.store(false, std::memory_order_release);
+    wake_.notify();
+    if (thread_.joinable()) thread_.join();
+}
+
+void TrackPrefetcher::add(const std::shared_ptr<TrackSource>& source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    source->prefetcher_ = this;
+    sources_.push_back(source);
+    if (!running_.load(std::memory_order_relaxed)) {
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread(&TrackPrefetcher::run, this);
+    }
+    wake_.notify();
+}
+
+void TrackPrefetcher::run() {
+    std::vector<std::shared_ptr<TrackSource>> pass;
+
+    while (running_.load(std::memory_order_acquire)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sources_.erase(
+                std::remove_if(sources_.begin(), sources_.end(),
+                    [](const std::weak_ptr<TrackSource>& s) { return s.expired(); }),
+                sources_.end());
+            for (const auto& weak : sources_) {
+                if (auto source = weak.lock()) pass.push_back(std::move(source));
+            }
+        }
+
+        // Taken before the pass, so a read that moves a head while we
+        // work still gets its own pass.
+        uint32_t token = wake_.prepareWait();
+        bool more = false;
+        for (const auto& source : pass) {
+            more = source->service(kServiceBudget) || more;
+            if (int64_t misses = source->takeMissCount()) {
+                LOGW("TrackPrefetcher: %lld read(s) found their data not ready",
+                     (long long)misses);
+            }
+        }
+        // The last reference to a removed track may be this one; it is
+        // freed here, off the audio thread.
+        pass.clear();
+
+        if (!more && running_.load(std::memory_order_acquire)) {
+            wake_.waitFor(token, kPrefetchIdleWait);
+        }
+    }
+}
+
+}  // namespace nightjar
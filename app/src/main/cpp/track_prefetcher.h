@@ -0,0 +1,47 @@
+#pragma once
+
+#include "event_signal.h"
+#include "track_source.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nightjar {
+
+/**
+ * Background thread that keeps every mixer source ready ahead of the
+ * playhead, so the audio callback never waits on storage: it decodes
+ * compressed takes and faults WAV pages in (see TrackSource::service()).
+ *
+ * Sources call requestPrefetch() from readFrames() when their read head
+ * moves on, and from cue() when a jump target changes. Started on the
+ * first registered source. Sources are held weakly: once the mixer's
+ * retired track lists drop a source, it falls out of the next pass.
+ */
+class TrackPrefetcher {
+public:
+    TrackPrefetcher() = default;
+    ~TrackPrefetcher();
+
+    TrackPrefetcher(const TrackPrefetcher&) = delete;
+    TrackPrefetcher& operator=(const TrackPrefetcher&) = delete;
+
+    /** Start servicing [source]. UI thread, before the source is published. */
+    void add(const std::shared_ptr<TrackSource>& source);
+
+    /** Ask for another pass. Real-time safe. */
+    void notify() { wake_.notify(); }
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::vector<std::weak_ptr<TrackSource>> sources_;   // guarded by mutex_
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    EventSignal wake_;
+};
+
+}  // namespace nightjar
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+
+namespace nightjar {
+
+class TrackPrefetcher;
+
+/**
+ * Jump targets a source can keep decoded ahead of time, so playback that
+ * lands there (a track starting, a loop wrapping, a seek) never waits for
+ * data. Only streaming sources act on them.
+ */
+enum TrackCue : int32_t {
+    kCueTrackStart = 0,   // first frame the slot plays (its trim start)
+    kCueLoopStart,        // where the loop region enters this track
+    kCueSeek,             // the last seek / play position
+    kCueCount
+};
+
+/**
+ * Audio backing one mixer slot.
+ *
+ * readFrames() is called from the audio callback and must do no I/O,
+ * locking or allocation. Everything that can block -- decoding a
+ * compressed take, faulting in pages of a mapped WAV -- happens in
+ * service() on the mixer's TrackPrefetcher thread, driven by where the
+ * callback last read and by the cued jump targets.
+ */
+class TrackSource {
+public:
+    virtual ~TrackSource() = default;
+
+    virtual bool isOpen() const = 0;
+
+    /** Total number of sample frames. */
+    virtual int64_t totalFrames() const = 0;
+
+    /**
+     * Interleaved channels per frame: 1 for recorded takes, 2 for the
+     * stereo renders of frozen MIDI and drum tracks.
+     */
+    virtual int32_t channelCount() const { return 1; }
+
+    /**
+     * Read [numFrames] frames of channelCount() interleaved channels from
+     * [frameOffset] as float32 into [output]. Returns the number of
+     * frames produced (less at EOF).
+     * Real-time safe. Frames a streaming source has not decoded yet
+     * read as silence.
+     */
+    virtual int64_t readFrames(float* output, int64_t frameOffset, int64_t numFrames) = 0;
+
+    /**
+     * As readFrames(), for the offline renderer: may block to produce
+     * every frame and does not disturb the live playback position.
+     */
+    virtual int64_t readFramesOffline(float* output, int64_t frameOffset, int64_t numFrames) {
+        return readFrames(output, frameOffset, numFrames);
+    }
+
+    /**
+     * Mix [numFrames] mono frames from [frameOffset] straight into the
+     * interleaved stereo [stereo] at [gainL] / [gainR], converting as it
+     * goes, for sources whose samples can be read in place. Returns the
+     * frames mixed (less at EOF), or -1 if this source can't; the mixer
+     * then reads a copy with readFrames() and mixes that. [offline] gives
+     * readFramesOffline()'s semantics.
+     */
+    virtual int64_t mixFrames(float* /* stereo */, int64_t /* frameOffset */,
+                              int64_t /* numFrames */, float /* gainL */, float /* gainR */,
+                              bool /* offline */) {
+        return -1;
+    }
+
+    /** Keep the frames from [frame] on ready for [cue]. UI thread. */
+    virtual void cue(TrackCue /* cue */, int64_t /* frame */) {}
+
+    /**
+     * Make the frames cued for [cue] readable right away, blocking the
+     * calling thread if needed. Used before playback resumes. UI thread.
+     */
+    virtual void prepare(TrackCue /* cue */) {}
+
+    /**
+     * Prefetch work for the upcoming reads, at most [budget] units of
+     * expensive work. TrackPrefetcher thread only. Returns true if work
+     * remains.
+     */
+    virtual bool service(int32_t /* budget */) { return false; }
+
+    /** Reads that found their data not ready since the last call. */
+    virtual int64_t takeMissCount() { return 0; }
+
+protected:
+    /** Wake the prefetcher, if attached. Real-time safe. */
+    void requestPrefetch();
+
+private:
+    friend class TrackPrefetcher;
+    TrackPrefetcher* prefetcher_ = nullptr;   // set before the source is published
+};
+
+}  // namespace nightjar
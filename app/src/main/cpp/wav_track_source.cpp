@@ -1,50 +1,24 @@
 #include "wav_track_source.h"
 #include "common.h"
+#include "mix_kernels.h"
 
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cstring>
 
 namespace nightjar {
 
-WavTrackSource::WavTrackSource() = default;
+WavTrackSource::WavTrackSource() {
+    for (auto& at : cueAt_) at.store(-1, std::memory_order_relaxed);
+}
 
 WavTrackSource::~WavTrackSource() {
     close();
 }
 
-WavTrackSource::WavTrackSource(WavTrackSource&& other) noexcept
-    : mappedData_(other.mappedData_),
-      mappedSize_(other.mappedSize_),
-      pcmData_(other.pcmData_),
-      totalFrames_(other.totalFrames_),
-      dataOffset_(other.dataOffset_) {
-    other.mappedData_ = nullptr;
-    other.mappedSize_ = 0;
-    other.pcmData_ = nullptr;
-    other.totalFrames_ = 0;
-    other.dataOffset_ = 0;
-}
-
-WavTrackSource& WavTrackSource::operator=(WavTrackSource&& other) noexcept {
-    if (this != &other) {
-        close();
-        mappedData_ = other.mappedData_;
-        mappedSize_ = other.mappedSize_;
-        pcmData_ = other.pcmData_;
-        totalFrames_ = other.totalFrames_;
-        dataOffset_ = other.dataOffset_;
-        other.mappedData_ = nullptr;
-        other.mappedSize_ = 0;
-        other.pcmData_ = nullptr;
-        other.totalFrames_ = 0;
-        other.dataOffset_ = 0;
-    }
-    return *this;
-}
-
 bool WavTrackSource::open(const std::string& filePath) {
     close();
 
@@ -72,8 +46,11 @@ bool WavTrackSource::open(const std::string& filePath) {
         return false;
     }
 
-    // Hint the kernel for sequential read access
-    madvise(mappedData_, mappedSize_, MADV_SEQUENTIAL);
+    // No MADV_SEQUENTIAL: it drops pages right behind the reader, and a
+    // looped region is read again every pass. The prefetcher asks for
+    // the pages playback will need instead (see service()).
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize > 0) pageSize_ = static_cast<size_t>(pageSize);
 
     // Parse WAV header — find the 'data' chunk
     auto* header = static_cast<const uint8_t*>(mappedData_);
@@ -96,6 +73,16 @@ bool WavTrackSource::open(const std::string& filePath) {
                             (static_cast<int32_t>(header[offset + 6]) << 16) |
                             (static_cast<int32_t>(header[offset + 7]) << 24);
 
+        if (std::memcmp(header + offset, "fmt ", 4) == 0 && chunkSize >= 16 &&
+            offset + 16 <= static_cast<int32_t>(mappedSize_)) {
+            channels_ = static_cast<int32_t>(header[offset + 10]) |
+                        (static_cast<int32_t>(header[offset + 11]) << 8);
+            sampleRate_ = static_cast<int32_t>(header[offset + 12]) |
+                          (static_cast<int32_t>(header[offset + 13]) << 8) |
+                          (static_cast<int32_t>(header[offset + 14]) << 16) |
+                          (static_cast<int32_t>(header[offset + 15]) << 24);
+        }
+
         if (std::memcmp(header + offset, "data", 4) == 0) {
             dataOffset_ = offset + 8;
             dataSize = chunkSize;
@@ -114,44 +101,168 @@ bool WavTrackSource::open(const std::string& filePath) {
         return false;
     }
 
+    if (channels_ != 1 && channels_ != kOutputChannelCount) {
+        LOGE("WavTrackSource: unsupported channel count %d in %s", channels_, filePath.c_str());
+        close();
+        return false;
+    }
+
     // Clamp dataSize to actual file bounds
     if (dataOffset_ + dataSize > static_cast<int32_t>(mappedSize_)) {
         dataSize = static_cast<int32_t>(mappedSize_) - dataOffset_;
     }
 
     pcmData_ = reinterpret_cast<const int16_t*>(header + dataOffset_);
-    totalFrames_ = dataSize / (kChannelCount * kBytesPerSample);
+    totalFrames_ = dataSize / (channels_ * kBytesPerSample);
 
-    LOGD("WavTrackSource: opened %s (dataOffset=%d, dataSize=%d, frames=%lld)",
-         filePath.c_str(), dataOffset_, dataSize, (long long)totalFrames_);
+    LOGD("WavTrackSource: opened %s (dataOffset=%d, dataSize=%d, frames=%lld, rate=%d, "
+         "channels=%d)", filePath.c_str(), dataOffset_, dataSize, (long long)totalFrames_,
+         sampleRate_, channels_);
     return true;
 }
 
 void WavTrackSource::close() {
     if (mappedData_ && mappedData_ != MAP_FAILED) {
-        munmap(mappedData_, mappedSize_);
+        munmap(mappedData_, mappedSize_);  // also drops any mlock()
     }
     mappedData_ = nullptr;
     mappedSize_ = 0;
     pcmData_ = nullptr;
     totalFrames_ = 0;
     dataOffset_ = 0;
+    sampleRate_ = kDefaultSampleRate;
+    channels_ = kChannelCount;
+    lockedFrame_ = -1;
 }
 
-int64_t WavTrackSource::readFrames(float* output, int64_t frameOffset, int64_t numFrames) const {
-    if (!pcmData_ || frameOffset >= totalFrames_) return 0;
+int64_t WavTrackSource::readFrames(float* output, int64_t frameOffset, int64_t numFrames) {
+    advanceHead(frameOffset);
+    return copyFrames(output, frameOffset, numFrames);
+}
 
-    int64_t available = totalFrames_ - frameOffset;
-    int64_t toRead = (numFrames < available) ? numFrames : available;
+int64_t WavTrackSource::readFramesOffline(float* output, int64_t frameOffset, int64_t numFrames) {
+    return copyFrames(output, frameOffset, numFrames);
+}
 
-    const int16_t* src = pcmData_ + (frameOffset * kChannelCount);
-    constexpr float kScale = 1.0f / 32768.0f;
+int64_t WavTrackSource::mixFrames(float* stereo, int64_t frameOffset, int64_t numFrames,
+                                  float gainL, float gainR, bool offline) {
+    if (channels_ != 1) return -1;
+    if (!offline) advanceHead(frameOffset);
+    int64_t toRead = readable(frameOffset, numFrames);
+    if (toRead > 0) {
+        mixInt16MonoToStereo(pcmData_ + frameOffset, stereo, static_cast<int32_t>(toRead),
+                             gainL, gainR);
+    }
+    return toRead;
+}
 
-    for (int64_t i = 0; i < toRead; ++i) {
-        output[i] = static_cast<float>(src[i]) * kScale;
+void WavTrackSource::advanceHead(int64_t frameOffset) {
+    if (frameOffset < 0) return;
+    int64_t chunk = frameOffset / kPrefetchChunkFrames;
+    if (head_.load(std::memory_order_relaxed) != chunk) {
+        head_.store(chunk, std::memory_order_release);
+        requestPrefetch();
     }
+}
+
+int64_t WavTrackSource::readable(int64_t frameOffset, int64_t numFrames) const {
+    if (!pcmData_ || frameOffset < 0 || frameOffset >= totalFrames_) return 0;
+    int64_t available = totalFrames_ - frameOffset;
+    return (numFrames < available) ? numFrames : available;
+}
+
+int64_t WavTrackSource::copyFrames(float* output, int64_t frameOffset, int64_t numFrames) const {
+    int64_t toRead = readable(frameOffset, numFrames);
+    if (toRead <= 0) return 0;
+
+    const int16_t* src = pcmData_ + (frameOffset * channels_);
+    convertInt16ToFloat(src, output, static_cast<int32_t>(toRead * channels_));
 
     return toRead;
 }
 
+// ── Prefetch ───────────────────────────────────────────────────────────
+
+void WavTrackSource::cue(TrackCue cue, int64_t frame) {
+    if (cue < 0 || cue >= kCueCount) return;
+    if (frame >= totalFrames_) frame = -1;
+    if (cueAt_[cue].exchange(frame, std::memory_order_acq_rel) != frame && frame >= 0) {
+        requestPrefetch();
+    }
+}
+
+void WavTrackSource::prepare(TrackCue cue) {
+    if (cue < 0 || cue >= kCueCount) return;
+    int64_t frame = cueAt_[cue].load(std::memory_order_acquire);
+    if (frame >= 0) touch(frame, kCueFrames);
+}
+
+bool WavTrackSource::service(int32_t /* budget */) {
+    if (!pcmData_) return false;
+
+    for (int32_t c = 0; c < kCueCount; ++c) {
+        int64_t frame = cueAt_[c].load(std::memory_order_acquire);
+        if (frame >= 0) touch(frame, kCueFrames);
+    }
+    lockWindow(cueAt_[kCueLoopStart].load(std::memory_order_acquire));
+
+    int64_t head = head_.load(std::memory_order_acquire);
+    touch(head * kPrefetchChunkFrames, kLookaheadChunks * kPrefetchChunkFrames);
+    return false;
+}
+
+/**
+ * Page-aligned byte range of [numFrames] frames from [frameOffset] in
+ * [pcm], which has [channels] interleaved channels.
+ */
+static void pageRange(const int16_t* pcm, int32_t channels, int64_t frameOffset,
+                      int64_t numFrames, size_t pageSize, uintptr_t& begin, size_t& length) {
+    auto first = reinterpret_cast<uintptr_t>(pcm + frameOffset * channels);
+    auto last = reinterpret_cast<uintptr_t>(pcm + (frameOffset + numFrames) * channels);
+    begin = first & ~(static_cast<uintptr_t>(pageSize) - 1);
+    length = static_cast<size_t>(last - begin);
+}
+
+void WavTrackSource::touch(int64_t frameOffset, int64_t numFrames) const {
+    if (!pcmData_ || frameOffset < 0 || frameOffset >= totalFrames_) return;
+    numFrames = std::min(numFrames, totalFrames_ - frameOffset);
+
+    uintptr_t begin;
+    size_t length;
+    pageRange(pcmData_, channels_, frameOffset, numFrames, pageSize_, begin, length);
+    // Start readahead for the whole window at once, then read one byte
+    // per page so every page is actually resident when we return.
+    madvise(reinterpret_cast<void*>(begin), length, MADV_WILLNEED);
+    auto* base = reinterpret_cast<const volatile uint8_t*>(mappedData_);
+    auto* end = base + mappedSize_;
+    for (auto* page = reinterpret_cast<const volatile uint8_t*>(begin);
+         page < reinterpret_cast<const volatile uint8_t*>(begin + length); page += pageSize_) {
+        if (page >= base && page < end) (void)*page;
+    }
+}
+
+void WavTrackSource::lockWindow(int64_t frame) {
+    if (frame == lockedFrame_ || lockFailed_) return;
+    uintptr_t begin;
+    size_t length;
+    if (lockedFrame_ >= 0) {
+        pageRange(pcmData_, channels_, lockedFrame_,
+                  std::min(kCueFrames, totalFrames_ - lockedFrame_), pageSize_, begin, length);
+        munlock(reinterpret_cast<void*>(begin), length);
+        lockedFrame_ = -1;
+    }
+    if (frame < 0 || frame >= totalFrames_) return;
+
+    pageRange(pcmData_, channels_, frame, std::min(kCueFrames, totalFrames_ - frame),
+              pageSize_, begin, length);
+    if (mlock(reinterpret_cast<void*>(begin), length) != 0) {
+        // Apps usually get a small RLIMIT_MEMLOCK; the window is still
+        // re-touched on every pass, which keeps it warm in practice.
+        LOGW("WavTrackSource: mlock of the loop window failed, relying on touches");
+        lockFailed_ = true;
+        return;
+    }
+    lockedFrame_ = frame;
+}
+
 }  // namespace nightjar
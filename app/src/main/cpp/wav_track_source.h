@@ -1,6 +1,9 @@
 #pragma once
 
-#include "audio_engine.h"
+#include "common.h"
+#include "track_source.h"
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <string>
 
@@ -13,22 +16,35 @@ namespace nightjar {
  * The audio callback reads PCM samples directly from the mapped region —
  * NO disk I/O, NO syscalls, NO allocations at read time.
  *
- * The OS pages data in and out as needed. madvise(SEQUENTIAL) hints
- * the kernel to prefetch ahead for smooth sequential playback.
+ * The OS pages data in and out as needed, so a read of a page that is
+ * not resident would stall the callback on storage. Readahead only
+ * covers straight playback; seeks, loop wraps and a track entering
+ * the timeline land cold. The mixer's TrackPrefetcher therefore
+ * faults pages in ahead of time: the chunks after the callback's
+ * read head, plus a window after each TrackCue. The loop-start window
+ * is also mlock()ed where the limit allows, so a long pass can't have
+ * the wrap target reclaimed under memory pressure.
  *
- * Supports 16-bit PCM mono WAV files at any sample rate (though we
- * only generate 44.1kHz in Nightjar).
+ * Supports 16-bit PCM WAV files at any sample rate, mono (recorded
+ * takes) or stereo (frozen tracks). The mixer only plays files at the
+ * engine rate; mono takes at another rate are converted once when the
+ * track is added (see resampler.h).
  */
-class WavTrackSource {
+class WavTrackSource : public TrackSource {
 public:
     WavTrackSource();
-    ~WavTrackSource();
+    ~WavTrackSource() override;
 
-    // Non-copyable, movable
+    /** Read head granularity: 16384 frames, ~370ms at 44.1kHz. */
+    static constexpr int64_t kPrefetchChunkFrames = 16384;
+    /** Chunks kept resident after the read head, ~2.2s. */
+    static constexpr int64_t kLookaheadChunks = 6;
+    /** Frames kept resident after each cue, ~1s. */
+    static constexpr int64_t kCueFrames = 44100;
+
+    // Non-copyable, non-movable (the prefetcher points at it)
     WavTrackSource(const WavTrackSource&) = delete;
     WavTrackSource& operator=(const WavTrackSource&) = delete;
-    WavTrackSource(WavTrackSource&& other) noexcept;
-    WavTrackSource& operator=(WavTrackSource&& other) noexcept;
 
     /**
      * Open and mmap a WAV file. Parses the 44-byte header to locate
@@ -41,10 +57,22 @@ public:
     void close();
 
     /** Returns true if a file is currently mapped. */
-    bool isOpen() const { return pcmData_ != nullptr; }
+    bool isOpen() const override { return pcmData_ != nullptr; }
 
     /** Total number of sample frames in the file. */
-    int64_t totalFrames() const { return totalFrames_; }
+    int64_t totalFrames() const override { return totalFrames_; }
+
+    /** Channel count from the 'fmt ' chunk (1 or 2). */
+    int32_t channelCount() const override { return channels_; }
+
+    /** Sample rate from the 'fmt ' chunk. */
+    int32_t sampleRate() const { return sampleRate_; }
+
+    /**
+     * The mapped 16-bit PCM samples (totalFrames() * channelCount() of
+     * them, interleaved), or null.
+     */
+    const int16_t* pcmData() const { return pcmData_; }
 
     /**
      * Read frames from the mapped file, converting int16 → float32.
@@ -55,15 +83,60 @@ public:
      * @return Number of frames actually read (may be less at EOF).
      *
      * This method does NO syscalls — it's safe for the audio callback.
+     * Moving into a new chunk wakes the prefetcher.
+     */
+    int64_t readFrames(float* output, int64_t frameOffset, int64_t numFrames) override;
+
+    /** As readFrames(), without moving the read head. */
+    int64_t readFramesOffline(float* output, int64_t frameOffset, int64_t numFrames) override;
+
+    /** Mixes mono files from the mapping in one pass; -1 for stereo. */
+    int64_t mixFrames(float* stereo, int64_t frameOffset, int64_t numFrames,
+                      float gainL, float gainR, bool offline) override;
+
+    void cue(TrackCue cue, int64_t frame) override;
+
+    /** Fault in the cue's window on the calling thread. */
+    void prepare(TrackCue cue) override;
+
+    /**
+     * Fault in the lookahead after the read head and every cue window.
+     * One pass covers everything, so [budget] is not used: touching
+     * pages that are already resident costs next to nothing.
      */
-    int64_t readFrames(float* output, int64_t frameOffset, int64_t numFrames) const;
+    bool service(int32_t budget) override;
 
 private:
+    /** Move the read head to [frameOffset]'s chunk, waking the prefetcher if it moved. */
+    void advanceHead(int64_t frameOffset);
+
+    /** Frames readable from [frameOffset], at most [numFrames]; 0 past the end. */
+    int64_t readable(int64_t frameOffset, int64_t numFrames) const;
+
+    /** The int16 → float32 copy shared by both read paths. */
+    int64_t copyFrames(float* output, int64_t frameOffset, int64_t numFrames) const;
+
+    /** Fault in [numFrames] frames from [frameOffset]. Blocks on I/O. */
+    void touch(int64_t frameOffset, int64_t numFrames) const;
+
+    /** Move the mlock()ed range to the window at [frame] (-1 = none). */
+    void lockWindow(int64_t frame);
+
     void* mappedData_ = nullptr;       // mmap'd file region
     size_t mappedSize_ = 0;            // total mmap size
     const int16_t* pcmData_ = nullptr; // pointer to first PCM sample (past header)
     int64_t totalFrames_ = 0;          // total sample frames
     int32_t dataOffset_ = 0;           // byte offset of 'data' chunk payload
+    int32_t sampleRate_ = kDefaultSampleRate;
+    int32_t channels_ = kChannelCount;
+    size_t pageSize_ = 4096;
+
+    std::atomic<int64_t> head_{0};     // chunk the callback last read
+    std::array<std::atomic<int64_t>, kCueCount> cueAt_;  // frame per cue, -1 = unset
+
+    // Prefetch thread only.
+    int64_t lockedFrame_ = -1;         // window held by mlock(), -1 = none
+    bool lockFailed_ = false;          // RLIMIT_MEMLOCK refused; don't retry
 };
 
 }  // namespace nightjar
@@ -1,37 +1,114 @@
 #include "wav_writer.h"
 #include "audio_engine.h"
+#include "mix_kernels.h"
+#include "thread_policy.h"
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/falloc.h>
+#endif
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <cstring>
 
 namespace nightjar {
 
-// Stack-allocated buffers used in the writer loop — no heap allocation.
-static constexpr size_t kWriteChunkSamples = 4096;
+// Samples converted per pass of the drain loop, straight from ring memory
+// into the write block.
+static constexpr size_t kConvertChunkSamples = 4096;
 
-WavWriter::WavWriter() = default;
+WavWriter::WavWriter(EngineTelemetry& telemetry) : telemetry_(telemetry) {}
 
 WavWriter::~WavWriter() {
     stopConsuming();
 }
 
-bool WavWriter::open(const std::string& filePath) {
-    filePath_ = filePath;
+bool WavWriter::open(const std::string& filePath, int32_t sampleRate) {
+    basePath_ = filePath;
+    sampleRate_ = sampleRate;
     totalBytesWritten_.store(0, std::memory_order_relaxed);
+    takeBoundaryCount_.store(0, std::memory_order_relaxed);
+    nextTakeBoundary_ = 0;
+    samplesConsumed_ = 0;
+    takePaths_.clear();
 
-    file_ = fopen(filePath.c_str(), "wb");
-    if (!file_) {
-        LOGE("WavWriter: failed to open %s", filePath.c_str());
-        return false;
+    int fd = openTakeFile(filePath);
+    if (fd < 0) return false;
+
+    if (!block_) block_ = std::make_unique<WriteBlock>();
+    beginTake(fd, filePath);
+    LOGD("WavWriter: opened %s (%d Hz)", filePath.c_str(), sampleRate);
+    return true;
+}
+
+int WavWriter::openTakeFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("WavWriter: failed to open %s: %s", path.c_str(), strerror(errno));
+    }
+    return fd;
+}
+
+void WavWriter::beginTake(int fd, const std::string& path) {
+    fd_ = fd;
+    filePath_ = path;
+    takePaths_.push_back(path);
+    peaks_.reset();
+
+    fileOffset_ = 0;
+    blockFill_ = kWavHeaderBytes;   // the header leads the first block
+    preallocatedTo_ = 0;
+    preallocateFailed_ = false;
+    preallocate(kWriteBlockBytes);
+
+    // Put a valid (empty) WAV on disk right away.
+    checkpoint();
+}
+
+void WavWriter::endTake() {
+    int64_t fileBytes = fileOffset_ + static_cast<int64_t>(blockFill_);
+    finish();
+
+    // A missing sidecar is rebuilt from the WAV on first read, so a
+    // failure here only costs one extra scan later.
+    peaks_.write(PeakCacheReader::sidecarPath(filePath_), fileBytes, sampleRate_);
+}
+
+void WavWriter::startNextTake() {
+    std::string stem = basePath_;
+    if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".wav") == 0) {
+        stem.resize(stem.size() - 4);
     }
+    std::string path = stem + "_take" + std::to_string(takePaths_.size() + 1) + ".wav";
 
-    writeWavHeader();
-    LOGD("WavWriter: opened %s", filePath.c_str());
+    // Open the next file before closing this one: if it fails, the rest
+    // of the session simply stays in the current take.
+    int fd = openTakeFile(path);
+    if (fd < 0) {
+        nextTakeBoundary_ = kMaxTakeBoundaries;
+        return;
+    }
+    endTake();
+    beginTake(fd, path);
+    LOGD("WavWriter: take %zu -> %s", takePaths_.size(), path.c_str());
+}
+
+bool WavWriter::markTakeBoundary(int64_t sampleIndex) {
+    int32_t n = takeBoundaryCount_.load(std::memory_order_relaxed);
+    if (n >= kMaxTakeBoundaries) return false;
+    takeBoundaries_[static_cast<size_t>(n)] = sampleIndex;
+    takeBoundaryCount_.store(n + 1, std::memory_order_release);
     return true;
 }
 
+int64_t WavWriter::pendingTakeBoundary() const {
+    if (nextTakeBoundary_ >= takeBoundaryCount_.load(std::memory_order_acquire)) return -1;
+    return takeBoundaries_[static_cast<size_t>(nextTakeBoundary_)];
+}
+
 void WavWriter::startConsuming(SpscRingBuffer<kRingBufferCapacity>& ringBuffer) {
-    if (!file_) {
+    if (fd_ < 0) {
         LOGE("WavWriter: startConsuming called but no file is open");
         return;
     }
@@ -41,37 +118,42 @@ void WavWriter::startConsuming(SpscRingBuffer<kRingBufferCapacity>& ringBuffer)
 
 void WavWriter::stopConsuming() {
     running_.store(false, std::memory_order_release);
+    dataReady_.notify();
     if (writerThread_.joinable()) {
         writerThread_.join();
     }
-    if (file_) {
-        patchWavHeader();
-        fclose(file_);
-        file_ = nullptr;
-        LOGD("WavWriter: closed, wrote %lld bytes (%lld ms)",
-             (long long)getTotalBytesWritten(), (long long)getDurationMs());
+    if (fd_ >= 0) {
+        endTake();
+        LOGD("WavWriter: closed, wrote %lld bytes (%lld ms) in %zu take(s)",
+             (long long)getTotalBytesWritten(), (long long)getDurationMs(),
+             takePaths_.size());
     }
 }
 
 void WavWriter::writerLoop(SpscRingBuffer<kRingBufferCapacity>& ringBuffer) {
-    float readBuf[kWriteChunkSamples];
-    int16_t writeBuf[kWriteChunkSamples];
-
-    while (running_.load(std::memory_order_relaxed)) {
-        size_t read = ringBuffer.read(readBuf, kWriteChunkSamples);
-        if (read > 0) {
-            // Convert float32 [-1.0, 1.0] → int16 [-32767, 32767]
-            for (size_t i = 0; i < read; ++i) {
-                float clamped = std::max(-1.0f, std::min(1.0f, readBuf[i]));
-                writeBuf[i] = static_cast<int16_t>(clamped * 32767.0f);
-            }
-            fwrite(writeBuf, sizeof(int16_t), read, file_);
-            totalBytesWritten_.fetch_add(
-                static_cast<int64_t>(read * sizeof(int16_t)),
-                std::memory_order_relaxed);
-        } else {
-            // No data available — sleep briefly to avoid spinning.
-            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ThreadPolicy::applyToCurrentThread(ThreadRole::RecordWriter);
+    lastCheckpoint_ = std::chrono::steady_clock::now();
+
+    while (running_.load(std::memory_order_acquire)) {
+        EngineTelemetry::raiseMax(telemetry_.recordRingHighWaterSamples,
+                                  ringBuffer.availableToRead());
+        drainRingBuffer(ringBuffer);
+
+        auto sinceCheckpoint = std::chrono::steady_clock::now() - lastCheckpoint_;
+        if (sinceCheckpoint >= kCheckpointInterval) {
+            checkpoint();
+            sinceCheckpoint = std::chrono::steady_clock::duration::zero();
+        }
+
+        // Park until the capture callback has queued a worthwhile amount
+        // or the next checkpoint is due. The token closes the window
+        // between the check and the wait.
+        uint32_t token = dataReady_.prepareWait();
+        if (ringBuffer.availableToRead() < kWriterWakeSamples &&
+            running_.load(std::memory_order_acquire)) {
+            auto timeout = std::chrono::duration_cast<std::chrono::microseconds>(
+                kCheckpointInterval - sinceCheckpoint);
+            dataReady_.waitFor(token, std::max(timeout, std::chrono::microseconds(1000)));
         }
     }
 
@@ -80,92 +162,195 @@ void WavWriter::writerLoop(SpscRingBuffer<kRingBufferCapacity>& ringBuffer) {
 }
 
 void WavWriter::drainRingBuffer(SpscRingBuffer<kRingBufferCapacity>& ringBuffer) {
-    float readBuf[kWriteChunkSamples];
-    int16_t writeBuf[kWriteChunkSamples];
-
-    while (ringBuffer.availableToRead() > 0) {
-        size_t read = ringBuffer.read(readBuf, kWriteChunkSamples);
-        if (read == 0) break;
-        for (size_t i = 0; i < read; ++i) {
-            float clamped = std::max(-1.0f, std::min(1.0f, readBuf[i]));
-            writeBuf[i] = static_cast<int16_t>(clamped * 32767.0f);
+    while (true) {
+        size_t room = (kWriteBlockBytes - blockFill_) / sizeof(int16_t);
+        size_t wanted = std::min({room, kConvertChunkSamples, ringBuffer.availableToRead()});
+        if (wanted == 0) break;
+
+        // Checked after sizing the read: the callback marks a boundary
+        // before queuing the samples behind it, so every sample counted
+        // above is ordered after any boundary it crosses.
+        int64_t boundary = pendingTakeBoundary();
+        if (boundary >= 0) {
+            if (boundary <= samplesConsumed_) {
+                // Don't leave an empty file behind for a boundary at the
+                // very start of a take.
+                if (fileOffset_ + static_cast<int64_t>(blockFill_) > kWavHeaderBytes) {
+                    startNextTake();
+                }
+                ++nextTakeBoundary_;
+                continue;
+            }
+            wanted = std::min(wanted, static_cast<size_t>(boundary - samplesConsumed_));
         }
-        fwrite(writeBuf, sizeof(int16_t), read, file_);
+
+        // Converted straight out of ring memory into the write block
+        auto queued = ringBuffer.peekRead(wanted);
+        size_t read = queued.size();
+        auto* dst = reinterpret_cast<int16_t*>(block_->bytes + blockFill_);
+        convertFloatToInt16(queued.first.data, dst, static_cast<int32_t>(queued.first.size));
+        convertFloatToInt16(queued.second.data, dst + queued.first.size,
+                            static_cast<int32_t>(queued.second.size));
+        ringBuffer.consumeRead(read);
+        samplesConsumed_ += static_cast<int64_t>(read);
+        peaks_.append(dst, read);
+        blockFill_ += read * sizeof(int16_t);
         totalBytesWritten_.fetch_add(
             static_cast<int64_t>(read * sizeof(int16_t)),
             std::memory_order_relaxed);
+
+        if (blockFill_ == kWriteBlockBytes) flushBlock();
     }
 }
 
-void WavWriter::writeWavHeader() {
-    // Write a 44-byte placeholder header. Sizes will be patched on close.
-    uint8_t header[44];
+static bool pwriteFully(int fd, const uint8_t* data, size_t size, int64_t offset) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+bool WavWriter::flushBlock() {
+    preallocate(fileOffset_ + static_cast<int64_t>(kWriteBlockBytes));
+    if (fileOffset_ == 0) writeHeader();
+
+    bool ok = pwriteFully(fd_, block_->bytes, kWriteBlockBytes, fileOffset_);
+    if (!ok) LOGE("WavWriter: write failed at %lld: %s", (long long)fileOffset_, strerror(errno));
+
+    fileOffset_ += static_cast<int64_t>(kWriteBlockBytes);
+    blockFill_ = 0;
+    return ok;
+}
+
+void WavWriter::checkpoint() {
+    lastCheckpoint_ = std::chrono::steady_clock::now();
+    if (fileOffset_ == 0) writeHeader();
+
+    // The partial block is rewritten in full once it fills, so the
+    // aligned block writes are unaffected.
+    if (blockFill_ > 0 && !pwriteFully(fd_, block_->bytes, blockFill_, fileOffset_)) {
+        LOGE("WavWriter: checkpoint write failed: %s", strerror(errno));
+        return;
+    }
+    if (fileOffset_ > 0) writeHeader();
+}
+
+void WavWriter::writeHeader() {
+    uint8_t header[kWavHeaderBytes];
+    int64_t dataBytes = fileOffset_ + static_cast<int64_t>(blockFill_) - kWavHeaderBytes;
+    buildPcmWavHeader(header, sampleRate_, kChannelCount, dataBytes);
+    if (fileOffset_ == 0) {
+        std::memcpy(block_->bytes, header, sizeof(header));
+    } else if (!pwriteFully(fd_, header, sizeof(header), 0)) {
+        LOGE("WavWriter: header write failed: %s", strerror(errno));
+    }
+}
+
+void WavWriter::preallocate(int64_t end) {
+#if defined(__linux__)
+    if (preallocateFailed_ || end <= preallocatedTo_) return;
+    // KEEP_SIZE: reserve blocks without moving EOF, so the file on disk
+    // always ends at the last real sample.
+    int64_t target = end + kPreallocateBytes;
+    if (fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(preallocatedTo_),
+                  static_cast<off_t>(target - preallocatedTo_)) != 0) {
+        LOGW("WavWriter: fallocate unavailable (%s), writing without preallocation",
+             strerror(errno));
+        preallocateFailed_ = true;
+        return;
+    }
+    preallocatedTo_ = target;
+#else
+    (void)end;
+#endif
+}
+
+void WavWriter::finish() {
+    checkpoint();
+    // Release the unused reservation past EOF.
+    if (preallocatedTo_ > 0) {
+        ftruncate(fd_, static_cast<off_t>(fileOffset_ + static_cast<int64_t>(blockFill_)));
+    }
+    ::close(fd_);
+    fd_ = -1;
+}
+
+// ── WAV header helpers (shared with the offline renderer) ───────────────
+
+void buildPcmWavHeader(uint8_t (&header)[kWavHeaderBytes], int32_t sampleRate,
+                       int32_t channelCount, int64_t dataBytes) {
     std::memset(header, 0, sizeof(header));
 
+    auto putInt32LE = [&](int offset, int32_t value) {
+        header[offset]     = static_cast<uint8_t>(value & 0xFF);
+        header[offset + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+        header[offset + 2] = static_cast<uint8_t>((value >> 16) & 0xFF);
+        header[offset + 3] = static_cast<uint8_t>((value >> 24) & 0xFF);
+    };
+
     // RIFF chunk
     header[0] = 'R'; header[1] = 'I'; header[2] = 'F'; header[3] = 'F';
-    // Bytes 4-7: file size - 8 (patched later)
+    putInt32LE(4, static_cast<int32_t>(dataBytes + kWavHeaderBytes - 8));
     header[8] = 'W'; header[9] = 'A'; header[10] = 'V'; header[11] = 'E';
 
     // fmt sub-chunk
     header[12] = 'f'; header[13] = 'm'; header[14] = 't'; header[15] = ' ';
     header[16] = 16;  // sub-chunk size (16 for PCM)
     header[20] = 1;   // audio format (1 = PCM)
-    header[22] = static_cast<uint8_t>(kChannelCount);
-
-    // Sample rate (little-endian)
-    header[24] = static_cast<uint8_t>(kSampleRate & 0xFF);
-    header[25] = static_cast<uint8_t>((kSampleRate >> 8) & 0xFF);
-    header[26] = static_cast<uint8_t>((kSampleRate >> 16) & 0xFF);
-    header[27] = static_cast<uint8_t>((kSampleRate >> 24) & 0xFF);
-
+    header[22] = static_cast<uint8_t>(channelCount);
+    putInt32LE(24, sampleRate);
     // Byte rate = sampleRate * channels * bytesPerSample
-    int32_t byteRate = kSampleRate * kChannelCount * kBytesPerSample;
-    header[28] = static_cast<uint8_t>(byteRate & 0xFF);
-    header[29] = static_cast<uint8_t>((byteRate >> 8) & 0xFF);
-    header[30] = static_cast<uint8_t>((byteRate >> 16) & 0xFF);
-    header[31] = static_cast<uint8_t>((byteRate >> 24) & 0xFF);
-
+    putInt32LE(28, sampleRate * channelCount * kBytesPerSample);
     // Block align = channels * bytesPerSample
-    int16_t blockAlign = kChannelCount * kBytesPerSample;
+    int16_t blockAlign = static_cast<int16_t>(channelCount * kBytesPerSample);
     header[32] = static_cast<uint8_t>(blockAlign & 0xFF);
     header[33] = static_cast<uint8_t>((blockAlign >> 8) & 0xFF);
-
     // Bits per sample
     header[34] = static_cast<uint8_t>(kBitsPerSample);
 
     // data sub-chunk
     header[36] = 'd'; header[37] = 'a'; header[38] = 't'; header[39] = 'a';
-    // Bytes 40-43: data size (patched later)
+    putInt32LE(40, static_cast<int32_t>(dataBytes));
+}
 
-    fwrite(header, 1, 44, file_);
+void writePcmWavHeader(FILE* file, int32_t sampleRate, int32_t channelCount) {
+    // Sizes describe an empty file until patchPcmWavHeader() runs on close.
+    uint8_t header[kWavHeaderBytes];
+    buildPcmWavHeader(header, sampleRate, channelCount, 0);
+    fwrite(header, 1, sizeof(header), file);
 }
 
-void WavWriter::patchWavHeader() {
-    if (!file_) return;
+void patchPcmWavHeader(FILE* file, int64_t dataBytes) {
+    if (!file) return;
 
-    int64_t dataSize = getTotalBytesWritten();
-    int64_t fileSize = dataSize + 44;
+    int64_t fileSize = dataBytes + kWavHeaderBytes;
 
     // Helper to write a 32-bit LE integer at an offset.
     auto writeInt32LE = [&](long offset, int32_t value) {
-        fseek(file_, offset, SEEK_SET);
+        fseek(file, offset, SEEK_SET);
         uint8_t buf[4];
         buf[0] = static_cast<uint8_t>(value & 0xFF);
         buf[1] = static_cast<uint8_t>((value >> 8) & 0xFF);
         buf[2] = static_cast<uint8_t>((value >> 16) & 0xFF);
         buf[3] = static_cast<uint8_t>((value >> 24) & 0xFF);
-        fwrite(buf, 1, 4, file_);
+        fwrite(buf, 1, 4, file);
     };
 
     // RIFF chunk size = fileSize - 8
     writeInt32LE(4, static_cast<int32_t>(fileSize - 8));
     // data sub-chunk size
-    writeInt32LE(40, static_cast<int32_t>(dataSize));
+    writeInt32LE(40, static_cast<int32_t>(dataBytes));
 
-    fflush(file_);
+    fflush(file);
     LOGD("WavWriter: patched header (dataSize=%lld, fileSize=%lld)",
-         (long long)dataSize, (long long)fileSize);
+         (long long)dataBytes, (long long)fileSize);
 }
 
 }  // namespace nightjar
@@ -2,9 +2,16 @@
 
 #include "spsc_ring_buffer.h"
 #include "common.h"
+#include "engine_telemetry.h"
+#include "peak_cache.h"
+#include "event_signal.h"
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <array>
 #include <thread>
 #include <string>
+#include <vector>
 #include <cstdio>
 
 namespace nightjar {
@@ -12,23 +19,83 @@ namespace nightjar {
 /** Ring buffer capacity: 2^17 = 131072 samples (~3 seconds at 44.1kHz). */
 constexpr size_t kRingBufferCapacity = 131072;
 
+/** Size of the canonical 16-bit PCM WAV header we write. */
+constexpr int32_t kWavHeaderBytes = 44;
+
+/**
+ * Fill [header] with a 16-bit PCM WAV header describing [dataBytes] of
+ * sample data.
+ */
+void buildPcmWavHeader(uint8_t (&header)[kWavHeaderBytes], int32_t sampleRate,
+                       int32_t channelCount, int64_t dataBytes);
+
+/**
+ * Write a 44-byte 16-bit PCM WAV header with placeholder sizes.
+ * The RIFF and data chunk sizes are filled in by patchPcmWavHeader().
+ */
+void writePcmWavHeader(FILE* file, int32_t sampleRate, int32_t channelCount);
+
+/**
+ * Patch the RIFF and data chunk sizes of a header written by
+ * writePcmWavHeader(), given the number of PCM bytes that follow it.
+ */
+void patchPcmWavHeader(FILE* file, int64_t dataBytes);
+
+// Recording sink tuning. Blocks are written at block-aligned file offsets
+// (the header shares the first block), so every write() hands the
+// filesystem whole, aligned pages.
+static constexpr size_t kWriteBlockBytes = 64 * 1024;
+// Disk space is reserved this far ahead of the write position so long
+// takes don't fragment or stall on allocation.
+static constexpr int64_t kPreallocateBytes = 8 * 1024 * 1024;
+// The capture callback wakes the writer once this much is queued
+// (~186ms of mono audio at 44.1kHz)...
+static constexpr size_t kWriterWakeSamples = 8192;
+// ...and the writer checkpoints the header (and any partial block) at
+// least this often, bounding what a crash can lose.
+static constexpr auto kCheckpointInterval = std::chrono::milliseconds(1000);
+// Loop passes one recording can be split into; later boundaries are
+// ignored and the remaining audio stays in the last take.
+static constexpr int32_t kMaxTakeBoundaries = 256;
+
 /**
  * Consumes float32 samples from a ring buffer on a dedicated thread
  * and writes them as 16-bit PCM WAV to disk.
  *
  * The writer thread is the ONLY place file I/O happens during recording.
- * The audio callback thread never touches the filesystem.
+ * The audio callback thread never touches the filesystem; it only calls
+ * notifyDataReady() once kWriterWakeSamples are queued.
+ *
+ * Samples are converted straight into an aligned kWriteBlockBytes block
+ * that is written with a single write() when full, into a file extended
+ * with fallocate() ahead of time. Every kCheckpointInterval the pending
+ * partial block is written in place and the header sizes are patched,
+ * so a killed process leaves a playable WAV missing at most the last
+ * checkpoint interval.
+ *
+ * Each pass records the ring's fill level into EngineTelemetry so a
+ * writer falling behind the input shows up before samples are dropped.
+ *
+ * The writer also folds every sample into a waveform peak pyramid and
+ * saves it as a `.peaks` sidecar when recording stops, so the UI can
+ * draw the take at any zoom without decoding it (see PeakCacheReader).
+ *
+ * A recording can be split into several takes while it is written: the
+ * capture callback marks loop boundaries with markTakeBoundary(), and
+ * when the writer reaches one it closes the current WAV and carries on
+ * in the next take file (`<name>_take2.wav`, ...). Stopping a loop
+ * session then only closes the last file.
  */
 class WavWriter {
 public:
-    WavWriter();
+    explicit WavWriter(EngineTelemetry& telemetry);
     ~WavWriter();
 
     /**
-     * Open a WAV file for writing and write the placeholder header.
-     * Returns true on success.
+     * Open a WAV file for writing at [sampleRate] and write the
+     * placeholder header. Returns true on success.
      */
-    bool open(const std::string& filePath);
+    bool open(const std::string& filePath, int32_t sampleRate);
 
     /**
      * Start the consumer thread that drains the ring buffer and writes
@@ -42,7 +109,25 @@ public:
      */
     void stopConsuming();
 
-    /** Total PCM data bytes written (excluding 44-byte header). */
+    /**
+     * Start a new take at capture sample [sampleIndex] (counted from the
+     * first sample that reached the ring). Real-time safe; called by the
+     * capture callback before it writes the samples from [sampleIndex]
+     * on. Returns false once kMaxTakeBoundaries have been marked.
+     */
+    bool markTakeBoundary(int64_t sampleIndex);
+
+    /**
+     * Files written by the last recording, in take order; the first is
+     * the path given to open(). Only valid once stopConsuming() returned.
+     */
+    const std::vector<std::string>& getTakePaths() const { return takePaths_; }
+
+    /** Wake the consumer thread. Real-time safe; called by the capture
+     *  callback when enough samples are queued. */
+    void notifyDataReady() { dataReady_.notify(); }
+
+    /** Total PCM data bytes written across all takes (excluding headers). */
     int64_t getTotalBytesWritten() const {
         return totalBytesWritten_.load(std::memory_order_relaxed);
     }
@@ -50,20 +135,75 @@ public:
     /** Recording duration in milliseconds. */
     int64_t getDurationMs() const {
         int64_t bytes = getTotalBytesWritten();
-        return (bytes * 1000L) / (kSampleRate * kChannelCount * kBytesPerSample);
+        return (bytes * 1000L) / (sampleRate_ * kChannelCount * kBytesPerSample);
     }
 
 private:
+    struct alignas(4096) WriteBlock {
+        uint8_t bytes[kWriteBlockBytes];
+    };
+
     void writerLoop(SpscRingBuffer<kRingBufferCapacity>& ringBuffer);
-    void writeWavHeader();
-    void patchWavHeader();
+
+    /** Convert everything queued in the ring into the block, writing
+     *  each block out as it fills. */
     void drainRingBuffer(SpscRingBuffer<kRingBufferCapacity>& ringBuffer);
 
-    FILE* file_ = nullptr;
+    /** Open [path] for a new take. Returns the fd, or -1. */
+    static int openTakeFile(const std::string& path);
+
+    /** Make [fd] the current take and put a valid (empty) WAV on disk. */
+    void beginTake(int fd, const std::string& path);
+
+    /** Close the current take and write its peak sidecar. */
+    void endTake();
+
+    /** Move on to the next take file at a loop boundary. */
+    void startNextTake();
+
+    /** Capture index of the next unconsumed take boundary, or -1. */
+    int64_t pendingTakeBoundary() const;
+
+    /** Write the full block at fileOffset_ and start the next one. */
+    bool flushBlock();
+
+    /** Write the partial block in place and patch the header sizes. */
+    void checkpoint();
+
+    /** Header for everything converted so far; goes into the block while
+     *  it still holds offset 0, otherwise straight to the file. */
+    void writeHeader();
+
+    /** Reserve disk space ahead of [end]. */
+    void preallocate(int64_t end);
+
+    /** Final checkpoint, trim the preallocation, close. */
+    void finish();
+
+    EngineTelemetry& telemetry_;
+    int32_t sampleRate_ = kDefaultSampleRate;   // set by open()
+    int fd_ = -1;
+    std::unique_ptr<WriteBlock> block_;
+    size_t blockFill_ = 0;          // bytes used in block_
+    int64_t fileOffset_ = 0;        // file offset of block_ (block-aligned)
+    int64_t preallocatedTo_ = 0;
+    bool preallocateFailed_ = false;
+    std::chrono::steady_clock::time_point lastCheckpoint_;
+    EventSignal dataReady_;
     std::thread writerThread_;
     std::atomic<bool> running_{false};
     std::atomic<int64_t> totalBytesWritten_{0};
-    std::string filePath_;
+    std::string basePath_;                 // path given to open()
+    std::string filePath_;                 // current take
+    std::vector<std::string> takePaths_;
+    PeakCacheBuilder peaks_;   // writer thread while consuming
+
+    // Take boundaries: appended by the capture callback (single
+    // producer), consumed in order by the writer thread.
+    std::array<int64_t, kMaxTakeBoundaries> takeBoundaries_{};
+    std::atomic<int32_t> takeBoundaryCount_{0};
+    int32_t nextTakeBoundary_ = 0;         // writer thread
+    int64_t samplesConsumed_ = 0;          // writer thread, all takes
 };
 
 }  // namespace nightjar
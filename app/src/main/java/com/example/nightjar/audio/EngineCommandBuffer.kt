@@ -0,0 +1,304 @@
+package com.example.nightjar.audio
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Writer for the native engine's command batches.
+ *
+ * Commands are encoded into one direct [ByteBuffer] in native byte order
+ * and handed over with a single JNI call ([OboeAudioEngine.submit]); the
+ * engine decodes arrays in place instead of pinning and copying each
+ * Java array. The layout must match `engine_commands.h`:
+ *
+ * - a 16 byte header (magic, version, command count, byte length),
+ * - per command an 8 byte record header (op, payload size) and a
+ *   payload padded to 8 bytes,
+ * - 4 byte scalars 4-aligned, 8 byte scalars 8-aligned, and arrays as an
+ *   8-aligned `count, pad` pair followed by their elements.
+ *
+ * Not thread-safe; [OboeAudioEngine] serializes access. The buffer is
+ * reused between batches and only grows.
+ */
+class EngineCommandBuffer(initialCapacity: Int = 4096) {
+
+    /** The encoded batch; valid up to [finish]'s returned length. */
+    var buffer: ByteBuffer = allocate(initialCapacity)
+        private set
+
+    /** Commands written since the last [reset]. */
+    var commandCount: Int = 0
+        private set
+
+    val isEmpty: Boolean get() = commandCount == 0
+
+    private var recordStart = -1
+
+    init {
+        reset()
+    }
+
+    /** Drop all commands and start a new batch. */
+    fun reset() {
+        buffer.clear()
+        buffer.position(HEADER_BYTES)
+        commandCount = 0
+        recordStart = -1
+    }
+
+    /** Write the batch header. Returns the batch length in bytes. */
+    fun finish(): Int {
+        val length = buffer.position()
+        buffer.putInt(0, MAGIC)
+        buffer.putShort(4, FORMAT_VERSION.toShort())
+        buffer.putShort(6, commandCount.toShort())
+        buffer.putInt(8, length)
+        buffer.putInt(12, 0)
+        return length
+    }
+
+    // ── Mixer ──────────────────────────────────────────────────────────────
+
+    fun trackVolume(trackId: Int, volume: Float) = command(OP_TRACK_VOLUME) {
+        putI32(trackId); putF32(volume)
+    }
+
+    fun trackMuted(trackId: Int, muted: Boolean) = command(OP_TRACK_MUTED) {
+        putI32(trackId); putBoolean(muted)
+    }
+
+    fun trackPan(trackId: Int, pan: Float) = command(OP_TRACK_PAN) {
+        putI32(trackId); putF32(pan)
+    }
+
+    fun busVolume(busId: Int, volume: Float) = command(OP_BUS_VOLUME) {
+        putI32(busId); putF32(volume)
+    }
+
+    fun busMuted(busId: Int, muted: Boolean) = command(OP_BUS_MUTED) {
+        putI32(busId); putBoolean(muted)
+    }
+
+    // ── Tempo map ──────────────────────────────────────────────────────────
+
+    fun bpm(bpm: Double) = command(OP_SET_BPM) {
+        putF64(bpm)
+    }
+
+    fun tempoMap(startTicks: LongArray, bpms: DoubleArray, beatsPerBar: IntArray) =
+        command(OP_SET_TEMPO_MAP) {
+            putArray(startTicks); putArray(bpms); putArray(beatsPerBar)
+        }
+
+    // ── Drum sequencer ─────────────────────────────────────────────────────
+
+    fun drumPatternClips(
+        volume: Float,
+        muted: Boolean,
+        patternStepsPerBar: IntArray,
+        patternTotalSteps: IntArray,
+        patternBeatsPerBar: IntArray,
+        patternHitCounts: IntArray,
+        hitStepIndices: IntArray,
+        hitDrumNotes: IntArray,
+        hitVelocities: FloatArray,
+        clipPatterns: IntArray,
+        clipOffsetsMs: LongArray
+    ) = command(OP_DRUM_PATTERN_CLIPS) {
+        putF32(volume); putBoolean(muted)
+        putArray(patternStepsPerBar); putArray(patternTotalSteps)
+        putArray(patternBeatsPerBar); putArray(patternHitCounts)
+        putArray(hitStepIndices); putArray(hitDrumNotes); putArray(hitVelocities)
+        putArray(clipPatterns); putArray(clipOffsetsMs)
+    }
+
+    fun drumSequencerEnabled(enabled: Boolean) = command(OP_DRUM_SEQUENCER_ENABLED) {
+        putBoolean(enabled)
+    }
+
+    // ── MIDI sequencer ─────────────────────────────────────────────────────
+
+    fun midiTracks(
+        channels: IntArray,
+        programs: IntArray,
+        volumes: FloatArray,
+        muted: BooleanArray,
+        trackClipCounts: IntArray,
+        clipOffsetsMs: LongArray,
+        clipLengthsMs: LongArray,
+        clipEventCounts: IntArray,
+        eventTicks: LongArray,
+        eventChannels: IntArray,
+        eventNotes: IntArray,
+        eventVelocities: IntArray
+    ) = command(OP_MIDI_TRACKS) {
+        putArray(channels); putArray(programs); putArray(volumes); putArray(muted)
+        putArray(trackClipCounts)
+        putClipArrays(clipOffsetsMs, clipLengthsMs, clipEventCounts,
+            eventTicks, eventChannels, eventNotes, eventVelocities)
+    }
+
+    fun midiTrack(
+        trackIndex: Int,
+        channel: Int,
+        program: Int,
+        volume: Float,
+        muted: Boolean,
+        clipOffsetsMs: LongArray,
+        clipLengthsMs: LongArray,
+        clipEventCounts: IntArray,
+        eventTicks: LongArray,
+        eventChannels: IntArray,
+        eventNotes: IntArray,
+        eventVelocities: IntArray
+    ) = command(OP_MIDI_TRACK) {
+        putI32(trackIndex); putI32(channel); putI32(program)
+        putF32(volume); putBoolean(muted)
+        putClipArrays(clipOffsetsMs, clipLengthsMs, clipEventCounts,
+            eventTicks, eventChannels, eventNotes, eventVelocities)
+    }
+
+    fun midiTrackRange(
+        trackIndex: Int,
+        startMs: Long,
+        endMs: Long,
+        clipOffsetsMs: LongArray,
+        clipLengthsMs: LongArray,
+        clipEventCounts: IntArray,
+        eventTicks: LongArray,
+        eventChannels: IntArray,
+        eventNotes: IntArray,
+        eventVelocities: IntArray
+    ) = command(OP_MIDI_TRACK_RANGE) {
+        putI32(trackIndex); putI64(startMs); putI64(endMs)
+        putClipArrays(clipOffsetsMs, clipLengthsMs, clipEventCounts,
+            eventTicks, eventChannels, eventNotes, eventVelocities)
+    }
+
+    fun midiSequencerEnabled(enabled: Boolean) = command(OP_MIDI_SEQUENCER_ENABLED) {
+        putBoolean(enabled)
+    }
+
+    // ── Encoding ───────────────────────────────────────────────────────────
+
+    private inline fun command(op: Int, payload: EngineCommandBuffer.() -> Unit) {
+        check(commandCount < MAX_COMMANDS) { "Too many commands in one batch" }
+        ensureCapacity(RECORD_HEADER_BYTES)
+        recordStart = buffer.position()
+        buffer.putShort(op.toShort())
+        buffer.putShort(0)
+        buffer.putInt(0)  // payload size, patched below
+        payload()
+        pad(8)
+        val payloadBytes = buffer.position() - recordStart - RECORD_HEADER_BYTES
+        buffer.putInt(recordStart + 4, payloadBytes)
+        commandCount++
+    }
+
+    private fun putClipArrays(
+        clipOffsetsMs: LongArray,
+        clipLengthsMs: LongArray,
+        clipEventCounts: IntArray,
+        eventTicks: LongArray,
+        eventChannels: IntArray,
+        eventNotes: IntArray,
+        eventVelocities: IntArray
+    ) {
+        putArray(clipOffsetsMs); putArray(clipLengthsMs); putArray(clipEventCounts)
+        putArray(eventTicks); putArray(eventChannels)
+        putArray(eventNotes); putArray(eventVelocities)
+    }
+
+    private fun putI32(value: Int) { pad(4); ensureCapacity(4); buffer.putInt(value) }
+    private fun putF32(value: Float) { pad(4); ensureCapacity(4); buffer.putFloat(value) }
+    private fun putBoolean(value: Boolean) = putI32(if (value) 1 else 0)
+    private fun putI64(value: Long) { pad(8); ensureCapacity(8); buffer.putLong(value) }
+    private fun putF64(value: Double) { pad(8); ensureCapacity(8); buffer.putDouble(value) }
+
+    private fun putArray(values: IntArray) {
+        beginArray(values.size, 4)
+        buffer.asIntBuffer().put(values)
+        buffer.position(buffer.position() + values.size * 4)
+    }
+
+    private fun putArray(values: FloatArray) {
+        beginArray(values.size, 4)
+        buffer.asFloatBuffer().put(values)
+        buffer.position(buffer.position() + values.size * 4)
+    }
+
+    private fun putArray(values: LongArray) {
+        beginArray(values.size, 8)
+        buffer.asLongBuffer().put(values)
+        buffer.position(buffer.position() + values.size * 8)
+    }
+
+    private fun putArray(values: DoubleArray) {
+        beginArray(values.size, 8)
+        buffer.asDoubleBuffer().put(values)
+        buffer.position(buffer.position() + values.size * 8)
+    }
+
+    private fun putArray(values: BooleanArray) {
+        beginArray(values.size, 1)
+        for (value in values) buffer.put(if (value) 1 else 0)
+    }
+
+    /** Array header, with room reserved for [count] elements of [elementBytes]. */
+    private fun beginArray(count: Int, elementBytes: Int) {
+        pad(8)
+        ensureCapacity(8 + count.toLong() * elementBytes + 8)
+        buffer.putInt(count)
+        buffer.putInt(0)
+    }
+
+    /** Zero-fill up to the next multiple of [align]. */
+    private fun pad(align: Int) {
+        val position = buffer.position()
+        val aligned = (position + align - 1) and (align - 1).inv()
+        if (aligned == position) return
+        ensureCapacity(aligned - position)
+        while (buffer.position() < aligned) buffer.put(0)
+    }
+
+    private fun ensureCapacity(bytes: Int) = ensureCapacity(bytes.toLong())
+
+    private fun ensureCapacity(bytes: Long) {
+        if (buffer.remaining() >= bytes) return
+        val needed = buffer.position() + bytes
+        require(needed <= Int.MAX_VALUE) { "Command batch too large" }
+        var capacity = buffer.capacity()
+        while (capacity < needed) capacity = (capacity * 2L).coerceAtMost(Int.MAX_VALUE.toLong()).toInt()
+        val grown = allocate(capacity)
+        buffer.flip()
+        grown.put(buffer)
+        buffer = grown
+    }
+
+    companion object {
+        /** "NJCB" read as a native-order u32; mirrors kCommandMagic. */
+        const val MAGIC = 0x42434A4E
+        const val FORMAT_VERSION = 1
+        const val HEADER_BYTES = 16
+        const val RECORD_HEADER_BYTES = 8
+        private const val MAX_COMMANDS = 0xFFFF
+
+        // Opcodes; mirror CommandOp in engine_commands.h.
+        const val OP_TRACK_VOLUME = 1
+        const val OP_TRACK_MUTED = 2
+        const val OP_TRACK_PAN = 3
+        const val OP_BUS_VOLUME = 4
+        const val OP_BUS_MUTED = 5
+        const val OP_SET_BPM = 16
+        const val OP_SET_TEMPO_MAP = 17
+        const val OP_DRUM_PATTERN_CLIPS = 32
+        const val OP_DRUM_SEQUENCER_ENABLED = 33
+        const val OP_MIDI_TRACKS = 48
+        const val OP_MIDI_TRACK = 49
+        const val OP_MIDI_SEQUENCER_ENABLED = 50
+        const val OP_MIDI_TRACK_RANGE = 51
+
+        private fun allocate(capacity: Int): ByteBuffer =
+            ByteBuffer.allocateDirect(capacity).order(ByteOrder.nativeOrder())
+    }
+}
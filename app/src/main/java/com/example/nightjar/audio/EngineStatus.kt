@@ -0,0 +1,136 @@
+package com.example.nightjar.audio
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Snapshot of the native engine's status block.
+ *
+ * Published by the real-time threads once per audio block or render
+ * chunk and read by [EngineStatusReader] without any JNI calls. The
+ * transport fields come from one playback block, the meter fields from
+ * one input block; the two sections are independent.
+ *
+ * [positionFrames] is the frame the latest block started at and
+ * [presentNanos] the `System.nanoTime()` at which that frame reaches
+ * the output, so [playheadFrames] can place the playhead between blocks.
+ */
+data class EngineStatus(
+    val isPlaying: Boolean = false,
+    val isRecording: Boolean = false,
+    val positionFrames: Long = 0L,
+    val totalFrames: Long = 0L,
+    val loopResetCount: Long = 0L,
+    val presentNanos: Long = 0L,
+    val sampleRate: Int = 0,
+    /** Frame of the last metronome beat, or -1 if none yet. */
+    val metronomeBeatFrame: Long = -1L,
+    /** Input peak of the latest recording block, normalised to 0-1. */
+    val inputPeak: Float = 0f,
+    val recordedFrames: Long = 0L
+) {
+    /**
+     * Timeline frame heard at [nowNanos]: the block position advanced by
+     * the time since it reached the output. Extrapolation is capped so a
+     * stalled stream doesn't run the playhead away, and stops at the end
+     * of the timeline unless recording past it.
+     */
+    fun playheadFrames(nowNanos: Long): Long {
+        if (!isPlaying || sampleRate <= 0) return positionFrames
+        val elapsed = (nowNanos - presentNanos).coerceIn(0L, MAX_EXTRAPOLATION_NANOS)
+        val frames = positionFrames + elapsed * sampleRate / 1_000_000_000L
+        return if (!isRecording && totalFrames > 0) minOf(frames, totalFrames) else frames
+    }
+
+    companion object {
+        const val MAX_EXTRAPOLATION_NANOS = 100_000_000L
+    }
+}
+
+/**
+ * Reads [EngineStatus] out of the native status block (engine_status.h),
+ * mapped as a direct [ByteBuffer].
+ *
+ * Each section is a seqlock: its first word counts updates and is odd
+ * while the writer is inside. The section is copied between two reads
+ * of that word and kept only if both match and are even; otherwise the
+ * read is retried a few times and the section's last good values stand.
+ *
+ * Not thread-safe; one reader (the UI poll) per instance.
+ */
+class EngineStatusReader(buffer: ByteBuffer) {
+
+    private val buffer: ByteBuffer = buffer.duplicate().order(ByteOrder.nativeOrder())
+
+    /** Last consistent value of every word. */
+    private val words = LongArray(WORD_COUNT).also { it[METRONOME_BEAT_FRAME] = -1L }
+    private val attempt = LongArray(SECTION_WORDS)
+
+    @Volatile private var fence = 0
+
+    init {
+        require(this.buffer.capacity() >= WORD_COUNT * 8) { "Status block too small" }
+    }
+
+    fun read(): EngineStatus {
+        readSection(TRANSPORT_SEQ)
+        readSection(SYNTH_SEQ)
+        readSection(INPUT_SEQ)
+        return EngineStatus(
+            isPlaying = words[PLAYING] != 0L,
+            isRecording = words[RECORDING] != 0L,
+            positionFrames = words[POSITION_FRAMES],
+            totalFrames = words[TOTAL_FRAMES],
+            loopResetCount = words[LOOP_RESET_COUNT],
+            presentNanos = words[PRESENT_NANOS],
+            sampleRate = words[SAMPLE_RATE].toInt(),
+            metronomeBeatFrame = words[METRONOME_BEAT_FRAME],
+            inputPeak = java.lang.Double.longBitsToDouble(words[INPUT_PEAK]).toFloat(),
+            recordedFrames = words[RECORDED_FRAMES]
+        )
+    }
+
+    private fun readSection(sequence: Int) {
+        repeat(MAX_ATTEMPTS) {
+            val before = buffer.getLong(sequence * 8)
+            if (before and 1L != 0L) return@repeat
+            loadFence()
+            for (i in 1 until SECTION_WORDS) attempt[i] = buffer.getLong((sequence + i) * 8)
+            loadFence()
+            if (buffer.getLong(sequence * 8) == before) {
+                System.arraycopy(attempt, 1, words, sequence + 1, SECTION_WORDS - 1)
+                return
+            }
+        }
+    }
+
+    /**
+     * Keep the sequence reads on either side of the field reads. A
+     * volatile write followed by a volatile read is a full barrier on
+     * ART (and HotSpot), and needs nothing newer than API 24.
+     */
+    private fun loadFence() {
+        fence = 0
+        @Suppress("UNUSED_VARIABLE") val ignored = fence
+    }
+
+    companion object {
+        // Word indices; mirror StatusWord in engine_status.h.
+        const val TRANSPORT_SEQ = 0
+        const val PLAYING = 1
+        const val RECORDING = 2
+        const val POSITION_FRAMES = 3
+        const val TOTAL_FRAMES = 4
+        const val LOOP_RESET_COUNT = 5
+        const val PRESENT_NANOS = 6
+        const val SAMPLE_RATE = 7
+        const val SYNTH_SEQ = 8
+        const val METRONOME_BEAT_FRAME = 9
+        const val INPUT_SEQ = 16
+        const val INPUT_PEAK = 17
+        const val RECORDED_FRAMES = 18
+        const val WORD_COUNT = 24
+        private const val SECTION_WORDS = 8
+        private const val MAX_ATTEMPTS = 4
+    }
+}
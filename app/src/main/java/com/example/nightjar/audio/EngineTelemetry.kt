@@ -0,0 +1,80 @@
+package com.example.nightjar.audio
+
+/**
+ * Snapshot of the native engine's real-time counters.
+ *
+ * Counters are cumulative since engine start or the last
+ * [OboeAudioEngine.resetTelemetry]; diff two snapshots to get a rate.
+ * The field order mirrors `TelemetryField` in engine_telemetry.h.
+ *
+ * [callbackHistogram] buckets callbacks by the fraction of their buffer
+ * period they took, in quarters: [0, 0.25), [0.25, 0.5), ... [1.75, inf).
+ * Anything from bucket 4 up ran past its deadline.
+ */
+data class EngineTelemetry(
+    val callbackCount: Long,
+    val callbackTotalNanos: Long,
+    val callbackMaxNanos: Long,
+    val callbackPeriodNanos: Long,
+    val callbackHistogram: List<Long>,
+    val xrunCount: Long,
+    val synthReads: Long,
+    val synthUnderruns: Long,
+    val synthShortReads: Long,
+    val synthMissingFrames: Long,
+    val renderChunks: Long,
+    val renderTotalNanos: Long,
+    val renderMaxNanos: Long,
+    val synthRingFillFrames: Long,
+    /** Lowest synth ring fill seen before a render, or -1 if none yet. */
+    val synthRingLowWaterFrames: Long,
+    val recordRingHighWaterSamples: Long,
+    val recordDroppedSamples: Long,
+    /** Times the callback re-aligned synth audio to the timeline. */
+    val synthAlignCorrections: Long,
+    val synthAlignDroppedFrames: Long,
+    val synthAlignPaddedFrames: Long
+) {
+    /** Average callback duration as a fraction of the buffer period. */
+    val averageCallbackLoad: Float
+        get() = if (callbackCount == 0L || callbackPeriodNanos == 0L) 0f
+        else callbackTotalNanos.toFloat() / callbackCount / callbackPeriodNanos
+
+    /** Callbacks that overran their buffer period. */
+    val lateCallbacks: Long
+        get() = callbackHistogram.drop(HISTOGRAM_BUCKETS / 2).sum()
+
+    companion object {
+        const val HISTOGRAM_BUCKETS = 8
+        const val FIELD_COUNT = 4 + HISTOGRAM_BUCKETS + 15
+
+        /** Parse the raw array filled by the native side. */
+        fun fromRaw(raw: LongArray): EngineTelemetry {
+            require(raw.size >= FIELD_COUNT) { "telemetry array too short: ${raw.size}" }
+            var i = 0
+            fun next() = raw[i++]
+            return EngineTelemetry(
+                callbackCount = next(),
+                callbackTotalNanos = next(),
+                callbackMaxNanos = next(),
+                callbackPeriodNanos = next(),
+                callbackHistogram = List(HISTOGRAM_BUCKETS) { next() },
+                xrunCount = next(),
+                synthReads = next(),
+                synthUnderruns = next(),
+                synthShortReads = next(),
+                synthMissingFrames = next(),
+                renderChunks = next(),
+                renderTotalNanos = next(),
+                renderMaxNanos = next(),
+                synthRingFillFrames = next(),
+                synthRingLowWaterFrames = next(),
+                recordRingHighWaterSamples = next(),
+                recordDroppedSamples = next(),
+                synthAlignCorrections = next(),
+                synthAlignDroppedFrames = next(),
+                synthAlignPaddedFrames = next()
+            )
+        }
+    }
+}
@@ -0,0 +1,21 @@
+package com.example.nightjar.audio
+
+/**
+ * Scheduling settings for the native engine's own threads; mirrors
+ * `ThreadPolicySettings` in thread_policy.h. Applied with
+ * [OboeAudioEngine.setThreadPolicy]; the defaults are what the engine
+ * uses until then.
+ */
+data class EngineThreadPolicy(
+    /** SCHED_FIFO where the process may use it, else the audio nice levels. */
+    val realtimePriority: Boolean = true,
+    /** Keep synth threads on the faster cores of a big/little CPU. */
+    val performanceCores: Boolean = true,
+    /** Report synth render work to an APerformanceHint session (API 33+). */
+    val performanceHint: Boolean = true,
+    /**
+     * Render time per chunk the hint session aims for, as a percentage
+     * of the chunk's duration (10-100). Lower asks for higher clocks.
+     */
+    val hintTargetPercent: Int = 50
+)
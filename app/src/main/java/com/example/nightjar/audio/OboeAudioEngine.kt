@@ -2,9 +2,12 @@ package com.example.nightjar.audio
 
 import android.util.Log
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.delay
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.withContext
+import java.io.File
+import java.nio.ByteBuffer
 import javax.inject.Inject
 import javax.inject.Singleton
 
@@ -16,8 +19,11 @@ import javax.inject.Singleton
  * ms-to-frame conversions.
  *
  * Thread safety: JNI calls are safe from any thread. The native engine
- * uses atomics for all cross-thread state. StateFlow updates happen via
- * [pollState] called from the ViewModel's tick coroutine.
+ * uses atomics for all cross-thread state. Mixer, tempo and sequencer
+ * edits go through the batched command channel ([submit]). StateFlow
+ * updates happen via [pollState] called from the ViewModel's tick
+ * coroutine, which reads the native status block ([readStatus])
+ * without crossing JNI.
  *
  * ## Lifecycle
  * - [initialize] once from [com.example.nightjar.NightjarApplication.onCreate]
@@ -38,29 +44,85 @@ class OboeAudioEngine @Inject constructor() {
     private val _totalDurationMs = MutableStateFlow(0L)
     val totalDurationMs: StateFlow<Long> = _totalDurationMs
 
+    /** Reader over the native status block; null while the engine is down. */
+    private var statusReader: EngineStatusReader? = null
+    private val statusLock = Any()
+
     // ── Lifecycle ──────────────────────────────────────────────────────────
 
     fun initialize(): Boolean {
         val result = nativeInit()
         Log.d(TAG, "initialize() → $result")
+        if (result) {
+            synchronized(statusLock) {
+                statusReader = nativeGetStatusBuffer()?.let { EngineStatusReader(it) }
+            }
+        }
         return result
     }
 
     fun shutdown() {
         Log.d(TAG, "shutdown()")
+        // The status block goes away with the engine
+        synchronized(statusLock) { statusReader = null }
         nativeShutdown()
     }
 
     fun isInitialized(): Boolean = nativeIsInitialized()
 
+    /**
+     * Engine sample rate in Hz: the output device's native rate, fixed by
+     * [initialize]. Frame positions passed to or read from the engine
+     * (MIDI events, metronome beats) are in this rate.
+     */
+    fun getSampleRate(): Int = nativeGetSampleRate()
+
     // ── Recording ──────────────────────────────────────────────────────────
 
-    fun startRecording(filePath: String): Boolean {
-        val ok = nativeStartRecording(filePath)
-        Log.d(TAG, "startRecording($filePath) → $ok")
+    /**
+     * Start recording into [filePath]. With [splitTakesAtLoop], each loop
+     * pass after the write gate opens is written to its own take file as
+     * it is recorded; see [getRecordedTakeFiles].
+     */
+    fun startRecording(filePath: String, splitTakesAtLoop: Boolean = false): Boolean {
+        val ok = nativeStartRecording(filePath, splitTakesAtLoop)
+        Log.d(TAG, "startRecording($filePath, split=$splitTakesAtLoop) → $ok")
+        return ok
+    }
+
+    /**
+     * Start a full-duplex recording into [filePath]: the output callback
+     * reads the input and stamps every block with the timeline frame
+     * being heard as it was captured. The take starts with the first
+     * input heard at or after [startMs], so it lands on the timeline
+     * without [awaitFirstBuffer], [openWriteGate] or latency compensation;
+     * [getRecordedStartMs] says where. False if the output isn't running,
+     * in which case [startRecording] is the fallback.
+     */
+    fun startDuplexRecording(
+        filePath: String, startMs: Long, splitTakesAtLoop: Boolean = false
+    ): Boolean {
+        val ok = nativeStartDuplexRecording(filePath, splitTakesAtLoop, startMs)
+        Log.d(TAG, "startDuplexRecording($filePath, start=$startMs, split=$splitTakesAtLoop) → $ok")
         return ok
     }
 
+    /**
+     * Timeline position the current or last full-duplex take starts at,
+     * or -1 before its first sample (and for [startRecording] takes).
+     */
+    fun getRecordedStartMs(): Long = nativeGetRecordedStartMs()
+
+    /**
+     * Hear the full-duplex input through the output mix at [gain], one
+     * output buffer behind the performer. Off by default; headphones only,
+     * or the speaker feeds back into the take.
+     */
+    fun setInputMonitoring(enabled: Boolean, gain: Float = 1f) {
+        nativeSetInputMonitoring(enabled, gain)
+        Log.d(TAG, "setInputMonitoring($enabled, gain=$gain)")
+    }
+
     suspend fun awaitFirstBuffer(timeoutMs: Int = 2000): Boolean =
         withContext(Dispatchers.IO) {
             val hot = nativeAwaitFirstBuffer(timeoutMs)
@@ -81,12 +143,52 @@ class OboeAudioEngine @Inject constructor() {
 
     fun isRecordingActive(): Boolean = nativeIsRecordingActive()
 
-    fun getLatestPeakAmplitude(): Float = nativeGetLatestPeakAmplitude()
+    fun getLatestPeakAmplitude(): Float = readStatus().inputPeak
+
+    private val envelopeScratch = FloatArray(ENVELOPE_DRAIN_POINTS * 3)
+
+    /**
+     * Hand every live-input envelope point captured since the last drain
+     * to [onPoint], oldest first, and return how many there were. Each
+     * point covers [ENVELOPE_WINDOW_FRAMES] input frames of the take (the
+     * last one of a take may be shorter), so the UI can poll at any rate
+     * without missing a peak.
+     */
+    fun drainInputEnvelope(onPoint: (min: Float, max: Float, rms: Float) -> Unit): Int =
+        synchronized(envelopeScratch) {
+            var total = 0
+            do {
+                val n = nativeDrainInputEnvelope(envelopeScratch)
+                for (i in 0 until n) {
+                    onPoint(envelopeScratch[i * 3], envelopeScratch[i * 3 + 1], envelopeScratch[i * 3 + 2])
+                }
+                total += n
+            } while (n == ENVELOPE_DRAIN_POINTS)
+            total
+        }
 
     fun getRecordedDurationMs(): Long = nativeGetRecordedDurationMs()
 
+    /**
+     * The files the last recording was written to, one per take in order.
+     * A single entry (the path given to [startRecording]) unless it was
+     * split at loop boundaries. Only meaningful after [stopRecording].
+     */
+    fun getRecordedTakeFiles(): List<File> =
+        nativeGetRecordedTakePaths().map { File(it) }
+
     // ── Playback ───────────────────────────────────────────────────────────
 
+    /**
+     * Get the take at [filePath] ready for [addTrack]: a take recorded at
+     * another rate than the engine's is converted once, on
+     * [Dispatchers.IO], to a copy kept next to it. [addTrack] will not
+     * play such a take unless this ran first. Returns false if the take
+     * can't be read or converted.
+     */
+    suspend fun prepareTrackFile(filePath: String): Boolean =
+        withContext(Dispatchers.IO) { nativePrepareTrackFile(filePath) }
+
     fun addTrack(
         trackId: Int, filePath: String, durationMs: Long,
         offsetMs: Long, trimStartMs: Long, trimEndMs: Long,
@@ -96,6 +198,16 @@ class OboeAudioEngine @Inject constructor() {
             trimStartMs, trimEndMs, volume, isMuted)
     }
 
+    /**
+     * Play the rendered audio of a frozen clip as a mixer slot. The whole
+     * file plays from [offsetMs]; its length comes from the file itself.
+     */
+    fun addFrozenTrack(
+        trackId: Int, filePath: String, offsetMs: Long, isMuted: Boolean
+    ): Boolean {
+        return nativeAddTrack(trackId, filePath, -1L, offsetMs, 0L, 0L, 1f, isMuted)
+    }
+
     fun removeTrack(trackId: Int) = nativeRemoveTrack(trackId)
 
     fun removeAllTracks() = nativeRemoveAllTracks()
@@ -114,21 +226,90 @@ class OboeAudioEngine @Inject constructor() {
 
     /**
      * Poll native transport state and update StateFlows.
-     * Call this at ~60fps from the ViewModel's tick coroutine.
+     * Call this every frame from the ViewModel's tick coroutine; it reads
+     * the status block only, so it costs no JNI calls. While playing, the
+     * position is extrapolated from the latest audio block to the frame
+     * being heard now.
      */
     fun pollState() {
-        _isPlaying.value = nativeIsPlaying()
-        _positionMs.value = nativeGetPositionMs()
-        _totalDurationMs.value = nativeGetTotalDurationMs()
+        val status = readStatus()
+        if (status.sampleRate <= 0) return  // no audio block yet
+        _isPlaying.value = status.isPlaying
+        _positionMs.value = framesToMs(status.playheadFrames(System.nanoTime()), status.sampleRate)
+        _totalDurationMs.value = framesToMs(status.totalFrames, status.sampleRate)
+    }
+
+    /**
+     * Consistent snapshot of the native status block: transport, last
+     * metronome beat and input meter, as published by the audio threads.
+     * No JNI; defaults before [initialize].
+     */
+    fun readStatus(): EngineStatus = synchronized(statusLock) {
+        statusReader?.read() ?: EngineStatus()
+    }
+
+    private fun framesToMs(frames: Long, sampleRate: Int): Long = frames * 1000L / sampleRate
+
+    // ── Command channel ───────────────────────────────────────────────────
+
+    private val commands = EngineCommandBuffer()
+
+    /**
+     * Send the commands written by [block] as one batch, in one JNI call.
+     * The engine applies them in order and together: mixer changes land
+     * on the same audio block, sequencer changes on the same render chunk.
+     * The single-command facades below are one-command batches.
+     *
+     * @return false if the engine rejected any command (e.g. a MIDI track
+     *         index it doesn't have) or the batch itself.
+     */
+    @Synchronized
+    fun submit(block: EngineCommandBuffer.() -> Unit): Boolean {
+        commands.reset()
+        commands.block()
+        if (commands.isEmpty) return true
+        val length = commands.finish()
+        return nativeSubmitCommands(commands.buffer, length) == 0
     }
 
     // ── Per-track controls ─────────────────────────────────────────────────
 
-    fun setTrackVolume(trackId: Int, volume: Float) =
-        nativeSetTrackVolume(trackId, volume)
+    fun setTrackVolume(trackId: Int, volume: Float) {
+        submit { trackVolume(trackId, volume) }
+    }
+
+    fun setTrackMuted(trackId: Int, muted: Boolean) {
+        submit { trackMuted(trackId, muted) }
+    }
+
+    /** Pan from -1 (hard left) to +1 (hard right); 0 is center. */
+    fun setTrackPan(trackId: Int, pan: Float) {
+        submit { trackPan(trackId, pan) }
+    }
+
+    /** Route a track into a group bus, or back to [MASTER_BUS]. */
+    fun setTrackBus(trackId: Int, busId: Int) =
+        nativeSetTrackBus(trackId, busId)
 
-    fun setTrackMuted(trackId: Int, muted: Boolean) =
-        nativeSetTrackMuted(trackId, muted)
+    // ── Buses ──────────────────────────────────────────────────────────────
+
+    /**
+     * Create group bus [busId] (> 0). Returns false if it already exists
+     * or the engine's group bus limit is reached.
+     */
+    fun addBus(busId: Int): Boolean = nativeAddBus(busId)
+
+    /** Remove a group bus; its tracks go back to the master. */
+    fun removeBus(busId: Int) = nativeRemoveBus(busId)
+
+    /** Volume of a group bus, or of the master with [MASTER_BUS]. */
+    fun setBusVolume(busId: Int, volume: Float) {
+        submit { busVolume(busId, volume) }
+    }
+
+    fun setBusMuted(busId: Int, muted: Boolean) {
+        submit { busMuted(busId, muted) }
+    }
 
     // ── Loop ───────────────────────────────────────────────────────────────
 
@@ -144,17 +325,23 @@ class OboeAudioEngine @Inject constructor() {
     // ── Loop reset tracking ─────────────────────────────────────────────
 
     /** Returns the number of times the playback loop has reset to loopStart. */
-    fun getLoopResetCount(): Long = nativeGetLoopResetCount()
+    fun getLoopResetCount(): Long = readStatus().loopResetCount
 
     // ── Synth API ────────────────────────────────────────────────────────
 
     /**
      * Load a SoundFont file by absolute path and start the synth render thread.
      * Must be called once after [initialize] before any note events.
+     *
+     * With [lazySamples] (the default) only the preset tables are read
+     * now: each instrument's samples load the first time a track or an
+     * audition selects it and are released once nothing uses it, which
+     * keeps startup fast and memory low. The first audition of a patch
+     * reads its samples on the calling thread.
      */
-    fun loadSoundFont(path: String): Boolean {
-        val ok = nativeLoadSoundFont(path)
-        Log.d(TAG, "loadSoundFont($path) -> $ok")
+    fun loadSoundFont(path: String, lazySamples: Boolean = true): Boolean {
+        val ok = nativeLoadSoundFont(path, lazySamples)
+        Log.d(TAG, "loadSoundFont($path, lazy=$lazySamples) -> $ok")
         return ok
     }
 
@@ -183,12 +370,11 @@ class OboeAudioEngine @Inject constructor() {
      * thread keeps cycling when paused (see `synth_engine.cpp`).
      */
     fun previewNote(channel: Int, pitch: Int, velocity: Int, program: Int) {
-        // Drop any pre-rendered silence in the synth's output ring buffer
-        // before kicking off the noteOn. Otherwise the freshly-fired
-        // voice waits behind ~186ms of buffered silence (the ring's
-        // near-capacity steady state when paused), which usually outlasts
-        // a 200ms preview duration and renders the preview inaudible.
-        // Render thread only honors this when paused, so playback isn't
+        // While paused the synth ring only holds the LiveInput fill
+        // target (a couple of bursts), so the noteOn is heard almost
+        // immediately. The flush covers the moment right after a pause,
+        // when the deeper Play-profile backlog is still queued. Render
+        // thread only honors this when paused, so playback isn't
         // glitched.
         nativeSynthRequestPreviewFlush()
         nativeSynthProgramChange(channel, program)
@@ -198,6 +384,26 @@ class OboeAudioEngine @Inject constructor() {
     fun setSynthVolume(volume: Float) =
         nativeSetSynthVolume(volume)
 
+    /**
+     * Choose how far ahead the synth renders while the transport is
+     * playing. [SynthLatencyProfile.LIVE_INPUT] trades jitter headroom for
+     * low latency when the user plays notes over the arrangement; paused
+     * always uses the low-latency profile.
+     */
+    fun setSynthLatencyProfile(profile: SynthLatencyProfile) =
+        nativeSetSynthLatencyProfile(profile.ordinal)
+
+    /**
+     * Quality the synth currently renders at. The engine steps down when
+     * rendering can't keep up with real time (fewer voices, then no
+     * reverb and cheaper interpolation) and back up once there is room.
+     */
+    fun getSynthQualityTier(): SynthQualityTier =
+        SynthQualityTier.fromNative(nativeGetSynthQualityTier())
+
+    /** Smoothed synth render time as a fraction of real time. */
+    fun getSynthRenderLoad(): Float = nativeGetSynthRenderLoad()
+
     /** Immediately silence all sounding synth notes on all channels. */
     fun synthAllSoundsOff() = nativeSynthAllSoundsOff()
 
@@ -223,43 +429,80 @@ class OboeAudioEngine @Inject constructor() {
         stepIndices, drumNotes, velocities, clipOffsetsMs, beatsPerBar)
 
     /**
-     * Replace the drum pattern with per-clip data. Each clip has its own grid dimensions and hits.
-     * Flat arrays: per-clip metadata + concatenated hit arrays.
+     * Replace the drum pattern with per-clip data. Each distinct pattern is
+     * sent once with its grid dimensions and hits, and each clip names its
+     * pattern by index, so linked clips share one pattern in the engine.
+     * Flat arrays: per-pattern metadata + concatenated hit arrays, then
+     * per-clip pattern index and offset.
      */
     fun updateDrumPatternClips(
         volume: Float,
         muted: Boolean,
-        clipStepsPerBar: IntArray,
-        clipTotalSteps: IntArray,
-        clipBeatsPerBar: IntArray,
-        clipOffsetsMs: LongArray,
-        clipHitCounts: IntArray,
+        patternStepsPerBar: IntArray,
+        patternTotalSteps: IntArray,
+        patternBeatsPerBar: IntArray,
+        patternHitCounts: IntArray,
         hitStepIndices: IntArray,
         hitDrumNotes: IntArray,
-        hitVelocities: FloatArray
-    ) = nativeUpdateDrumPatternClips(
-        volume, muted,
-        clipStepsPerBar, clipTotalSteps, clipBeatsPerBar, clipOffsetsMs, clipHitCounts,
-        hitStepIndices, hitDrumNotes, hitVelocities
-    )
+        hitVelocities: FloatArray,
+        clipPatterns: IntArray,
+        clipOffsetsMs: LongArray
+    ) {
+        submit {
+            drumPatternClips(
+                volume, muted,
+                patternStepsPerBar, patternTotalSteps, patternBeatsPerBar, patternHitCounts,
+                hitStepIndices, hitDrumNotes, hitVelocities,
+                clipPatterns, clipOffsetsMs
+            )
+        }
+    }
 
-    fun setBpm(bpm: Double) = nativeSetBpm(bpm)
+    fun setDrumSequencerEnabled(enabled: Boolean) {
+        submit { drumSequencerEnabled(enabled) }
+    }
 
-    fun setDrumSequencerEnabled(enabled: Boolean) =
-        nativeSetDrumSequencerEnabled(enabled)
+    // ── Tempo map ─────────────────────────────────────────────────────────
+
+    /**
+     * Set a single tempo for the whole song. Drum steps and MIDI notes are
+     * held natively in musical ticks, so nothing needs re-sending after a
+     * tempo change.
+     */
+    fun setBpm(bpm: Double) {
+        submit { bpm(bpm) }
+    }
+
+    /**
+     * Replace the tempo map. Parallel arrays, one entry per segment: the
+     * tick it starts at ([TICKS_PER_BEAT] per beat), its tempo and its
+     * beats per bar. The first segment always starts at tick 0.
+     */
+    fun setTempoMap(startTicks: LongArray, bpms: DoubleArray, beatsPerBar: IntArray) {
+        submit { tempoMap(startTicks, bpms, beatsPerBar) }
+    }
 
     // ── MIDI Sequencer ────────────────────────────────────────────────────
 
     /**
      * Replace all MIDI track data in the C++ MIDI sequencer.
-     * Flat parallel arrays: per-track metadata + flattened noteOn/noteOff events.
+     * Flat parallel arrays: per-track metadata, per-clip placement, then
+     * the flattened noteOn/noteOff events of every clip in order. Clips
+     * are placed in milliseconds; their events are in ticks from the clip
+     * start, so they follow the tempo map. Notes may run past the clip
+     * length -- the engine drops notes starting at or after it and ends
+     * the rest there.
      *
-     * @param channels         MIDI channel per track (size = trackCount)
+     * @param channels         Logical MIDI channel per track, 0-255 (size = trackCount);
+     *                         the engine binds each to a synth channel as needed
      * @param programs         GM program per track (size = trackCount)
      * @param volumes          Volume per track (size = trackCount)
      * @param muted            Mute flag per track (size = trackCount)
-     * @param trackEventCounts Number of events per track (size = trackCount)
-     * @param eventFrames      Frame position of each event (size = totalEvents)
+     * @param trackClipCounts  Number of clips per track (size = trackCount)
+     * @param clipOffsetsMs    Timeline start of each clip (size = totalClips)
+     * @param clipLengthsMs    Length of each clip, 0 = unbounded (size = totalClips)
+     * @param clipEventCounts  Number of events per clip (size = totalClips)
+     * @param eventTicks       Tick of each event from its clip start (size = totalEvents)
      * @param eventChannels    MIDI channel of each event (size = totalEvents)
      * @param eventNotes       MIDI note of each event (size = totalEvents)
      * @param eventVelocities  Velocity of each event, 0 = noteOff (size = totalEvents)
@@ -269,18 +512,83 @@ class OboeAudioEngine @Inject constructor() {
         programs: IntArray,
         volumes: FloatArray,
         muted: BooleanArray,
-        trackEventCounts: IntArray,
-        eventFrames: LongArray,
+        trackClipCounts: IntArray,
+        clipOffsetsMs: LongArray,
+        clipLengthsMs: LongArray,
+        clipEventCounts: IntArray,
+        eventTicks: LongArray,
         eventChannels: IntArray,
         eventNotes: IntArray,
         eventVelocities: IntArray
-    ) = nativeUpdateMidiTracks(
-        channels, programs, volumes, muted, trackEventCounts,
-        eventFrames, eventChannels, eventNotes, eventVelocities
-    )
+    ) {
+        submit {
+            midiTracks(
+                channels, programs, volumes, muted, trackClipCounts,
+                clipOffsetsMs, clipLengthsMs, clipEventCounts,
+                eventTicks, eventChannels, eventNotes, eventVelocities
+            )
+        }
+    }
+
+    /**
+     * Replace a single MIDI track, addressed by its index in the last
+     * [updateMidiTracks] call. Other tracks keep their data and playback
+     * position, so this is the cheap path for edits confined to one track.
+     * Clip and event arrays are laid out as in [updateMidiTracks].
+     *
+     * @return false if [trackIndex] does not name a loaded track; callers
+     *         should fall back to [updateMidiTracks].
+     */
+    fun updateMidiTrack(
+        trackIndex: Int,
+        channel: Int,
+        program: Int,
+        volume: Float,
+        muted: Boolean,
+        clipOffsetsMs: LongArray,
+        clipLengthsMs: LongArray,
+        clipEventCounts: IntArray,
+        eventTicks: LongArray,
+        eventChannels: IntArray,
+        eventNotes: IntArray,
+        eventVelocities: IntArray
+    ): Boolean = submit {
+        midiTrack(
+            trackIndex, channel, program, volume, muted,
+            clipOffsetsMs, clipLengthsMs, clipEventCounts,
+            eventTicks, eventChannels, eventNotes, eventVelocities
+        )
+    }
 
-    fun setMidiSequencerEnabled(enabled: Boolean) =
-        nativeSetMidiSequencerEnabled(enabled)
+    /**
+     * Replace the clips of one MIDI track that start inside
+     * [startMs, endMs) (e.g. a single clip), leaving the rest of the track
+     * untouched. Clips given outside the range are ignored.
+     *
+     * @return false if [trackIndex] does not name a loaded track.
+     */
+    fun replaceMidiTrackRange(
+        trackIndex: Int,
+        startMs: Long,
+        endMs: Long,
+        clipOffsetsMs: LongArray,
+        clipLengthsMs: LongArray,
+        clipEventCounts: IntArray,
+        eventTicks: LongArray,
+        eventChannels: IntArray,
+        eventNotes: IntArray,
+        eventVelocities: IntArray
+    ): Boolean = submit {
+        midiTrackRange(
+            trackIndex, startMs, endMs,
+            clipOffsetsMs, clipLengthsMs, clipEventCounts,
+            eventTicks, eventChannels, eventNotes, eventVelocities
+        )
+    }
+
+    fun setMidiSequencerEnabled(enabled: Boolean) {
+        submit { midiSequencerEnabled(enabled) }
+    }
 
     // ── Count-in ──────────────────────────────────────────────────────────
 
@@ -300,7 +608,7 @@ class OboeAudioEngine @Inject constructor() {
         nativeSetMetronomeBeatsPerBar(beatsPerBar)
 
     /** Returns the frame of the last metronome beat event. Polled for LED pulse. */
-    fun getLastMetronomeBeatFrame(): Long = nativeGetLastMetronomeBeatFrame()
+    fun getLastMetronomeBeatFrame(): Long = readStatus().metronomeBeatFrame
 
     // ── Hardware latency measurement ──────────────────────────────────────
 
@@ -318,22 +626,162 @@ class OboeAudioEngine @Inject constructor() {
      */
     fun getInputLatencyMs(): Long = nativeGetInputLatencyMs()
 
+    // ── Offline export ────────────────────────────────────────────────────
+
+    /**
+     * Start a faster-than-realtime mixdown of the whole arrangement (audio
+     * tracks, drums, MIDI and optionally the metronome) to a stereo 16-bit
+     * WAV at [filePath]. Playback is paused first. Returns false if an
+     * export is already running or the timeline is empty.
+     */
+    fun startExport(filePath: String, includeMetronome: Boolean): Boolean {
+        val ok = nativeStartExport(filePath, includeMetronome)
+        Log.d(TAG, "startExport($filePath, metronome=$includeMetronome) -> $ok")
+        return ok
+    }
+
+    /** Cancel a running export. The partial file is deleted natively. */
+    fun cancelExport() = nativeCancelExport()
+
+    fun getExportState(): ExportState = ExportState.fromNative(nativeGetExportState())
+
+    /** Fraction of the timeline rendered by the current export, 0.0 - 1.0. */
+    fun getExportProgress(): Float = nativeGetExportProgress()
+
+    /**
+     * Run an export to completion, reporting progress as it goes.
+     * Cancelling the calling coroutine cancels the native export.
+     */
+    suspend fun exportMixdown(
+        filePath: String,
+        includeMetronome: Boolean,
+        onProgress: (Float) -> Unit = {}
+    ): ExportState = withContext(Dispatchers.IO) {
+        if (!startExport(filePath, includeMetronome)) return@withContext ExportState.FAILED
+        try {
+            var state = getExportState()
+            while (state == ExportState.RUNNING) {
+                onProgress(getExportProgress())
+                delay(EXPORT_POLL_INTERVAL_MS)
+                state = getExportState()
+            }
+            if (state == ExportState.COMPLETED) onProgress(1f)
+            Log.d(TAG, "exportMixdown($filePath) -> $state")
+            state
+        } finally {
+            if (getExportState() == ExportState.RUNNING) cancelExport()
+        }
+    }
+
+    // ── Track freeze ──────────────────────────────────────────────────────
+
+    /**
+     * Render one MIDI clip to a stereo WAV at [filePath] for a frozen
+     * track, alongside playback. Event ticks are relative to the clip
+     * start and rendered at the current tempo map; [lengthMs] is the clip
+     * length (the release tail is added natively). Cancelling the calling coroutine cancels the render.
+     */
+    suspend fun freezeMidiClip(
+        filePath: String, channel: Int, program: Int, volume: Float,
+        eventTicks: LongArray, eventChannels: IntArray,
+        eventNotes: IntArray, eventVelocities: IntArray, lengthMs: Long
+    ): ExportState = awaitFreeze(filePath) {
+        nativeStartMidiFreeze(
+            filePath, channel, program, volume,
+            eventTicks, eventChannels, eventNotes, eventVelocities, lengthMs
+        )
+    }
+
+    /** As [freezeMidiClip] for one drum clip at the current tempo. */
+    suspend fun freezeDrumClip(
+        filePath: String, volume: Float,
+        stepsPerBar: Int, totalSteps: Int, beatsPerBar: Int,
+        hitStepIndices: IntArray, hitDrumNotes: IntArray, hitVelocities: FloatArray
+    ): ExportState = awaitFreeze(filePath) {
+        nativeStartDrumFreeze(
+            filePath, volume, stepsPerBar, totalSteps, beatsPerBar,
+            hitStepIndices, hitDrumNotes, hitVelocities
+        )
+    }
+
+    /** Fraction of the clip rendered by the current freeze, 0.0 - 1.0. */
+    fun getFreezeProgress(): Float = nativeGetFreezeProgress()
+
+    private suspend fun awaitFreeze(
+        filePath: String,
+        start: () -> Boolean
+    ): ExportState = withContext(Dispatchers.IO) {
+        if (!start()) return@withContext ExportState.FAILED
+        try {
+            var state = ExportState.fromNative(nativeGetFreezeState())
+            while (state == ExportState.RUNNING) {
+                delay(EXPORT_POLL_INTERVAL_MS)
+                state = ExportState.fromNative(nativeGetFreezeState())
+            }
+            Log.d(TAG, "freeze($filePath) -> $state")
+            state
+        } finally {
+            if (ExportState.fromNative(nativeGetFreezeState()) == ExportState.RUNNING) {
+                nativeCancelFreeze()
+            }
+        }
+    }
+
+    // ── Telemetry ─────────────────────────────────────────────────────────
+
+    private val telemetryBuffer = LongArray(EngineTelemetry.FIELD_COUNT)
+
+    /**
+     * Read every real-time counter (callback timing, xruns, synth ring
+     * underruns, render cost, recording ring pressure) in one native call.
+     * Returns null if the engine is not initialized.
+     */
+    @Synchronized
+    fun getTelemetry(): EngineTelemetry? {
+        val n = nativeGetTelemetry(telemetryBuffer)
+        if (n < EngineTelemetry.FIELD_COUNT) return null
+        return EngineTelemetry.fromRaw(telemetryBuffer)
+    }
+
+    /** Zero the native counters to start a new aggregation window. */
+    fun resetTelemetry() = nativeResetTelemetry()
+
+    // ── Thread policy ─────────────────────────────────────────────────────
+
+    /**
+     * Tune how the engine schedules its own threads (synth render and
+     * workers, the recording writer). Takes effect before the next synth
+     * chunk; the writer picks it up with the next recording.
+     */
+    fun setThreadPolicy(policy: EngineThreadPolicy) = nativeSetThreadPolicy(
+        policy.realtimePriority, policy.performanceCores,
+        policy.performanceHint, policy.hintTargetPercent
+    )
+
     // ── Native method declarations ─────────────────────────────────────────
 
     private external fun nativeInit(): Boolean
     private external fun nativeShutdown()
     private external fun nativeIsInitialized(): Boolean
+    private external fun nativeGetSampleRate(): Int
 
     // Recording
-    private external fun nativeStartRecording(filePath: String): Boolean
+    private external fun nativeStartRecording(filePath: String, splitTakesAtLoop: Boolean): Boolean
+    private external fun nativeStartDuplexRecording(
+        filePath: String, splitTakesAtLoop: Boolean, startMs: Long
+    ): Boolean
+    private external fun nativeGetRecordedStartMs(): Long
+    private external fun nativeSetInputMonitoring(enabled: Boolean, gain: Float)
     private external fun nativeAwaitFirstBuffer(timeoutMs: Int): Boolean
     private external fun nativeOpenWriteGate()
     private external fun nativeStopRecording(): Long
     private external fun nativeIsRecordingActive(): Boolean
-    private external fun nativeGetLatestPeakAmplitude(): Float
+    private external fun nativeDrainInputEnvelope(out: FloatArray): Int
     private external fun nativeGetRecordedDurationMs(): Long
+    private external fun nativeGetRecordedTakePaths(): Array<String>
 
     // Playback
+    private external fun nativePrepareTrackFile(filePath: String): Boolean
     private external fun nativeAddTrack(
         trackId: Int, filePath: String, durationMs: Long,
         offsetMs: Long, trimStartMs: Long, trimEndMs: Long,
@@ -344,13 +792,16 @@ class OboeAudioEngine @Inject constructor() {
     private external fun nativePlay()
     private external fun nativePause()
     private external fun nativeSeekTo(positionMs: Long)
-    private external fun nativeIsPlaying(): Boolean
-    private external fun nativeGetPositionMs(): Long
-    private external fun nativeGetTotalDurationMs(): Long
 
-    // Per-track controls
-    private external fun nativeSetTrackVolume(trackId: Int, volume: Float)
-    private external fun nativeSetTrackMuted(trackId: Int, muted: Boolean)
+    // Command channel
+    private external fun nativeSubmitCommands(buffer: ByteBuffer, length: Int): Int
+
+    // Routing
+    private external fun nativeSetTrackBus(trackId: Int, busId: Int)
+
+    // Buses
+    private external fun nativeAddBus(busId: Int): Boolean
+    private external fun nativeRemoveBus(busId: Int)
 
     // Loop
     private external fun nativeSetLoopRegion(startMs: Long, endMs: Long)
@@ -359,16 +810,16 @@ class OboeAudioEngine @Inject constructor() {
     // Overdub
     private external fun nativeSetRecording(active: Boolean)
 
-    // Loop reset tracking
-    private external fun nativeGetLoopResetCount(): Long
-
     // Synth
-    private external fun nativeLoadSoundFont(path: String): Boolean
+    private external fun nativeLoadSoundFont(path: String, lazySamples: Boolean): Boolean
     private external fun nativeSynthNoteOn(channel: Int, note: Int, velocity: Int)
     private external fun nativeSynthNoteOff(channel: Int, note: Int)
     private external fun nativeSynthProgramChange(channel: Int, program: Int)
     private external fun nativeSynthRequestPreviewFlush()
     private external fun nativeSetSynthVolume(volume: Float)
+    private external fun nativeSetSynthLatencyProfile(profile: Int)
+    private external fun nativeGetSynthQualityTier(): Int
+    private external fun nativeGetSynthRenderLoad(): Float
     private external fun nativeSynthAllSoundsOff()
 
     // Drum sequencer
@@ -378,26 +829,6 @@ class OboeAudioEngine @Inject constructor() {
         stepIndices: IntArray, drumNotes: IntArray, velocities: FloatArray,
         clipOffsetsMs: LongArray, beatsPerBar: Int
     )
-    private external fun nativeUpdateDrumPatternClips(
-        volume: Float, muted: Boolean,
-        clipStepsPerBar: IntArray, clipTotalSteps: IntArray,
-        clipBeatsPerBar: IntArray, clipOffsetsMs: LongArray,
-        clipHitCounts: IntArray,
-        hitStepIndices: IntArray, hitDrumNotes: IntArray,
-        hitVelocities: FloatArray
-    )
-    private external fun nativeSetBpm(bpm: Double)
-    private external fun nativeSetDrumSequencerEnabled(enabled: Boolean)
-
-    // MIDI sequencer
-    private external fun nativeUpdateMidiTracks(
-        channels: IntArray, programs: IntArray,
-        volumes: FloatArray, muted: BooleanArray,
-        trackEventCounts: IntArray,
-        eventFrames: LongArray, eventChannels: IntArray,
-        eventNotes: IntArray, eventVelocities: IntArray
-    )
-    private external fun nativeSetMidiSequencerEnabled(enabled: Boolean)
 
     // Count-in
     private external fun nativeSetCountIn(bars: Int, beatsPerBar: Int)
@@ -406,17 +837,82 @@ class OboeAudioEngine @Inject constructor() {
     private external fun nativeSetMetronomeEnabled(enabled: Boolean)
     private external fun nativeSetMetronomeVolume(volume: Float)
     private external fun nativeSetMetronomeBeatsPerBar(beatsPerBar: Int)
-    private external fun nativeGetLastMetronomeBeatFrame(): Long
 
     // Hardware latency
     private external fun nativeGetOutputLatencyMs(): Long
     private external fun nativeGetInputLatencyMs(): Long
 
+    // Offline export
+    private external fun nativeStartExport(filePath: String, includeMetronome: Boolean): Boolean
+    private external fun nativeCancelExport()
+    private external fun nativeGetExportState(): Int
+    private external fun nativeGetExportProgress(): Float
+    private external fun nativeStartMidiFreeze(
+        filePath: String, channel: Int, program: Int, volume: Float,
+        eventTicks: LongArray, eventChannels: IntArray,
+        eventNotes: IntArray, eventVelocities: IntArray, lengthMs: Long
+    ): Boolean
+    private external fun nativeStartDrumFreeze(
+        filePath: String, volume: Float,
+        stepsPerBar: Int, totalSteps: Int, beatsPerBar: Int,
+        hitStepIndices: IntArray, hitDrumNotes: IntArray, hitVelocities: FloatArray
+    ): Boolean
+    private external fun nativeCancelFreeze()
+    private external fun nativeGetFreezeState(): Int
+    private external fun nativeGetFreezeProgress(): Float
+
+    // Telemetry
+    private external fun nativeGetTelemetry(out: LongArray): Int
+    private external fun nativeResetTelemetry()
+
+    // Thread policy
+    private external fun nativeSetThreadPolicy(
+        realtimePriority: Boolean, performanceCores: Boolean,
+        performanceHint: Boolean, hintTargetPercent: Int
+    )
+
+    // Status block
+    private external fun nativeGetStatusBuffer(): ByteBuffer?
+
     companion object {
         private const val TAG = "OboeAudioEngine"
+        private const val EXPORT_POLL_INTERVAL_MS = 50L
+        private const val ENVELOPE_DRAIN_POINTS = 512
+
+        /** Input frames per live envelope point (mirrors `kEnvelopeWindowFrames`). */
+        const val ENVELOPE_WINDOW_FRAMES = 512
+
+        /** Bus id of the master bus (mirrors `kMasterBus`). */
+        const val MASTER_BUS = 0
+
+        /** Musical time resolution of the tempo map (mirrors `kTicksPerBeat`). */
+        const val TICKS_PER_BEAT = 960
 
         init {
             System.loadLibrary("nightjar-audio")
         }
     }
 }
+
+/** State of a native offline export. Ordinals mirror `OfflineRenderState`. */
+enum class ExportState {
+    IDLE, RUNNING, COMPLETED, FAILED, CANCELLED;
+
+    companion object {
+        fun fromNative(value: Int): ExportState = entries.getOrElse(value) { FAILED }
+    }
+}
+
+/** Synth render-ahead profile. Ordinals mirror `SynthLatencyProfile`. */
+enum class SynthLatencyProfile {
+    PLAY, LIVE_INPUT
+}
+
+/** Synth rendering quality. Ordinals mirror `SynthQualityTier`. */
+enum class SynthQualityTier {
+    FULL, REDUCED, LOW, MINIMAL;
+
+    companion object {
+        fun fromNative(value: Int): SynthQualityTier = entries.getOrElse(value) { FULL }
+    }
+}
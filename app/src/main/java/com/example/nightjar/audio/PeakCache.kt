@@ -0,0 +1,44 @@
+package com.example.nightjar.audio
+
+import java.io.File
+
+/**
+ * The [PeakCache] sidecar for [takeFile]. Delete it together with the take.
+ * Top-level so callers that only manage files don't load the native library.
+ */
+fun peakSidecarFor(takeFile: File): File = File(takeFile.path + ".peaks")
+
+/**
+ * Native waveform peak cache for recorded takes (WAV or `.njca`).
+ *
+ * The recorder writes a min/max peak pyramid next to every take
+ * (`take.wav.peaks`) as it records; older, split or compressed files get
+ * one built on first read. Reading any zoom level or range is then a
+ * small mmap lookup instead of a full MediaCodec decode.
+ */
+object PeakCache {
+
+    init {
+        System.loadLibrary("nightjar-audio")
+    }
+
+    /**
+     * Absolute peaks (0f..1f, not normalised) for [bars] equal slices of
+     * the frame range [startFrame, endFrame) of [takeFile]; [endFrame] < 0
+     * means the end of the file. Returns null if [takeFile] is not a mono
+     * 16-bit WAV or compressed take, or the cache cannot be built.
+     *
+     * Blocking; call from [kotlinx.coroutines.Dispatchers.IO].
+     */
+    fun readBars(takeFile: File, bars: Int, startFrame: Long = 0L, endFrame: Long = -1L): FloatArray? {
+        if (bars <= 0) return null
+        if (!takeFile.name.endsWith(".wav", ignoreCase = true) && !isCompressedTake(takeFile)) {
+            return null
+        }
+        return nativeReadBars(takeFile.absolutePath, startFrame, endFrame, bars)
+    }
+
+    private external fun nativeReadBars(
+        takePath: String, startFrame: Long, endFrame: Long, bars: Int
+    ): FloatArray?
+}
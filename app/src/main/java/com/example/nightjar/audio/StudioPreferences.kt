@@ -22,8 +22,14 @@ class StudioPreferences @Inject constructor(
         get() = prefs.getBoolean(KEY_RETURN_TO_CURSOR, true)
         set(value) = prefs.edit().putBoolean(KEY_RETURN_TO_CURSOR, value).apply()
 
+    /** Hear the mic through the mix while recording (headphones). */
+    var inputMonitoring: Boolean
+        get() = prefs.getBoolean(KEY_INPUT_MONITORING, false)
+        set(value) = prefs.edit().putBoolean(KEY_INPUT_MONITORING, value).apply()
+
     companion object {
         private const val PREFS_NAME = "nightjar_studio"
         private const val KEY_RETURN_TO_CURSOR = "return_to_cursor"
+        private const val KEY_INPUT_MONITORING = "input_monitoring"
     }
 }
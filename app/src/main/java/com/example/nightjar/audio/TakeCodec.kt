@@ -0,0 +1,44 @@
+package com.example.nightjar.audio
+
+import java.io.File
+
+/** Extension of takes stored as Nightjar compressed audio. */
+const val COMPRESSED_TAKE_EXTENSION = "njca"
+
+/**
+ * True if [file] is a compressed take. Top-level so callers that only
+ * manage files don't load the native library.
+ */
+fun isCompressedTake(file: File): Boolean =
+    file.extension.equals(COMPRESSED_TAKE_EXTENSION, ignoreCase = true)
+
+/**
+ * Native conversion between WAV takes and Nightjar compressed audio
+ * (`.njca`): lossless, block-coded 16-bit mono PCM that the engine plays
+ * directly. Recorded takes are WAV; [compress] shrinks them once they
+ * are finished, and [expand] turns one back into a WAV for other apps.
+ *
+ * Both write via a temp file + rename, so a failed conversion leaves no
+ * partial output. Blocking; call from [kotlinx.coroutines.Dispatchers.IO].
+ */
+object TakeCodec {
+
+    init {
+        System.loadLibrary("nightjar-audio")
+    }
+
+    /**
+     * Encode the 16-bit mono WAV [wavFile] to [outFile]. The WAV's peaks
+     * sidecar, if current, is copied for [outFile] so its waveform isn't
+     * rebuilt.
+     */
+    fun compress(wavFile: File, outFile: File): Boolean =
+        nativeCompress(wavFile.absolutePath, outFile.absolutePath)
+
+    /** Decode the compressed take [takeFile] to the WAV [outFile]. */
+    fun expand(takeFile: File, outFile: File): Boolean =
+        nativeExpand(takeFile.absolutePath, outFile.absolutePath)
+
+    private external fun nativeCompress(wavPath: String, outPath: String): Boolean
+    private external fun nativeExpand(takePath: String, outPath: String): Boolean
+}
@@ -18,8 +18,12 @@ private const val CODEC_TIMEOUT_US = 5_000L
 private const val INT16_MAX_F = 32768f
 
 /**
- * Decodes an audio file to PCM and returns a normalized amplitude list
- * suitable for waveform rendering.  Runs entirely on [Dispatchers.IO].
+ * Returns a normalized amplitude list suitable for waveform rendering.
+ * Runs entirely on [Dispatchers.IO].
+ *
+ * WAV and compressed (`.njca`) takes are served from the native
+ * [PeakCache] (built during recording); anything else, or a WAV the
+ * cache can't read, is decoded to PCM through MediaCodec.
  *
  * @param file   The audio file (M4A/AAC or any format supported by MediaCodec).
  * @param bars   The desired number of amplitude bars in the output.
@@ -30,6 +34,8 @@ suspend fun extractWaveform(file: File, bars: Int = 120): FloatArray =
     withContext(Dispatchers.IO) {
         if (!file.exists() || bars <= 0) return@withContext FloatArray(0)
 
+        readCachedPeaks(file, bars)?.let { return@withContext normalize(it) }
+
         val extractor = MediaExtractor()
         try {
             extractor.setDataSource(file.absolutePath)
@@ -45,6 +51,14 @@ suspend fun extractWaveform(file: File, bars: Int = 120): FloatArray =
         }
     }
 
+private fun readCachedPeaks(file: File, bars: Int): FloatArray? =
+    try {
+        PeakCache.readBars(file, bars)
+    } catch (_: LinkageError) {
+        // Native library unavailable (e.g. JVM unit tests).
+        null
+    }
+
 private fun selectAudioTrack(extractor: MediaExtractor): Pair<Int, MediaFormat>? {
     for (i in 0 until extractor.trackCount) {
         val fmt = extractor.getTrackFormat(i)
@@ -162,13 +176,16 @@ private fun bucketize(peaks: List<Float>, bars: Int): FloatArray {
         result[i] = max
     }
 
-    // Normalize to 0..1 so quiet recordings still look decent.
-    val globalMax = result.max()
+    return normalize(result)
+}
+
+/** Scales [amps] in place so the loudest bar = 1f, so quiet recordings still look decent. */
+private fun normalize(amps: FloatArray): FloatArray {
+    val globalMax = amps.maxOrNull() ?: return amps
     if (globalMax > 0f) {
-        for (i in result.indices) result[i] = result[i] / globalMax
+        for (i in amps.indices) amps[i] = amps[i] / globalMax
     }
-
-    return result
+    return amps
 }
 
 /**
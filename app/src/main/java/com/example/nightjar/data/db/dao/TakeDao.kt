@@ -46,6 +46,10 @@ interface TakeDao {
     @Query("DELETE FROM takes WHERE id = :id")
     suspend fun deleteTakeById(id: Long)
 
+    /** Point every take that plays [oldName] at [newName]. Used when a take is compacted. */
+    @Query("UPDATE takes SET audioFileName = :newName WHERE audioFileName = :oldName")
+    suspend fun renameAudioFile(oldName: String, newName: String)
+
     /** Re-parent every take from [oldClipId] to [newClipId]. Used during source promotion. */
     @Query("UPDATE takes SET clipId = :newClipId WHERE clipId = :oldClipId")
     suspend fun repointTakes(oldClipId: Long, newClipId: Long)
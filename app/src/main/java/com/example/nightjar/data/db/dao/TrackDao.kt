@@ -36,6 +36,13 @@ interface TrackDao {
     @Query("UPDATE tracks SET midiChannel = :channel WHERE id = :id")
     suspend fun updateMidiChannel(id: Long, channel: Int)
 
+    @Query("UPDATE tracks SET isFrozen = :frozen WHERE id = :id")
+    suspend fun updateFrozen(id: Long, frozen: Boolean)
+
+    /** Point every track that names [oldName] at [newName]. Used when a take is compacted. */
+    @Query("UPDATE tracks SET audioFileName = :newName WHERE audioFileName = :oldName")
+    suspend fun renameAudioFile(oldName: String, newName: String)
+
     @Query("DELETE FROM tracks WHERE id = :id")
     suspend fun deleteTrackById(id: Long)
 
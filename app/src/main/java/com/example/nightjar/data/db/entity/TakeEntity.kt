@@ -14,7 +14,8 @@ import androidx.room.PrimaryKey
  * that can be activated by the user.
  *
  * @property clipId        Foreign key to the parent [AudioClipEntity].
- * @property audioFileName Filename of the WAV audio file in the recordings directory.
+ * @property audioFileName Filename of the audio file (WAV, or `.njca` once compacted)
+ *                         in the recordings directory.
  * @property displayName   User-visible label (e.g. "Take 1", "Take 2").
  * @property sortIndex     Ordering within the clip (0 = first take).
  * @property durationMs    Total duration of the underlying audio file.
@@ -22,8 +22,8 @@ import androidx.room.PrimaryKey
  *
  * @property ideaId        Foreign key to the parent [IdeaEntity].
  * @property trackType     Track type: "audio", "drum", or "midi".
- * @property audioFileName Filename of the audio file (WAV) in the recordings directory.
- *                         Null for drum and MIDI tracks.
+ * @property audioFileName Filename of the audio file (WAV, or `.njca` once compacted)
+ *                         in the recordings directory. Null for drum and MIDI tracks.
  * @property displayName   User-visible label shown in the timeline header (e.g. "Track 1").
  * @property sortIndex     Vertical ordering in the timeline (0 = topmost).
  * @property offsetMs      Horizontal offset on the timeline.
@@ -35,7 +35,11 @@ import androidx.room.PrimaryKey
  * @property isMuted       When true, this track is silenced during playback.
  * @property volume        Playback volume multiplier (0.0-1.0).
  * @property midiProgram   General MIDI program number (0-127) for MIDI tracks.
- * @property midiChannel   MIDI channel (0-15) for FluidSynth routing. Channel 9 = drums (reserved).
+ * @property midiChannel   Logical MIDI channel (0-255); the engine maps it to a synth channel.
+ *                         Channel 9 = drums, 15 = preview (both reserved).
+ * @property isFrozen      MIDI and drum tracks only: play from rendered audio instead of
+ *                         synthesizing live. The renders are a cache, rebuilt when the
+ *                         track's content changes.
  */
 @Entity(
     tableName = "tracks",
@@ -62,6 +66,7 @@ data class TrackEntity(
     val volume: Float = 1.0f,
     val midiProgram: Int = 0,
     val midiChannel: Int = 0,
+    val isFrozen: Boolean = false,
     val createdAtEpochMs: Long = System.currentTimeMillis()
 ) {
     val isAudio: Boolean get() = trackType == "audio"
@@ -1,6 +1,8 @@
 package com.example.nightjar.data.repository
 
 import androidx.room.withTransaction
+import com.example.nightjar.audio.TakeCodec
+import com.example.nightjar.audio.isCompressedTake
 import com.example.nightjar.data.db.IdeaTagCrossRef
 import com.example.nightjar.data.db.NightjarDatabase
 import com.example.nightjar.data.db.dao.IdeaDao
@@ -10,7 +12,9 @@ import com.example.nightjar.data.db.entity.IdeaEntity
 import com.example.nightjar.data.db.entity.TagEntity
 import com.example.nightjar.data.db.entity.TrackEntity
 import com.example.nightjar.data.storage.RecordingStorage
+import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.withContext
 import java.io.File
 import java.text.SimpleDateFormat
 import java.util.Date
@@ -153,12 +157,19 @@ class IdeaRepository(
 
     /**
      * Returns the audio file for the first track (by sort index) of the given idea,
-     * or null if the idea has no tracks.
+     * or null if the idea has no tracks. A compressed take is handed out as a
+     * WAV copy, since it is meant for other apps.
      */
     suspend fun getFirstTrackFile(ideaId: Long): File? {
         val tracks = trackDao.getTracksForIdea(ideaId)
         val first = tracks.filter { it.isAudio }.minByOrNull { it.sortIndex } ?: return null
-        return first.audioFileName?.let { storage.getAudioFile(it) }
+        val file = first.audioFileName?.let { storage.getAudioFile(it) } ?: return null
+        if (!isCompressedTake(file)) return file
+        return withContext(Dispatchers.IO) {
+            val copy = storage.getShareFile(file.name)
+            val fresh = copy.exists() && copy.lastModified() >= file.lastModified()
+            if (fresh || TakeCodec.expand(file, copy)) copy else null
+        }
     }
 
     /** Returns all audio tracks for the given idea, sorted by sort index. */
@@ -355,10 +355,17 @@ class MidiRepository(
     /** Reserved MIDI channels: 9 = drums, 15 = preview. */
     private val reservedChannels = setOf(9, 15)
 
+    /**
+     * Logical channels the engine accepts. They are not synth channels:
+     * the engine binds each to one of its synths' channels while the
+     * track can sound, so a project may hold far more than 16 tracks.
+     */
+    private val logicalChannelCount = 256
+
     /**
      * Find the next available MIDI channel for a new track in this idea.
      * Scans existing MIDI tracks and skips reserved channels.
-     * Returns channel 0 with a warning if all 14 slots are used.
+     * Returns channel 0 if every logical channel is used.
      */
     suspend fun nextAvailableChannel(ideaId: Long): Int {
         val tracks = trackDao.getTracksForIdea(ideaId)
@@ -367,10 +374,10 @@ class MidiRepository(
             .map { it.midiChannel }
             .toSet()
 
-        for (ch in 0..15) {
+        for (ch in 0 until logicalChannelCount) {
             if (ch !in reservedChannels && ch !in usedChannels) return ch
         }
-        // All 14 slots used -- reuse channel 0
+        // Every slot used -- reuse channel 0
         return 0
     }
 
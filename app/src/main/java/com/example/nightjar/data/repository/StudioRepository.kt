@@ -2,6 +2,8 @@ package com.example.nightjar.data.repository
 
 import android.media.MediaMetadataRetriever
 import androidx.room.withTransaction
+import com.example.nightjar.audio.TakeCodec
+import com.example.nightjar.audio.isCompressedTake
 import com.example.nightjar.data.db.NightjarDatabase
 import com.example.nightjar.data.db.dao.AudioClipDao
 import com.example.nightjar.data.db.dao.TakeDao
@@ -13,6 +15,12 @@ import com.example.nightjar.data.events.PulseBus
 import com.example.nightjar.data.storage.RecordingStorage
 import com.example.nightjar.ui.studio.ClipLinkage
 import com.example.nightjar.ui.studio.GroupKey
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.launch
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.withContext
 import java.io.File
 
 /**
@@ -34,20 +42,30 @@ class StudioRepository(
     private val takeDao: TakeDao,
     private val storage: RecordingStorage,
     private val database: NightjarDatabase,
-    private val pulseBus: PulseBus
+    private val pulseBus: PulseBus,
+    private val backgroundScope: CoroutineScope
 ) {
 
+    /** Serializes [compactTakes] passes, so two opens don't compress the same take. */
+    private val compactionMutex = Mutex()
+
+    /** Ideas compacted since the process started; guarded by [compactionMutex]. */
+    private val compactedIdeas = mutableSetOf<Long>()
+
     // ── Project lifecycle ───────────────────────────────────────────────
 
     /**
      * Returns existing tracks for the idea, fixing up any zero-duration
-     * tracks left behind by the v3->v4 migration.
+     * tracks left behind by the v3->v4 migration, and starts compacting
+     * its WAV takes in the background (see [compactTakes]); the tracks
+     * returned don't wait for it.
      */
     suspend fun ensureProjectInitialized(ideaId: Long): List<TrackEntity> {
         val existing = trackDao.getTracksForIdea(ideaId)
         if (existing.isEmpty()) return emptyList()
 
-        // Fix up tracks with unknown duration (from v3->v4 migration)
+        // Fix up tracks with unknown duration (from v3->v4 migration).
+        // Before compaction: the duration is read from the WAV header.
         var needsRefresh = false
         for (track in existing) {
             if (track.durationMs == 0L && track.audioFileName != null) {
@@ -59,9 +77,60 @@ class StudioRepository(
                 }
             }
         }
+        backgroundScope.launch { compactionMutex.withLock { compactTakes(ideaId, existing) } }
         return if (needsRefresh) trackDao.getTracksForIdea(ideaId) else existing
     }
 
+    /**
+     * Compress every WAV take of [tracks] to `.njca` ([TakeCodec]) and
+     * point the takes and tracks that play it at the compressed file.
+     * Takes are recorded as WAV and compacted after their project opens.
+     *
+     * Screens that loaded the project may still hold the WAV names, so
+     * the WAVs are only deleted by the idea's first pass in a later
+     * process, when no screen can, and only if nothing refers to them
+     * any more. A take that doesn't compress (e.g. a stereo import) is
+     * marked and stays a WAV without being tried again.
+     */
+    private suspend fun compactTakes(ideaId: Long, tracks: List<TrackEntity>) {
+        val audioTracks = tracks.filter { it.isAudio }
+        if (audioTracks.isEmpty()) return
+        val clipIds = audioClipDao.getClipsForTracks(audioTracks.map { it.id }).map { it.id }
+        val takeNames = if (clipIds.isEmpty()) emptyList()
+            else takeDao.getTakesForClips(clipIds).map { it.audioFileName }
+        val names = (takeNames + audioTracks.mapNotNull { it.audioFileName }).toSet()
+
+        if (compactedIdeas.add(ideaId)) {
+            // WAVs compacted in an earlier process that nothing plays now
+            withContext(Dispatchers.IO) {
+                for (name in names) {
+                    if (!isCompressedTake(File(name))) continue
+                    val wavName = "${File(name).nameWithoutExtension}.wav"
+                    if (wavName !in names && storage.getAudioFile(wavName).exists()) {
+                        storage.deleteCompactedWav(wavName)
+                    }
+                }
+            }
+        }
+
+        val wavNames = names.filter { it.endsWith(".wav", ignoreCase = true) }
+        for (wavName in wavNames) {
+            val wav = storage.getAudioFile(wavName)
+            val compressed = storage.getCompressedFile(wavName)
+            val ok = withContext(Dispatchers.IO) {
+                if (!wav.exists() || storage.isMarkedUncompressible(wavName)) return@withContext false
+                TakeCodec.compress(wav, compressed).also { compressedOk ->
+                    if (!compressedOk) storage.markUncompressible(wavName)
+                }
+            }
+            if (!ok) continue
+            database.withTransaction {
+                takeDao.renameAudioFile(wavName, compressed.name)
+                trackDao.renameAudioFile(wavName, compressed.name)
+            }
+        }
+    }
+
     // ── Track CRUD ────────────────────────────────────────────────────────
 
     /**
@@ -183,6 +252,10 @@ class StudioRepository(
         trackDao.updateVolume(trackId, volume)
     }
 
+    suspend fun setTrackFrozen(trackId: Long, frozen: Boolean) {
+        trackDao.updateFrozen(trackId, frozen)
+    }
+
     // ── Reads ────────────────────────────────────────────────────────────
 
     suspend fun getTracks(ideaId: Long): List<TrackEntity> =
@@ -1,6 +1,9 @@
 package com.example.nightjar.data.storage
 
 import android.content.Context
+import com.example.nightjar.audio.COMPRESSED_TAKE_EXTENSION
+import com.example.nightjar.audio.isCompressedTake
+import com.example.nightjar.audio.peakSidecarFor
 import java.io.File
 import java.text.SimpleDateFormat
 import java.util.Date
@@ -10,13 +13,23 @@ import java.util.Locale
  * Abstraction over the app-private file system for audio recordings.
  *
  * All audio files are stored in a single `recordings/` directory under
- * [Context.getFilesDir].
+ * [Context.getFilesDir]. Takes are recorded as WAV and compacted to
+ * `.njca` next to it (same name, other extension). Renders of frozen
+ * tracks and WAV copies made for sharing are derived data and live in
+ * [Context.getCacheDir], where the system may reclaim them; a missing
+ * file is simply made again.
  */
 class RecordingStorage(private val context: Context) {
 
     private fun recordingsDir(): File =
         File(context.filesDir, "recordings").apply { mkdirs() }
 
+    private fun freezeDir(): File =
+        File(context.cacheDir, "freeze").apply { mkdirs() }
+
+    private fun shareDir(): File =
+        File(context.cacheDir, "share").apply { mkdirs() }
+
     fun createRecordingFile(prefix: String = "nightjar", extension: String = "wav"): File {
         val ts = SimpleDateFormat("yyyyMMdd_HHmmss", Locale.US).format(Date())
         return File(recordingsDir(), "${prefix}_${ts}.${extension}")
@@ -25,8 +38,58 @@ class RecordingStorage(private val context: Context) {
     fun getAudioFile(fileName: String): File =
         File(recordingsDir(), fileName)
 
+    /** Render of a frozen clip, named by its content key (see `FreezeKeys`). */
+    fun getFreezeFile(contentKey: String): File =
+        File(freezeDir(), "$contentKey.wav")
+
+    /** Where the compacted form of the take [fileName] goes (`take.njca`). */
+    fun getCompressedFile(fileName: String): File =
+        File(recordingsDir(), "${File(fileName).nameWithoutExtension}.$COMPRESSED_TAKE_EXTENSION")
+
+    /** WAV copy of the compressed take [fileName], for the share sheet. */
+    fun getShareFile(fileName: String): File =
+        File(shareDir(), "${File(fileName).nameWithoutExtension}.wav")
+
+    /**
+     * Delete a take with its derived files. The other form of the take
+     * (the WAV of a `.njca`, or the reverse) goes too, in case compaction
+     * was interrupted between writing one and removing the other.
+     */
     fun deleteAudioFile(fileName: String) {
         val f = getAudioFile(fileName)
+        deleteWithDerived(f)
+        deleteWithDerived(
+            if (isCompressedTake(f)) File(recordingsDir(), "${f.nameWithoutExtension}.wav")
+            else getCompressedFile(fileName)
+        )
+        getShareFile(fileName).delete()
+    }
+
+    /**
+     * Delete the WAV [wavName] was compacted from, with its derived files;
+     * the `.njca` stays, with the peaks sidecar compaction gave it.
+     */
+    fun deleteCompactedWav(wavName: String) {
+        deleteWithDerived(getAudioFile(wavName))
+    }
+
+    /** Record that the take [wavName] can't be compacted, so it isn't tried again. */
+    fun markUncompressible(wavName: String) {
+        uncompressibleMarkerFor(getAudioFile(wavName)).createNewFile()
+    }
+
+    fun isMarkedUncompressible(wavName: String): Boolean =
+        uncompressibleMarkerFor(getAudioFile(wavName)).exists()
+
+    private fun uncompressibleMarkerFor(f: File): File = File(f.parentFile, "${f.name}.nocompact")
+
+    private fun deleteWithDerived(f: File) {
         if (f.exists()) f.delete()
+        peakSidecarFor(f).delete()
+        uncompressibleMarkerFor(f).delete()
+        // Copies the engine converted to the device rate (`<name>.48000hz.wav`).
+        recordingsDir().listFiles { file ->
+            file.name.startsWith("${f.name}.") && file.name.endsWith("hz.wav")
+        }?.forEach { it.delete() }
     }
 }
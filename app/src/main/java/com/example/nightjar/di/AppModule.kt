@@ -21,8 +21,17 @@ import dagger.Provides
 import dagger.hilt.InstallIn
 import dagger.hilt.android.qualifiers.ApplicationContext
 import dagger.hilt.components.SingletonComponent
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import javax.inject.Qualifier
 import javax.inject.Singleton
 
+/** Qualifies the app-wide [CoroutineScope]. */
+@Qualifier
+@Retention(AnnotationRetention.BINARY)
+annotation class ApplicationScope
+
 /** Hilt module providing database, DAOs, repositories, and audio infrastructure. */
 @Module
 @InstallIn(SingletonComponent::class)
@@ -39,6 +48,13 @@ abstract class AppModule {
         @Provides
         fun provideTagDao(db: NightjarDatabase): TagDao = db.tagDao()
 
+        /** Scope for work that outlives the screen that started it. */
+        @Provides
+        @Singleton
+        @ApplicationScope
+        fun provideApplicationScope(): CoroutineScope =
+            CoroutineScope(SupervisorJob() + Dispatchers.IO)
+
         @Provides
         fun provideRecordingStorage(@ApplicationContext context: Context): RecordingStorage =
             RecordingStorage(context)
@@ -70,9 +86,10 @@ abstract class AppModule {
             takeDao: TakeDao,
             storage: RecordingStorage,
             database: NightjarDatabase,
-            pulseBus: PulseBus
+            pulseBus: PulseBus,
+            @ApplicationScope backgroundScope: CoroutineScope
         ): StudioRepository = StudioRepository(
-            trackDao, audioClipDao, takeDao, storage, database, pulseBus
+            trackDao, audioClipDao, takeDao, storage, database, pulseBus, backgroundScope
         )
 
         @Provides
@@ -150,10 +150,15 @@ class LibraryViewModel @Inject constructor(
                     return@launch
                 }
 
-                // Load active audio clips into the native engine
+                // Load active audio clips into the native engine, each take
+                // converted to the engine rate first if it needs it
+                val files = slots.map { repo.getAudioFile(it.audioFileName) }
+                for (file in files.distinct()) {
+                    if (file.exists()) audioEngine.prepareTrackFile(file.absolutePath)
+                }
                 audioEngine.removeAllTracks()
                 for ((index, slot) in slots.withIndex()) {
-                    val file = repo.getAudioFile(slot.audioFileName)
+                    val file = files[index]
                     if (!file.exists()) continue
                     audioEngine.addTrack(
                         trackId = index,
@@ -170,10 +170,14 @@ class OverviewViewModel @Inject constructor(
     }
 
     private suspend fun loadTracksIntoEngine(ideaId: Long) {
-        audioEngine.removeAllTracks()
         val slots = studioRepo.getActiveAudioSlotsForIdea(ideaId)
+        val files = slots.map { getAudioFile(it.audioFileName) }
+        for (file in files.distinct()) {
+            if (file.exists()) audioEngine.prepareTrackFile(file.absolutePath)
+        }
+        audioEngine.removeAllTracks()
         for ((index, slot) in slots.withIndex()) {
-            val file = getAudioFile(slot.audioFileName)
+            val file = files[index]
             if (!file.exists()) continue
             audioEngine.addTrack(
                 trackId = index,
@@ -181,8 +181,9 @@ class RecordViewModel @Inject constructor(
         amplitudeTickJob?.cancel()
         amplitudeTickJob = viewModelScope.launch {
             while (isActive) {
-                val peak = audioEngine.getLatestPeakAmplitude()
-                amplitudeBuffer.add(peak)
+                audioEngine.drainInputEnvelope { min, max, _ ->
+                    amplitudeBuffer.add(maxOf(-min, max))
+                }
                 _state.value = _state.value.copy(
                     liveAmplitudes = amplitudeBuffer.toFloatArray()
                 )
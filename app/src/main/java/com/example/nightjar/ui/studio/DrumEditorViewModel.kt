@@ -276,25 +276,15 @@ class DrumEditorViewModel @Inject constructor(
         val clips = st.clips
         if (clips.isEmpty()) return
 
-        val clipStepsPerBar = IntArray(clips.size)
-        val clipTotalSteps = IntArray(clips.size)
-        val clipBeatsPerBar = IntArray(clips.size)
-        val clipOffsetsMs = LongArray(clips.size)
-        val clipHitCounts = IntArray(clips.size)
+        // Linked clips share a pattern: send each pattern's hits once
+        val patterns = clips.distinctBy { it.patternId }
+        val patternIndex = patterns.withIndex().associate { (i, clip) -> clip.patternId to i }
 
         val allStepIndices = mutableListOf<Int>()
         val allDrumNotes = mutableListOf<Int>()
         val allVelocities = mutableListOf<Float>()
-
-        for (i in clips.indices) {
-            val clip = clips[i]
-            clipStepsPerBar[i] = clip.stepsPerBar
-            clipTotalSteps[i] = clip.lengthSteps
-            clipBeatsPerBar[i] = st.timeSignatureNumerator
-            clipOffsetsMs[i] = clip.offsetMs
-            clipHitCounts[i] = clip.steps.size
-
-            for (step in clip.steps) {
+        for (pattern in patterns) {
+            for (step in pattern.steps) {
                 allStepIndices.add(step.stepIndex)
                 allDrumNotes.add(step.drumNote)
                 allVelocities.add(step.velocity)
@@ -304,14 +294,15 @@ class DrumEditorViewModel @Inject constructor(
         audioEngine.updateDrumPatternClips(
             volume = st.trackVolume,
             muted = st.trackMuted,
-            clipStepsPerBar = clipStepsPerBar,
-            clipTotalSteps = clipTotalSteps,
-            clipBeatsPerBar = clipBeatsPerBar,
-            clipOffsetsMs = clipOffsetsMs,
-            clipHitCounts = clipHitCounts,
+            patternStepsPerBar = IntArray(patterns.size) { patterns[it].stepsPerBar },
+            patternTotalSteps = IntArray(patterns.size) { patterns[it].lengthSteps },
+            patternBeatsPerBar = IntArray(patterns.size) { st.timeSignatureNumerator },
+            patternHitCounts = IntArray(patterns.size) { patterns[it].steps.size },
             hitStepIndices = allStepIndices.toIntArray(),
             hitDrumNotes = allDrumNotes.toIntArray(),
-            hitVelocities = allVelocities.toFloatArray()
+            hitVelocities = allVelocities.toFloatArray(),
+            clipPatterns = IntArray(clips.size) { patternIndex.getValue(clips[it].patternId) },
+            clipOffsetsMs = LongArray(clips.size) { clips[it].offsetMs }
         )
     }
 
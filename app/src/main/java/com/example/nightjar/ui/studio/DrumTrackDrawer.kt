@@ -29,6 +29,7 @@ import com.example.nightjar.ui.theme.NjError
 import com.example.nightjar.ui.theme.NjMuted2
 import com.example.nightjar.ui.theme.NjAmber
 import com.example.nightjar.ui.theme.NjSurface2
+import com.example.nightjar.ui.theme.NjLedGreen
 import com.example.nightjar.ui.theme.NjLedTeal
 import com.example.nightjar.ui.theme.NjLedYellow
 
@@ -112,6 +113,14 @@ fun DrumTrackDrawer(
                                 onAction(StudioAction.SetTrackMuted(track.id, !track.isMuted))
                             }
                         )
+                        DrawerToggleButton(
+                            label = "Frz",
+                            isActive = track.isFrozen,
+                            ledColor = NjLedGreen,
+                            onClick = {
+                                onAction(StudioAction.SetTrackFrozen(track.id, !track.isFrozen))
+                            }
+                        )
                     }
 
                     if (pattern != null) {
@@ -283,6 +292,14 @@ fun DrumTrackDrawer(
                                 onAction(StudioAction.SetTrackMuted(track.id, !track.isMuted))
                             }
                         )
+                        DrawerToggleButton(
+                            label = "Frz",
+                            isActive = track.isFrozen,
+                            ledColor = NjLedGreen,
+                            onClick = {
+                                onAction(StudioAction.SetTrackFrozen(track.id, !track.isFrozen))
+                            }
+                        )
                     }
 
                     Spacer(Modifier.width(12.dp))
@@ -0,0 +1,52 @@
+package com.example.nightjar.ui.studio
+
+import java.security.MessageDigest
+
+/**
+ * Cache keys and mixer slot ids for frozen clips.
+ *
+ * A frozen clip's render is stored under a key hashed from everything
+ * that changes how it sounds -- its notes or steps, length, instrument,
+ * track volume, tempo for drums, and the engine sample rate -- and
+ * nothing that doesn't, such as where the clip sits on the timeline.
+ * Linked siblings therefore share one key and one render, and any edit
+ * to a clip's content moves it to a new key, which is what invalidates
+ * a stale render.
+ */
+object FreezeKeys {
+
+    /** Bump when the render itself changes, to orphan every old file. */
+    private const val FORMAT_VERSION = 1
+
+    fun midi(clip: MidiClipUiState, program: Int, volume: Float, sampleRate: Int): String =
+        hash(buildString {
+            append("midi:$FORMAT_VERSION:$sampleRate:$program:$volume:${clip.effectiveLengthMs}")
+            for (note in clip.notes.sortedWith(compareBy({ it.startMs }, { it.pitch }))) {
+                append(";${note.pitch},${note.startMs},${note.durationMs},${note.velocity}")
+            }
+        })
+
+    fun drum(
+        clip: DrumClipUiState, volume: Float, bpm: Double, beatsPerBar: Int, sampleRate: Int
+    ): String = hash(buildString {
+        append("drum:$FORMAT_VERSION:$sampleRate:$volume:$bpm:$beatsPerBar")
+        append(":${clip.stepsPerBar}:${clip.lengthSteps}")
+        for (step in clip.steps.sortedWith(compareBy({ it.stepIndex }, { it.drumNote }))) {
+            append(";${step.stepIndex},${step.drumNote},${step.velocity}")
+        }
+    })
+
+    /**
+     * Mixer slot id of a frozen MIDI clip. Negative so it never collides
+     * with an audio clip's slot (its positive clip id); MIDI and drum
+     * clips come from separate tables, so they take alternate values.
+     */
+    fun midiSlotId(clipId: Long): Int = (-2 * clipId).toInt()
+
+    fun drumSlotId(clipId: Long): Int = (-2 * clipId - 1).toInt()
+
+    private fun hash(content: String): String =
+        MessageDigest.getInstance("SHA-1")
+            .digest(content.toByteArray())
+            .joinToString("") { "%02x".format(it) }
+}
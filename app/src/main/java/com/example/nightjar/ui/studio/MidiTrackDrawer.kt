@@ -29,6 +29,7 @@ import com.example.nightjar.ui.theme.NjAccent
 import com.example.nightjar.ui.theme.NjError
 import com.example.nightjar.ui.theme.NjMuted
 import com.example.nightjar.ui.theme.NjAmber
+import com.example.nightjar.ui.theme.NjLedGreen
 import com.example.nightjar.ui.theme.NjLedTeal
 import com.example.nightjar.ui.theme.NjLedYellow
 import com.example.nightjar.ui.theme.NjSurface2
@@ -112,6 +113,12 @@ fun MidiTrackDrawer(
                         isActive = track.isMuted,
                         ledColor = NjLedYellow
                     )
+                    NjButton(
+                        text = "Frz",
+                        onClick = { onAction(StudioAction.SetTrackFrozen(track.id, !track.isFrozen)) },
+                        isActive = track.isFrozen,
+                        ledColor = NjLedGreen
+                    )
                 }
 
                 Spacer(Modifier.width(8.dp))
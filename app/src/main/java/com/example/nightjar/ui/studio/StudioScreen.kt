@@ -554,6 +554,8 @@ fun StudioScreen(
             onOffsetChange = { vm.onAction(StudioAction.SetManualOffset(it)) },
             onClearOffset = { vm.onAction(StudioAction.ClearManualOffset) },
             onToggleReturnToCursor = { vm.onAction(StudioAction.ToggleReturnToCursor) },
+            inputMonitoring = state.isInputMonitoring,
+            onToggleInputMonitoring = { vm.onAction(StudioAction.ToggleInputMonitoring) },
             onDismiss = { vm.onAction(StudioAction.DismissLatencySetup) }
         )
     }
@@ -1314,6 +1316,8 @@ private fun LatencySetupDialog(
     onOffsetChange: (Long) -> Unit,
     onClearOffset: () -> Unit,
     onToggleReturnToCursor: () -> Unit,
+    inputMonitoring: Boolean,
+    onToggleInputMonitoring: () -> Unit,
     onDismiss: () -> Unit
 ) {
     AlertDialog(
@@ -1381,6 +1385,19 @@ private fun LatencySetupDialog(
                         isActive = returnToCursor,
                         ledColor = NjCursorTeal
                     )
+
+                    NjButton(
+                        text = "Monitor input",
+                        onClick = onToggleInputMonitoring,
+                        isActive = inputMonitoring,
+                        ledColor = NjAmber
+                    )
+
+                    Text(
+                        text = "Hear the mic while recording. Use headphones",
+                        style = MaterialTheme.typography.bodySmall,
+                        color = MaterialTheme.colorScheme.onSurface.copy(alpha = 0.4f)
+                    )
                 } else {
                     Text(
                         "Loading…",
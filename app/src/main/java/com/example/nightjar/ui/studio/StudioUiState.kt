@@ -196,6 +196,7 @@ data class StudioUiState(
     val isControlsDrawerOpen: Boolean = false,
     val cursorPositionMs: Long = 0L,
     val returnToCursor: Boolean = true,
+    val isInputMonitoring: Boolean = false,
     val collapsedHeaderTrackIds: Set<Long> = emptySet(),
     val headersCollapsedMode: Boolean = false,
 
@@ -287,6 +288,7 @@ data class StudioUiState(
                 isControlsDrawerOpen == other.isControlsDrawerOpen &&
                 cursorPositionMs == other.cursorPositionMs &&
                 returnToCursor == other.returnToCursor &&
+                isInputMonitoring == other.isInputMonitoring &&
                 collapsedHeaderTrackIds == other.collapsedHeaderTrackIds &&
                 headersCollapsedMode == other.headersCollapsedMode &&
                 splitModeClipId == other.splitModeClipId &&
@@ -357,6 +359,7 @@ data class StudioUiState(
         result = 31 * result + isControlsDrawerOpen.hashCode()
         result = 31 * result + cursorPositionMs.hashCode()
         result = 31 * result + returnToCursor.hashCode()
+        result = 31 * result + isInputMonitoring.hashCode()
         result = 31 * result + collapsedHeaderTrackIds.hashCode()
         result = 31 * result + headersCollapsedMode.hashCode()
         result = 31 * result + (splitModeClipId?.hashCode() ?: 0)
@@ -413,6 +416,8 @@ sealed interface StudioAction {
     data class OpenTrackSettings(val trackId: Long) : StudioAction
     data class SetTrackMuted(val trackId: Long, val muted: Boolean) : StudioAction
     data class SetTrackVolume(val trackId: Long, val volume: Float) : StudioAction
+    /** Play a MIDI or drum track from cached renders instead of the live synth. */
+    data class SetTrackFrozen(val trackId: Long, val frozen: Boolean) : StudioAction
     data class ToggleSolo(val trackId: Long) : StudioAction
 
     // Loop
@@ -512,6 +517,7 @@ sealed interface StudioAction {
     // Cursor / Transport
     data class SetCursorPosition(val positionMs: Long) : StudioAction
     data object ToggleReturnToCursor : StudioAction
+    data object ToggleInputMonitoring : StudioAction
 
     // Metronome
     data object ToggleMetronome : StudioAction
@@ -4,12 +4,12 @@ import android.util.Log
 import androidx.lifecycle.ViewModel
 import androidx.lifecycle.viewModelScope
 import com.example.nightjar.audio.AudioLatencyEstimator
+import com.example.nightjar.audio.ExportState
 import com.example.nightjar.audio.MetronomePreferences
 import com.example.nightjar.audio.MusicalTimeConverter
 import com.example.nightjar.audio.StudioPreferences
 import com.example.nightjar.audio.OboeAudioEngine
 import com.example.nightjar.audio.SoundFontManager
-import com.example.nightjar.audio.WavSplitter
 import com.example.nightjar.data.db.entity.AudioClipEntity
 import com.example.nightjar.data.db.entity.MidiNoteEntity
 import com.example.nightjar.data.db.entity.TakeEntity
@@ -20,7 +20,6 @@ import com.example.nightjar.data.repository.StudioRepository
 import com.example.nightjar.data.repository.IdeaRepository
 import com.example.nightjar.data.storage.RecordingStorage
 import dagger.hilt.android.lifecycle.HiltViewModel
-import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.Job
 import kotlinx.coroutines.delay
 import kotlinx.coroutines.flow.MutableSharedFlow
@@ -30,7 +29,6 @@ import kotlinx.coroutines.flow.asStateFlow
 import kotlinx.coroutines.flow.update
 import kotlinx.coroutines.isActive
 import kotlinx.coroutines.launch
-import kotlinx.coroutines.withContext
 import kotlin.math.abs
 import kotlin.math.roundToLong
 import java.io.File
@@ -93,6 +91,8 @@ class StudioViewModel @Inject constructor(
         private const val MIN_EFFECTIVE_DURATION_MS = 200L
         private const val MIN_LOOP_DURATION_MS = 500L
         private const val TICK_MS = 16L // ~60fps
+        /** Rate of takes recorded before the engine followed the device. */
+        private const val DEFAULT_SAMPLE_RATE = 44100
     }
 
     private val _state = MutableStateFlow(StudioUiState())
@@ -104,6 +104,7 @@ class StudioViewModel @Inject constructor(
     private var recordingStartGlobalMs: Long = 0L
     private var recordingStartNanos: Long = 0L
     private var recordingTrimStartMs: Long = 0L
+    private var isDuplexRecording = false
     private var recordingTickJob: Job? = null
     private var recordingFile: File? = null
     private var tickJob: Job? = null
@@ -111,9 +112,7 @@ class StudioViewModel @Inject constructor(
     // Live waveform amplitude buffer (mirrors RecordViewModel pattern)
     private val amplitudeBuffer = ArrayList<Float>()
 
-    // Loop recording: track loop reset timestamps for post-split
-    private var loopResetTimestampsMs: MutableList<Long> = mutableListOf()
-    private var lastLoopResetCount: Long = 0L
+    // Loop recording: the engine writes one take file per loop pass
     private var isLoopRecording: Boolean = false
     // SoundFont loading (one-time)
     private var soundFontLoaded: Boolean = false
@@ -130,6 +129,13 @@ class StudioViewModel @Inject constructor(
     private var isFirstTrackRecording: Boolean = false
     // Auto-punch-out boundary (ms) -- recording stops when playhead reaches this
     private var autoPunchOutMs: Long? = null
+    // Frozen clips playing as mixer slots, per track: slot id -> its render
+    private val frozenSlots: MutableMap<Long, Map<Int, FrozenClip>> = mutableMapOf()
+    // Renders still to make for frozen tracks, in request order, by output file
+    private val pendingFreezes = LinkedHashMap<File, PendingFreeze>()
+    // Renders that failed this session; their clips stay live instead of retrying
+    private val failedFreezes: MutableSet<File> = mutableSetOf()
+    private var freezeJob: Job? = null
 
     init {
         // Load persisted settings
@@ -138,9 +144,11 @@ class StudioViewModel @Inject constructor(
                 isMetronomeEnabled = metronomePrefs.isEnabled,
                 metronomeVolume = metronomePrefs.volume,
                 countInBars = metronomePrefs.countInBars,
-                returnToCursor = studioPrefs.returnToCursor
+                returnToCursor = studioPrefs.returnToCursor,
+                isInputMonitoring = studioPrefs.inputMonitoring
             )
         }
+        audioEngine.setInputMonitoring(studioPrefs.inputMonitoring)
         audioEngine.setMetronomeVolume(metronomePrefs.volume)
 
         startTick()
@@ -184,19 +192,6 @@ class StudioViewModel @Inject constructor(
                     _effects.emit(StudioEffect.ShowStatus("Punched out"))
                 }
 
-                // Track loop resets during recording for post-split
-                if (isLoopRecording) {
-                    val currentCount = audioEngine.getLoopResetCount()
-                    if (currentCount > lastLoopResetCount) {
-                        val elapsedMs = (System.nanoTime() - recordingStartNanos) / 1_000_000L
-                        for (i in lastLoopResetCount until currentCount) {
-                            loopResetTimestampsMs.add(elapsedMs)
-                            Log.d(TAG, "Loop reset #${loopResetTimestampsMs.size} at ${elapsedMs}ms")
-                        }
-                        lastLoopResetCount = currentCount
-                    }
-                }
-
                 delay(TICK_MS)
             }
         }
@@ -287,6 +282,7 @@ class StudioViewModel @Inject constructor(
                 }
             }
             is StudioAction.SetTrackMuted -> setTrackMuted(action.trackId, action.muted)
+            is StudioAction.SetTrackFrozen -> setTrackFrozen(action.trackId, action.frozen)
             is StudioAction.SetTrackVolume -> setTrackVolume(action.trackId, action.volume)
             is StudioAction.ToggleSolo -> toggleSolo(action.trackId)
 
@@ -445,6 +441,7 @@ class StudioViewModel @Inject constructor(
             // Cursor / Transport
             is StudioAction.SetCursorPosition -> setCursorPosition(action.positionMs)
             StudioAction.ToggleReturnToCursor -> toggleReturnToCursor()
+            StudioAction.ToggleInputMonitoring -> toggleInputMonitoring()
 
             // Metronome
             StudioAction.ToggleMetronome -> toggleMetronome()
@@ -607,12 +604,24 @@ class StudioViewModel @Inject constructor(
      * Load tracks into the native engine using clip-based audio arrangement.
      * For each audio track, loads the active take from each unmuted clip.
      * The engine sees flat track slots (one per clip) -- no C++ changes needed.
+     *
+     * Takes are prepared (converted to the engine rate where needed) before
+     * the old slots go, so the engine keeps playing the previous set meanwhile.
      */
-    private fun loadTracksIntoEngine(
+    private suspend fun loadTracksIntoEngine(
         tracks: List<com.example.nightjar.data.db.entity.TrackEntity>
     ) {
-        audioEngine.removeAllTracks()
         val clipsMap = _state.value.audioClips
+        for (track in tracks) {
+            if (!track.isAudio) continue
+            for (clip in clipsMap[track.id].orEmpty()) {
+                val activeTake = clip.activeTake ?: continue
+                audioEngine.prepareTrackFile(getAudioFile(activeTake.audioFileName).absolutePath)
+            }
+        }
+
+        audioEngine.removeAllTracks()
+        frozenSlots.clear()
 
         for (track in tracks) {
             // Drum and MIDI tracks are handled by the synth engine
@@ -635,6 +644,8 @@ class StudioViewModel @Inject constructor(
                 )
             }
         }
+        // Removing every slot dropped the frozen clips too
+        refreshFrozenTracks()
     }
 
     // ── Arm ────────────────────────────────────────────────────────────────
@@ -694,8 +705,9 @@ class StudioViewModel @Inject constructor(
 
         // Determine if loop recording should be active
         isLoopRecording = st.isLoopEnabled && st.hasLoopRegion
-        loopResetTimestampsMs.clear()
-        lastLoopResetCount = audioEngine.getLoopResetCount()
+        // Only takes on an armed track are split per pass; a first-track
+        // recording keeps the whole session in one file.
+        val splitTakes = isLoopRecording && recordingArmedTrackId != null && !isFirstTrackRecording
 
         viewModelScope.launch {
             try {
@@ -718,15 +730,22 @@ class StudioViewModel @Inject constructor(
 
                 val intendedStartMs = _state.value.cursorPositionMs
 
-                // Phase 1: Start input stream
-                val started = audioEngine.startRecording(file.absolutePath)
+                // Phase 1: Start input stream. Full duplex stamps the take
+                // against the output, so it needs neither the write gate
+                // nor latency compensation; the callback stream is the
+                // fallback where the output isn't running.
+                val duplex = audioEngine.startDuplexRecording(
+                    file.absolutePath, intendedStartMs, splitTakes
+                )
+                isDuplexRecording = duplex
+                val started = duplex || audioEngine.startRecording(file.absolutePath, splitTakes)
                 if (!started) {
                     _state.update { it.copy(isCountingIn = false) }
                     _effects.emit(StudioEffect.ShowError("Failed to start recording."))
                     return@launch
                 }
                 // Phase 2: Pipeline hot
-                audioEngine.awaitFirstBuffer()
+                if (!duplex) audioEngine.awaitFirstBuffer()
 
                 // Seek to cursor position before starting playback for overdub context
                 audioEngine.seekTo(intendedStartMs)
@@ -744,14 +763,18 @@ class StudioViewModel @Inject constructor(
                 }
 
                 // Phase 3: Open write gate -- recording starts as position crosses 0
-                audioEngine.openWriteGate()
-                val writeGateNanos = System.nanoTime()
-
-                val preRollMs = (System.nanoTime() - writeGateNanos) / 1_000_000L
-                val compensation = latencyEstimator.computeCompensationMs(
-                    preRollMs = preRollMs,
-                    hasPlayableTracks = hasPlayableTracks
-                )
+                var preRollMs = 0L
+                var compensation = 0L
+                if (!duplex) {
+                    audioEngine.openWriteGate()
+                    val writeGateNanos = System.nanoTime()
+
+                    preRollMs = (System.nanoTime() - writeGateNanos) / 1_000_000L
+                    compensation = latencyEstimator.computeCompensationMs(
+                        preRollMs = preRollMs,
+                        hasPlayableTracks = hasPlayableTracks
+                    )
+                }
 
                 recordingStartGlobalMs = intendedStartMs
                 recordingTrimStartMs = compensation
@@ -775,7 +798,7 @@ class StudioViewModel @Inject constructor(
                 }
 
                 Log.d(TAG, "Recording started: intendedStart=${intendedStartMs}ms, " +
-                    "preRoll=${preRollMs}ms, compensation=${compensation}ms, " +
+                    "duplex=$duplex, preRoll=${preRollMs}ms, compensation=${compensation}ms, " +
                     "hasPlayableTracks=$hasPlayableTracks, " +
                     "isLoopRecording=$isLoopRecording, " +
                     "armedTrackId=$recordingArmedTrackId, " +
@@ -798,7 +821,9 @@ class StudioViewModel @Inject constructor(
                     while (true) {
                         delay(TICK_MS)
                         val elapsed = (System.nanoTime() - recordingStartNanos) / 1_000_000L
-                        amplitudeBuffer.add(audioEngine.getLatestPeakAmplitude())
+                        audioEngine.drainInputEnvelope { min, max, _ ->
+                            amplitudeBuffer.add(maxOf(-min, max))
+                        }
                         _state.update {
                             it.copy(
                                 recordingElapsedMs = elapsed,
@@ -820,7 +845,7 @@ class StudioViewModel @Inject constructor(
      * Stop recording and save the result. Handles three cases:
      * 1. First track creation (no armed track)
      * 2. Simple take recording (armed track, no loop)
-     * 3. Loop recording with post-split (armed track + loop)
+     * 3. Loop recording, already split into one file per pass (armed track + loop)
      */
     private fun stopRecording() {
         val ideaId = currentIdeaId ?: return
@@ -831,17 +856,23 @@ class StudioViewModel @Inject constructor(
         recordingTickJob = null
 
         val durationMs = audioEngine.stopRecording()
+        val takeFiles = audioEngine.getRecordedTakeFiles()
+        // A duplex take starts at the first frame heard at or after the
+        // cursor, normally the cursor itself
+        if (isDuplexRecording) {
+            val startMs = audioEngine.getRecordedStartMs()
+            if (startMs >= 0) recordingStartGlobalMs = startMs
+            isDuplexRecording = false
+        }
         val file = recordingFile
         recordingFile = null
 
         val wasLoopRecording = isLoopRecording
-        val loopResets = loopResetTimestampsMs.toList()
         val armedId = recordingArmedTrackId
         val wasFirstTrack = isFirstTrackRecording
 
         // Reset recording state
         isLoopRecording = false
-        loopResetTimestampsMs.clear()
         recordingArmedTrackId = null
         isFirstTrackRecording = false
         autoPunchOutMs = null
@@ -869,7 +900,7 @@ class StudioViewModel @Inject constructor(
         Log.d(TAG, "Recording stopped: file=${file.name}, " +
             "durationMs=$durationMs, offsetMs=$recordingStartGlobalMs, " +
             "trimStartMs=$safeTrimStartMs (raw=${recordingTrimStartMs}), " +
-            "loopResets=${loopResets.size}, wasFirstTrack=$wasFirstTrack")
+            "takes=${takeFiles.size}, wasFirstTrack=$wasFirstTrack")
 
         viewModelScope.launch {
             try {
@@ -882,14 +913,12 @@ class StudioViewModel @Inject constructor(
                         offsetMs = recordingStartGlobalMs,
                         trimStartMs = safeTrimStartMs
                     )
-                } else if (armedId != null && wasLoopRecording && loopResets.isNotEmpty()) {
-                    // Case 3: Loop recording -- split into takes within a clip
+                } else if (armedId != null && wasLoopRecording && takeFiles.size > 1) {
+                    // Case 3: Loop recording -- one take per pass within a clip
                     saveLoopRecordingAsTakes(
                         armedTrackId = armedId,
-                        file = file,
-                        totalDurationMs = durationMs,
-                        trimStartMs = safeTrimStartMs,
-                        loopResetTimestampsMs = loopResets
+                        takeFiles = takeFiles,
+                        trimStartMs = safeTrimStartMs
                     )
                 } else if (armedId != null) {
                     // Case 2: Simple recording -- find or create clip at playhead
@@ -928,62 +957,26 @@ class StudioViewModel @Inject constructor(
     }
 
     /**
-     * Split a continuous loop recording into individual takes within a clip.
-     * The recording file is split at the loop reset timestamps,
-     * creating one take per loop cycle in the same clip.
+     * Register a loop recording as takes within a clip. The engine already
+     * wrote one file per loop pass, so this only adds the takes; the
+     * capture compensation applies to the first pass only.
      */
     private suspend fun saveLoopRecordingAsTakes(
         armedTrackId: Long,
-        file: File,
-        totalDurationMs: Long,
-        trimStartMs: Long,
-        loopResetTimestampsMs: List<Long>
+        takeFiles: List<File>,
+        trimStartMs: Long
     ) {
-        val st = _state.value
-        val loopStartMs = st.loopStartMs ?: recordingStartGlobalMs
-        val outputDir = file.parentFile ?: return
-
         // Find or create clip at playhead
         val existingClip = studioRepo.findClipAtPosition(armedTrackId, recordingStartGlobalMs)
         val clipId = existingClip?.id ?: studioRepo.addClip(armedTrackId, recordingStartGlobalMs)
 
-        // Split the WAV file at loop reset points
-        val splitFiles = withContext(Dispatchers.IO) {
-            WavSplitter.split(
-                sourceFile = file,
-                splitPointsMs = loopResetTimestampsMs,
-                outputDir = outputDir,
-                namePrefix = file.nameWithoutExtension + "_take"
-            )
-        }
-
-        if (splitFiles.isEmpty()) {
-            // Split failed or only one segment -- save as a single take
-            Log.w(TAG, "WAV split returned no files, saving as single take")
+        for ((index, takeFile) in takeFiles.withIndex()) {
             studioRepo.addTakeToClip(
                 clipId = clipId,
-                audioFile = file,
-                durationMs = totalDurationMs,
-                trimStartMs = trimStartMs
+                audioFile = takeFile,
+                durationMs = getFileDurationMs(takeFile),
+                trimStartMs = if (index == 0) trimStartMs else 0L
             )
-        } else {
-            // Save each segment as a separate take within the clip
-            for ((index, segFile) in splitFiles.withIndex()) {
-                val segDurationMs = getFileDurationMs(segFile)
-                val segTrimStart = if (index == 0) trimStartMs else 0L
-
-                studioRepo.addTakeToClip(
-                    clipId = clipId,
-                    audioFile = segFile,
-                    durationMs = segDurationMs,
-                    trimStartMs = segTrimStart
-                )
-            }
-
-            // Delete the original unsplit file
-            withContext(Dispatchers.IO) {
-                file.delete()
-            }
         }
 
         studioRepo.recomputeAudioTrackDuration(armedTrackId)
@@ -993,14 +986,24 @@ class StudioViewModel @Inject constructor(
     /** Get the duration of a WAV file in ms from its header. */
     private fun getFileDurationMs(file: File): Long {
         if (!file.exists() || file.length() < 44) return 0L
-        // For PCM WAV at 44100Hz, 16-bit mono: bytesPerMs = 44100 * 2 / 1000 = 88.2
-        // Read from header for accuracy
+        // 16-bit mono PCM; the rate comes from the header, since takes are
+        // recorded at the engine's (device's) rate.
         val dataSize = file.length() - 44
         val bytesPerSample = 2 // 16-bit
         val channels = 1 // mono
-        val sampleRate = 44100
-        val bytesPerMs = (sampleRate.toLong() * bytesPerSample * channels) / 1000L
-        return if (bytesPerMs > 0) dataSize / bytesPerMs else 0L
+        val sampleRate = readWavSampleRate(file)
+        return (dataSize * 1000L) / (sampleRate.toLong() * bytesPerSample * channels)
+    }
+
+    /** Sample rate field of a WAV header (bytes 24..27, little-endian). */
+    private fun readWavSampleRate(file: File): Int {
+        val header = ByteArray(28)
+        file.inputStream().use { if (it.read(header) < header.size) return DEFAULT_SAMPLE_RATE }
+        val rate = (header[24].toInt() and 0xFF) or
+            ((header[25].toInt() and 0xFF) shl 8) or
+            ((header[26].toInt() and 0xFF) shl 16) or
+            ((header[27].toInt() and 0xFF) shl 24)
+        return if (rate > 0) rate else DEFAULT_SAMPLE_RATE
     }
 
     // ── Audio Clips ────────────────────────────────────────────────────────
@@ -1341,6 +1344,13 @@ class StudioViewModel @Inject constructor(
         _state.update { it.copy(returnToCursor = newValue) }
     }
 
+    private fun toggleInputMonitoring() {
+        val newValue = !_state.value.isInputMonitoring
+        studioPrefs.inputMonitoring = newValue
+        audioEngine.setInputMonitoring(newValue)
+        _state.update { it.copy(isInputMonitoring = newValue) }
+    }
+
     // ── Snap helper ─────────────────────────────────────────────────────
 
     /** Snap a ms value to the nearest grid step if snap is enabled. */
@@ -1464,6 +1474,18 @@ class StudioViewModel @Inject constructor(
         }
     }
 
+    private fun setTrackFrozen(trackId: Long, frozen: Boolean) {
+        viewModelScope.launch {
+            try {
+                studioRepo.setTrackFrozen(trackId, frozen)
+                reloadTracks()
+                refreshTrack(trackId)
+            } catch (e: Exception) {
+                _effects.emit(StudioEffect.ShowError(e.message ?: "Failed to update track."))
+            }
+        }
+    }
+
     private fun toggleSolo(trackId: Long) {
         _state.update { st ->
             val newSet = if (trackId in st.soloedTrackIds) {
@@ -1479,20 +1501,23 @@ class StudioViewModel @Inject constructor(
     private fun reapplyEffectiveMute() {
         val st = _state.value
         val anySoloed = st.soloedTrackIds.isNotEmpty()
+        // Audio clip mutes go out as one batch so a solo switches every
+        // clip on the same audio block.
+        audioEngine.submit {
+            for (track in st.tracks) {
+                if (!track.isAudio) continue
+                val muted = track.isMuted ||
+                    (anySoloed && track.id !in st.soloedTrackIds)
+                val clips = st.audioClips[track.id] ?: continue
+                for (clip in clips) {
+                    trackMuted(clip.clipId.toInt(), muted || clip.isMuted)
+                }
+            }
+        }
         for (track in st.tracks) {
             val trackMuted = track.isMuted ||
                 (anySoloed && track.id !in st.soloedTrackIds)
-            if (track.isAudio) {
-                val clips = st.audioClips[track.id]
-                if (clips != null) {
-                    for (clip in clips) {
-                        audioEngine.setTrackMuted(
-                            clip.clipId.toInt(),
-                            trackMuted || clip.isMuted
-                        )
-                    }
-                }
-            } else if (track.isDrum) {
+            if (track.isDrum) {
                 // Re-push pattern with updated mute state
                 val pattern = st.drumPatterns[track.id] ?: continue
                 pushDrumClipsToEngine(track.copy(isMuted = trackMuted), pattern)
@@ -1527,6 +1552,10 @@ class StudioViewModel @Inject constructor(
             try {
                 studioRepo.setTrackVolume(trackId, clamped)
                 reloadTracks()
+                // Volume is baked into a frozen MIDI track's renders
+                if (track != null && track.isMidi && track.isFrozen) {
+                    pushMidiTrackToEngine(trackId)
+                }
             } catch (e: Exception) {
                 _effects.emit(StudioEffect.ShowError(e.message ?: "Failed to update volume."))
             }
@@ -1783,30 +1812,21 @@ class StudioViewModel @Inject constructor(
         track: com.example.nightjar.data.db.entity.TrackEntity,
         drumState: DrumPatternUiState
     ) {
-        val clips = drumState.clips
-        if (clips.isEmpty()) return
-
-        val clipStepsPerBar = IntArray(clips.size)
-        val clipTotalSteps = IntArray(clips.size)
-        val clipBeatsPerBar = IntArray(clips.size)
-        val clipOffsetsMs = LongArray(clips.size)
-        val clipHitCounts = IntArray(clips.size)
+        if (drumState.clips.isEmpty()) return
+        // Frozen clips play from their renders; only the rest are sequenced
+        val frozen = syncFrozenSlots(track.id, frozenDrumClips(track, drumState), track.isMuted)
+        val clips = drumState.clips.filter { FreezeKeys.drumSlotId(it.clipId) !in frozen }
+
+        // Linked clips share a pattern: send each pattern's hits once
+        val patterns = clips.distinctBy { it.patternId }
+        val patternIndex = patterns.withIndex().associate { (i, clip) -> clip.patternId to i }
+        val beatsPerBar = _state.value.timeSignatureNumerator
 
         val allStepIndices = mutableListOf<Int>()
         val allDrumNotes = mutableListOf<Int>()
         val allVelocities = mutableListOf<Float>()
-
-        val beatsPerBar = _state.value.timeSignatureNumerator
-
-        for (i in clips.indices) {
-            val clip = clips[i]
-            clipStepsPerBar[i] = clip.stepsPerBar
-            clipTotalSteps[i] = clip.lengthSteps
-            clipBeatsPerBar[i] = beatsPerBar
-            clipOffsetsMs[i] = clip.offsetMs
-            clipHitCounts[i] = clip.steps.size
-
-            for (step in clip.steps) {
+        for (pattern in patterns) {
+            for (step in pattern.steps) {
                 allStepIndices.add(step.stepIndex)
                 allDrumNotes.add(step.drumNote)
                 allVelocities.add(step.velocity)
@@ -1816,14 +1836,15 @@ class StudioViewModel @Inject constructor(
         audioEngine.updateDrumPatternClips(
             volume = track.volume,
             muted = track.isMuted,
-            clipStepsPerBar = clipStepsPerBar,
-            clipTotalSteps = clipTotalSteps,
-            clipBeatsPerBar = clipBeatsPerBar,
-            clipOffsetsMs = clipOffsetsMs,
-            clipHitCounts = clipHitCounts,
+            patternStepsPerBar = IntArray(patterns.size) { patterns[it].stepsPerBar },
+            patternTotalSteps = IntArray(patterns.size) { patterns[it].lengthSteps },
+            patternBeatsPerBar = IntArray(patterns.size) { beatsPerBar },
+            patternHitCounts = IntArray(patterns.size) { patterns[it].steps.size },
             hitStepIndices = allStepIndices.toIntArray(),
             hitDrumNotes = allDrumNotes.toIntArray(),
-            hitVelocities = allVelocities.toFloatArray()
+            hitVelocities = allVelocities.toFloatArray(),
+            clipPatterns = IntArray(clips.size) { patternIndex.getValue(clips[it].patternId) },
+            clipOffsetsMs = LongArray(clips.size) { clips[it].offsetMs }
         )
     }
 
@@ -1923,8 +1944,11 @@ class StudioViewModel @Inject constructor(
                 }
             )
         }
+        // MIDI notes reach the engine in ticks, so the new tempo map alone
+        // moves them; only the rescaled state above needs updating.
         audioEngine.setBpm(clamped)
-        pushAllMidiToEngine()
+        // Drum renders are tempo-dependent; MIDI ones were re-keyed above
+        refreshFrozenTracks()
 
         val ideaId = currentIdeaId ?: return
         viewModelScope.launch {
@@ -2364,7 +2388,7 @@ class StudioViewModel @Inject constructor(
                         midiTracks = st.midiTracks + (trackId to updatedState)
                     )
                 }
-                pushAllMidiToEngine()
+                pushMidiTrackToEngine(trackId)
             }
         }
     }
@@ -2398,7 +2422,8 @@ class StudioViewModel @Inject constructor(
 
     /**
      * Convert all MIDI tracks to flat arrays and push to the C++ engine.
-     * Applies clip offsets so notes play at their absolute timeline positions.
+     * Clips are placed at their timeline offsets; their notes are sent in
+     * ticks from the clip start, so the engine's tempo map places them.
      */
     private fun pushAllMidiToEngine() {
         val st = _state.value
@@ -2406,6 +2431,7 @@ class StudioViewModel @Inject constructor(
         if (midiTrackEntries.isEmpty()) {
             audioEngine.updateMidiTracks(
                 IntArray(0), IntArray(0), FloatArray(0), BooleanArray(0), IntArray(0),
+                LongArray(0), LongArray(0), IntArray(0),
                 LongArray(0), IntArray(0), IntArray(0), IntArray(0)
             )
             return
@@ -2416,13 +2442,10 @@ class StudioViewModel @Inject constructor(
         val programs = IntArray(trackCount)
         val volumes = FloatArray(trackCount)
         val muted = BooleanArray(trackCount)
-        val trackEventCounts = IntArray(trackCount)
+        val trackClipCounts = IntArray(trackCount)
         val anySoloed = st.soloedTrackIds.isNotEmpty()
 
-        val allFrames = mutableListOf<Long>()
-        val allChannels = mutableListOf<Int>()
-        val allNotes = mutableListOf<Int>()
-        val allVelocities = mutableListOf<Int>()
+        val allClips = mutableListOf<MidiClipFlat>()
 
         for (i in midiTrackEntries.indices) {
             val track = midiTrackEntries[i]
@@ -2434,80 +2457,359 @@ class StudioViewModel @Inject constructor(
             muted[i] = track.isMuted ||
                 (anySoloed && track.id !in st.soloedTrackIds)
 
-            // Generate events from clips with absolute positions
-            val events = generateMidiEventsFromClips(
-                midiState?.clips ?: emptyList(),
-                track.midiChannel
+            val clips = generateMidiClips(
+                liveMidiClips(track, midiState?.clips ?: emptyList(), muted[i]),
+                track.midiChannel,
+                st.bpm
             )
-            trackEventCounts[i] = events.size
-
-            for (event in events) {
-                allFrames.add(event.framePos)
-                allChannels.add(event.channel)
-                allNotes.add(event.note)
-                allVelocities.add(event.velocity)
-            }
+            trackClipCounts[i] = clips.size
+            allClips.addAll(clips)
         }
 
+        val arrays = MidiClipArrays.of(allClips)
         audioEngine.updateMidiTracks(
             channels = channels,
             programs = programs,
             volumes = volumes,
             muted = muted,
-            trackEventCounts = trackEventCounts,
-            eventFrames = allFrames.toLongArray(),
-            eventChannels = allChannels.toIntArray(),
-            eventNotes = allNotes.toIntArray(),
-            eventVelocities = allVelocities.toIntArray()
+            trackClipCounts = trackClipCounts,
+            clipOffsetsMs = arrays.offsetsMs,
+            clipLengthsMs = arrays.lengthsMs,
+            clipEventCounts = arrays.eventCounts,
+            eventTicks = arrays.ticks,
+            eventChannels = arrays.channels,
+            eventNotes = arrays.notes,
+            eventVelocities = arrays.velocities
         )
     }
 
     /**
-     * Generate sorted noteOn/noteOff event pairs from MIDI clips.
-     * Applies clip offsets to convert clip-relative positions to absolute timeline positions.
-     * Honors each clip's `effectiveLengthMs`: notes starting past the clip length
-     * are dropped, and notes crossing the clip boundary get a synthetic noteOff
-     * emitted at exactly `effectiveLengthMs` (the DB note is untouched, so
-     * re-expanding the clip restores the full note next build).
+     * Push a single MIDI track to the C++ engine, leaving the other
+     * tracks' data and playback cursors alone. Falls back to
+     * [pushAllMidiToEngine] when the engine's track list no longer
+     * lines up (e.g. the track was just added).
      */
-    private fun generateMidiEventsFromClips(
-        clips: List<MidiClipUiState>,
-        channel: Int
-    ): List<MidiEventFlat> {
-        val events = mutableListOf<MidiEventFlat>()
-        val sampleRate = 44100L
+    private fun pushMidiTrackToEngine(trackId: Long) {
+        val st = _state.value
+        val midiTrackEntries = st.tracks.filter { it.isMidi }
+        val index = midiTrackEntries.indexOfFirst { it.id == trackId }
+        if (index < 0) {
+            pushAllMidiToEngine()
+            return
+        }
+        val track = midiTrackEntries[index]
+        val anySoloed = st.soloedTrackIds.isNotEmpty()
+        val muted = track.isMuted || (anySoloed && track.id !in st.soloedTrackIds)
+        val arrays = MidiClipArrays.of(
+            generateMidiClips(
+                liveMidiClips(track, st.midiTracks[track.id]?.clips ?: emptyList(), muted),
+                track.midiChannel,
+                st.bpm
+            )
+        )
 
-        for (clip in clips) {
-            val clipLengthMs = clip.effectiveLengthMs
+        val pushed = audioEngine.updateMidiTrack(
+            trackIndex = index,
+            channel = track.midiChannel,
+            program = track.midiProgram,
+            volume = track.volume,
+            muted = muted,
+            clipOffsetsMs = arrays.offsetsMs,
+            clipLengthsMs = arrays.lengthsMs,
+            clipEventCounts = arrays.eventCounts,
+            eventTicks = arrays.ticks,
+            eventChannels = arrays.channels,
+            eventNotes = arrays.notes,
+            eventVelocities = arrays.velocities
+        )
+        if (!pushed) pushAllMidiToEngine()
+    }
+
+    /**
+     * Generate each clip's sorted noteOn/noteOff event pairs, in ticks
+     * from the clip start at [bpm] (the tempo the stored note times were
+     * written at). Notes are sent whole: the engine honors each clip's
+     * `effectiveLengthMs`, dropping notes that start past it and ending
+     * the rest at the clip boundary, so the DB notes stay untouched and
+     * re-expanding a clip restores them.
+     */
+    private fun generateMidiClips(
+        clips: List<MidiClipUiState>,
+        channel: Int,
+        bpm: Double
+    ): List<MidiClipFlat> {
+        val ticksPerMs = bpm * OboeAudioEngine.TICKS_PER_BEAT / 60_000.0
+        return clips.map { clip ->
+            val events = mutableListOf<MidiEventFlat>()
             for (note in clip.notes) {
-                if (clipLengthMs > 0 && note.startMs >= clipLengthMs) continue
-                val rawEndMs = note.startMs + note.durationMs
-                val effectiveEndMs = if (clipLengthMs > 0) rawEndMs.coerceAtMost(clipLengthMs) else rawEndMs
-                val absoluteStartMs = clip.offsetMs + note.startMs
-                val absoluteEndMs = clip.offsetMs + effectiveEndMs
-                val startFrame = (absoluteStartMs * sampleRate) / 1000
-                val endFrame = (absoluteEndMs * sampleRate) / 1000
+                val startTick = (note.startMs * ticksPerMs).roundToLong()
+                val endTick = ((note.startMs + note.durationMs) * ticksPerMs).roundToLong()
                 val velocity = (note.velocity * 127).toInt().coerceIn(1, 127)
 
-                events.add(MidiEventFlat(startFrame, channel, note.pitch, velocity))
-                events.add(MidiEventFlat(endFrame, channel, note.pitch, 0))
+                events.add(MidiEventFlat(startTick, channel, note.pitch, velocity))
+                events.add(MidiEventFlat(endTick, channel, note.pitch, 0))
             }
+            events.sortWith(
+                compareBy<MidiEventFlat> { it.tick }
+                    .thenBy { if (it.velocity == 0) 0 else 1 }
+            )
+            MidiClipFlat(clip.offsetMs, clip.effectiveLengthMs, events)
         }
-
-        events.sortWith(
-            compareBy<MidiEventFlat> { it.framePos }
-                .thenBy { if (it.velocity == 0) 0 else 1 }
-        )
-        return events
     }
 
     private data class MidiEventFlat(
-        val framePos: Long,
+        val tick: Long,
         val channel: Int,
         val note: Int,
         val velocity: Int
     )
 
+    private data class MidiClipFlat(
+        val offsetMs: Long,
+        val lengthMs: Long,
+        val events: List<MidiEventFlat>
+    )
+
+    /** [MidiClipFlat]s flattened into the engine's parallel clip and event arrays. */
+    private class MidiClipArrays(
+        val offsetsMs: LongArray,
+        val lengthsMs: LongArray,
+        val eventCounts: IntArray,
+        val ticks: LongArray,
+        val channels: IntArray,
+        val notes: IntArray,
+        val velocities: IntArray
+    ) {
+        companion object {
+            fun of(clips: List<MidiClipFlat>): MidiClipArrays {
+                val events = clips.flatMap { it.events }
+                return MidiClipArrays(
+                    offsetsMs = LongArray(clips.size) { clips[it].offsetMs },
+                    lengthsMs = LongArray(clips.size) { clips[it].lengthMs },
+                    eventCounts = IntArray(clips.size) { clips[it].events.size },
+                    ticks = LongArray(events.size) { events[it].tick },
+                    channels = IntArray(events.size) { events[it].channel },
+                    notes = IntArray(events.size) { events[it].note },
+                    velocities = IntArray(events.size) { events[it].velocity }
+                )
+            }
+        }
+    }
+
+    // ── Track freeze ───────────────────────────────────────────────────
+    //
+    // A frozen MIDI or drum track plays each clip from a cached stereo
+    // render placed as a mixer slot, instead of through the live synth.
+    // Renders are keyed by clip content (see FreezeKeys): an edit re-keys
+    // the clip, which plays live again until its new render is ready, and
+    // linked siblings share one render. Missing renders are made one at
+    // a time in the background on a detached synth, so freezing never
+    // interrupts playback.
+
+    /** A frozen clip's render and where it sits on the timeline. */
+    private data class FrozenClip(val offsetMs: Long, val file: File)
+
+    private class PendingFreeze(val trackId: Long, val render: suspend () -> ExportState)
+
+    /**
+     * MIDI clips of [track] that still play through the synth: all of
+     * them unless the track is frozen, else those whose render is not
+     * ready yet. The ready ones are synced to mixer slots.
+     */
+    private fun liveMidiClips(
+        track: com.example.nightjar.data.db.entity.TrackEntity,
+        clips: List<MidiClipUiState>,
+        muted: Boolean
+    ): List<MidiClipUiState> {
+        val frozen = syncFrozenSlots(track.id, frozenMidiClips(track, clips), muted)
+        if (frozen.isEmpty()) return clips
+        return clips.filter { FreezeKeys.midiSlotId(it.clipId) !in frozen }
+    }
+
+    /** Ready renders of a frozen MIDI track's clips by slot id; queues the missing ones. */
+    private fun frozenMidiClips(
+        track: com.example.nightjar.data.db.entity.TrackEntity,
+        clips: List<MidiClipUiState>
+    ): Map<Int, FrozenClip> {
+        dropPendingFreezes(track.id)
+        if (!track.isFrozen) return emptyMap()
+        val sampleRate = audioEngine.getSampleRate()
+        val ready = mutableMapOf<Int, FrozenClip>()
+        for (clip in clips) {
+            if (clip.notes.isEmpty() || clip.effectiveLengthMs <= 0L) continue
+            val key = FreezeKeys.midi(clip, track.midiProgram, track.volume, sampleRate)
+            val file = recordingStorage.getFreezeFile(key)
+            if (file in failedFreezes) continue
+            if (file.exists()) {
+                ready[FreezeKeys.midiSlotId(clip.clipId)] = FrozenClip(clip.offsetMs, file)
+            } else {
+                pendingFreezes.getOrPut(file) {
+                    PendingFreeze(track.id) { renderMidiClip(track, clip, file) }
+                }
+            }
+        }
+        return ready
+    }
+
+    /** As [frozenMidiClips] for a drum track's clips, at the current tempo. */
+    private fun frozenDrumClips(
+        track: com.example.nightjar.data.db.entity.TrackEntity,
+        drumState: DrumPatternUiState
+    ): Map<Int, FrozenClip> {
+        dropPendingFreezes(track.id)
+        if (!track.isFrozen) return emptyMap()
+        val st = _state.value
+        val sampleRate = audioEngine.getSampleRate()
+        val ready = mutableMapOf<Int, FrozenClip>()
+        for (clip in drumState.clips) {
+            if (clip.steps.isEmpty()) continue
+            val key = FreezeKeys.drum(
+                clip, track.volume, st.bpm, st.timeSignatureNumerator, sampleRate
+            )
+            val file = recordingStorage.getFreezeFile(key)
+            if (file in failedFreezes) continue
+            if (file.exists()) {
+                ready[FreezeKeys.drumSlotId(clip.clipId)] = FrozenClip(clip.offsetMs, file)
+            } else {
+                val bpm = st.bpm
+                val beatsPerBar = st.timeSignatureNumerator
+                pendingFreezes.getOrPut(file) {
+                    PendingFreeze(track.id) {
+                        renderDrumClip(track.volume, bpm, beatsPerBar, clip, file)
+                    }
+                }
+            }
+        }
+        return ready
+    }
+
+    private fun dropPendingFreezes(trackId: Long) {
+        pendingFreezes.values.removeAll { it.trackId == trackId }
+    }
+
+    /**
+     * Make [trackId]'s frozen slots in the mixer match [clips], touching
+     * only the slots that changed, and start rendering anything queued.
+     * Returns the slot ids now playing; a clip whose render the mixer
+     * rejects is left out, so it keeps playing live.
+     */
+    private fun syncFrozenSlots(
+        trackId: Long,
+        clips: Map<Int, FrozenClip>,
+        muted: Boolean
+    ): Set<Int> {
+        val previous = frozenSlots[trackId].orEmpty()
+        for (slotId in previous.keys) {
+            if (slotId !in clips) audioEngine.removeTrack(slotId)
+        }
+        val playing = mutableMapOf<Int, FrozenClip>()
+        for ((slotId, clip) in clips) {
+            val old = previous[slotId]
+            if (old == clip) {
+                audioEngine.setTrackMuted(slotId, muted)
+                playing[slotId] = clip
+                continue
+            }
+            if (old != null) audioEngine.removeTrack(slotId)
+            if (audioEngine.addFrozenTrack(slotId, clip.file.absolutePath, clip.offsetMs, muted)) {
+                playing[slotId] = clip
+            } else {
+                Log.w(TAG, "Mixer rejected frozen render ${clip.file.name}")
+                failedFreezes.add(clip.file)
+            }
+        }
+        if (playing.isEmpty()) frozenSlots.remove(trackId) else frozenSlots[trackId] = playing
+        startFreezeJob()
+        return playing.keys
+    }
+
+    /** Render queued clips one at a time, swapping each in once it is ready. */
+    private fun startFreezeJob() {
+        if (freezeJob?.isActive == true || pendingFreezes.isEmpty()) return
+        freezeJob = viewModelScope.launch {
+            while (pendingFreezes.isNotEmpty()) {
+                val file = pendingFreezes.keys.first()
+                val pending = pendingFreezes.remove(file) ?: continue
+                if (file.exists()) continue
+                val result = pending.render()
+                if (result == ExportState.FAILED) {
+                    failedFreezes.add(file)
+                    _effects.emit(StudioEffect.ShowError("Failed to freeze track."))
+                }
+                refreshFrozenTracks()
+            }
+        }
+    }
+
+    private suspend fun renderMidiClip(
+        track: com.example.nightjar.data.db.entity.TrackEntity,
+        clip: MidiClipUiState,
+        file: File
+    ): ExportState {
+        val arrays = MidiClipArrays.of(
+            generateMidiClips(listOf(clip), track.midiChannel, _state.value.bpm)
+        )
+        return audioEngine.freezeMidiClip(
+            filePath = file.absolutePath,
+            channel = track.midiChannel,
+            program = track.midiProgram,
+            volume = track.volume,
+            eventTicks = arrays.ticks,
+            eventChannels = arrays.channels,
+            eventNotes = arrays.notes,
+            eventVelocities = arrays.velocities,
+            lengthMs = clip.effectiveLengthMs
+        )
+    }
+
+    private suspend fun renderDrumClip(
+        volume: Float,
+        bpm: Double,
+        beatsPerBar: Int,
+        clip: DrumClipUiState,
+        file: File
+    ): ExportState {
+        // The native side renders at the engine's tempo; a render queued
+        // before a tempo change would land under the wrong key.
+        if (_state.value.bpm != bpm) return ExportState.CANCELLED
+        return audioEngine.freezeDrumClip(
+            filePath = file.absolutePath,
+            volume = volume,
+            stepsPerBar = clip.stepsPerBar,
+            totalSteps = clip.lengthSteps,
+            beatsPerBar = beatsPerBar,
+            hitStepIndices = IntArray(clip.steps.size) { clip.steps[it].stepIndex },
+            hitDrumNotes = IntArray(clip.steps.size) { clip.steps[it].drumNote },
+            hitVelocities = FloatArray(clip.steps.size) { clip.steps[it].velocity }
+        )
+    }
+
+    /** Re-push one MIDI or drum track, re-syncing its frozen slots. */
+    private fun refreshTrack(trackId: Long) {
+        val st = _state.value
+        val track = st.tracks.find { it.id == trackId } ?: return
+        if (track.isMidi) {
+            pushMidiTrackToEngine(trackId)
+        } else if (track.isDrum) {
+            val pattern = st.drumPatterns[trackId] ?: return
+            val anySoloed = st.soloedTrackIds.isNotEmpty()
+            val muted = track.isMuted || (anySoloed && trackId !in st.soloedTrackIds)
+            pushDrumClipsToEngine(track.copy(isMuted = muted), pattern)
+        }
+    }
+
+    /** Re-sync every frozen track, e.g. after a render lands or the slots were cleared. */
+    private fun refreshFrozenTracks() {
+        val st = _state.value
+        // Slots of tracks that were deleted since
+        for (trackId in frozenSlots.keys.toList()) {
+            if (st.tracks.none { it.id == trackId }) syncFrozenSlots(trackId, emptyMap(), true)
+        }
+        for (track in st.tracks) {
+            if (track.isFrozen || track.id in frozenSlots) refreshTrack(track.id)
+        }
+    }
+
     /** Set instrument (GM program) for a MIDI track. */
     private fun setMidiInstrument(trackId: Long, program: Int) {
         viewModelScope.launch {
@@ -2795,6 +3097,7 @@ class StudioViewModel @Inject constructor(
 
     override fun onCleared() {
         super.onCleared()
+        freezeJob?.cancel()
         tickJob?.cancel()
         recordingTickJob?.cancel()
         previewNoteOffJob?.cancel()
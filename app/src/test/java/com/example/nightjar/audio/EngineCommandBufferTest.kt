@@ -0,0 +1,98 @@
+package com.example.nightjar.audio
+
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertTrue
+import org.junit.Test
+
+/**
+ * Unit tests for [EngineCommandBuffer]: the bytes must match the layout
+ * the native decoder in engine_commands.cpp expects.
+ */
+class EngineCommandBufferTest {
+
+    @Test
+    fun `header describes the batch`() {
+        val commands = EngineCommandBuffer()
+        commands.trackVolume(7, 0.5f)
+        commands.busMuted(2, true)
+        val length = commands.finish()
+        val buffer = commands.buffer
+
+        assertEquals(EngineCommandBuffer.MAGIC, buffer.getInt(0))
+        assertEquals(EngineCommandBuffer.FORMAT_VERSION, buffer.getShort(4).toInt())
+        assertEquals(2, buffer.getShort(6).toInt())
+        assertEquals(length, buffer.getInt(8))
+        // Two records of an 8 byte header and an 8 byte payload
+        assertEquals(EngineCommandBuffer.HEADER_BYTES + 2 * 16, length)
+    }
+
+    @Test
+    fun `scalars are aligned within the payload`() {
+        val commands = EngineCommandBuffer()
+        commands.midiTrackRange(
+            trackIndex = 3, startMs = 1000L, endMs = 2000L,
+            clipOffsetsMs = LongArray(0), clipLengthsMs = LongArray(0),
+            clipEventCounts = IntArray(0), eventTicks = LongArray(0),
+            eventChannels = IntArray(0), eventNotes = IntArray(0),
+            eventVelocities = IntArray(0)
+        )
+        commands.finish()
+        val buffer = commands.buffer
+        val payload = EngineCommandBuffer.HEADER_BYTES + EngineCommandBuffer.RECORD_HEADER_BYTES
+
+        assertEquals(EngineCommandBuffer.OP_MIDI_TRACK_RANGE, buffer.getShort(16).toInt())
+        assertEquals(3, buffer.getInt(payload))
+        // The i64 after a lone i32 is padded to the next 8 byte boundary
+        assertEquals(1000L, buffer.getLong(payload + 8))
+        assertEquals(2000L, buffer.getLong(payload + 16))
+    }
+
+    @Test
+    fun `arrays carry a count and start 8 byte aligned`() {
+        val commands = EngineCommandBuffer()
+        commands.tempoMap(longArrayOf(0L, 3840L), doubleArrayOf(120.0, 90.0), intArrayOf(4, 3))
+        val length = commands.finish()
+        val buffer = commands.buffer
+        var pos = EngineCommandBuffer.HEADER_BYTES + EngineCommandBuffer.RECORD_HEADER_BYTES
+
+        assertEquals(2, buffer.getInt(pos))
+        assertEquals(3840L, buffer.getLong(pos + 16))
+        pos += 8 + 16
+        assertEquals(2, buffer.getInt(pos))
+        assertEquals(90.0, buffer.getDouble(pos + 16), 0.0)
+        pos += 8 + 16
+        assertEquals(2, buffer.getInt(pos))
+        assertEquals(3, buffer.getInt(pos + 12))
+        // The trailing i32 array is padded out to the record boundary
+        assertEquals(pos + 16, length)
+        assertEquals(0, (length - EngineCommandBuffer.HEADER_BYTES) % 8)
+    }
+
+    @Test
+    fun `buffer grows and keeps earlier commands`() {
+        val commands = EngineCommandBuffer(initialCapacity = 64)
+        commands.bpm(96.0)
+        commands.drumPatternClips(
+            volume = 1f, muted = false,
+            patternStepsPerBar = intArrayOf(16), patternTotalSteps = intArrayOf(64),
+            patternBeatsPerBar = intArrayOf(4), patternHitCounts = intArrayOf(500),
+            hitStepIndices = IntArray(500) { it % 64 }, hitDrumNotes = IntArray(500) { 36 },
+            hitVelocities = FloatArray(500) { 0.8f },
+            clipPatterns = intArrayOf(0), clipOffsetsMs = longArrayOf(0L)
+        )
+        val length = commands.finish()
+
+        assertTrue(commands.buffer.capacity() >= length)
+        assertEquals(2, commands.buffer.getShort(6).toInt())
+        assertEquals(96.0, commands.buffer.getDouble(EngineCommandBuffer.HEADER_BYTES + 8), 0.0)
+    }
+
+    @Test
+    fun `reset starts an empty batch`() {
+        val commands = EngineCommandBuffer()
+        commands.trackMuted(1, true)
+        commands.reset()
+        assertTrue(commands.isEmpty)
+        assertEquals(EngineCommandBuffer.HEADER_BYTES, commands.finish())
+    }
+}
@@ -0,0 +1,100 @@
+package com.example.nightjar.audio
+
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertFalse
+import org.junit.Assert.assertTrue
+import org.junit.Test
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Unit tests for [EngineStatusReader] and [EngineStatus.playheadFrames],
+ * against a status block laid out as engine_status.h writes it.
+ */
+class EngineStatusReaderTest {
+
+    private val block: ByteBuffer =
+        ByteBuffer.allocateDirect(EngineStatusReader.WORD_COUNT * 8).order(ByteOrder.nativeOrder())
+
+    private fun put(word: Int, value: Long) {
+        block.putLong(word * 8, value)
+    }
+
+    private fun publishTransport(seq: Long, playing: Boolean, position: Long) {
+        put(EngineStatusReader.TRANSPORT_SEQ, seq)
+        put(EngineStatusReader.PLAYING, if (playing) 1L else 0L)
+        put(EngineStatusReader.POSITION_FRAMES, position)
+        put(EngineStatusReader.TOTAL_FRAMES, 480_000L)
+        put(EngineStatusReader.PRESENT_NANOS, 1_000_000_000L)
+        put(EngineStatusReader.SAMPLE_RATE, 48_000L)
+    }
+
+    @Test
+    fun `reads every section`() {
+        publishTransport(seq = 2L, playing = true, position = 96_000L)
+        put(EngineStatusReader.SYNTH_SEQ, 4L)
+        put(EngineStatusReader.METRONOME_BEAT_FRAME, 72_000L)
+        put(EngineStatusReader.INPUT_SEQ, 2L)
+        put(EngineStatusReader.INPUT_PEAK, java.lang.Double.doubleToRawLongBits(0.5))
+
+        val status = EngineStatusReader(block).read()
+
+        assertTrue(status.isPlaying)
+        assertEquals(96_000L, status.positionFrames)
+        assertEquals(48_000, status.sampleRate)
+        assertEquals(72_000L, status.metronomeBeatFrame)
+        assertEquals(0.5f, status.inputPeak, 0f)
+    }
+
+    @Test
+    fun `a section mid-update keeps its last good values`() {
+        val reader = EngineStatusReader(block)
+        publishTransport(seq = 2L, playing = true, position = 96_000L)
+        reader.read()
+
+        // Writer inside its update: odd sequence, fields half written
+        publishTransport(seq = 3L, playing = false, position = 0L)
+        val status = reader.read()
+
+        assertTrue(status.isPlaying)
+        assertEquals(96_000L, status.positionFrames)
+    }
+
+    @Test
+    fun `beat frame defaults to none`() {
+        assertEquals(-1L, EngineStatusReader(block).read().metronomeBeatFrame)
+    }
+
+    @Test
+    fun `playhead extrapolates from the presented frame`() {
+        val status = EngineStatus(
+            isPlaying = true, positionFrames = 48_000L, totalFrames = 480_000L,
+            presentNanos = 1_000_000_000L, sampleRate = 48_000
+        )
+        // Before the block is heard the playhead holds
+        assertEquals(48_000L, status.playheadFrames(900_000_000L))
+        // 10 ms after: 480 frames on
+        assertEquals(48_480L, status.playheadFrames(1_010_000_000L))
+        // A stalled stream stops at the extrapolation cap
+        val capped = 48_000L + EngineStatus.MAX_EXTRAPOLATION_NANOS * 48_000 / 1_000_000_000L
+        assertEquals(capped, status.playheadFrames(60_000_000_000L))
+    }
+
+    @Test
+    fun `paused playhead is the block position`() {
+        val status = EngineStatus(
+            isPlaying = false, positionFrames = 12_345L, presentNanos = 0L, sampleRate = 48_000
+        )
+        assertFalse(status.isPlaying)
+        assertEquals(12_345L, status.playheadFrames(5_000_000_000L))
+    }
+
+    @Test
+    fun `playhead stops at the end of the timeline`() {
+        val status = EngineStatus(
+            isPlaying = true, positionFrames = 479_900L, totalFrames = 480_000L,
+            presentNanos = 0L, sampleRate = 48_000
+        )
+        assertEquals(480_000L, status.playheadFrames(50_000_000L))
+    }
+}
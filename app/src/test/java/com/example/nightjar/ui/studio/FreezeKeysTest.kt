@@ -0,0 +1,63 @@
+package com.example.nightjar.ui.studio
+
+import com.example.nightjar.data.db.entity.DrumStepEntity
+import com.example.nightjar.data.db.entity.MidiNoteEntity
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertNotEquals
+import org.junit.Assert.assertTrue
+import org.junit.Test
+
+/**
+ * Unit tests for [FreezeKeys]: a render key must follow a clip's sound
+ * and nothing else, so linked siblings share a render and edits re-key.
+ */
+class FreezeKeysTest {
+
+    private fun note(clipId: Long, pitch: Int = 60, startMs: Long = 0L) = MidiNoteEntity(
+        trackId = 1L, clipId = clipId, pitch = pitch, startMs = startMs, durationMs = 500L
+    )
+
+    private fun midiClip(clipId: Long, offsetMs: Long, notes: List<MidiNoteEntity>) =
+        MidiClipUiState(clipId = clipId, offsetMs = offsetMs, notes = notes, effectiveLengthMs = 2000L)
+
+    private fun drumClip(clipId: Long, offsetMs: Long) = DrumClipUiState(
+        clipId = clipId,
+        offsetMs = offsetMs,
+        patternId = 3L,
+        steps = listOf(DrumStepEntity(patternId = 3L, stepIndex = 0, drumNote = 36))
+    )
+
+    @Test
+    fun `linked midi siblings share a key`() {
+        val a = midiClip(1L, offsetMs = 0L, notes = listOf(note(1L), note(1L, pitch = 64)))
+        val b = midiClip(2L, offsetMs = 4000L, notes = listOf(note(2L, pitch = 64), note(2L)))
+        assertEquals(FreezeKeys.midi(a, 0, 0.8f, 48000), FreezeKeys.midi(b, 0, 0.8f, 48000))
+    }
+
+    @Test
+    fun `midi edits change the key`() {
+        val clip = midiClip(1L, offsetMs = 0L, notes = listOf(note(1L)))
+        val base = FreezeKeys.midi(clip, 0, 0.8f, 48000)
+        val moved = clip.copy(notes = listOf(note(1L, startMs = 10L)))
+        assertNotEquals(base, FreezeKeys.midi(moved, 0, 0.8f, 48000))
+        assertNotEquals(base, FreezeKeys.midi(clip.copy(effectiveLengthMs = 4000L), 0, 0.8f, 48000))
+        assertNotEquals(base, FreezeKeys.midi(clip, 1, 0.8f, 48000))
+        assertNotEquals(base, FreezeKeys.midi(clip, 0, 0.5f, 48000))
+        assertNotEquals(base, FreezeKeys.midi(clip, 0, 0.8f, 44100))
+    }
+
+    @Test
+    fun `drum key follows tempo but not offset`() {
+        val a = drumClip(1L, offsetMs = 0L)
+        val b = drumClip(2L, offsetMs = 2000L)
+        assertEquals(FreezeKeys.drum(a, 1f, 120.0, 4, 48000), FreezeKeys.drum(b, 1f, 120.0, 4, 48000))
+        assertNotEquals(FreezeKeys.drum(a, 1f, 120.0, 4, 48000), FreezeKeys.drum(a, 1f, 90.0, 4, 48000))
+    }
+
+    @Test
+    fun `midi and drum slot ids never collide`() {
+        val ids = (1L..50L).flatMap { listOf(FreezeKeys.midiSlotId(it), FreezeKeys.drumSlotId(it)) }
+        assertEquals(ids.size, ids.toSet().size)
+        assertTrue(ids.all { it < 0 })
+    }
+}